@@ -56,7 +56,6 @@ typedef pthread_spinlock_t ptlock_t;
 #  define GL_UNLOCK(lock)				pthread_spin_unlock((pthread_spinlock_t *) lock)
 #elif defined(TAS)			/* TAS */
 #  if RETRY_STATS == 1
-extern RETRY_STATS_VARS;
 #    define PTLOCK_SIZE 32		/* choose 8, 16, 32, 64 */
 typedef struct tticket
 {
@@ -31,10 +31,13 @@
 
 #define UNIFORM_WORKLOAD 1
 
+/* TEST_LOOP takes the operations from the thread's op stream ops (op_stream.h)
+   when there is one, else from my_random() */
+
 #if UNIFORM_WORKLOAD == 0
 #  define TEST_LOOP(algo_type)						\
-  c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));	\
-  key = (c & rand_max) + rand_min;					\
+  OP_STREAM_OR_RAND_NXT(ops, ops_idx, op_stream_len - 1, c, key,	\
+			seeds, rand_max, rand_min);			\
   if (!phase_put && c > phase_put_threshold_start)			\
     {									\
       phase_start = getticks();						\
@@ -44,7 +47,7 @@
   else if (phase_put && c > phase_put_threshold_stop)			\
     {									\
       phase_stop = getticks();						\
-      if (!ID) printf("[%2u]phase dur = %f\n", ID, (phase_stop-phase_start)/2.8e9); \
+      if (!ID) printf("[%2u]phase dur = %f\n", ID, ticks_to_ns(phase_stop-phase_start) / 1e9); \
       phase_put = 0;							\
     }									\
 									\
@@ -97,8 +100,8 @@
 #else
 
 #  define TEST_LOOP(algo_type)						\
-  c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));	\
-  key = (c & rand_max) + rand_min;					\
+  OP_STREAM_OR_RAND_NXT(ops, ops_idx, op_stream_len - 1, c, key,	\
+			seeds, rand_max, rand_min);			\
 									\
   if (unlikely(c <= scale_put))						\
     {									\
@@ -0,0 +1,169 @@
+/*
+ *   File: mem_footprint.h
+ *   Description: the memory that a table uses, as its adapter reports it, and
+ *   the memory of the process, sampled at the phases of a run
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _MEM_FOOTPRINT_H_
+#define _MEM_FOOTPRINT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <unistd.h>
+
+/* The adapter of each table fills a mem_footprint_t. The first four fields are
+   disjoint, and their sum is the memory of the table itself. The allocator
+   fields describe the allocator that the nodes or values come from, which
+   other users may share: they are printed apart, and are not in the sum. */
+typedef struct mem_footprint
+{
+  size_t table;			/* the live bucket arrays and their headers, without locks */
+  size_t locks;			/* lock arrays, or the locks inside the buckets */
+  size_t overflow;		/* chained or overflow buckets and entries */
+  size_t garbage;		/* retired tables and lock arrays that are not freed yet */
+  const char* alloc;		/* the allocator of the nodes or values, or NULL */
+  size_t alloc_reserved;	/* what it holds from the system */
+  size_t alloc_used;		/* what it handed out and did not get back */
+  size_t alloc_garbage;		/* what it got back and cannot reuse yet */
+} mem_footprint_t;
+
+static inline size_t
+mem_footprint_total(const mem_footprint_t* f)
+{
+  return f->table + f->locks + f->overflow + f->garbage;
+}
+
+/* the malloc heap of the process, as the allocator of tables that use malloc */
+static inline void
+mem_footprint_malloc(mem_footprint_t* f)
+{
+  f->alloc = "malloc";
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+#elif defined(__GLIBC__)
+  struct mallinfo mi = mallinfo();
+#endif
+#if defined(__GLIBC__)
+  f->alloc_reserved = (size_t) mi.arena + (size_t) mi.hblkhd;
+  f->alloc_used = (size_t) mi.uordblks + (size_t) mi.hblkhd;
+#endif
+  f->alloc_garbage = 0;
+}
+
+/* #footprint: table: .. KB | locks: .. | overflow: .. | garbage: .. | total: .. KB
+   (.. B/key) | <alloc>: reserved: .. KB, used: .., garbage: .. */
+static inline void
+mem_footprint_print(const mem_footprint_t* f, size_t keys)
+{
+  const size_t total = mem_footprint_total(f);
+  printf("#footprint: table: %.1f KB | locks: %.1f KB | overflow: %.1f KB"
+	 " | garbage: %.1f KB | total: %.1f KB (%.1f B/key)",
+	 f->table / 1024.0, f->locks / 1024.0, f->overflow / 1024.0,
+	 f->garbage / 1024.0, total / 1024.0, keys ? (double) total / keys : 0.0);
+  if (f->alloc != NULL)
+    {
+      printf(" | %s: reserved: %.1f KB, used: %.1f KB, garbage: %.1f KB",
+	     f->alloc, f->alloc_reserved / 1024.0, f->alloc_used / 1024.0,
+	     f->alloc_garbage / 1024.0);
+    }
+  printf("\n");
+}
+
+/* the memory of the process, in bytes, from /proc/self/smaps_rollup, or only
+   rss from /proc/self/statm on kernels without it (before 4.14) */
+typedef struct mem_process
+{
+  size_t rss;
+  size_t pss;
+  size_t anon;
+  size_t anon_huge;		/* the part of anon in transparent huge pages */
+  size_t swap;
+} mem_process_t;
+
+static inline int
+mem_process_sample(mem_process_t* m)
+{
+  memset(m, 0, sizeof(mem_process_t));
+  FILE* f = fopen("/proc/self/smaps_rollup", "r");
+  if (f != NULL)
+    {
+      char line[256];
+      unsigned long long kb;
+      while (fgets(line, sizeof(line), f) != NULL)
+	{
+	  if (sscanf(line, "Rss: %llu kB", &kb) == 1)
+	    m->rss = kb * 1024;
+	  else if (sscanf(line, "Pss: %llu kB", &kb) == 1)
+	    m->pss = kb * 1024;
+	  else if (sscanf(line, "Anonymous: %llu kB", &kb) == 1)
+	    m->anon = kb * 1024;
+	  else if (sscanf(line, "AnonHugePages: %llu kB", &kb) == 1)
+	    m->anon_huge = kb * 1024;
+	  else if (sscanf(line, "Swap: %llu kB", &kb) == 1)
+	    m->swap = kb * 1024;
+	}
+      fclose(f);
+      return 0;
+    }
+
+  f = fopen("/proc/self/statm", "r");
+  if (f == NULL)
+    {
+      return -1;
+    }
+  unsigned long long size, resident;
+  if (fscanf(f, "%llu %llu", &size, &resident) == 2)
+    {
+      m->rss = resident * sysconf(_SC_PAGESIZE);
+    }
+  fclose(f);
+  return 0;
+}
+
+/* #mem <phase>: rss: .. MB | pss: .. | anon: .. | anon_huge: .. | swap: .. */
+static inline void
+mem_process_print(const char* phase, const mem_process_t* m)
+{
+  printf("#mem %s: rss: %.2f MB | pss: %.2f MB | anon: %.2f MB | anon_huge: %.2f MB"
+	 " | swap: %.2f MB\n", phase, m->rss / (1024.0 * 1024.0),
+	 m->pss / (1024.0 * 1024.0), m->anon / (1024.0 * 1024.0),
+	 m->anon_huge / (1024.0 * 1024.0), m->swap / (1024.0 * 1024.0));
+}
+
+/* #mem efficiency: .. Mops/s per GB of rss | .. per GB of table */
+static inline void
+mem_efficiency_print(double ops_per_ms, const mem_process_t* m, const mem_footprint_t* f)
+{
+  const double gb = 1024.0 * 1024.0 * 1024.0;
+  const double mops = ops_per_ms / 1000.0;
+  printf("#mem efficiency: %.1f Mops/s per GB of rss", m->rss ? mops * gb / m->rss : 0.0);
+  if (f != NULL && mem_footprint_total(f))
+    {
+      printf(" | %.1f Mops/s per GB of table", mops * gb / mem_footprint_total(f));
+    }
+  printf("\n");
+}
+
+#endif	/* _MEM_FOOTPRINT_H_ */
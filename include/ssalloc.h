@@ -43,20 +43,26 @@
 
 #define SSALLOC_NUM_ALLOCATORS 2
 
-#if defined(__sparc__)
-#  define SSALLOC_SIZE (128LL * 1024 * 1024)
-#elif defined(__tile__)
-#  define SSALLOC_SIZE (100 * 1024 * 1024)
-#elif defined(LAPTOP) | defined(IGORLAPTOPLINUX) | defined(OANALAPTOPLINUX)
-#  define SSALLOC_SIZE (100 * 1024 * 1024)
-#else
-#  define SSALLOC_SIZE (1024 * 1024 * 1024)
-#endif
+/* Every thread has an arena per allocator, which grows on demand by chunks of
+   SSALLOC_CHUNK_SIZE bytes, mapped aligned to their size (huge pages, unless
+   SSALLOC_NO_HUGEPAGES is defined) and only touched when they are used; with
+   NUMA defined, they are bound to the node of the thread before that.
+   A chunk is cut into runs of SSALLOC_RUN_SIZE bytes, each serving one size
+   class, whose header lets ssfree() put an object back on the free list of
+   its class. Objects larger than SSALLOC_MAX_SMALL get a mapping of their own,
+   which ssfree() unmaps. Once the objects on the free lists of a thread add
+   up to SSALLOC_TRIM_SIZE bytes, ssalloc looks for chunks whose objects are
+   all free, and gives their memory back (madvise(MADV_DONTNEED)); the chunks
+   are reused before new ones are mapped. */
+#define SSALLOC_CHUNK_SIZE (2 * 1024 * 1024L)
+#define SSALLOC_RUN_SIZE (64 * 1024L)
+#define SSALLOC_RUN_HEADER 64
+#define SSALLOC_MAX_SMALL (8 * 1024L)
+#define SSALLOC_NUM_CLASSES 24
+#define SSALLOC_TRIM_SIZE (64 * 1024 * 1024L)
 
 
-void ssalloc_set(void* mem);
 void ssalloc_init();
-void ssalloc_offset(size_t size);
 void* ssalloc_alloc(unsigned int allocator, size_t size);
 void* ssalloc_aligned_alloc(unsigned int allocator, size_t alignment, size_t size);
 void ssfree_alloc(unsigned int allocator, void* ptr);
@@ -65,4 +71,10 @@ void* ssalloc_aligned(size_t alignment, size_t size);
 
 void ssfree(void* ptr);
 
+/* gives the memory of the chunks of allocator whose objects are all free
+   back to the OS, and returns how many bytes it gave back */
+size_t ssalloc_trim(unsigned int allocator);
+/* bytes the thread has mapped for allocator */
+size_t ssalloc_mapped(unsigned int allocator);
+
 #endif
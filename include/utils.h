@@ -725,22 +725,18 @@ static __attribute__ ((unused)) double eng_per_test_iter_nj[40][5] =
     while (wtime() < __ts_end);
   }
 
-  //getticks needs to have a correction because the call itself takes a
-  //significant number of cycles and skewes the measurement
-  extern ticks getticks_correction_calc();
-
   static inline ticks get_noop_duration() {
 #define NOOP_CALC_REPS 1000000
     ticks noop_dur = 0;
     uint32_t i;
-    ticks corr = getticks_correction_calc();
+    ticks corr = getticks_overhead();
     ticks start;
     ticks end;
-    start = getticks();
+    start = getticks_start();
     for (i=0;i<NOOP_CALC_REPS;i++) {
       __asm__ __volatile__("nop");
     }
-    end = getticks();
+    end = getticks_stop();
     noop_dur = (ticks)((end-start-corr)/(double)NOOP_CALC_REPS);
     return noop_dur;
   }
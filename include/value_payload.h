@@ -0,0 +1,267 @@
+/*
+ *   File: value_payload.h
+ *   Description: values of configurable sizes, that puts write and gets read
+ *   back in full
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _VALUE_PAYLOAD_H_
+#define _VALUE_PAYLOAD_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* A payload is a whole number of 8-byte words. The first word holds the size of
+   the payload in bytes (upper 32 bits) and the key (lower 32 bits), the others a
+   pattern derived from the key. Puts write every word of it, and gets sum every
+   word, so that the cost of moving the value is part of each operation.
+
+   The sizes follow one of these distributions, given as a string (-z):
+     fixed:<bytes>
+     uniform:<min>:<max>
+     bimodal:<small>:<large>:<percentage of large>
+     trace:<file>   sizes sampled from the file: a size per line, optionally
+                    followed by its count (lines starting with # are skipped)
+   Sizes are rounded up to a multiple of 8, and clamped to [8, cap] where cap is
+   the room the table has for a value.
+
+   Include this file after my_random() is defined. */
+
+#define PAYLOAD_MIN          8
+#define PAYLOAD_MAX          (64 * 1024)
+#define PAYLOAD_WORDS(bytes) (((bytes) + 7) / 8)
+
+typedef enum
+{
+  PAYLOAD_NONE = 0,		/* no payload: the driver's own values */
+  PAYLOAD_FIXED,
+  PAYLOAD_UNIFORM,
+  PAYLOAD_BIMODAL,
+  PAYLOAD_TRACE
+} payload_dist_t;
+
+typedef struct payload_conf
+{
+  payload_dist_t dist;
+  uint32_t a;			/* fixed size; uniform min; bimodal small */
+  uint32_t b;			/* uniform max; bimodal large */
+  uint32_t pct_b;		/* bimodal: percentage of the large size */
+  uint32_t* trace_size;		/* trace: the sizes, */
+  uint64_t* trace_cum;		/* and the running sum of their counts */
+  size_t trace_len;
+} payload_conf_t;
+
+static inline uint32_t
+payload_round(uint64_t bytes, uint32_t cap)
+{
+  bytes = (bytes + 7) & ~7ULL;
+  if (bytes < PAYLOAD_MIN)
+    {
+      bytes = PAYLOAD_MIN;
+    }
+  return bytes > cap ? cap : (uint32_t) bytes;
+}
+
+static inline int
+payload_load_trace(payload_conf_t* conf, const char* path, uint32_t cap)
+{
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    {
+      perror("payload: trace");
+      return -1;
+    }
+
+  size_t room = 1024;
+  conf->trace_size = (uint32_t*) malloc(room * sizeof(uint32_t));
+  conf->trace_cum = (uint64_t*) malloc(room * sizeof(uint64_t));
+  conf->trace_len = 0;
+  uint64_t total = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != NULL)
+    {
+      unsigned long long size, count = 1;
+      if (line[0] == '#' || sscanf(line, "%llu %llu", &size, &count) < 1 || count == 0)
+	{
+	  continue;
+	}
+      if (conf->trace_len == room)
+	{
+	  room *= 2;
+	  conf->trace_size = (uint32_t*) realloc(conf->trace_size, room * sizeof(uint32_t));
+	  conf->trace_cum = (uint64_t*) realloc(conf->trace_cum, room * sizeof(uint64_t));
+	}
+      total += count;
+      conf->trace_size[conf->trace_len] = payload_round(size, cap);
+      conf->trace_cum[conf->trace_len] = total;
+      conf->trace_len++;
+    }
+  fclose(f);
+
+  if (conf->trace_len == 0)
+    {
+      fprintf(stderr, "payload: no sizes in %s\n", path);
+      return -1;
+    }
+  return 0;
+}
+
+/* reads the distribution spec into conf; returns 0, or -1 if spec is wrong */
+static inline int
+payload_parse(payload_conf_t* conf, const char* spec, uint32_t cap)
+{
+  unsigned long long a = 0, b = 0, pct = 0;
+  memset(conf, 0, sizeof(payload_conf_t));
+  if (sscanf(spec, "fixed:%llu", &a) == 1)
+    {
+      conf->dist = PAYLOAD_FIXED;
+    }
+  else if (sscanf(spec, "uniform:%llu:%llu", &a, &b) == 2 && a <= b)
+    {
+      conf->dist = PAYLOAD_UNIFORM;
+    }
+  else if (sscanf(spec, "bimodal:%llu:%llu:%llu", &a, &b, &pct) == 3 && pct <= 100)
+    {
+      conf->dist = PAYLOAD_BIMODAL;
+      conf->pct_b = (uint32_t) pct;
+    }
+  else if (!strncmp(spec, "trace:", 6))
+    {
+      conf->dist = PAYLOAD_TRACE;
+      return payload_load_trace(conf, spec + 6, cap);
+    }
+  else
+    {
+      fprintf(stderr, "payload: unknown value sizes '%s'\n", spec);
+      return -1;
+    }
+  conf->a = payload_round(a, cap);
+  conf->b = payload_round(b, cap);
+  return 0;
+}
+
+/* the size of the next payload */
+static inline uint32_t
+payload_size(const payload_conf_t* conf, unsigned long* seeds)
+{
+  const uint64_t r = my_random(&(seeds[0]), &(seeds[1]), &(seeds[2]));
+  switch (conf->dist)
+    {
+    case PAYLOAD_UNIFORM:
+      return conf->a + 8 * (uint32_t) (r % ((conf->b - conf->a) / 8 + 1));
+    case PAYLOAD_BIMODAL:
+      return (r % 100) < conf->pct_b ? conf->b : conf->a;
+    case PAYLOAD_TRACE:
+      {
+	const uint64_t x = r % conf->trace_cum[conf->trace_len - 1];
+	size_t lo = 0, hi = conf->trace_len - 1;
+	while (lo < hi)
+	  {
+	    const size_t mid = (lo + hi) / 2;
+	    if (conf->trace_cum[mid] > x)
+	      {
+		hi = mid;
+	      }
+	    else
+	      {
+		lo = mid + 1;
+	      }
+	  }
+	return conf->trace_size[lo];
+      }
+    default:
+      return conf->a;
+    }
+}
+
+/* the mean size of the payloads, in bytes */
+static inline double
+payload_mean(const payload_conf_t* conf)
+{
+  switch (conf->dist)
+    {
+    case PAYLOAD_UNIFORM:
+      return (conf->a + conf->b) / 2.0;
+    case PAYLOAD_BIMODAL:
+      return conf->a + (conf->b - (double) conf->a) * conf->pct_b / 100.0;
+    case PAYLOAD_TRACE:
+      {
+	double sum = 0;
+	uint64_t prev = 0;
+	size_t i;
+	for (i = 0; i < conf->trace_len; i++)
+	  {
+	    sum += (double) conf->trace_size[i] * (conf->trace_cum[i] - prev);
+	    prev = conf->trace_cum[i];
+	  }
+	return sum / prev;
+      }
+    default:
+      return conf->a;
+    }
+}
+
+static inline void
+payload_write(void* dst, uint32_t bytes, uint64_t key)
+{
+  uint64_t* w = (uint64_t*) dst;
+  const size_t words = PAYLOAD_WORDS(bytes);
+  size_t i;
+  w[0] = ((uint64_t) bytes << 32) | (uint32_t) key;
+  for (i = 1; i < words; i++)
+    {
+      w[i] = (key + i) * 0x9E3779B97F4A7C15ULL;
+    }
+}
+
+static inline uint32_t
+payload_bytes(const void* src)
+{
+  return (uint32_t) (((const uint64_t*) src)[0] >> 32);
+}
+
+/* reads every word of the payload at src */
+static inline uint64_t
+payload_sum(const void* src)
+{
+  const uint64_t* w = (const uint64_t*) src;
+  const size_t words = PAYLOAD_WORDS(payload_bytes(src));
+  uint64_t sum = 0;
+  size_t i;
+  for (i = 0; i < words; i++)
+    {
+      sum += w[i];
+    }
+  return sum;
+}
+
+/* #payload: <spec> | mean: <bytes> B | written: <MB> | read: <MB> */
+static inline void
+payload_print(const payload_conf_t* conf, const char* spec, uint64_t written, uint64_t read)
+{
+  printf("#payload: %s | mean: %.1f B | written: %.2f MB | read: %.2f MB\n",
+	 spec, payload_mean(conf), written / (1024.0 * 1024.0), read / (1024.0 * 1024.0));
+}
+
+#endif	/* _VALUE_PAYLOAD_H_ */
@@ -7,10 +7,13 @@ initial_size=(1000 10000 100000 1000000 10000000)
 #algs=(LFList LFArray LFArrayOpt SO AdaptiveArray AdaptiveArrayOpt WFList WFArray Benchmark )
 #algs=(lf-ht_rcu_np hop_no_htm )
 algs=(hop_htm)
+baselines=(null private-std private-oa locked-std sharded-rw)
+# the baseline the throughput of the tables is divided by, in *.rel.csv
+reference=private-oa
 
 for ratio in ${update_rate[*]}
 do
-    for alg in ${algs[*]}
+    for alg in ${algs[*]} ${baselines[*]}
     do
         for thr in ${threads[*]}
         do
@@ -32,3 +35,17 @@ do
         done
     done
 done
+
+# threads, average and median throughput of each table over the reference
+for ratio in ${update_rate[*]}
+do
+    for alg in ${algs[*]}
+    do
+        for initial in ${initial_size[*]}
+        do
+            ofile=./csv/$alg."u$ratio"."i$initial".csv
+            rfile=./csv/$reference."u$ratio"."i$initial".csv
+            paste -d, $ofile $rfile | awk -F, '$5 > 0 && $6 > 0 { printf "%s, %.4f, %.4f\n", $1, $2 / $5, $3 / $6 }' > ./csv/$alg."u$ratio"."i$initial".rel.csv
+        done
+    done
+done
@@ -38,17 +38,44 @@ set xtics 8
 set output './eps/HopU10.eps'
 plot  \
 	"./csv/hop_htm.u10.i1000000.csv"			u 1:($2/1000) w lp lc rgb "light-red" lw 5 pt 8 ps 2 t 'Hop_htm', \
-	"./csv/hop_fine_grained.u10.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained'	
+	"./csv/hop_fine_grained.u10.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained', \
+	"./csv/private-oa.u10.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray40" lw 3 dt 2 t 'Private (OA)', \
+	"./csv/locked-std.u10.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray60" lw 3 dt 3 t 'Global lock', \
+	"./csv/sharded-rw.u10.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray20" lw 3 dt 4 t 'Sharded RW'	
 
 set output './eps/HopU0.eps'
 plot  \
 	"./csv/hop_htm.u0.i1000000.csv"			u 1:($2/1000) w lp lc rgb "light-red" lw 5 pt 8 ps 2 t 'Hop_htm', \
-	"./csv/hop_fine_grained.u0.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained'	
+	"./csv/hop_fine_grained.u0.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained', \
+	"./csv/private-oa.u0.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray40" lw 3 dt 2 t 'Private (OA)', \
+	"./csv/locked-std.u0.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray60" lw 3 dt 3 t 'Global lock', \
+	"./csv/sharded-rw.u0.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray20" lw 3 dt 4 t 'Sharded RW'	
 
 
 set output './eps/HopU80.eps'
 plot  \
 	"./csv/hop_htm.u80.i1000000.csv"			u 1:($2/1000) w lp lc rgb "light-red" lw 5 pt 8 ps 2 t 'Hop_htm', \
-	"./csv/hop_fine_grained.u80.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained'	
+	"./csv/hop_fine_grained.u80.i1000000.csv"		u 1:($2/1000) w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained', \
+	"./csv/private-oa.u80.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray40" lw 3 dt 2 t 'Private (OA)', \
+	"./csv/locked-std.u80.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray60" lw 3 dt 3 t 'Global lock', \
+	"./csv/sharded-rw.u80.i1000000.csv"			u 1:($2/1000) w l lc rgb "gray20" lw 3 dt 4 t 'Sharded RW'	
 
 
+
+# the tables as a fraction of the thread-private open-addressing baseline
+# (mkcsv.sh writes the *.rel.csv files)
+set ylabel 'Throughput / private' font 'Helvetica,35'
+set ytic 0.25
+set yrange [0:1.25]
+
+set output './eps/HopU10Rel.eps'
+plot  \
+	"./csv/hop_htm.u10.i1000000.rel.csv"			u 1:2 w lp lc rgb "light-red" lw 5 pt 8 ps 2 t 'Hop_htm', \
+	"./csv/hop_fine_grained.u10.i1000000.rel.csv"		u 1:2 w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained', \
+	1 w l lc rgb "gray40" lw 3 dt 2 t 'Private (OA)'
+
+set output './eps/HopU80Rel.eps'
+plot  \
+	"./csv/hop_htm.u80.i1000000.rel.csv"			u 1:2 w lp lc rgb "light-red" lw 5 pt 8 ps 2 t 'Hop_htm', \
+	"./csv/hop_fine_grained.u80.i1000000.rel.csv"		u 1:2 w lp lc rgb "orange" lw 5 pt 6 ps 2 t 'Hop_fine_grained', \
+	1 w l lc rgb "gray40" lw 3 dt 2 t 'Private (OA)'
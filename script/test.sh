@@ -7,11 +7,18 @@ initial_size=(1000 10000 100000 1000000 10000000)
 #algs=(LFList LFArray LFArrayOpt SO AdaptiveArray AdaptiveArrayOpt WFList WFArray Benchmark )
 #algs=(lf-ht_rcu_np)
 algs=(hop_htm)
+# the reference maps of the hopscotch driver (-t), run like the tables
+baselines=(null private-std private-oa locked-std sharded-rw)
 
 for ratio in ${update_rate[*]}
 do
-    for alg in ${algs[*]}
+    for alg in ${algs[*]} ${baselines[*]}
     do
+        bin=./$alg
+        if [[ " ${baselines[*]} " == *" $alg "* ]]
+        then
+            bin="./hopscotch -t $alg"
+        fi
         for thr in ${threads[*]}
         do
         	for initial in ${initial_size[*]}
@@ -20,7 +27,7 @@ do
 	            do
 	            filename=output.$alg."n$thr"."u$ratio"."i$initial".csv
 	            echo $filename
-	            ./$alg -u $ratio -n $thr -i $initial -d 3000 |grep "ops/ms*" | cut -d':' -f2 >> ./raw/$filename             	
+	            $bin -u $ratio -n $thr -i $initial -d 3000 |grep "ops/ms*" | cut -d':' -f2 >> ./raw/$filename             	
 	             done
 	         done
         done
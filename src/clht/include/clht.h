@@ -342,9 +342,24 @@ clht_val_t clht_get(clht_hashtable_t* hashtable, clht_addr_t key);
 /* Remove a key-value pair from a hashtable. */
 clht_val_t clht_remove(clht_t* hashtable, clht_addr_t key);
 
+/* Insert num key-value pairs using num_threads threads, each one owning a
+   range of buckets. The table must not be used concurrently. Only provided by
+   the implementations built with CLHT_BULK_PUT. */
+size_t clht_bulk_put(clht_t* hashtable, clht_addr_t* keys, clht_val_t* vals, size_t num, int num_threads);
+
 /* returns the size of the hash table */
 size_t clht_size(clht_hashtable_t* hashtable);
 
+/* The memory of the hash table, in bytes: clht_size_mem is the buckets of the
+   table, of which clht_size_mem_locks is in the bucket locks and
+   clht_size_mem_overflow in the buckets chained to the full ones;
+   clht_size_mem_garbage is the tables that resizes replaced and that are not
+   freed yet. Only provided by the resizing implementations. */
+size_t clht_size_mem(clht_hashtable_t* hashtable);
+size_t clht_size_mem_locks(clht_hashtable_t* hashtable);
+size_t clht_size_mem_overflow(clht_hashtable_t* hashtable);
+size_t clht_size_mem_garbage(clht_hashtable_t* hashtable);
+
 /* frees the memory used by the hashtable */
 void clht_gc_destroy(clht_t* hashtable);
 
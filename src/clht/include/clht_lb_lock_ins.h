@@ -376,6 +376,8 @@ clht_val_t clht_remove(clht_t* hashtable, clht_addr_t key);
 size_t clht_size(clht_hashtable_t* hashtable);
 size_t clht_size_mem(clht_hashtable_t* hashtable);
 size_t clht_size_mem_garbage(clht_hashtable_t* hashtable);
+size_t clht_size_mem_locks(clht_hashtable_t* hashtable);
+size_t clht_size_mem_overflow(clht_hashtable_t* hashtable);
 
 void clht_gc_thread_init(clht_t* hashtable, int id);
 inline void clht_gc_thread_version(clht_hashtable_t* h);
@@ -36,6 +36,7 @@
 #include <inttypes.h>
 #include "atomic_ops.h"
 #include "utils.h"
+#include "retry_stats.h"
 
 #include "ssmem.h"
 
@@ -303,11 +304,14 @@ lock_acq_chk_resize(clht_lock_t* lock, clht_hashtable_t* h)
   clht_lock_t l;
   //printf("l %d\n", l);
   
+  RETRY_STAT_INC(LOCK_TRY);
   while ((l = CAS_U8(lock, LOCK_FREE, LOCK_UPDATE)) == LOCK_UPDATE)
     {
+      RETRY_STAT_INC(LOCK_RETRY);
       if (once)
       	{
       	  DPP(put_num_restarts);
+      	  RETRY_STAT_INC(PUT_RESTART);
       	  once = 0;
       	}
       _mm_pause();
@@ -395,6 +399,7 @@ lock_acq_rtm_chk_resize(clht_lock_t* lock, clht_hashtable_t* h)
 	    }
 
 	  DPP(put_num_restarts);
+	  RETRY_STAT_INC(PUT_RESTART);
 	  _xabort(0xff);
 	}
     } while (rtm_retries-- > 0);
@@ -421,9 +426,15 @@ clht_val_t clht_get(clht_hashtable_t* hashtable, clht_addr_t key);
 /* Remove a key-value pair from a hashtable. */
 clht_val_t clht_remove(clht_t* hashtable, clht_addr_t key);
 
+/* Insert num key-value pairs using num_threads threads, each one owning a
+   range of buckets. The table must not be used concurrently. */
+size_t clht_bulk_put(clht_t* hashtable, clht_addr_t* keys, clht_val_t* vals, size_t num, int num_threads);
+
 size_t clht_size(clht_hashtable_t* hashtable);
 size_t clht_size_mem(clht_hashtable_t* hashtable);
 size_t clht_size_mem_garbage(clht_hashtable_t* hashtable);
+size_t clht_size_mem_locks(clht_hashtable_t* hashtable);
+size_t clht_size_mem_overflow(clht_hashtable_t* hashtable);
 
 void clht_gc_thread_init(clht_t* hashtable, int id);
 inline void clht_gc_thread_version(clht_hashtable_t* h);
@@ -0,0 +1,238 @@
+/*   
+ *   File: getticks.h
+ *   Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *   Description: 
+ *   getticks.h is part of ASCYLIB
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>,
+ * 	     	      Tudor David <tudor.david@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * ASCYLIB is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _H_GETTICKS_
+#define _H_GETTICKS_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#  include <cpuid.h>
+#endif
+typedef uint64_t ticks;
+
+#if defined(__i386__)
+static inline ticks 
+getticks(void) 
+{
+  ticks ret;
+
+  __asm__ __volatile__("rdtsc" : "=A" (ret));
+  return ret;
+}
+#elif defined(__x86_64__)
+static inline ticks
+ getticks(void)
+{
+  unsigned hi, lo;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ( (unsigned long long)lo)|( ((unsigned long long)hi)<<32 );
+}
+#elif defined(__sparc__)
+static inline ticks 
+getticks()
+{
+  ticks ret = 0;
+  __asm__ __volatile__ ("rd %%tick, %0" : "=r" (ret) : "0" (ret)); 
+  return ret;
+}
+#elif defined(__tile__)
+#  include <arch/cycle.h>
+static inline ticks
+getticks()
+{
+  return get_cycle_count();
+}
+#endif
+
+/* getticks() is a bare rdtsc, which the CPU may execute before the preceding
+   instructions complete, or after the following ones start. To time a region,
+   take getticks_start() before it and getticks_stop() after it: the lfence
+   before the rdtsc of getticks_start() waits for the instructions before it,
+   the one after keeps the region from starting early; rdtscp waits for the
+   region to complete, and the lfence after it keeps the code that follows out
+   of the measurement. Other platforms fall back to getticks(). */
+#if defined(__x86_64__) || defined(__i386__)
+static inline ticks
+getticks_start(void)
+{
+  unsigned hi, lo;
+  __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a"(lo), "=d"(hi) :: "memory");
+  return ( (unsigned long long)lo)|( ((unsigned long long)hi)<<32 );
+}
+
+static inline ticks
+getticks_stop(void)
+{
+  unsigned hi, lo, aux;
+  __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a"(lo), "=d"(hi), "=c"(aux) :: "memory");
+  return ( (unsigned long long)lo)|( ((unsigned long long)hi)<<32 );
+}
+#else
+#  define getticks_start getticks
+#  define getticks_stop  getticks
+#endif
+
+/* the cost of an empty getticks_start()/getticks_stop() region, to subtract
+   from the regions that the calling thread measures. It takes the minimum over
+   the samples, as interrupts and migrations only ever add to one. */
+#define GETTICKS_OVERHEAD_REPS 100000
+
+static inline ticks
+getticks_overhead(void)
+{
+  ticks min = (ticks) -1;
+  uint32_t i;
+  for (i = 0; i < GETTICKS_OVERHEAD_REPS; i++)
+    {
+      ticks t_start = getticks_start();
+      ticks t_end = getticks_stop();
+      if (t_end - t_start < min)
+	{
+	  min = t_end - t_start;
+	}
+    }
+  return min;
+}
+
+/* 1 if the tick counter runs at a constant rate, in every P- and C-state:
+   CPUID says so (invariant TSC), or Linux does (constant_tsc and nonstop_tsc).
+   Without it, ticks_to_ns() is only an approximation. */
+static inline int
+tsc_invariant(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned a, b, c, d;
+  if (__get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1 << 8)))
+    {
+      return 1;
+    }
+  FILE* f = fopen("/proc/cpuinfo", "r");
+  if (f == NULL)
+    {
+      return 0;
+    }
+  char line[4096];
+  int constant = 0, nonstop = 0;
+  while (fgets(line, sizeof(line), f) != NULL)
+    {
+      if (strncmp(line, "flags", 5) == 0)
+	{
+	  constant = strstr(line, " constant_tsc") != NULL;
+	  nonstop = strstr(line, " nonstop_tsc") != NULL;
+	  break;
+	}
+    }
+  fclose(f);
+  return constant && nonstop;
+#else
+  return 0;
+#endif
+}
+
+/* Calibration of the tick counter against CLOCK_MONOTONIC_RAW, which NTP does
+   not slew: (nanoseconds, ticks) pairs taken TSC_CALIBRATE_MS apart. A pair is
+   read between two clock reads, and the tightest of a few tries is kept. */
+#if !defined(TSC_CALIBRATE_MS)
+#  define TSC_CALIBRATE_MS 100
+#endif
+#define TSC_CALIBRATE_TRIES 16
+
+/* ticks per ns, 0 until calibrated. The definition is weak, so the linker
+   keeps a single copy for all the translation units of a program, and the
+   calibration that main() does holds in every one of them. */
+__attribute__ ((weak)) double tsc_calibrated_ticks_per_ns = 0;
+
+static inline uint64_t
+tsc_clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+tsc_sample(uint64_t* ns, ticks* t)
+{
+  uint64_t best = (uint64_t) -1;
+  int i;
+  for (i = 0; i < TSC_CALIBRATE_TRIES; i++)
+    {
+      uint64_t ns0 = tsc_clock_ns();
+      ticks t0 = getticks_start();
+      uint64_t ns1 = tsc_clock_ns();
+      if (ns1 - ns0 < best)
+	{
+	  best = ns1 - ns0;
+	  *ns = ns0 + (ns1 - ns0) / 2;
+	  *t = t0;
+	}
+    }
+}
+
+/* calibrates the conversion (call it once, before the threads start), warns
+   on stderr if the counter is not invariant, and returns the ticks per ns */
+static inline double
+tsc_calibrate(void)
+{
+  uint64_t ns0 = 0, ns1 = 0;
+  ticks t0 = 0, t1 = 0;
+  tsc_sample(&ns0, &t0);
+  struct timespec wait = { TSC_CALIBRATE_MS / 1000, (TSC_CALIBRATE_MS % 1000) * 1000000L };
+  nanosleep(&wait, NULL);
+  tsc_sample(&ns1, &t1);
+  tsc_calibrated_ticks_per_ns = (double) (t1 - t0) / (ns1 - ns0);
+  if (!tsc_invariant())
+    {
+      fprintf(stderr, "# warning: the tick counter is not invariant; the latencies in ns are approximate\n");
+    }
+  return tsc_calibrated_ticks_per_ns;
+}
+
+/* ticks per ns, calibrated on first use */
+static inline double
+tsc_ticks_per_ns(void)
+{
+  if (tsc_calibrated_ticks_per_ns == 0)
+    {
+      tsc_calibrate();
+    }
+  return tsc_calibrated_ticks_per_ns;
+}
+
+static inline double
+ticks_to_ns(double t)
+{
+  return t / tsc_ticks_per_ns();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -43,82 +43,7 @@
     barrier_cross(barrier);			\
     }}
 
-#if RETRY_STATS == 1
-#  define RETRY_STATS_VARS						\
-  __thread size_t __parse_try, __update_try, __cleanup_try, __lock_try, __lock_queue, __lock_try_once
-#  define RETRY_STATS_VARS_GLOBAL					\
-  size_t __parse_try_global, __update_try_global, __cleanup_try_global, __lock_try_global, __lock_queue_global
-
-extern RETRY_STATS_VARS;
-extern RETRY_STATS_VARS_GLOBAL;
-
-#  define RETRY_STATS_ZERO()			\
-  __parse_try = 0;				\
-  __update_try = 0;				\
-  __cleanup_try = 0;				\
-  __lock_try = 0;				\
-  __lock_queue = 0;				\
-  __lock_try_once = 1;
-
-#  define PARSE_TRY()        __parse_try++
-#  define UPDATE_TRY()       __update_try++
-#  define CLEANUP_TRY()      __cleanup_try++
-#  define LOCK_TRY()         __lock_try++
-#  define LOCK_TRY_ONCE()			\
-  if (__lock_try_once)				\
-    {						\
-      LOCK_TRY();				\
-    }
-#  define LOCK_QUEUE(q)      __lock_queue += (q)
-#  define LOCK_QUEUE_ONCE(q)			\
-  if (__lock_try_once)				\
-    {						\
-      __lock_try_once = 0;			\
-      __lock_queue += (q);			\
-    }
-#  define LOCK_TRY_ONCE_CLEAR()    __lock_try_once = 1
-#  define RETRY_STATS_PRINT(thr, put, rem, upd_suc)   retry_stats_print(thr, put, rem, (upd_suc))
-#  define RETRY_STATS_SHARE()			\
-  __parse_try_global +=  __parse_try;		\
-  __update_try_global += __update_try;		\
-  __cleanup_try_global += __cleanup_try;	\
-  __lock_try_global += __lock_try;		\
-  __lock_queue_global += __lock_queue
-
-static inline void 
-retry_stats_print(size_t thr, size_t put, size_t rem, size_t upd_suc)
-{
-  double ratio_all = 100.0 * (((double) __parse_try_global / thr) - 1);
-  printf("#parse_all:    %-10zu %f %%\n", __parse_try_global, ratio_all);
-  size_t updates = put + rem;
-  ratio_all = 100.0 * (((double) __update_try_global / updates) - 1);
-  printf("#update_all:   %-10zu %f %%\n", __update_try_global, ratio_all);
-  ratio_all = 100.0 * (__cleanup_try_global / (thr - (double) __cleanup_try_global));
-  double ratio_upd = 100.0 * (__cleanup_try_global / (updates - (double) __cleanup_try_global));
-  printf("#cleanup_all:  %-10zu %f %% %f %%\n", __cleanup_try_global, ratio_upd, ratio_all);
-  ratio_all = (double) __lock_queue_global / __lock_try_global;
-  if (__lock_try_global == 0)
-    {
-      ratio_all = 0;
-    }
-  double ratio_to_succ_upd = (double) __lock_try_global / upd_suc;
-  printf("#lock_all:     %-10zu %f   %f\n", __lock_try_global, ratio_all, ratio_to_succ_upd);
-}
-
-#else  /* RETRY_STATS == 0 */
-#  define RETRY_STATS_VARS
-#  define RETRY_STATS_VARS_GLOBAL
-#  define RETRY_STATS_ZERO()
-
-#  define PARSE_TRY()     
-#  define UPDATE_TRY()    
-#  define CLEANUP_TRY()   
-#  define RETRY_STATS_PRINT(thr, put, rem, upd_suc)
-#  define RETRY_STATS_SHARE()
-#  define LOCK_TRY()
-#  define LOCK_QUEUE(q)
-#  define LOCK_TRY_ONCE_CLEAR()
-#endif	/* RETRY_STATS */
+#include "retry_stats.h"
 
 /* ****************************************************************************************** */
 /* ****************************************************************************************** */
@@ -161,20 +86,18 @@ retry_stats_print(size_t thr, size_t put, size_t rem, size_t upd_suc)
 #  define PARSE_END_TS(s, i)
 #  define PARSE_END_INC(i)
 #  define START_TS(s)				\
-    asm volatile ("");				\
-    start_acq = getticks();			\
-    LFENCE;
+    start_acq = getticks_start();
 #  define END_TS(s, i)				\
-    asm volatile ("");				\
-    end_acq = getticks();			\
-    asm volatile ("");
+    end_acq = getticks_stop();
 #  define END_TS_ELSE(s, i, inc)		\
   else						\
     {						\
       END_TS(s, i);				\
       ADD_DUR(inc);				\
     }
-#  define ADD_DUR(tar) tar += (end_acq - start_acq - correction)
+/* correction: getticks_overhead() of the thread */
+#  define ADD_DUR(tar)						\
+  tar += (end_acq - start_acq > correction ? end_acq - start_acq - correction : 0)
 #  define ADD_DUR_FAIL(tar)					\
   else								\
     {								\
@@ -221,6 +144,26 @@ extern size_t pf_vals_num;
 #  endif	 /* LATENCY_PARSING */
 #endif
 
+#if (PFD_TYPE == 1) && defined(COMPUTE_LATENCY)
+/* the first num_print samples of store and the statistics of num_vals, in ns */
+#  define LATENCY_PN_NS(store, num_vals, num_print)			\
+  {									\
+    size_t _i;								\
+    size_t p = num_print;						\
+    if (p > num_vals) { p = num_vals; }					\
+    for (_i = 0; _i < p; _i++)						\
+      {									\
+	printf("%.0f,", ticks_to_ns(sspfd_store[store][_i]));		\
+      }									\
+    printf("\n");							\
+    sspfd_stats_t ad;							\
+    sspfd_get_stats(store, num_vals, &ad);				\
+    printf("#  avg: %.1f ns | std dev: %.1f ns | min: %.1f ns | max: %.1f ns\n", \
+	   ticks_to_ns(ad.avg), ticks_to_ns(ad.std_dev),		\
+	   ticks_to_ns(ad.min_val), ticks_to_ns(ad.max_val));		\
+  }
+#endif
+
 static inline void
 print_latency_stats(int ID, size_t num_entries, size_t num_entries_print)
 {
@@ -230,29 +173,29 @@ print_latency_stats(int ID, size_t num_entries, size_t num_entries_print)
 #  if LATENCY_PARSING == 1
       printf("get ------------------------------------------------------------------------\n");
       printf("#latency_get_parse: ");
-      SSPFDPN_COMMA(0, num_entries, num_entries_print);
+      LATENCY_PN_NS(0, num_entries, num_entries_print);
       printf("put ------------------------------------------------------------------------\n");
       printf("#latency_put_parse: ");
-      SSPFDPN_COMMA(1, num_entries, num_entries_print);
+      LATENCY_PN_NS(1, num_entries, num_entries_print);
       printf("rem ------------------------------------------------------------------------\n");
       printf("#latency_rem_parse: ");
-      SSPFDPN_COMMA(2, num_entries, num_entries_print);
+      LATENCY_PN_NS(2, num_entries, num_entries_print);
 #  else  /* LATENCY_PARSING == 0*/
       printf("get ------------------------------------------------------------------------\n");
       printf("#latency_get_suc: ");
-      SSPFDPN_COMMA(0, num_entries, num_entries_print);
+      LATENCY_PN_NS(0, num_entries, num_entries_print);
       printf("#latency_get_fal: ");
-      SSPFDPN_COMMA(3, num_entries, num_entries_print);
+      LATENCY_PN_NS(3, num_entries, num_entries_print);
       printf("put ------------------------------------------------------------------------\n");
       printf("#latency_put_suc: ");
-      SSPFDPN_COMMA(1, num_entries, num_entries_print);
+      LATENCY_PN_NS(1, num_entries, num_entries_print);
       printf("#latency_put_fal: ");
-      SSPFDPN_COMMA(4, num_entries, num_entries_print);
+      LATENCY_PN_NS(4, num_entries, num_entries_print);
       printf("rem ------------------------------------------------------------------------\n");
       printf("#latency_rem_suc: ");
-      SSPFDPN_COMMA(2, num_entries, num_entries_print);
+      LATENCY_PN_NS(2, num_entries, num_entries_print);
       printf("#latency_rem_fal: ");
-      SSPFDPN_COMMA(5, num_entries, num_entries_print);
+      LATENCY_PN_NS(5, num_entries, num_entries_print);
 #  endif	/* LATENCY_PARSING */
     }
 #  if LATENCY_ALL_CORES == 1
@@ -261,29 +204,29 @@ print_latency_stats(int ID, size_t num_entries, size_t num_entries_print)
 #    if LATENCY_PARSING == 1
       printf("get ------------------------------------------------------------------------\n");
       printf("#latency_get_parse: ");
-      SSPFDPN_COMMA(0, num_entries, num_entries_print);
+      LATENCY_PN_NS(0, num_entries, num_entries_print);
       printf("put ------------------------------------------------------------------------\n");
       printf("#latency_put_parse: ");
-      SSPFDPN_COMMA(1, num_entries, num_entries_print);
+      LATENCY_PN_NS(1, num_entries, num_entries_print);
       printf("rem ------------------------------------------------------------------------\n");
       printf("#latency_rem_parse: ");
-      SSPFDPN_COMMA(2, num_entries, num_entries_print);
+      LATENCY_PN_NS(2, num_entries, num_entries_print);
 #    else  /* LATENCY_PARSING == 0*/
       printf("get ------------------------------------------------------------------------\n");
       printf("#latency_get_suc: ");
-      SSPFDPN_COMMA(0, num_entries, num_entries_print);
+      LATENCY_PN_NS(0, num_entries, num_entries_print);
       printf("#latency_get_fal: ");
-      SSPFDPN_COMMA(3, num_entries, num_entries_print);
+      LATENCY_PN_NS(3, num_entries, num_entries_print);
       printf("put ------------------------------------------------------------------------\n");
       printf("#latency_put_suc: ");
-      SSPFDPN_COMMA(1, num_entries, num_entries_print);
+      LATENCY_PN_NS(1, num_entries, num_entries_print);
       printf("#latency_put_fal: ");
-      SSPFDPN_COMMA(4, num_entries, num_entries_print);
+      LATENCY_PN_NS(4, num_entries, num_entries_print);
       printf("rem ------------------------------------------------------------------------\n");
       printf("#latency_rem_suc: ");
-      SSPFDPN_COMMA(2, num_entries, num_entries_print);
+      LATENCY_PN_NS(2, num_entries, num_entries_print);
       printf("#latency_rem_fal: ");
-      SSPFDPN_COMMA(5, num_entries, num_entries_print);
+      LATENCY_PN_NS(5, num_entries, num_entries_print);
 #    endif	/* LATENCY_PARSING */
 }
 #  endif
@@ -0,0 +1,71 @@
+/*
+ *   File: lf_chain.h
+ *   Description: lock-free chained hash table (Michael, SPAA 2002), whose
+ *                removed nodes go through the reclaim.h policy
+ *   lf_chain.h is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _LF_CHAIN_H_
+#define _LF_CHAIN_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Every bucket is a lock-free list sorted by key. A node is removed by marking
+   its next pointer, and then unlinked by whoever gets to it first; that thread
+   retires it. The buckets are never resized. The operations have to run
+   between reclaim_begin() and reclaim_end(); they use the three hazard slots. */
+
+typedef uintptr_t lfc_key_t;
+typedef uintptr_t lfc_val_t;
+
+typedef struct lfc_node
+{
+  lfc_key_t key;
+  lfc_val_t val;
+  struct lfc_node* volatile next; /* the lowest bit marks the node as removed */
+} lfc_node_t;
+
+typedef struct lfc
+{
+  size_t hash;			/* num_buckets - 1 */
+  lfc_node_t* volatile* buckets;
+} lfc_t;
+
+/* num_buckets is rounded up to a power of two */
+lfc_t* lfc_create(size_t num_buckets);
+/* frees the nodes with reclaim_unused(): call it from a registered thread */
+void lfc_destroy(lfc_t* t);
+
+/* the value of key, or 0 */
+lfc_val_t lfc_get(lfc_t* t, lfc_key_t key);
+/* 1 if key was not in the table */
+int lfc_put(lfc_t* t, lfc_key_t key, lfc_val_t val);
+/* the value of the removed key, or 0 */
+lfc_val_t lfc_remove(lfc_t* t, lfc_key_t key);
+size_t lfc_size(lfc_t* t);
+
+#endif	/* _LF_CHAIN_H_ */
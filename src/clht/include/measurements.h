@@ -46,21 +46,14 @@ extern "C" {
 typedef uint64_t ticks;
 #endif
 
+#include "getticks.h"
+
+/* Ticks are converted to time with the rate that getticks.h calibrates
+   against CLOCK_MONOTONIC_RAW (ticks_to_ns()), not with a nominal frequency. */
+
 #define PLATFORM_MCORE
 /* #define DO_TIMINGS */
 
-#ifndef REF_SPEED_GHZ
-#  if defined(PLATFORM_MCORE)
-#    define REF_SPEED_GHZ           2.1
-#  elif defined(SCC)
-#    define REF_SPEED_GHZ           0.533
-#  elif defined(PLATFORM_TILERA)
-#    define REF_SPEED_GHZ           0.7
-#  else
-#    error "Need to set REF_SPEED_GHZ for the platform"
-#  endif
-#endif  /* REF_SPEED_GHZ */
-
 #define DO_TIMINGS_TICKS
 
 
@@ -247,9 +240,9 @@ while (0);
     for (i = start; i < end; i++) {					\
       if (total_samples[i]) {						\
 	printf("[%02d]%s:\n", i, measurement_msgs[i]);	\
-	printf("  samples: %-16llu | secs: %-4.10f | avg ticks: %-4.10f\n", \
-		total_samples[i], total_sum_ticks[i] / (REF_SPEED_GHZ * 1.e9),   \
-                (total_sum_ticks[i] / total_samples[i])/ (REF_SPEED_GHZ * 1.e9));\
+	printf("  samples: %-16llu | secs: %-4.10f | avg ns: %-4.1f\n", \
+		total_samples[i], ticks_to_ns(total_sum_ticks[i]) / 1.e9,   \
+                ticks_to_ns(total_sum_ticks[i]) / total_samples[i]);\
         }                                                               \
     }                                                                   \
 }                                                                       \
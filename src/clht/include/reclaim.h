@@ -0,0 +1,214 @@
+/*
+ *   File: reclaim.h
+ *   Description: memory-reclamation policies for the lock-free tables
+ *   reclaim.h is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _RECLAIM_H_
+#define _RECLAIM_H_
+
+#include <stdint.h>
+#include "utils.h"
+#include "ssmem.h"
+
+#if !defined(likely)
+#  define likely(x)       __builtin_expect((x), 1)
+#  define unlikely(x)     __builtin_expect((x), 0)
+#endif
+
+/* **************************************************************************************** */
+/* policies */
+/* **************************************************************************************** */
+
+/* The policy is chosen at compile time with -DRECLAIM=RECLAIM_<policy>:
+ *  NONE  - removed objects are never freed (the lower bound of the cost)
+ *  SSMEM - ssmem_free(): timestamps that move on every ssmem_alloc()/ssmem_free()
+ *  EBR   - epochs: an operation pins the global epoch; objects retired in epoch
+ *          e are freed once the epoch reaches e + 2
+ *  QSBR  - the same epochs, but a thread only announces them between operations
+ *          (quiescent states), so an operation does no store at all
+ *  HP    - hazard pointers: a thread publishes the objects it reads, and the
+ *          retired objects that no hazard pointer names are freed
+ *  HE    - hazard eras: a thread publishes the era of the global clock it reads
+ *          at, and an object is freed once no published era falls between the
+ *          era it was allocated in and the one it was retired in
+ * Except with SSMEM, the objects come from malloc(), with a header that holds
+ * their size and birth era. */
+#define RECLAIM_NONE            0
+#define RECLAIM_SSMEM           1
+#define RECLAIM_EBR             2
+#define RECLAIM_QSBR            3
+#define RECLAIM_HP              4
+#define RECLAIM_HE              5
+
+#if !defined(RECLAIM)
+#  define RECLAIM RECLAIM_SSMEM
+#endif
+
+#define RECLAIM_MAX_THREADS     256
+#define RECLAIM_SLOTS           3 /* hazard pointers (eras) per thread */
+#if !defined(RECLAIM_BATCH)
+#  define RECLAIM_BATCH         128 /* retires between two attempts to reclaim (EBR, QSBR),
+				       and the fewest retired objects HP and HE scan for */
+#endif
+#define RECLAIM_INACTIVE        0
+
+/* the policies that keep lists of the retired objects */
+#define RECLAIM_KEEPS_LISTS     (RECLAIM == RECLAIM_EBR || RECLAIM == RECLAIM_QSBR || \
+				 RECLAIM == RECLAIM_HP || RECLAIM == RECLAIM_HE)
+
+/* **************************************************************************************** */
+/* data structures */
+/* **************************************************************************************** */
+
+/* the state of a thread that the others read, and its counters */
+typedef struct ALIGNED(CACHE_LINE_SIZE) reclaim_thread
+{
+  union
+  {
+    struct
+    {
+      volatile uint64_t epoch;	/* EBR, QSBR: (epoch << 1) | 1 while active, else 0 */
+      volatile uintptr_t slot[RECLAIM_SLOTS]; /* HP: pointers, HE: eras (0: none) */
+    };
+    uint8_t padding[CACHE_LINE_SIZE];
+  };
+  /* written by the thread only */
+  volatile size_t retired_num;
+  volatile size_t retired_bytes;
+  volatile size_t freed_num;
+  volatile size_t freed_bytes;
+  volatile ticks lat_sum;	/* retire to free, of the freed objects */
+  volatile ticks lat_max;
+} reclaim_thread_t;
+
+/* the header of a malloc'ed object */
+typedef struct reclaim_hdr
+{
+  size_t size;
+  uint64_t birth;		/* HE: era of the allocation */
+} reclaim_hdr_t;
+
+/* counters summed over the threads */
+typedef struct reclaim_stats
+{
+  size_t retired_num;
+  size_t retired_bytes;
+  size_t freed_num;
+  size_t freed_bytes;
+  ticks lat_sum;
+  ticks lat_max;
+} reclaim_stats_t;
+
+extern reclaim_thread_t reclaim_threads[RECLAIM_MAX_THREADS];
+extern volatile uint64_t reclaim_epoch; /* EBR, QSBR: the global epoch, HE: the era */
+extern __thread reclaim_thread_t* reclaim_me;
+extern __thread uint64_t reclaim_my_epoch;
+extern __thread ssmem_allocator_t* reclaim_alloc_ssmem;
+
+/* **************************************************************************************** */
+/* interface */
+/* **************************************************************************************** */
+
+/* registers the calling thread as thread id (after it is pinned) */
+void reclaim_thread_init(int id);
+/* the thread won't use the table anymore; it no longer holds back reclamation,
+   and frees what it can of its retired objects. The last thread to terminate
+   frees the ones the others could not. */
+void reclaim_thread_term();
+void* reclaim_alloc(size_t size);
+/* obj is not reachable anymore: free it once no thread can hold a reference to it */
+void reclaim_retire(void* obj);
+/* frees obj, which no other thread has seen */
+void reclaim_unused(void* obj);
+/* frees the retired objects that the epochs already allow to (EBR, QSBR) */
+void reclaim_epoch_changed();
+void reclaim_stats_get(reclaim_stats_t* stats);
+const char* reclaim_name();
+
+/* an operation on the table starts */
+static inline void
+reclaim_begin()
+{
+#if RECLAIM == RECLAIM_EBR
+  const uint64_t e = reclaim_epoch;
+  /* the exchange also orders the store before the reads of the operation */
+  __sync_lock_test_and_set(&reclaim_me->epoch, (e << 1) | 1);
+  if (unlikely(e != reclaim_my_epoch))
+    {
+      reclaim_my_epoch = e;
+      reclaim_epoch_changed();
+    }
+#endif
+}
+
+/* an operation ends: the thread holds no references to the table anymore */
+static inline void
+reclaim_end()
+{
+#if RECLAIM == RECLAIM_EBR
+  __asm__ __volatile__ ("" ::: "memory");
+  reclaim_me->epoch = RECLAIM_INACTIVE;
+#elif RECLAIM == RECLAIM_QSBR
+  const uint64_t e = reclaim_epoch;
+  if (unlikely(e != reclaim_my_epoch))
+    {
+      __asm__ __volatile__ ("" ::: "memory");
+      reclaim_me->epoch = (e << 1) | 1;
+      reclaim_my_epoch = e;
+      reclaim_epoch_changed();
+    }
+#elif RECLAIM == RECLAIM_HP || RECLAIM == RECLAIM_HE
+  __asm__ __volatile__ ("" ::: "memory");
+  int i;
+  for (i = 0; i < RECLAIM_SLOTS; i++)
+    {
+      reclaim_me->slot[i] = 0;
+    }
+#endif
+}
+
+/* protects ptr, just read from the table, in slot i. The caller then has to
+   check that ptr is still reachable, before it uses it. */
+static inline void
+reclaim_publish(int i, void* ptr)
+{
+#if RECLAIM == RECLAIM_HP
+  __sync_lock_test_and_set(&reclaim_me->slot[i], (uintptr_t) ptr);
+#elif RECLAIM == RECLAIM_HE
+  const uint64_t era = reclaim_epoch;
+  if (reclaim_me->slot[i] != era)
+    {
+      __sync_lock_test_and_set(&reclaim_me->slot[i], era);
+    }
+  (void) ptr;
+#else
+  (void) i;
+  (void) ptr;
+#endif
+}
+
+#endif	/* _RECLAIM_H_ */
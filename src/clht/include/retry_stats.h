@@ -0,0 +1,184 @@
+/*
+ *   File: retry_stats.h
+ *   Description: per-thread counters of the retries and of the contention
+ *   that the data structures run into
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _RETRY_STATS_H_
+#define _RETRY_STATS_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+/* The counters are compiled in with -DRETRY_STATS=1 (STATS=1 with make) only.
+   Otherwise every macro below expands to nothing, so that the data structures
+   can call them on their fast paths.
+
+   Each thread counts into a slot of its own, a few cache lines that no other
+   thread writes, once it called RETRY_STATS_THREAD_INIT(id). The events of the
+   threads that never did go to a spare slot that they share. The slots are summed
+   only when the results are printed. */
+
+/* the counters, and what one increment stands for */
+#define RETRY_STATS_FOREACH(X)						\
+  X(PARSE_TRY)		/* traversals (lock-free lists) */		\
+  X(UPDATE_TRY)		/* update attempts, including the failed CASes */ \
+  X(CLEANUP_TRY)	/* attempts to unlink a marked node */		\
+  X(LOCK_TRY)		/* lock acquisitions */				\
+  X(LOCK_QUEUE)		/* threads found ahead in the lock queue */	\
+  X(LOCK_RETRY)		/* lock acquisitions that found the lock held */ \
+  X(PUT_RESTART)	/* updates that restarted on a busy bucket */	\
+  X(RESIZE_HELP)	/* times a thread helped a resize */		\
+  X(HASHPOWER_RETRY)	/* lookups redone after a concurrent resize */	\
+  X(BFS_FAIL)		/* cuckoo path searches that found no free slot */ \
+  X(TS_RETRY)		/* reads redone as the timestamp changed */	\
+  X(DISPLACE)		/* keys moved to make room (cuckoo, hopscotch) */
+
+#define RETRY_STATS_MAX_THREADS 256
+
+#if RETRY_STATS == 1
+
+#  define RETRY_STATS_ENUM(name) RETRY_STAT_##name,
+enum retry_stat
+{
+  RETRY_STATS_FOREACH(RETRY_STATS_ENUM)
+  RETRY_STAT_NUM
+};
+#  undef RETRY_STATS_ENUM
+
+typedef struct __attribute__ ((aligned (64))) retry_stats
+{
+  size_t c[RETRY_STAT_NUM];
+} retry_stats_t;
+
+/* Weak, so that the data structures and the harness, in C or in C++, share one
+   copy whether or not the harness declares them. */
+__attribute__ ((weak)) retry_stats_t retry_stats_threads[RETRY_STATS_MAX_THREADS + 1];
+__attribute__ ((weak)) __thread retry_stats_t* retry_stats_me =
+  &retry_stats_threads[RETRY_STATS_MAX_THREADS];
+__attribute__ ((weak)) __thread size_t retry_stats_lock_once = 1;
+
+#  define RETRY_STAT_ADD(name, n)    (retry_stats_me->c[RETRY_STAT_##name] += (n))
+#  define RETRY_STAT_INC(name)       (retry_stats_me->c[RETRY_STAT_##name]++)
+
+#  define RETRY_STATS_THREAD_INIT(id)					\
+  retry_stats_me = &retry_stats_threads[(id) % RETRY_STATS_MAX_THREADS];	\
+  RETRY_STATS_ZERO()
+#  define RETRY_STATS_ZERO()						\
+  memset(retry_stats_me, 0, sizeof(retry_stats_t));			\
+  retry_stats_lock_once = 1
+
+/* the counters that the lock-free lists and lock_if.h used before */
+#  define PARSE_TRY()        RETRY_STAT_INC(PARSE_TRY)
+#  define UPDATE_TRY()       RETRY_STAT_INC(UPDATE_TRY)
+#  define CLEANUP_TRY()      RETRY_STAT_INC(CLEANUP_TRY)
+#  define LOCK_TRY()         RETRY_STAT_INC(LOCK_TRY)
+#  define LOCK_TRY_ONCE()			\
+  if (retry_stats_lock_once)			\
+    {						\
+      LOCK_TRY();				\
+    }
+#  define LOCK_QUEUE(q)      RETRY_STAT_ADD(LOCK_QUEUE, q)
+#  define LOCK_QUEUE_ONCE(q)			\
+  if (retry_stats_lock_once)			\
+    {						\
+      retry_stats_lock_once = 0;		\
+      LOCK_QUEUE(q);				\
+    }
+#  define LOCK_TRY_ONCE_CLEAR()    retry_stats_lock_once = 1
+
+#  define RETRY_STATS_PRINT(ops)   retry_stats_print_json(ops)
+
+static inline void
+retry_stats_sum(size_t* sum)
+{
+  int t, i;
+  memset(sum, 0, RETRY_STAT_NUM * sizeof(size_t));
+  for (t = 0; t <= RETRY_STATS_MAX_THREADS; t++)
+    {
+      for (i = 0; i < RETRY_STAT_NUM; i++)
+	{
+	  sum[i] += retry_stats_threads[t].c[i];
+	}
+    }
+}
+
+/* prints the name of counter i, in lower case, as a JSON key */
+static inline void
+retry_stats_print_key(int i)
+{
+#  define RETRY_STATS_NAME(name) #name,
+  static const char* const names[RETRY_STAT_NUM] = { RETRY_STATS_FOREACH(RETRY_STATS_NAME) };
+#  undef RETRY_STATS_NAME
+  const char* c;
+  printf("%s\"", i ? ", " : "");
+  for (c = names[i]; *c; c++)
+    {
+      putchar((*c >= 'A' && *c <= 'Z') ? *c - 'A' + 'a' : *c);
+    }
+  printf("\": ");
+}
+
+/* prints the counters, summed over the threads, and divided by ops, on one line:
+   #retry_stats: {"ops": .., "total": {"parse_try": .., ..}, "per_op": {..}} */
+static inline void
+retry_stats_print_json(size_t ops)
+{
+  size_t sum[RETRY_STAT_NUM];
+  int i;
+  retry_stats_sum(sum);
+
+  printf("#retry_stats: {\"ops\": %zu, \"total\": {", ops);
+  for (i = 0; i < RETRY_STAT_NUM; i++)
+    {
+      retry_stats_print_key(i);
+      printf("%zu", sum[i]);
+    }
+  printf("}, \"per_op\": {");
+  for (i = 0; i < RETRY_STAT_NUM; i++)
+    {
+      retry_stats_print_key(i);
+      printf("%.6f", ops ? (double) sum[i] / ops : 0.0);
+    }
+  printf("}}\n");
+}
+
+#else  /* RETRY_STATS == 0 */
+#  define RETRY_STAT_ADD(name, n)
+#  define RETRY_STAT_INC(name)
+#  define RETRY_STATS_THREAD_INIT(id)
+#  define RETRY_STATS_ZERO()
+
+#  define PARSE_TRY()
+#  define UPDATE_TRY()
+#  define CLEANUP_TRY()
+#  define LOCK_TRY()
+#  define LOCK_TRY_ONCE()
+#  define LOCK_QUEUE(q)
+#  define LOCK_QUEUE_ONCE(q)
+#  define LOCK_TRY_ONCE_CLEAR()
+#  define RETRY_STATS_PRINT(ops)
+#endif	/* RETRY_STATS */
+
+#endif	/* _RETRY_STATS_H_ */
@@ -56,6 +56,28 @@
 #define SSMEM_TS_INCR_ON_FREE   3
 
 #define SSMEM_TS_INCR_ON        SSMEM_TS_INCR_ON_BOTH
+
+/* Each allocator serves several object sizes. A request is rounded up to one of
+   SSMEM_NUM_CLASSES size classes, and objects of a class are carved out of pages of
+   SSMEM_PAGE_SIZE bytes that only hold that class. A page starts with a header
+   (SSMEM_PAGE_HEADER bytes) that names its class, so that ssmem_free() finds the
+   class of any object returned by ssmem_alloc(), whichever thread allocated it.
+   Objects larger than SSMEM_MAX_SMALL get pages of their own, and go back to the
+   OS once they are safe to reclaim. */
+#define SSMEM_PAGE_SIZE         (64 * 1024L)
+#define SSMEM_PAGE_HEADER       CACHE_LINE_SIZE
+#define SSMEM_MAX_SMALL         (8 * 1024L)
+#define SSMEM_NUM_CLASSES       24
+#define SSMEM_CLASS_LARGE       SSMEM_NUM_CLASSES
+
+/* With NUMA defined, the chunks of an allocator are bound (mbind, preferred policy)
+   to the node of the thread that initializes it, which should be pinned by then, and
+   every page records that node. Objects that a thread frees into pages of another
+   node are sent back to that node once they are safe to reclaim, in batches of
+   SSMEM_REMOTE_BATCH, so that the allocators of the node reuse them. ssmem_node_stats
+   counts the memory placed on each node and the objects sent back. */
+#define SSMEM_MAX_NODES         16
+#define SSMEM_REMOTE_BATCH      64
 /* **************************************************************************************** */
 /* help definitions */
 /* **************************************************************************************** */
@@ -66,6 +88,19 @@
 /* data structures used by ssmem */
 /* **************************************************************************************** */
 
+/* the objects of one size class in an allocator */
+typedef struct ssmem_class
+{
+  uintptr_t page_curr;		/* next object in the page the class bump-allocates from */
+  uintptr_t page_end;		/* end of that page */
+  struct ssmem_free_set* free_set_list; /* list of free_set. A free set holds freed mem 
+					   that has not yet been reclaimed */
+  size_t free_set_num;		/* number of sets in the free_set_list */
+  struct ssmem_free_set* collected_set_list; /* list of collected_set. A collected set
+					        contains mem that has been reclaimed */
+  size_t collected_set_num;	/* number of sets in the collected_set_list */
+} ssmem_class_t;
+
 /* an ssmem allocator */
 typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_allocator
 {
@@ -73,8 +108,8 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_allocator
   {
     struct
     {
-      void* mem;		/* the actual memory the allocator uses */
-      size_t mem_curr;		/* pointer to the next addrr to be allocated */
+      void* mem;		/* the chunk the allocator takes pages from */
+      size_t mem_curr;		/* offset of the next page in mem */
       size_t mem_size;		/* size of mem chunk */
       size_t tot_size;		/* total memory that the allocator uses */
       size_t fs_size;		/* size (in objects) of free_sets */
@@ -82,21 +117,46 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_allocator
 
       struct ssmem_ts* ts;	/* timestamp object associated with the allocator */
 
-      struct ssmem_free_set* free_set_list; /* list of free_set. A free set holds freed mem 
-					     that has not yet been reclaimed */
-      size_t free_set_num;	/* number of sets in the free_set_list */
-      struct ssmem_free_set* collected_set_list; /* list of collected_set. A collected set
-						  contains mem that has been reclaimed */
-      size_t collected_set_num;	/* number of sets in the collected_set_list */
       struct ssmem_free_set* available_set_list; /* list of set structs that are not used
 						  and can be used as free sets */
       size_t released_num;	/* number of released memory objects */
       struct ssmem_released* released_mem_list; /* list of release memory objects */
+
+      int node;			/* NUMA node of the chunks */
+      struct ssmem_free_set** remote_out; /* per node and class, the batch of reclaimed
+					     objects to send back to that node */
+      size_t reclaimed_num;	/* freed objects that became safe to reuse */
+      size_t reclaimed_bytes;	/* their size */
+      /* for ssmem_mem_stats: what the thread allocated and freed, and the pages
+	 of the large objects it allocated less those it reclaimed */
+      size_t alloc_bytes;
+      size_t free_bytes;
+      size_t large_bytes;
     };
-    uint8_t padding[2 * CACHE_LINE_SIZE];
+    uint8_t padding[3 * CACHE_LINE_SIZE];
   };
+  ssmem_class_t classes[SSMEM_NUM_CLASSES + 1]; /* the last one for large objects */
 } ssmem_allocator_t;
 
+/* the header of a page */
+typedef struct ssmem_page
+{
+  uint32_t class_id;		/* size class of the objects in the page */
+  uint32_t obj_size;		/* their size */
+  uint32_t node;		/* NUMA node of the allocator that carved the page */
+} ssmem_page_t;
+
+/* per NUMA node counters */
+typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_node_stats
+{
+  size_t chunks;		/* chunks placed on the node */
+  size_t bytes;			/* their size */
+  size_t remote_out;		/* objects of other nodes freed by threads of the node */
+  size_t remote_in;		/* objects of the node sent back to it */
+} ssmem_node_stats_t;
+
+extern ssmem_node_stats_t ssmem_node_stats[SSMEM_MAX_NODES];
+
 /* a timestamp used by a thread */
 typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_ts
 {
@@ -106,6 +166,7 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_ts
     {
       size_t version;
       size_t id;
+      size_t idx;		/* position in the timestamp sets */
       struct ssmem_ts* next;
     };
   };
@@ -122,6 +183,7 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_ts
 typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_free_set
 {
   size_t* ts_set;		/* set of timestamps for GC */
+  size_t ts_num;		/* number of timestamps in ts_set */
   size_t size;
   long int curr;		
   struct ssmem_free_set* set_next;
@@ -136,6 +198,7 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) ssmem_free_set
 typedef struct ssmem_released
 {
   size_t* ts_set;
+  size_t ts_num;
   void* mem;
   struct ssmem_released* next;
 } ssmem_released_t;
@@ -167,12 +230,15 @@ void ssmem_term();
  * might have been freed (and is still in use) by other allocators */
 void ssmem_alloc_term(ssmem_allocator_t* a);
 
-/* allocate some memory using allocator a */
+/* allocate some memory using allocator a. Any allocator can free it */
 inline void* ssmem_alloc(ssmem_allocator_t* a, size_t size);
-/* free some memory using allocator a */
+/* free some memory that was allocated with ssmem_alloc, using allocator a */
 inline void ssmem_free(ssmem_allocator_t* a, void* obj);
 
-/* release some memory to the OS using allocator a */
+/* the size of the class of obj, which ssmem_alloc returned */
+size_t ssmem_obj_size(void* obj);
+
+/* release some memory (from malloc/memalign) to the OS using allocator a */
 inline void ssmem_release(ssmem_allocator_t* a, void* obj);
 
 /* increment the thread-local activity counter. Invoking this function suggests that
@@ -192,6 +258,21 @@ void ssmem_collected_list_print(ssmem_allocator_t* a);
 void ssmem_available_list_print(ssmem_allocator_t* a);
 void ssmem_all_list_print(ssmem_allocator_t* a, int id);
 
+/* number of NUMA nodes that ssmem places memory on (1 without NUMA) */
+int ssmem_num_nodes();
+void ssmem_node_stats_print();
+
+/* the memory of all the allocators that are not terminated, in bytes. The
+   counters of the threads are read as they run, so take it when they are quiet. */
+typedef struct ssmem_mem_stats
+{
+  size_t reserved;		/* chunks, and the pages of the large objects */
+  size_t used;			/* objects allocated and not freed */
+  size_t garbage;		/* objects freed and not safe to reuse yet */
+} ssmem_mem_stats_t;
+
+void ssmem_mem_stats(ssmem_mem_stats_t* s);
+
 
 /* **************************************************************************************** */
 /* platform-specific definitions */
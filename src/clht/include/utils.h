@@ -36,6 +36,7 @@
 #endif
 #include <pthread.h>
 
+#include "getticks.h"
 #include "sspfd.h"
 
 #ifdef __cplusplus
@@ -391,27 +392,16 @@ extern "C" {
     while (wtime() < __ts_end);
   }
 
-  //getticks needs to have a correction because the call itself takes a
-  //significant number of cycles and skewes the measurement
+  //the overhead of a fenced measurement on the calling thread (see getticks.h)
   static inline ticks getticks_correction_calc() {
-#define GETTICKS_CALC_REPS 5000000
-    ticks t_dur = 0;
-    uint32_t i;
-    for (i = 0; i < GETTICKS_CALC_REPS; i++) {
-      ticks t_start = getticks();
-      ticks t_end = getticks();
-      t_dur += t_end - t_start;
-    }
-    //    printf("corr in float %f\n", (t_dur / (double) GETTICKS_CALC_REPS));
-    ticks getticks_correction = (ticks)(t_dur / (double) GETTICKS_CALC_REPS);
-    return getticks_correction;
+    return getticks_overhead();
   }
 
   static inline ticks get_noop_duration() {
 #define NOOP_CALC_REPS 1000000
     ticks noop_dur = 0;
     uint32_t i;
-    ticks corr = getticks_correction_calc();
+    ticks corr = getticks_overhead();
     ticks start;
     ticks end;
     start = getticks();
@@ -0,0 +1,176 @@
+/*
+ *   File: clht_baseline.cc
+ *   Description: the CLHT interface over a reference map of baseline_maps.h,
+ *   so that test_mem.c measures it like the tables (make baselines)
+ *   clht_baseline.cc is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <unistd.h>
+#include "baseline_maps.h"
+
+/* clht.h declares is_power_of_two inline, which C++ would not emit for
+   test_mem.c: the declaration is renamed away and defined below */
+#define is_power_of_two clht_h_is_power_of_two
+extern "C" {
+#include "atomic_ops.h"
+#include "utils.h"
+#include "clht.h"
+}
+#undef is_power_of_two
+
+#if !defined(BASELINE)
+#  error "build with -DBASELINE=<kind>, see baseline_maps.h"
+#endif
+
+/* The values are the pointers to the ssmem objects of test_mem.c: the map owns
+   an object from the put that adds it to the remove that returns it. The null
+   map drops the objects of its puts, that ssmem then never gets back. */
+typedef baseline_map<BASELINE, clht_addr_t, uintptr_t>::type map_t;
+
+/* The map sits behind the header of a table with no buckets, that the driver
+   reads num_buckets from. */
+typedef struct clht_baseline
+{
+  clht_hashtable_t ht;
+  map_t* map;
+} clht_baseline_t;
+
+static inline map_t*
+baseline_of(clht_hashtable_t* h)
+{
+  return ((clht_baseline_t*) h)->map;
+}
+
+extern "C" {
+
+const char*
+clht_type_desc()
+{
+  return map_t::name();
+}
+
+int
+is_power_of_two(unsigned int x)
+{
+  return ((x != 0) && !(x & (x - 1)));
+}
+
+/* sized for the keys of num_buckets CLHT buckets; the shards, for the cores */
+clht_t*
+clht_create(uint32_t num_buckets)
+{
+  clht_t* w = (clht_t*) memalign(CACHE_LINE_SIZE, sizeof(clht_t));
+  clht_baseline_t* b = (clht_baseline_t*) memalign(CACHE_LINE_SIZE, sizeof(clht_baseline_t));
+  if (w == NULL || b == NULL)
+    {
+      return NULL;
+    }
+  memset((void*) w, 0, sizeof(clht_t));
+  memset((void*) b, 0, sizeof(clht_baseline_t));
+  b->map = new map_t((size_t) num_buckets * ENTRIES_PER_BUCKET,
+		     (size_t) sysconf(_SC_NPROCESSORS_ONLN));
+  w->ht = &b->ht;
+  return w;
+}
+
+void
+clht_gc_thread_init(clht_t* hashtable, int id)
+{
+}
+
+int
+clht_put(clht_t* hashtable, clht_addr_t key, clht_val_t val)
+{
+  return baseline_of(hashtable->ht)->insert(key, (uintptr_t) val);
+}
+
+clht_val_t
+clht_get(clht_hashtable_t* hashtable, clht_addr_t key)
+{
+  uintptr_t val;
+  return baseline_of(hashtable)->find(key, val) ? val : 0;
+}
+
+clht_val_t
+clht_remove(clht_t* hashtable, clht_addr_t key)
+{
+  uintptr_t val;
+  return baseline_of(hashtable->ht)->erase(key, val) ? val : 0;
+}
+
+size_t
+clht_size(clht_hashtable_t* hashtable)
+{
+  return baseline_of(hashtable)->size();
+}
+
+/* the map and its header, as the table and the locks of the driver */
+size_t
+clht_size_mem(clht_hashtable_t* h) /* in bytes */
+{
+  mem_footprint_t f;
+  memset(&f, 0, sizeof(f));
+  baseline_of(h)->footprint(&f);
+  return sizeof(clht_baseline_t) + mem_footprint_total(&f);
+}
+
+size_t
+clht_size_mem_locks(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  mem_footprint_t f;
+  memset(&f, 0, sizeof(f));
+  baseline_of(h)->footprint(&f);
+  return f.locks;
+}
+
+size_t
+clht_size_mem_overflow(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  mem_footprint_t f;
+  memset(&f, 0, sizeof(f));
+  baseline_of(h)->footprint(&f);
+  return f.overflow;
+}
+
+size_t
+clht_size_mem_garbage(clht_hashtable_t* h) /* in bytes */
+{
+  return 0;
+}
+
+void
+clht_gc_destroy(clht_t* hashtable)
+{
+  clht_baseline_t* b = (clht_baseline_t*) hashtable->ht;
+  delete b->map;
+  free(b);
+  free(hashtable);
+}
+
+void
+clht_print(clht_hashtable_t* hashtable)
+{
+  printf("%s: %zu keys\n", clht_type_desc(), clht_size(hashtable));
+}
+
+}
@@ -728,6 +728,28 @@ clht_size_mem(clht_hashtable_t* h) /* in bytes */
   return size_tot;
 }
 
+size_t
+clht_size_mem_locks(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  if (h == NULL)
+    {
+      return 0;
+    }
+
+  return h->num_buckets * sizeof(clht_lock_t);
+}
+
+size_t
+clht_size_mem_overflow(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  if (h == NULL)
+    {
+      return 0;
+    }
+
+  return CLHT_LINKED_MAX_EXPANSIONS_HARD * sizeof(bucket_t);
+}
+
 size_t
 clht_size_mem_garbage(clht_hashtable_t* h) /* in bytes */
 {
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "clht_lb_res.h"
 
@@ -502,6 +503,7 @@ ht_resize_help(clht_hashtable_t* h)
       return;
     }
 
+  RETRY_STAT_INC(RESIZE_HELP);
   int32_t b;
   /* hash = num_buckets - 1 */
   for (b = h->hash; b >= 0; b--)
@@ -624,6 +626,195 @@ ht_resize_pes(clht_t* h, int is_increase, int by)
   return 1;
 }
 
+/* ******************************************************************************** */
+/* bulk loading */
+/* ******************************************************************************** */
+
+typedef struct clht_bulk_arg
+{
+  int id;
+  int num_threads;
+  clht_hashtable_t* ht;
+  clht_addr_t* keys;
+  clht_val_t* vals;
+  size_t num;
+  size_t* counts;		/* num_threads x num_threads: chunk-major */
+  size_t* order;
+  pthread_barrier_t* barrier;
+  size_t num_put;
+} clht_bulk_arg_t;
+
+static inline int
+clht_bulk_owner(clht_hashtable_t* ht, uint32_t bin, int num_threads)
+{
+  return (int) (((uint64_t) bin * num_threads) / ht->num_buckets);
+}
+
+/* Each thread first counts the keys of its chunk of the input per owner, where
+   thread o owns the buckets [o * nb / T, (o + 1) * nb / T). After a prefix sum
+   (done by thread 0), the threads scatter the indices of their chunk so that
+   the keys of every owner are contiguous and in input order, and finally each
+   thread inserts the keys of the buckets it owns, without taking any bucket
+   lock. */
+static void*
+clht_bulk_thread(void* a)
+{
+  clht_bulk_arg_t* arg = (clht_bulk_arg_t*) a;
+  const int id = arg->id, T = arg->num_threads;
+  clht_hashtable_t* ht = arg->ht;
+  const size_t lo = arg->num * id / T, hi = arg->num * (id + 1) / T;
+  size_t* counts = arg->counts + (size_t) id * T;
+  size_t i;
+
+  for (i = lo; i < hi; i++)
+    {
+      if (arg->keys[i] != 0)
+	{
+	  counts[clht_bulk_owner(ht, clht_hash(ht, arg->keys[i]), T)]++;
+	}
+    }
+
+  pthread_barrier_wait(arg->barrier);
+  if (id == 0)
+    {
+      size_t sum = 0;
+      int o, c;
+      for (o = 0; o < T; o++)
+	{
+	  for (c = 0; c < T; c++)
+	    {
+	      size_t cnt = arg->counts[(size_t) c * T + o];
+	      arg->counts[(size_t) c * T + o] = sum;
+	      sum += cnt;
+	    }
+	}
+    }
+  pthread_barrier_wait(arg->barrier);
+
+  for (i = lo; i < hi; i++)
+    {
+      if (arg->keys[i] != 0)
+	{
+	  arg->order[counts[clht_bulk_owner(ht, clht_hash(ht, arg->keys[i]), T)]++] = i;
+	}
+    }
+
+  pthread_barrier_wait(arg->barrier);
+
+  /* after the scatter, the offset of (chunk T-1, owner o) points to the end of
+     owner o's keys, and the one of (chunk 0, owner o) to the start of owner
+     o + 1's, so the range of o starts at the end of o - 1 */
+  size_t start = (id == 0) ? 0 : arg->counts[(size_t) (T - 1) * T + id - 1];
+  size_t end = arg->counts[(size_t) (T - 1) * T + id];
+  size_t num_put = 0;
+  for (i = start; i < end; i++)
+    {
+      clht_addr_t key = arg->keys[arg->order[i]];
+      uint32_t bin = clht_hash(ht, key);
+      if (!bucket_exists(ht->table + bin, key))
+	{
+	  clht_put_seq(ht, key, arg->vals[arg->order[i]], bin);
+	  num_put++;
+	}
+    }
+  arg->num_put = num_put;
+
+  return NULL;
+}
+
+/* Insert num key-value pairs with num_threads threads. The table is first
+   grown so that it holds its current and new elements at about
+   CLHT_OCCUP_AFTER_RES occupancy. Keys that are 0 or already in the table are
+   skipped (for a key that appears more than once, the first occurrence wins).
+   This is meant for loading the table: no other thread may use it while
+   clht_bulk_put is running, and, as for clht_put, the caller must have called
+   clht_gc_thread_init, since growing the table releases the old one through
+   its allocator. Returns the number of inserted pairs. */
+size_t
+clht_bulk_put(clht_t* h, clht_addr_t* keys, clht_val_t* vals, size_t num, int num_threads)
+{
+  if (num == 0)
+    {
+      return 0;
+    }
+  if (num_threads < 1)
+    {
+      num_threads = 1;
+    }
+
+  size_t size = clht_size(h->ht);
+  size_t num_buckets_min = ((size + num) * 100) / (ENTRIES_PER_BUCKET * CLHT_OCCUP_AFTER_RES);
+  while (h->ht->num_buckets < num_buckets_min)
+    {
+      size_t by = pow2roundup((num_buckets_min + h->ht->num_buckets - 1) / h->ht->num_buckets);
+      if (by < 2)
+	{
+	  by = 2;
+	}
+      ht_resize_pes(h, 1, by);
+    }
+
+  clht_hashtable_t* ht = h->ht;
+  if ((size_t) num_threads > ht->num_buckets)
+    {
+      num_threads = ht->num_buckets;
+    }
+
+  const int T = num_threads;
+  size_t* counts = (size_t*) calloc((size_t) T * T, sizeof(size_t));
+  size_t* order = (size_t*) malloc(num * sizeof(size_t));
+  clht_bulk_arg_t* args = (clht_bulk_arg_t*) malloc(T * sizeof(clht_bulk_arg_t));
+  pthread_t* threads = (pthread_t*) malloc(T * sizeof(pthread_t));
+  assert(counts != NULL && order != NULL && args != NULL && threads != NULL);
+
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, T);
+
+  int t;
+  for (t = 0; t < T; t++)
+    {
+      args[t].id = t;
+      args[t].num_threads = T;
+      args[t].ht = ht;
+      args[t].keys = keys;
+      args[t].vals = vals;
+      args[t].num = num;
+      args[t].counts = counts;
+      args[t].order = order;
+      args[t].barrier = &barrier;
+      args[t].num_put = 0;
+      if (t > 0)
+	{
+	  int rc = pthread_create(threads + t, NULL, clht_bulk_thread, args + t);
+	  assert(rc == 0);
+	  (void) rc;
+	}
+    }
+  clht_bulk_thread(args);
+
+  size_t num_put = args[0].num_put;
+  for (t = 1; t < T; t++)
+    {
+      pthread_join(threads[t], NULL);
+      num_put += args[t].num_put;
+    }
+
+  pthread_barrier_destroy(&barrier);
+  free(threads);
+  free(args);
+  free(order);
+  free(counts);
+
+  /* long overflow chains are handled the same way a put that hits the
+     threshold handles them */
+  if (ht->num_expands >= ht->num_expands_threshold)
+    {
+      ht_status(h, 1, 0);
+    }
+
+  return num_put;
+}
+
 size_t
 clht_size(clht_hashtable_t* hashtable)
 {
@@ -753,6 +944,28 @@ clht_size_mem(clht_hashtable_t* h) /* in bytes */
   return size_tot;
 }
 
+size_t
+clht_size_mem_locks(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  if (h == NULL)
+    {
+      return 0;
+    }
+
+  return h->num_buckets * sizeof(clht_lock_t);
+}
+
+size_t
+clht_size_mem_overflow(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  if (h == NULL)
+    {
+      return 0;
+    }
+
+  return h->num_expands * sizeof(bucket_t);
+}
+
 size_t
 clht_size_mem_garbage(clht_hashtable_t* h) /* in bytes */
 {
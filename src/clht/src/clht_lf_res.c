@@ -35,6 +35,18 @@
 
 #include "clht_lf_res.h"
 
+#if defined(RECLAIM)
+/* built with a reclamation policy (test_reclaim.c): the values are objects that
+   the removers retire, so a reader that found its value protects it, and then
+   checks that the slot still holds it */
+#  include "reclaim.h"
+#  define CLHT_PROTECT_VAL(bucket, i, val)					\
+  (reclaim_publish(0, (void*) (val)),						\
+   (bucket)->map[i] == MAP_VALID && (bucket)->val[i] == (val))
+#else
+#  define CLHT_PROTECT_VAL(bucket, i, val) 1
+#endif
+
 __thread ssmem_allocator_t* clht_alloc;
 
 #ifdef DEBUG
@@ -201,7 +213,7 @@ clht_bucket_search(bucket_t* bucket, clht_addr_t key)
       	{
 	  if (bucket->key[i] == key)
 	    {
-	      if (likely(bucket->val[i] == val))
+	      if (likely(bucket->val[i] == val && CLHT_PROTECT_VAL(bucket, i, val)))
 		{
 		  return val;
 		}
@@ -292,6 +304,7 @@ clht_put(clht_t* h, clht_addr_t key, clht_val_t val)
 	{
 	  empty_index = -2;
 	  INC(num_retry_cas1);
+	  RETRY_STAT_INC(UPDATE_TRY);
 	  goto retry;
 	}
   
@@ -313,6 +326,7 @@ clht_put(clht_t* h, clht_addr_t key, clht_val_t val)
   if (CAS_U64(&bucket->snapshot, s1, s2) != s1)
     {
       INC(num_retry_cas2);
+      RETRY_STAT_INC(UPDATE_TRY);
       goto retry;
     }
 
@@ -356,6 +370,7 @@ clht_remove(clht_t* h, clht_addr_t key)
 	  else
 	    {
 	      INC(num_retry_cas3);
+	      RETRY_STAT_INC(UPDATE_TRY);
 	      goto retry;
 	    }
 	}
@@ -586,6 +601,19 @@ clht_size_mem(clht_hashtable_t* h) /* in bytes */
   return size_tot;
 }
 
+/* no locks, and no overflow buckets: a full bucket makes the table grow */
+size_t
+clht_size_mem_locks(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  return 0;
+}
+
+size_t
+clht_size_mem_overflow(clht_hashtable_t* h) /* in bytes, part of clht_size_mem */
+{
+  return 0;
+}
+
 size_t
 clht_size_mem_garbage(clht_hashtable_t* h) /* in bytes */
 {
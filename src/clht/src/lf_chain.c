@@ -0,0 +1,236 @@
+/*
+ *   File: lf_chain.c
+ *   Description: lock-free chained hash table (Michael, SPAA 2002), whose
+ *                removed nodes go through the reclaim.h policy
+ *   lf_chain.c is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+
+#include "lf_chain.h"
+#include "reclaim.h"
+
+#define LFC_MARKED(p)    ((uintptr_t) (p) & 1)
+#define LFC_MARK(p)      ((lfc_node_t*) ((uintptr_t) (p) | 1))
+#define LFC_UNMARK(p)    ((lfc_node_t*) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define LFC_CAS(a, b, c) __sync_bool_compare_and_swap(a, b, c)
+
+/* hazard slots */
+#define LFC_HP_CUR       1
+#define LFC_HP_PREV      2
+
+/* where a key is, or would be, in a bucket */
+typedef struct lfc_pos
+{
+  lfc_node_t* volatile* prev;	/* the link to cur */
+  lfc_node_t* cur;		/* the first node whose key is not smaller */
+  lfc_node_t* next;
+} lfc_pos_t;
+
+lfc_t*
+lfc_create(size_t num_buckets)
+{
+  size_t n = 1;
+  while (n < num_buckets)
+    {
+      n <<= 1;
+    }
+  lfc_t* t = (lfc_t*) malloc(sizeof(lfc_t));
+  assert(t != NULL);
+  t->hash = n - 1;
+  t->buckets = (lfc_node_t* volatile*) calloc(n, sizeof(lfc_node_t*));
+  assert(t->buckets != NULL);
+  return t;
+}
+
+void
+lfc_destroy(lfc_t* t)
+{
+  size_t b;
+  for (b = 0; b <= t->hash; b++)
+    {
+      lfc_node_t* cur = LFC_UNMARK(t->buckets[b]);
+      while (cur != NULL)
+	{
+	  lfc_node_t* next = LFC_UNMARK(cur->next);
+	  reclaim_unused(cur);
+	  cur = next;
+	}
+    }
+  free((void*) t->buckets);
+  free(t);
+}
+
+static inline lfc_node_t* volatile*
+lfc_bucket(lfc_t* t, lfc_key_t key)
+{
+  return &t->buckets[key & t->hash];
+}
+
+/* Finds key in the bucket at head, and unlinks the removed nodes it passes.
+   Returns 1 if key is in, with pos->cur its node. cur stays protected (and
+   the node before it), until the next find or reclaim_end(). */
+static int
+lfc_find(lfc_node_t* volatile* head, lfc_key_t key, lfc_pos_t* pos)
+{
+ retry:
+  {
+    lfc_node_t* volatile* prev = head;
+    lfc_node_t* cur = *prev;
+    while (1)
+      {
+	if (cur == NULL)
+	  {
+	    pos->prev = prev;
+	    pos->cur = NULL;
+	    pos->next = NULL;
+	    return 0;
+	  }
+	reclaim_publish(LFC_HP_CUR, cur);
+	if (*prev != cur)
+	  {
+	    goto retry;
+	  }
+
+	lfc_node_t* next = cur->next;
+	if (LFC_MARKED(next))
+	  {
+	    if (!LFC_CAS(prev, cur, LFC_UNMARK(next)))
+	      {
+		goto retry;
+	      }
+	    reclaim_retire(cur);
+	    cur = LFC_UNMARK(next);
+	    continue;
+	  }
+
+	const lfc_key_t ckey = cur->key;
+	if (*prev != cur)
+	  {
+	    goto retry;
+	  }
+	if (ckey >= key)
+	  {
+	    pos->prev = prev;
+	    pos->cur = cur;
+	    pos->next = next;
+	    return ckey == key;
+	  }
+	/* cur is protected already, so the new slot needs no check */
+	reclaim_publish(LFC_HP_PREV, cur);
+	prev = &cur->next;
+	cur = next;
+      }
+  }
+}
+
+lfc_val_t
+lfc_get(lfc_t* t, lfc_key_t key)
+{
+  lfc_pos_t pos;
+  if (lfc_find(lfc_bucket(t, key), key, &pos))
+    {
+      return pos.cur->val;
+    }
+  return 0;
+}
+
+int
+lfc_put(lfc_t* t, lfc_key_t key, lfc_val_t val)
+{
+  lfc_node_t* volatile* head = lfc_bucket(t, key);
+  lfc_node_t* node = NULL;
+  lfc_pos_t pos;
+  while (1)
+    {
+      if (lfc_find(head, key, &pos))
+	{
+	  if (node != NULL)
+	    {
+	      reclaim_unused(node);
+	    }
+	  return 0;
+	}
+      if (node == NULL)
+	{
+	  node = (lfc_node_t*) reclaim_alloc(sizeof(lfc_node_t));
+	  node->key = key;
+	  node->val = val;
+	}
+      node->next = pos.cur;
+      if (LFC_CAS(pos.prev, pos.cur, node))
+	{
+	  return 1;
+	}
+    }
+}
+
+lfc_val_t
+lfc_remove(lfc_t* t, lfc_key_t key)
+{
+  lfc_node_t* volatile* head = lfc_bucket(t, key);
+  lfc_pos_t pos;
+  while (1)
+    {
+      if (!lfc_find(head, key, &pos))
+	{
+	  return 0;
+	}
+      lfc_node_t* next = pos.next;
+      if (!LFC_CAS(&pos.cur->next, next, LFC_MARK(next)))
+	{
+	  continue;
+	}
+      const lfc_val_t val = pos.cur->val;
+      if (LFC_CAS(pos.prev, pos.cur, next))
+	{
+	  reclaim_retire(pos.cur);
+	}
+      else
+	{
+	  /* someone changed the link: the find unlinks it */
+	  lfc_find(head, key, &pos);
+	}
+      return val;
+    }
+}
+
+size_t
+lfc_size(lfc_t* t)
+{
+  size_t size = 0, b;
+  for (b = 0; b <= t->hash; b++)
+    {
+      lfc_node_t* cur = LFC_UNMARK(t->buckets[b]);
+      while (cur != NULL)
+	{
+	  lfc_node_t* next = cur->next;
+	  size += !LFC_MARKED(next);
+	  cur = LFC_UNMARK(next);
+	}
+    }
+  return size;
+}
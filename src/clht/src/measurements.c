@@ -65,12 +65,12 @@ prints_ticks_stats(int start, int end)
     if (total_samples[i] && total_sum_ticks[i]) {
       printf("[%02d]%s:\n", i, measurement_msgs[i]);
       double ticks_perc = 100 * ((double) total_sum_ticks[i] / tticks);
-      double secs = total_sum_ticks[i] / (REF_SPEED_GHZ * 1.e9);
+      double secs = ticks_to_ns(total_sum_ticks[i]) / 1.e9;
       int s = (int) trunc(secs);
       int ms = (int) trunc((secs - s) * 1000);
       int us = (int) trunc(((secs - s) * 1000000) - (ms * 1000));
       int ns = (int) trunc(((secs - s) * 1000000000) - (ms * 1000000) - (us * 1000));
-      double secsa = (total_sum_ticks[i] / total_samples[i]) / (REF_SPEED_GHZ * 1.e9);
+      double secsa = (ticks_to_ns(total_sum_ticks[i]) / total_samples[i]) / 1.e9;
       int sa = (int) trunc(secsa);
       int msa = (int) trunc((secsa - sa) * 1000);
       int usa = (int) trunc(((secsa - sa) * 1000000) - (msa * 1000));
@@ -0,0 +1,466 @@
+/*
+ *   File: reclaim.c
+ *   Description: memory-reclamation policies for the lock-free tables
+ *   reclaim.c is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "reclaim.h"
+
+reclaim_thread_t reclaim_threads[RECLAIM_MAX_THREADS];
+volatile uint64_t reclaim_epoch = 1;
+static volatile uint32_t reclaim_num_threads = 0; /* highest id + 1 */
+
+__thread reclaim_thread_t* reclaim_me = NULL;
+__thread uint64_t reclaim_my_epoch = 0;
+__thread ssmem_allocator_t* reclaim_alloc_ssmem = NULL;
+
+/* a retired object */
+typedef struct reclaim_retired
+{
+  void* obj;
+  ticks when;
+  uint64_t era;			/* HE: era of the retirement */
+} reclaim_retired_t;
+
+/* retired objects that are not freed yet */
+typedef struct reclaim_list
+{
+  reclaim_retired_t* objs;
+  size_t num;
+  size_t size;
+  uint64_t epoch;		/* EBR, QSBR: the epoch they were retired in */
+  size_t kept;			/* HP, HE: the objects the last scan could not free */
+} reclaim_list_t;
+
+#if RECLAIM_KEEPS_LISTS
+/* EBR and QSBR keep a list per epoch that can still be pending, HP and HE one */
+static __thread reclaim_list_t reclaim_lists[3];
+static __thread size_t __attribute__ ((unused)) reclaim_since = 0; /* retires since the last attempt */
+
+/* the objects that the threads left at their term, for the last one to free */
+static reclaim_list_t reclaim_orphans;
+static uint32_t reclaim_active = 0;
+static pthread_mutex_t reclaim_orphans_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static const char* reclaim_names[] = { "none", "ssmem", "ebr", "qsbr", "hp", "he" };
+
+const char*
+reclaim_name()
+{
+  return reclaim_names[RECLAIM];
+}
+
+void
+reclaim_thread_init(int id)
+{
+  assert(id < RECLAIM_MAX_THREADS);
+  reclaim_me = &reclaim_threads[id];
+  uint32_t n;
+  do
+    {
+      n = reclaim_num_threads;
+    }
+  while (n < (uint32_t) id + 1
+	 && !__sync_bool_compare_and_swap(&reclaim_num_threads, n, (uint32_t) id + 1));
+
+#if RECLAIM_KEEPS_LISTS
+  pthread_mutex_lock(&reclaim_orphans_lock);
+  reclaim_active++;
+  pthread_mutex_unlock(&reclaim_orphans_lock);
+#endif
+
+  reclaim_my_epoch = reclaim_epoch;
+#if RECLAIM == RECLAIM_QSBR
+  __sync_lock_test_and_set(&reclaim_me->epoch, (reclaim_my_epoch << 1) | 1);
+#endif
+#if RECLAIM == RECLAIM_SSMEM
+  reclaim_alloc_ssmem = (ssmem_allocator_t*) malloc(sizeof(ssmem_allocator_t));
+  assert(reclaim_alloc_ssmem != NULL);
+  ssmem_alloc_init_fs_size(reclaim_alloc_ssmem, SSMEM_DEFAULT_MEM_SIZE, SSMEM_GC_FREE_SET_SIZE, id);
+#endif
+}
+
+void
+reclaim_stats_get(reclaim_stats_t* stats)
+{
+  memset(stats, 0, sizeof(reclaim_stats_t));
+  uint32_t t;
+  for (t = 0; t < reclaim_num_threads; t++)
+    {
+      reclaim_thread_t* th = &reclaim_threads[t];
+      stats->retired_num += th->retired_num;
+      stats->retired_bytes += th->retired_bytes;
+      stats->freed_num += th->freed_num;
+      stats->freed_bytes += th->freed_bytes;
+      stats->lat_sum += th->lat_sum;
+      if (th->lat_max > stats->lat_max)
+	{
+	  stats->lat_max = th->lat_max;
+	}
+    }
+}
+
+/* **************************************************************************************** */
+/* alloc / free */
+/* **************************************************************************************** */
+
+void*
+reclaim_alloc(size_t size)
+{
+#if RECLAIM == RECLAIM_SSMEM
+  return ssmem_alloc(reclaim_alloc_ssmem, size);
+#else
+  reclaim_hdr_t* hdr = (reclaim_hdr_t*) malloc(sizeof(reclaim_hdr_t) + size);
+  assert(hdr != NULL);
+  hdr->size = size;
+  hdr->birth = reclaim_epoch;
+  return (void*) (hdr + 1);
+#endif
+}
+
+static inline reclaim_hdr_t*
+reclaim_hdr_of(void* obj)
+{
+  return ((reclaim_hdr_t*) obj) - 1;
+}
+
+void
+reclaim_unused(void* obj)
+{
+#if RECLAIM == RECLAIM_SSMEM
+  /* ssmem cannot tell it from a retired object: count it as one, so that
+     freed does not overtake retired */
+  reclaim_me->retired_num++;
+  reclaim_me->retired_bytes += ssmem_obj_size(obj);
+  ssmem_free(reclaim_alloc_ssmem, obj);
+#else
+  free(reclaim_hdr_of(obj));
+#endif
+}
+
+#if RECLAIM_KEEPS_LISTS
+
+static void
+reclaim_list_add(reclaim_list_t* l, void* obj, uint64_t era)
+{
+  if (unlikely(l->num == l->size))
+    {
+      l->size = l->size ? 2 * l->size : 2 * RECLAIM_BATCH;
+      l->objs = (reclaim_retired_t*) realloc(l->objs, l->size * sizeof(reclaim_retired_t));
+      assert(l->objs != NULL);
+    }
+  reclaim_retired_t* r = &l->objs[l->num++];
+  r->obj = obj;
+  r->when = getticks();
+  r->era = era;
+}
+
+/* frees r, retired then */
+static inline void
+reclaim_free(reclaim_retired_t* r, ticks now, size_t* bytes, ticks* lat_max)
+{
+  const ticks lat = now - r->when;
+  reclaim_me->lat_sum += lat;
+  if (lat > *lat_max)
+    {
+      *lat_max = lat;
+    }
+  reclaim_hdr_t* hdr = reclaim_hdr_of(r->obj);
+  *bytes += hdr->size;
+  free(hdr);
+}
+
+static void
+reclaim_account(size_t num, size_t bytes, ticks lat_max)
+{
+  reclaim_me->freed_num += num;
+  reclaim_me->freed_bytes += bytes;
+  if (lat_max > reclaim_me->lat_max)
+    {
+      reclaim_me->lat_max = lat_max;
+    }
+}
+
+#endif	/* RECLAIM_KEEPS_LISTS */
+
+/* **************************************************************************************** */
+/* EBR, QSBR */
+/* **************************************************************************************** */
+
+#if RECLAIM == RECLAIM_EBR || RECLAIM == RECLAIM_QSBR
+/* moves the epoch on if every active thread has seen the current one */
+static void
+reclaim_epoch_try_advance()
+{
+  const uint64_t e = reclaim_epoch;
+  const uint64_t cur = (e << 1) | 1;
+  uint32_t t;
+  for (t = 0; t < reclaim_num_threads; t++)
+    {
+      const uint64_t te = reclaim_threads[t].epoch;
+      if (te != RECLAIM_INACTIVE && te != cur)
+	{
+	  return;
+	}
+    }
+  __sync_bool_compare_and_swap(&reclaim_epoch, e, e + 1);
+}
+#endif
+
+void
+reclaim_epoch_changed()
+{
+#if RECLAIM == RECLAIM_EBR || RECLAIM == RECLAIM_QSBR
+  const uint64_t e = reclaim_my_epoch;
+  ticks now = 0, lat_max = 0;
+  size_t num = 0, bytes = 0;
+  int i;
+  for (i = 0; i < 3; i++)
+    {
+      reclaim_list_t* l = &reclaim_lists[i];
+      if (l->num > 0 && l->epoch + 2 <= e)
+	{
+	  if (now == 0)
+	    {
+	      now = getticks();
+	    }
+	  size_t j;
+	  for (j = 0; j < l->num; j++)
+	    {
+	      reclaim_free(&l->objs[j], now, &bytes, &lat_max);
+	    }
+	  num += l->num;
+	  l->num = 0;
+	}
+    }
+  if (num > 0)
+    {
+      reclaim_account(num, bytes, lat_max);
+    }
+#endif
+}
+
+/* **************************************************************************************** */
+/* HP, HE */
+/* **************************************************************************************** */
+
+#if RECLAIM == RECLAIM_HP || RECLAIM == RECLAIM_HE
+static int
+reclaim_uintptr_cmp(const void* a, const void* b)
+{
+  const uintptr_t x = *(const uintptr_t*) a, y = *(const uintptr_t*) b;
+  return (x > y) - (x < y);
+}
+
+/* frees the retired objects that no slot of any thread protects */
+static void
+reclaim_scan(reclaim_list_t* l)
+{
+  uintptr_t slots[RECLAIM_MAX_THREADS * RECLAIM_SLOTS];
+  size_t num_slots = 0;
+  __sync_synchronize();
+  uint32_t t;
+  for (t = 0; t < reclaim_num_threads; t++)
+    {
+      int i;
+      for (i = 0; i < RECLAIM_SLOTS; i++)
+	{
+	  const uintptr_t s = reclaim_threads[t].slot[i];
+	  if (s != 0)
+	    {
+	      slots[num_slots++] = s;
+	    }
+	}
+    }
+  qsort(slots, num_slots, sizeof(uintptr_t), reclaim_uintptr_cmp);
+
+  const ticks now = getticks();
+  ticks lat_max = 0;
+  size_t j, kept = 0, bytes = 0;
+  for (j = 0; j < l->num; j++)
+    {
+      reclaim_retired_t* r = &l->objs[j];
+#  if RECLAIM == RECLAIM_HP
+      const int safe = bsearch(&r->obj, slots, num_slots, sizeof(uintptr_t), reclaim_uintptr_cmp) == NULL;
+#  else
+      /* the first era at or after the birth of the object must be after its retirement */
+      const uintptr_t birth = reclaim_hdr_of(r->obj)->birth;
+      size_t lo = 0, hi = num_slots;
+      while (lo < hi)
+	{
+	  const size_t mid = (lo + hi) / 2;
+	  if (slots[mid] < birth)
+	    {
+	      lo = mid + 1;
+	    }
+	  else
+	    {
+	      hi = mid;
+	    }
+	}
+      const int safe = lo == num_slots || slots[lo] > r->era;
+#  endif
+      if (safe)
+	{
+	  reclaim_free(r, now, &bytes, &lat_max);
+	}
+      else
+	{
+	  l->objs[kept++] = *r;
+	}
+    }
+  reclaim_account(l->num - kept, bytes, lat_max);
+  l->num = kept;
+  l->kept = kept;
+}
+#endif
+
+void
+reclaim_retire(void* obj)
+{
+#if RECLAIM == RECLAIM_SSMEM
+  reclaim_me->retired_num++;
+  reclaim_me->retired_bytes += ssmem_obj_size(obj);
+  ssmem_free(reclaim_alloc_ssmem, obj);
+  reclaim_me->freed_num = reclaim_alloc_ssmem->reclaimed_num;
+  reclaim_me->freed_bytes = reclaim_alloc_ssmem->reclaimed_bytes;
+#else
+  reclaim_me->retired_num++;
+  reclaim_me->retired_bytes += reclaim_hdr_of(obj)->size;
+#  if RECLAIM == RECLAIM_EBR || RECLAIM == RECLAIM_QSBR
+  /* the epoch now, read after obj was unlinked: not the one this operation
+     pinned (EBR), which the others can have moved on from before the unlink and
+     then read obj in the next one. The threads that can still hold obj have
+     pinned e at most (EBR), or not gone through a quiescent state of e + 1 yet
+     (QSBR), so the epoch gets to e + 2 only after they are done with it. */
+  const uint64_t e = reclaim_epoch;
+  reclaim_list_t* l = &reclaim_lists[e % 3];
+  if (l->num > 0 && l->epoch != e)
+    {
+      /* the list of e - 3, which we did not get to free yet */
+      reclaim_epoch_changed();
+    }
+  l->epoch = e;
+  reclaim_list_add(l, obj, 0);
+  if (++reclaim_since >= RECLAIM_BATCH)
+    {
+      reclaim_since = 0;
+      reclaim_epoch_try_advance();
+    }
+#  elif RECLAIM == RECLAIM_HP || RECLAIM == RECLAIM_HE
+  reclaim_list_t* l = &reclaim_lists[0];
+#    if RECLAIM == RECLAIM_HE
+  reclaim_list_add(l, obj, reclaim_epoch);
+  if (++reclaim_since >= RECLAIM_BATCH)
+    {
+      reclaim_since = 0;
+      __sync_fetch_and_add(&reclaim_epoch, 1);
+    }
+#    else
+  reclaim_list_add(l, obj, 0);
+#    endif
+  size_t threshold = 2 * reclaim_num_threads * RECLAIM_SLOTS;
+  if (threshold < RECLAIM_BATCH)
+    {
+      threshold = RECLAIM_BATCH;
+    }
+  /* counted from what the last scan kept, or every retire would scan once the
+     slots protect that many */
+  if (l->num >= l->kept + threshold)
+    {
+      reclaim_scan(l);
+    }
+#  endif
+#endif
+}
+
+/* **************************************************************************************** */
+/* term */
+/* **************************************************************************************** */
+
+void
+reclaim_thread_term()
+{
+  reclaim_me->epoch = RECLAIM_INACTIVE;
+  int i;
+  for (i = 0; i < RECLAIM_SLOTS; i++)
+    {
+      reclaim_me->slot[i] = 0;
+    }
+
+#if RECLAIM_KEEPS_LISTS
+  /* frees what the others let us free now */
+#  if RECLAIM == RECLAIM_EBR || RECLAIM == RECLAIM_QSBR
+  reclaim_epoch_try_advance();
+  reclaim_my_epoch = reclaim_epoch;
+  reclaim_epoch_changed();
+#  else
+  if (reclaim_lists[0].num > 0)
+    {
+      reclaim_scan(&reclaim_lists[0]);
+    }
+#  endif
+
+  /* and leaves the rest to the last thread, when no one can hold them anymore */
+  pthread_mutex_lock(&reclaim_orphans_lock);
+  for (i = 0; i < 3; i++)
+    {
+      reclaim_list_t* l = &reclaim_lists[i];
+      size_t j;
+      for (j = 0; j < l->num; j++)
+	{
+	  reclaim_retired_t* r = &l->objs[j];
+	  reclaim_list_add(&reclaim_orphans, r->obj, r->era);
+	  reclaim_orphans.objs[reclaim_orphans.num - 1].when = r->when;
+	}
+      free(l->objs);
+      memset(l, 0, sizeof(reclaim_list_t));
+    }
+  reclaim_since = 0;
+
+  if (--reclaim_active == 0 && reclaim_orphans.num > 0)
+    {
+      const ticks now = getticks();
+      ticks lat_max = 0;
+      size_t j, bytes = 0;
+      for (j = 0; j < reclaim_orphans.num; j++)
+	{
+	  reclaim_free(&reclaim_orphans.objs[j], now, &bytes, &lat_max);
+	}
+      reclaim_account(reclaim_orphans.num, bytes, lat_max);
+      free(reclaim_orphans.objs);
+      memset(&reclaim_orphans, 0, sizeof(reclaim_list_t));
+    }
+  pthread_mutex_unlock(&reclaim_orphans_lock);
+#endif
+}
@@ -0,0 +1,949 @@
+/*
+ *   File: ssmem.c
+ *   Description: ssmem, a simple, timestamp-based, memory allocator with
+ *                garbage collection, for concurrent data structures
+ *   ssmem.c is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Every thread has a timestamp (ssmem_ts_t) that it increments on ssmem_alloc()
+ * and/or ssmem_free() (see SSMEM_TS_INCR_ON), or on SSMEM_SAFE_TO_RECLAIM().
+ * Freed objects are gathered in free sets, one list of sets per size class.
+ * When a set gets full, the timestamps of all threads are collected into it,
+ * and the older sets of all classes are checked against this collection: a set
+ * whose timestamps have all been passed is not referenced by anyone anymore.
+ * Such a set, and every older set of its class, becomes a collected set, whose
+ * objects ssmem_alloc() hands out again before it bump-allocates new ones.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <malloc.h>
+#include <pthread.h>
+#if defined(NUMA)
+#  include <sched.h>
+#  include <numa.h>
+#  include <numaif.h>
+#endif
+
+#include "ssmem.h"
+
+#if !defined(likely)
+#  define likely(x)       __builtin_expect((x), 1)
+#  define unlikely(x)     __builtin_expect((x), 0)
+#endif
+
+#define SSMEM_TS_INACTIVE ((size_t) -1)
+
+static const uint32_t ssmem_class_size[SSMEM_NUM_CLASSES] =
+  {
+    8, 16, 24, 32, 48, 64, 80, 96, 128, 160, 192, 256,
+    320, 384, 512, 640, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192
+  };
+
+/* the class of a size, per multiple of 8 bytes */
+static uint8_t ssmem_size_class[SSMEM_MAX_SMALL / 8 + 1];
+static pthread_once_t ssmem_global_once = PTHREAD_ONCE_INIT;
+
+static int ssmem_nodes = 1;
+ssmem_node_stats_t ssmem_node_stats[SSMEM_MAX_NODES];
+/* per node, a stack of the sets of objects sent back to the node */
+static ssmem_free_set_t* volatile ssmem_remote_inbox[SSMEM_MAX_NODES];
+
+static ssmem_ts_t* volatile ssmem_ts_list = NULL;
+static volatile uint32_t ssmem_ts_list_len = 0;
+
+static __thread ssmem_ts_t* ssmem_ts_local = NULL;
+static __thread size_t ssmem_num_allocators = 0;
+static __thread ssmem_list_t* ssmem_allocator_list = NULL;
+
+/* every allocator of every thread, for ssmem_mem_stats */
+static ssmem_list_t* ssmem_stats_list = NULL;
+static pthread_mutex_t ssmem_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+ssmem_global_init()
+{
+#if defined(NUMA)
+  if (numa_available() >= 0)
+    {
+      ssmem_nodes = numa_max_node() + 1;
+      if (ssmem_nodes > SSMEM_MAX_NODES)
+	{
+	  ssmem_nodes = SSMEM_MAX_NODES;
+	}
+    }
+#endif
+
+  size_t units, c = 0;
+  for (units = 0; units <= SSMEM_MAX_SMALL / 8; units++)
+    {
+      while (ssmem_class_size[c] < units * 8)
+	{
+	  c++;
+	}
+      ssmem_size_class[units] = (uint8_t) c;
+    }
+}
+
+static inline uint32_t
+ssmem_class_of(size_t size)
+{
+  if (unlikely(size > SSMEM_MAX_SMALL))
+    {
+      return SSMEM_CLASS_LARGE;
+    }
+  return ssmem_size_class[(size + 7) >> 3];
+}
+
+static inline ssmem_page_t*
+ssmem_page_of(void* obj)
+{
+  return (ssmem_page_t*) ((uintptr_t) obj & ~(SSMEM_PAGE_SIZE - 1));
+}
+
+/* **************************************************************************************** */
+/* NUMA placement */
+/* **************************************************************************************** */
+
+int
+ssmem_num_nodes()
+{
+  pthread_once(&ssmem_global_once, ssmem_global_init);
+  return ssmem_nodes;
+}
+
+static int
+ssmem_node_of_thread()
+{
+#if defined(NUMA)
+  if (ssmem_nodes > 1)
+    {
+      const int cpu = sched_getcpu();
+      const int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+      if (node >= 0 && node < ssmem_nodes)
+	{
+	  return node;
+	}
+    }
+#endif
+  return 0;
+}
+
+/* a chunk of size bytes on the node of a. The binding is only a preference: if
+   it fails, the pages still land on the node of the thread that first touches
+   them, which is mostly the owner, as it carves the pages. */
+static void*
+ssmem_chunk_alloc(ssmem_allocator_t* a, size_t size)
+{
+  void* mem = memalign(SSMEM_PAGE_SIZE, size);
+  assert(mem != NULL);
+#if defined(NUMA)
+  if (ssmem_nodes > 1)
+    {
+      unsigned long mask = 1UL << a->node;
+      /* MPOL_MF_MOVE also moves the pages that malloc has touched already */
+      mbind(mem, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, MPOL_MF_MOVE);
+    }
+#endif
+  __sync_fetch_and_add(&ssmem_node_stats[a->node].chunks, 1);
+  __sync_fetch_and_add(&ssmem_node_stats[a->node].bytes, size);
+  return mem;
+}
+
+void
+ssmem_node_stats_print()
+{
+  int n;
+  for (n = 0; n < ssmem_num_nodes(); n++)
+    {
+      ssmem_node_stats_t* st = &ssmem_node_stats[n];
+      printf("#ssmem node %d: chunks %zu (%.1f MB) | remote frees out %zu | sent back in %zu\n",
+	     n, st->chunks, st->bytes / (1024.0 * 1024), st->remote_out, st->remote_in);
+    }
+}
+
+/* an object freed by one thread counts as freed in its allocator, and as reclaimed
+   in the allocator that reclaims it, so that only the sums over the allocators mean
+   anything. They are taken modulo 2^64, which the differences survive. */
+void
+ssmem_mem_stats(ssmem_mem_stats_t* s)
+{
+  size_t reserved = 0, alloc = 0, freed = 0, reclaimed = 0;
+  pthread_mutex_lock(&ssmem_stats_lock);
+  ssmem_list_t* cur;
+  for (cur = ssmem_stats_list; cur != NULL; cur = cur->next)
+    {
+      ssmem_allocator_t* a = (ssmem_allocator_t*) cur->obj;
+      reserved += a->tot_size + a->large_bytes;
+      alloc += a->alloc_bytes;
+      freed += a->free_bytes;
+      reclaimed += a->reclaimed_bytes;
+    }
+  pthread_mutex_unlock(&ssmem_stats_lock);
+  s->reserved = reserved;
+  s->used = alloc - freed;
+  s->garbage = freed - reclaimed;
+}
+
+/* **************************************************************************************** */
+/* timestamps */
+/* **************************************************************************************** */
+
+void
+ssmem_gc_thread_init(ssmem_allocator_t* a, int id)
+{
+  if (ssmem_ts_local == NULL)
+    {
+      ssmem_ts_local = (ssmem_ts_t*) memalign(CACHE_LINE_SIZE, sizeof(ssmem_ts_t));
+      assert(ssmem_ts_local != NULL);
+      memset(ssmem_ts_local, 0, sizeof(ssmem_ts_t));
+      ssmem_ts_local->id = id;
+      ssmem_ts_local->idx = FAI_U32(&ssmem_ts_list_len);
+
+      ssmem_ts_t* head;
+      do
+	{
+	  head = ssmem_ts_list;
+	  ssmem_ts_local->next = head;
+	}
+      while (CAS_U64((uint64_t*) &ssmem_ts_list, (uint64_t) head, (uint64_t) ssmem_ts_local)
+	     != (uint64_t) head);
+    }
+  a->ts = ssmem_ts_local;
+}
+
+void
+ssmem_ts_next()
+{
+  ssmem_ts_local->version++;
+}
+
+/* collects the timestamps of the first num threads (num is the length of the
+   list when ts_set was allocated) into ts_set, and returns num. Threads that
+   registered since can not hold references to memory that was freed before;
+   neither can the ones that are not in the list yet, or have terminated,
+   which are marked inactive. */
+static size_t
+ssmem_ts_collect(size_t* ts_set, size_t num)
+{
+  size_t i;
+  for (i = 0; i < num; i++)
+    {
+      ts_set[i] = SSMEM_TS_INACTIVE;
+    }
+  ssmem_ts_t* cur;
+  for (cur = ssmem_ts_list; cur != NULL; cur = cur->next)
+    {
+      if (cur->idx < num)
+	{
+	  ts_set[cur->idx] = cur->version;
+	}
+    }
+  return num;
+}
+
+/* 1 if every thread that was active in s_old has moved on since */
+static int
+ssmem_ts_compare(size_t* s_new, size_t* s_old, size_t num)
+{
+  size_t i;
+  for (i = 0; i < num; i++)
+    {
+      if (s_old[i] != SSMEM_TS_INACTIVE && s_new[i] != SSMEM_TS_INACTIVE && s_new[i] <= s_old[i])
+	{
+	  return 0;
+	}
+    }
+  return 1;
+}
+
+size_t*
+ssmem_ts_set_collect()
+{
+  size_t num = ssmem_ts_list_len;
+  size_t* set = (size_t*) calloc(num + 1, sizeof(size_t));
+  assert(set != NULL);
+  set[0] = ssmem_ts_collect(set + 1, num);
+  return set;
+}
+
+void
+ssmem_ts_set_print(size_t* set)
+{
+  size_t i;
+  printf("[%zu] set: [", set[0]);
+  for (i = 1; i <= set[0]; i++)
+    {
+      printf("%zu | ", set[i]);
+    }
+  printf("]\n");
+}
+
+void
+ssmem_ts_list_print()
+{
+  ssmem_ts_t* cur;
+  printf("(%u)@ ", ssmem_ts_list_len);
+  for (cur = ssmem_ts_list; cur != NULL; cur = cur->next)
+    {
+      printf("(id %zu, idx %zu: %zu) -> ", cur->id, cur->idx, cur->version);
+    }
+  printf("NULL\n");
+}
+
+/* **************************************************************************************** */
+/* free sets */
+/* **************************************************************************************** */
+
+static ssmem_free_set_t*
+ssmem_free_set_new(size_t size, ssmem_free_set_t* next)
+{
+  /* the set and its objects in one allocation; the timestamps get their own,
+     as the number of threads can grow */
+  ssmem_free_set_t* fs = (ssmem_free_set_t*) memalign(CACHE_LINE_SIZE, sizeof(ssmem_free_set_t)
+							+ (size * sizeof(uintptr_t)));
+  assert(fs != NULL);
+  fs->ts_set = NULL;
+  fs->ts_num = 0;
+  fs->size = size;
+  fs->curr = 0;
+  fs->set = (uintptr_t*) (((uintptr_t) fs) + sizeof(ssmem_free_set_t));
+  fs->set_next = next;
+  return fs;
+}
+
+static ssmem_free_set_t*
+ssmem_free_set_get_avail(ssmem_allocator_t* a, size_t size, ssmem_free_set_t* next)
+{
+  ssmem_free_set_t* fs = a->available_set_list;
+  if (fs != NULL)
+    {
+      a->available_set_list = fs->set_next;
+      fs->curr = 0;
+      fs->set_next = next;
+    }
+  else
+    {
+      fs = ssmem_free_set_new(size, next);
+    }
+  return fs;
+}
+
+static void
+ssmem_free_set_make_avail(ssmem_allocator_t* a, ssmem_free_set_t* set)
+{
+  set->curr = 0;
+  set->set_next = a->available_set_list;
+  a->available_set_list = set;
+}
+
+/* makes sure set->ts_set has room for the current number of threads, and
+   stamps it */
+static void
+ssmem_free_set_stamp(ssmem_free_set_t* set)
+{
+  const size_t num = ssmem_ts_list_len;
+  if (set->ts_num < num)
+    {
+      free(set->ts_set);
+      set->ts_set = (size_t*) malloc(num * sizeof(size_t));
+      assert(set->ts_set != NULL);
+    }
+  set->ts_num = ssmem_ts_collect(set->ts_set, num);
+}
+
+static size_t
+ssmem_large_bytes(size_t size)
+{
+  return (SSMEM_PAGE_HEADER + size + SSMEM_PAGE_SIZE - 1) & ~(SSMEM_PAGE_SIZE - 1);
+}
+
+static void
+ssmem_large_free(void* obj)
+{
+  free(ssmem_page_of(obj));
+}
+
+/* pushes a batch of objects onto the inbox of their node */
+static void
+ssmem_remote_send(ssmem_allocator_t* a, int node, ssmem_free_set_t* set)
+{
+  __sync_fetch_and_add(&ssmem_node_stats[a->node].remote_out, set->curr);
+  __sync_fetch_and_add(&ssmem_node_stats[node].remote_in, set->curr);
+  ssmem_free_set_t* head;
+  do
+    {
+      head = ssmem_remote_inbox[node];
+      set->set_next = head;
+    }
+  while (CAS_U64((uint64_t*) &ssmem_remote_inbox[node], (uint64_t) head, (uint64_t) set)
+	 != (uint64_t) head);
+}
+
+/* moves the objects of set (of class c) that are in pages of other nodes to the
+   batches that go back to those nodes */
+static void
+ssmem_remote_sort(ssmem_allocator_t* a, uint32_t c, ssmem_free_set_t* set)
+{
+  long i, kept = 0;
+  for (i = 0; i < set->curr; i++)
+    {
+      const int node = (int) ssmem_page_of((void*) set->set[i])->node;
+      if (likely(node == a->node))
+	{
+	  set->set[kept++] = set->set[i];
+	  continue;
+	}
+
+      ssmem_free_set_t** out = &a->remote_out[node * SSMEM_NUM_CLASSES + c];
+      if (*out == NULL)
+	{
+	  *out = ssmem_free_set_get_avail(a, a->fs_size, NULL);
+	}
+      (*out)->set[(*out)->curr++] = set->set[i];
+      if ((*out)->curr == SSMEM_REMOTE_BATCH || (*out)->curr == (long) (*out)->size)
+	{
+	  ssmem_remote_send(a, node, *out);
+	  *out = NULL;
+	}
+    }
+  set->curr = kept;
+}
+
+/* takes the batches sent back to the node of a, as collected sets of their classes */
+static void
+ssmem_remote_receive(ssmem_allocator_t* a)
+{
+  ssmem_free_set_t* set = __sync_lock_test_and_set(&ssmem_remote_inbox[a->node], NULL);
+  while (set != NULL)
+    {
+      ssmem_free_set_t* next = set->set_next;
+      ssmem_class_t* cl = &a->classes[ssmem_page_of((void*) set->set[0])->class_id];
+      set->set_next = cl->collected_set_list;
+      cl->collected_set_list = set;
+      cl->collected_set_num++;
+      set = next;
+    }
+}
+
+/* moves the free sets that are safe to reclaim, in every class, to the
+   collected lists. now holds the timestamps of the threads taken when the
+   newest set got full. */
+static void
+ssmem_mem_reclaim(ssmem_allocator_t* a, ssmem_free_set_t* now)
+{
+  uint32_t c;
+  for (c = 0; c <= SSMEM_CLASS_LARGE; c++)
+    {
+      ssmem_class_t* cl = &a->classes[c];
+      if (cl->free_set_num <= 1)
+	{
+	  continue;
+	}
+
+      /* the sets are ordered newest first: once one is safe, all the older
+	 ones are */
+      ssmem_free_set_t* prev = cl->free_set_list;
+      ssmem_free_set_t* cur = prev->set_next;
+      size_t kept = 1;
+      while (cur != NULL && !ssmem_ts_compare(now->ts_set, cur->ts_set, cur->ts_num))
+	{
+	  prev = cur;
+	  cur = cur->set_next;
+	  kept++;
+	}
+      if (cur == NULL)
+	{
+	  continue;
+	}
+
+      prev->set_next = NULL;
+      cl->free_set_num = kept;
+      while (cur != NULL)
+	{
+	  ssmem_free_set_t* next = cur->set_next;
+	  a->reclaimed_num += cur->curr;
+	  if (c == SSMEM_CLASS_LARGE)
+	    {
+	      long i;
+	      for (i = 0; i < cur->curr; i++)
+		{
+		  const size_t size = ssmem_page_of((void*) cur->set[i])->obj_size;
+		  a->reclaimed_bytes += size;
+		  a->large_bytes -= ssmem_large_bytes(size);
+		  ssmem_large_free((void*) cur->set[i]);
+		}
+	      ssmem_free_set_make_avail(a, cur);
+	    }
+	  else
+	    {
+	      a->reclaimed_bytes += cur->curr * ssmem_class_size[c];
+	      if (ssmem_nodes > 1)
+		{
+		  ssmem_remote_sort(a, c, cur);
+		}
+	      if (cur->curr == 0)
+		{
+		  ssmem_free_set_make_avail(a, cur);
+		}
+	      else
+		{
+		  cur->set_next = cl->collected_set_list;
+		  cl->collected_set_list = cur;
+		  cl->collected_set_num++;
+		}
+	    }
+	  cur = next;
+	}
+    }
+}
+
+/* **************************************************************************************** */
+/* init / term */
+/* **************************************************************************************** */
+
+void
+ssmem_alloc_init_fs_size(ssmem_allocator_t* a, size_t size, size_t free_set_size, int id)
+{
+  pthread_once(&ssmem_global_once, ssmem_global_init);
+
+  memset(a, 0, sizeof(ssmem_allocator_t));
+  a->node = ssmem_node_of_thread();
+  if (ssmem_nodes > 1)
+    {
+      a->remote_out = (ssmem_free_set_t**) calloc(ssmem_nodes * SSMEM_NUM_CLASSES,
+						  sizeof(ssmem_free_set_t*));
+      assert(a->remote_out != NULL);
+    }
+  if (size < SSMEM_PAGE_SIZE)
+    {
+      size = SSMEM_PAGE_SIZE;
+    }
+  size &= ~(SSMEM_PAGE_SIZE - 1);
+
+  ssmem_num_allocators++;
+  ssmem_list_t* al = (ssmem_list_t*) malloc(sizeof(ssmem_list_t));
+  assert(al != NULL);
+  al->obj = (void*) a;
+  al->next = ssmem_allocator_list;
+  ssmem_allocator_list = al;
+
+  ssmem_list_t* sl = (ssmem_list_t*) malloc(sizeof(ssmem_list_t));
+  assert(sl != NULL);
+  sl->obj = (void*) a;
+  pthread_mutex_lock(&ssmem_stats_lock);
+  sl->next = ssmem_stats_list;
+  ssmem_stats_list = sl;
+  pthread_mutex_unlock(&ssmem_stats_lock);
+
+  a->mem = ssmem_chunk_alloc(a, size);
+  a->mem_curr = 0;
+  a->mem_size = size;
+  a->tot_size = size;
+  a->fs_size = free_set_size;
+
+  a->mem_chunks = (ssmem_list_t*) malloc(sizeof(ssmem_list_t));
+  assert(a->mem_chunks != NULL);
+  a->mem_chunks->obj = a->mem;
+  a->mem_chunks->next = NULL;
+
+  ssmem_gc_thread_init(a, id);
+
+  uint32_t c;
+  for (c = 0; c <= SSMEM_CLASS_LARGE; c++)
+    {
+      a->classes[c].free_set_list = ssmem_free_set_new(a->fs_size, NULL);
+      a->classes[c].free_set_num = 1;
+    }
+}
+
+void
+ssmem_alloc_init(ssmem_allocator_t* a, size_t size, int id)
+{
+  ssmem_alloc_init_fs_size(a, size, SSMEM_GC_FREE_SET_SIZE, id);
+}
+
+static void
+ssmem_free_set_list_free(ssmem_free_set_t* set)
+{
+  while (set != NULL)
+    {
+      ssmem_free_set_t* next = set->set_next;
+      free(set->ts_set);
+      free(set);
+      set = next;
+    }
+}
+
+void
+ssmem_alloc_term(ssmem_allocator_t* a)
+{
+  if (a->remote_out != NULL)
+    {
+      /* the objects are reclaimed already, their nodes can have them now */
+      int i;
+      for (i = 0; i < ssmem_nodes * SSMEM_NUM_CLASSES; i++)
+	{
+	  if (a->remote_out[i] != NULL)
+	    {
+	      ssmem_remote_send(a, i / SSMEM_NUM_CLASSES, a->remote_out[i]);
+	    }
+	}
+      free(a->remote_out);
+      a->remote_out = NULL;
+    }
+
+  ssmem_list_t* mcur = a->mem_chunks;
+  while (mcur != NULL)
+    {
+      ssmem_list_t* mnxt = mcur->next;
+      free(mcur->obj);
+      free(mcur);
+      mcur = mnxt;
+    }
+
+  uint32_t c;
+  for (c = 0; c <= SSMEM_CLASS_LARGE; c++)
+    {
+      ssmem_class_t* cl = &a->classes[c];
+      if (c == SSMEM_CLASS_LARGE)
+	{
+	  ssmem_free_set_t* fs;
+	  for (fs = cl->free_set_list; fs != NULL; fs = fs->set_next)
+	    {
+	      long i;
+	      for (i = 0; i < fs->curr; i++)
+		{
+		  ssmem_large_free((void*) fs->set[i]);
+		}
+	    }
+	}
+      ssmem_free_set_list_free(cl->free_set_list);
+      ssmem_free_set_list_free(cl->collected_set_list);
+    }
+  ssmem_free_set_list_free(a->available_set_list);
+
+  ssmem_released_t* rel = a->released_mem_list;
+  while (rel != NULL)
+    {
+      ssmem_released_t* next = rel->next;
+      free(rel->mem);
+      free(rel->ts_set);
+      free(rel);
+      rel = next;
+    }
+
+  pthread_mutex_lock(&ssmem_stats_lock);
+  ssmem_list_t** sl = &ssmem_stats_list;
+  while (*sl != NULL && (*sl)->obj != (void*) a)
+    {
+      sl = &(*sl)->next;
+    }
+  if (*sl != NULL)
+    {
+      ssmem_list_t* found = *sl;
+      *sl = found->next;
+      free(found);
+    }
+  pthread_mutex_unlock(&ssmem_stats_lock);
+
+  ssmem_list_t* prv = NULL;
+  ssmem_list_t* cur = ssmem_allocator_list;
+  while (cur != NULL && (uintptr_t) cur->obj != (uintptr_t) a)
+    {
+      prv = cur;
+      cur = cur->next;
+    }
+  if (cur != NULL)
+    {
+      if (prv == NULL)
+	{
+	  ssmem_allocator_list = cur->next;
+	}
+      else
+	{
+	  prv->next = cur->next;
+	}
+      free(cur);
+      ssmem_num_allocators--;
+    }
+
+  if (ssmem_num_allocators == 0 && ssmem_ts_local != NULL)
+    {
+      /* the timestamp stays in the list, but no longer holds back reclamation */
+      ssmem_ts_local->version = SSMEM_TS_INACTIVE;
+      ssmem_ts_local = NULL;
+    }
+}
+
+void
+ssmem_term()
+{
+  while (ssmem_allocator_list != NULL)
+    {
+      ssmem_alloc_term((ssmem_allocator_t*) ssmem_allocator_list->obj);
+    }
+}
+
+/* **************************************************************************************** */
+/* alloc / free */
+/* **************************************************************************************** */
+
+/* a new chunk for a, of at least size bytes */
+static void
+ssmem_chunk_new(ssmem_allocator_t* a, size_t size)
+{
+  size_t chunk = a->mem_size;
+  if (chunk < size)
+    {
+      chunk = (size + SSMEM_PAGE_SIZE - 1) & ~(SSMEM_PAGE_SIZE - 1);
+    }
+  a->mem = ssmem_chunk_alloc(a, chunk);
+  a->mem_curr = 0;
+  a->tot_size += chunk;
+
+  ssmem_list_t* new_mem_chunks = (ssmem_list_t*) malloc(sizeof(ssmem_list_t));
+  assert(new_mem_chunks != NULL);
+  new_mem_chunks->obj = a->mem;
+  new_mem_chunks->next = a->mem_chunks;
+  a->mem_chunks = new_mem_chunks;
+}
+
+/* gives class c of a a new page to bump-allocate from */
+static void
+ssmem_page_new(ssmem_allocator_t* a, uint32_t c)
+{
+  if (a->mem_curr + SSMEM_PAGE_SIZE > a->mem_size)
+    {
+      ssmem_chunk_new(a, SSMEM_PAGE_SIZE);
+    }
+  ssmem_page_t* page = (ssmem_page_t*) ((uintptr_t) a->mem + a->mem_curr);
+  a->mem_curr += SSMEM_PAGE_SIZE;
+  page->class_id = c;
+  page->obj_size = ssmem_class_size[c];
+  page->node = a->node;
+
+  a->classes[c].page_curr = (uintptr_t) page + SSMEM_PAGE_HEADER;
+  a->classes[c].page_end = (uintptr_t) page + SSMEM_PAGE_SIZE;
+}
+
+/* large objects are not reused, but their pages are freed once safe */
+static void*
+ssmem_alloc_large(ssmem_allocator_t* a, size_t size)
+{
+  size_t bytes = ssmem_large_bytes(size);
+  ssmem_page_t* page = (ssmem_page_t*) memalign(SSMEM_PAGE_SIZE, bytes);
+  assert(page != NULL);
+  page->class_id = SSMEM_CLASS_LARGE;
+  page->obj_size = (uint32_t) (size < UINT32_MAX ? size : UINT32_MAX);
+  page->node = a->node;
+  a->alloc_bytes += page->obj_size;
+  a->large_bytes += bytes;
+  return (void*) ((uintptr_t) page + SSMEM_PAGE_HEADER);
+}
+
+void*
+ssmem_alloc(ssmem_allocator_t* a, size_t size)
+{
+  void* m;
+  const uint32_t c = ssmem_class_of(size);
+  if (unlikely(c == SSMEM_CLASS_LARGE))
+    {
+      m = ssmem_alloc_large(a, size);
+    }
+  else
+    {
+      ssmem_class_t* cl = &a->classes[c];
+      ssmem_free_set_t* cs = cl->collected_set_list;
+      if (cs == NULL && ssmem_nodes > 1 && ssmem_remote_inbox[a->node] != NULL)
+	{
+	  ssmem_remote_receive(a);
+	  cs = cl->collected_set_list;
+	}
+      if (cs != NULL)
+	{
+	  m = (void*) cs->set[--cs->curr];
+	  if (cs->curr == 0)
+	    {
+	      cl->collected_set_list = cs->set_next;
+	      cl->collected_set_num--;
+	      ssmem_free_set_make_avail(a, cs);
+	    }
+	}
+      else
+	{
+	  if (unlikely(cl->page_curr + ssmem_class_size[c] > cl->page_end))
+	    {
+	      ssmem_page_new(a, c);
+	    }
+	  m = (void*) cl->page_curr;
+	  cl->page_curr += ssmem_class_size[c];
+	}
+      a->alloc_bytes += ssmem_class_size[c];
+    }
+
+#if SSMEM_TS_INCR_ON == SSMEM_TS_INCR_ON_BOTH || SSMEM_TS_INCR_ON == SSMEM_TS_INCR_ON_ALLOC
+  ssmem_ts_next();
+#endif
+  return m;
+}
+
+size_t
+ssmem_obj_size(void* obj)
+{
+  return ssmem_page_of(obj)->obj_size;
+}
+
+void
+ssmem_free(ssmem_allocator_t* a, void* obj)
+{
+  ssmem_class_t* cl = &a->classes[ssmem_page_of(obj)->class_id];
+  ssmem_free_set_t* fs = cl->free_set_list;
+  if (unlikely(fs->curr == (long) fs->size))
+    {
+      /* a full set: stamp it, and reclaim what the stamp lets us reclaim */
+      ssmem_free_set_stamp(fs);
+      ssmem_mem_reclaim(a, fs);
+
+      fs = ssmem_free_set_get_avail(a, a->fs_size, cl->free_set_list);
+      cl->free_set_list = fs;
+      cl->free_set_num++;
+    }
+
+  fs->set[fs->curr++] = (uintptr_t) obj;
+  a->free_bytes += ssmem_page_of(obj)->obj_size;
+#if SSMEM_TS_INCR_ON == SSMEM_TS_INCR_ON_BOTH || SSMEM_TS_INCR_ON == SSMEM_TS_INCR_ON_FREE
+  ssmem_ts_next();
+#endif
+}
+
+/* **************************************************************************************** */
+/* release */
+/* **************************************************************************************** */
+
+void
+ssmem_release(ssmem_allocator_t* a, void* obj)
+{
+  ssmem_released_t* rel = (ssmem_released_t*) malloc(sizeof(ssmem_released_t));
+  assert(rel != NULL);
+  rel->ts_num = ssmem_ts_list_len;
+  rel->ts_set = (size_t*) malloc((rel->ts_num + 1) * sizeof(size_t));
+  assert(rel->ts_set != NULL);
+  rel->ts_num = ssmem_ts_collect(rel->ts_set, rel->ts_num);
+  rel->mem = obj;
+  rel->next = a->released_mem_list;
+  a->released_mem_list = rel;
+  a->released_num++;
+
+  if (a->released_num < 2)
+    {
+      return;
+    }
+
+  /* the list is ordered newest first, as the free sets */
+  ssmem_released_t* prev = rel;
+  ssmem_released_t* cur = rel->next;
+  size_t kept = 1;
+  while (cur != NULL && !ssmem_ts_compare(rel->ts_set, cur->ts_set, cur->ts_num))
+    {
+      prev = cur;
+      cur = cur->next;
+      kept++;
+    }
+  if (cur != NULL)
+    {
+      prev->next = NULL;
+      a->released_num = kept;
+      while (cur != NULL)
+	{
+	  ssmem_released_t* next = cur->next;
+	  free(cur->mem);
+	  free(cur->ts_set);
+	  free(cur);
+	  cur = next;
+	}
+    }
+}
+
+/* **************************************************************************************** */
+/* debug / help */
+/* **************************************************************************************** */
+
+static void
+ssmem_set_list_print(const char* name, ssmem_free_set_t* set)
+{
+  printf("%s: ", name);
+  for (; set != NULL; set = set->set_next)
+    {
+      printf("[%ld/%zu] -> ", set->curr, set->size);
+    }
+  printf("NULL\n");
+}
+
+void
+ssmem_free_list_print(ssmem_allocator_t* a)
+{
+  uint32_t c;
+  for (c = 0; c <= SSMEM_CLASS_LARGE; c++)
+    {
+      if (a->classes[c].free_set_list->curr > 0 || a->classes[c].free_set_num > 1)
+	{
+	  printf("class %2u (%zu sets) ", c, a->classes[c].free_set_num);
+	  ssmem_set_list_print("free_set list", a->classes[c].free_set_list);
+	}
+    }
+}
+
+void
+ssmem_collected_list_print(ssmem_allocator_t* a)
+{
+  uint32_t c;
+  for (c = 0; c < SSMEM_CLASS_LARGE; c++)
+    {
+      if (a->classes[c].collected_set_list != NULL)
+	{
+	  printf("class %2u (%zu sets) ", c, a->classes[c].collected_set_num);
+	  ssmem_set_list_print("collected_set list", a->classes[c].collected_set_list);
+	}
+    }
+}
+
+void
+ssmem_available_list_print(ssmem_allocator_t* a)
+{
+  ssmem_set_list_print("available_set list", a->available_set_list);
+}
+
+void
+ssmem_all_list_print(ssmem_allocator_t* a, int id)
+{
+  printf("[[%3d]] --- %zu KB in chunks\n", id, a->tot_size / 1024);
+  ssmem_free_list_print(a);
+  ssmem_collected_list_print(a);
+  ssmem_available_list_print(a);
+}
@@ -84,6 +84,9 @@ int print_vals_num = 0;
 size_t  pf_vals_num = 8191;
 size_t initial = 1024 ;
 int seed = 0;
+int bulk_load = 0;
+size_t op_stream_len = 0;
+const char* payload_spec = NULL;
 __thread unsigned long * seeds;
 uint32_t rand_max;
 #define rand_min 1
@@ -153,15 +156,117 @@ void barrier_cross(barrier_t *b)
 }
 
 #include "latency.h"
+#include "op_stream.h"
+#include "value_payload.h"
+#include "mem_footprint.h"
 
 barrier_t barrier, barrier_global;
 
+/* the value sizes of -z; without it, values are MEM_SIZE bytes */
+payload_conf_t payload;
+volatile uint64_t payload_written = 0, payload_read = 0, payload_checksum = 0;
+
+/* a new value object for key, adding the payload bytes it wrote to *written */
+static inline char*
+value_new(ssmem_allocator_t* alloc, uint64_t key, uint64_t* written)
+{
+  if (payload.dist == PAYLOAD_NONE)
+    {
+      char* obj = (char*) ssmem_alloc(alloc, MEM_SIZE);
+      *obj = (char) key;
+      return obj;
+    }
+  const uint32_t bytes = payload_size(&payload, seeds);
+  char* obj = (char*) ssmem_alloc(alloc, bytes);
+  payload_write(obj, bytes, key);
+  *written += bytes;
+  return obj;
+}
+
+/* only the resizing implementations account for their memory */
+#pragma weak clht_size_mem
+#pragma weak clht_size_mem_locks
+#pragma weak clht_size_mem_overflow
+#pragma weak clht_size_mem_garbage
+/* and the prebuilt libssmem (SSMEM_PREBUILT=1) does not count its bytes */
+#pragma weak ssmem_mem_stats
+
+/* the footprint of the table, and of the ssmem allocators of the values and of
+   the retired tables. Without clht_size_mem, only the buckets of the table. */
+static void
+footprint_get(clht_t* hashtable, mem_footprint_t* f)
+{
+  clht_hashtable_t* ht = hashtable->ht;
+  memset(f, 0, sizeof(mem_footprint_t));
+  if (clht_size_mem != NULL)
+    {
+      f->locks = clht_size_mem_locks(ht);
+      f->overflow = clht_size_mem_overflow(ht);
+      f->table = sizeof(clht_t) + clht_size_mem(ht) - f->locks - f->overflow;
+      f->garbage = clht_size_mem_garbage(ht);
+    }
+  else
+    {
+      f->table = sizeof(clht_t) + ht->num_buckets * sizeof(bucket_t);
+    }
+
+  if (ssmem_mem_stats != NULL)
+    {
+      ssmem_mem_stats_t s;
+      ssmem_mem_stats(&s);
+      f->alloc = "ssmem";
+      f->alloc_reserved = s.reserved;
+      f->alloc_used = s.used;
+      f->alloc_garbage = s.garbage;
+    }
+}
+
 typedef struct thread_data
 {
   uint32_t id;
   clht_t* ht;
 } thread_data_t;
 
+#if defined(CLHT_BULK_PUT)
+/* fills the table with initial * filling_rate random keys through
+   clht_bulk_put, instead of having each thread put its share. Keys that are
+   drawn twice are not inserted, so it loads again until the table is full.
+   Run by thread 0, after its clht_gc_thread_init. */
+static void
+bulk_load_initial(clht_t* hashtable, ssmem_allocator_t* alloc)
+{
+  size_t num = (size_t) (initial * filling_rate);
+  clht_addr_t* keys = (clht_addr_t*) malloc(num * sizeof(clht_addr_t));
+  clht_val_t* vals = (clht_val_t*) malloc(num * sizeof(clht_val_t));
+  assert(keys != NULL && vals != NULL);
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  size_t loaded = 0, rounds = 0;
+  uint64_t written = 0;
+  while (loaded < num)
+    {
+      size_t n = num - loaded, i;
+      for (i = 0; i < n; i++)
+	{
+	  keys[i] = (my_random(&(seeds[0]), &(seeds[1]), &(seeds[2])) % (rand_max + 1)) + rand_min;
+	  vals[i] = (clht_val_t) value_new(alloc, keys[i], &written);
+	}
+      loaded += clht_bulk_put(hashtable, keys, vals, n, num_threads);
+      rounds++;
+    }
+
+  gettimeofday(&end, NULL);
+  double ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+  printf("#bulk load: %zu keys in %zu round(s), %.3f ms (%.1f keys/ms)\n",
+	 loaded, rounds, ms, ms > 0 ? loaded / ms : 0.0);
+
+  free((void*) vals);
+  free(keys);
+}
+#endif
+
 void*
 test(void* thread) 
 {
@@ -179,7 +284,7 @@ test(void* thread)
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
 
   PF_INIT(3, SSPFD_NUM_ENTRIES, ID);
@@ -200,6 +305,10 @@ test(void* thread)
   uint64_t my_putting_count_succ = 0;
   uint64_t my_getting_count_succ = 0;
   uint64_t my_removing_count_succ = 0;
+
+  uint64_t my_payload_written = 0;
+  uint64_t my_payload_read = 0;
+  uint64_t my_payload_sum = 0;
     
   seeds = seed_rand();
     
@@ -219,12 +328,22 @@ test(void* thread)
       num_elems_thread++;
     }
     
+  if (bulk_load)
+    {
+      num_elems_thread = 0;
+#if defined(CLHT_BULK_PUT)
+      if (!ID)
+	{
+	  bulk_load_initial(hashtable, alloc);
+	}
+#endif
+    }
+
   for(i = 0; i < num_elems_thread; i++) 
     {
       key = (my_random(&(seeds[0]), &(seeds[1]), &(seeds[2])) % (rand_max + 1)) + rand_min;
       
-      char* obj = (char*) ssmem_alloc(alloc, MEM_SIZE);
-      *obj = (char) key;
+      char* obj = value_new(alloc, key, &my_payload_written);
 
       if(!clht_put(hashtable, key, (clht_val_t) obj))
 	{
@@ -233,6 +352,25 @@ test(void* thread)
 	}
     }
   MEM_BARRIER;
+
+  /* the operations of the measured phase, drawn before it starts */
+  op_stream_t* ops = NULL;
+  size_t ops_idx = 0;
+  if (op_stream_len)
+    {
+      ops = op_stream_new(op_stream_len, seeds, rand_max, rand_min);
+    }
+  if (!ID)
+    {
+      printf("#null backend: %.1f cycles/op (%s)\n",
+	     op_stream_null_cycles(ops, op_stream_len - 1, seeds, rand_max, rand_min,
+				   scale_put, scale_rem),
+	     ops != NULL ? "op stream" : "my_random");
+    }
+
+  /* count the retries and the payload bytes of the measured phase only */
+  RETRY_STATS_THREAD_INIT(ID);
+  my_payload_written = 0;
   
   barrier_cross(&barrier);
 
@@ -240,6 +378,12 @@ test(void* thread)
     {
       // printf("#BEFORE size: %zu\n", clht_size(hashtable->ht));
       /* clht_print(hashtable, num_buckets); */
+      mem_footprint_t f;
+      mem_process_t m;
+      footprint_get(hashtable, &f);
+      mem_process_sample(&m);
+      mem_process_print("filled", &m);
+      mem_footprint_print(&f, clht_size(hashtable->ht));
     }
 
   char* obj = NULL;
@@ -248,12 +392,25 @@ test(void* thread)
 
   while (stop == 0) 
     {
-      c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));	
-      key = (c & rand_max) + rand_min;					
+      OP_STREAM_OR_RAND_NXT(ops, ops_idx, op_stream_len - 1, c, key, seeds, rand_max, rand_min);
 									
       if (unlikely(c <= scale_put))						
 	{									
-	  if (obj == NULL)
+	  if (payload.dist != PAYLOAD_NONE)
+	    {
+	      /* an object that a failed put left is rewritten for this key */
+	      if (obj == NULL)
+		{
+		  obj = value_new(alloc, key, &my_payload_written);
+		}
+	      else
+		{
+		  payload_write(obj, payload_bytes(obj), key);
+		  my_payload_written += payload_bytes(obj);
+		}
+	      MEM_BARRIER;
+	    }
+	  else if (obj == NULL)
 	    {
 	      obj = (char*) ssmem_alloc(alloc, MEM_SIZE);
 #if RW_SSMEM_MEM == 1
@@ -301,6 +458,11 @@ test(void* thread)
 #if RW_SSMEM_MEM == 1
 	      __attribute__ ((unused)) volatile char value = *(char*) res;
 #endif
+	      if (payload.dist != PAYLOAD_NONE)
+		{
+		  my_payload_sum += payload_sum((void*) res);
+		  my_payload_read += payload_bytes((void*) res);
+		}
 	      END_TS(0, my_getting_count_succ);				
 	      ADD_DUR(my_getting_succ);					
 	      my_getting_count_succ++;					
@@ -312,6 +474,10 @@ test(void* thread)
     }
 
   barrier_cross(&barrier);
+  op_stream_free(ops, op_stream_len);
+  __sync_fetch_and_add(&payload_written, my_payload_written);
+  __sync_fetch_and_add(&payload_read, my_payload_read);
+  __sync_fetch_and_xor(&payload_checksum, my_payload_sum);
 #if defined(DEBUG)
   if (!ID)
     {
@@ -346,7 +512,6 @@ test(void* thread)
   EXEC_IN_DEC_ID_ORDER(ID, num_threads)
     {
       print_latency_stats(ID, SSPFD_NUM_ENTRIES, print_vals_num);
-      RETRY_STATS_SHARE();
     }
   EXEC_IN_DEC_ID_ORDER_END(&barrier);
 
@@ -376,6 +541,11 @@ main(int argc, char **argv)
     {"num-buckets",               required_argument, NULL, 'b'},
     {"print-vals",                required_argument, NULL, 'v'},
     {"table-density",             required_argument, NULL, 't'},
+#if defined(CLHT_BULK_PUT)
+    {"bulk-load",                 no_argument,       NULL, 'B'},
+#endif
+    {"op-stream",                 required_argument, NULL, 'O'},
+    {"value-size",                required_argument, NULL, 'z'},
     {NULL, 0, NULL, 0}
   };
 
@@ -387,7 +557,7 @@ main(int argc, char **argv)
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:f:t:", long_options, &i);
+      c = getopt_long(argc, argv, "hABf:d:i:n:r:s:u:m:a:l:p:b:v:f:t:O:z:", long_options, &i);
 		
       if(c == -1)
 	break;
@@ -428,7 +598,17 @@ main(int argc, char **argv)
 		 "        When using detailed profiling, how many values to print.\n"
 		 "  -t, --table-density <float>\n"
 		 "        Table density.\n"
-		 );
+		 "  -O, --op-stream <int>\n"
+		 "        Draw the operations of each thread before the test, into a buffer of <int>\n"
+		 "        operations (rounded up to a power of two) that the test loops over\n"
+		 "  -z, --value-size <fixed:B|uniform:min:max|bimodal:small:large:pct|trace:file>\n"
+		 "        Sizes of the values in bytes (up to 64 KiB); puts write them in full\n"
+		 "        and gets read them back (default: %d-byte values that are not read)\n"
+#if defined(CLHT_BULK_PUT)
+		 "  -B, --bulk-load\n"
+		 "        Fill the table with clht_bulk_put before the test\n"
+#endif
+		 , MEM_SIZE);
 	  exit(0);
 	case 'd':
 	  duration = atoi(optarg);
@@ -461,6 +641,21 @@ main(int argc, char **argv)
 	case 't':
 	  density = atoi(optarg);
 	  break;
+#if defined(CLHT_BULK_PUT)
+	case 'B':
+	  bulk_load = 1;
+	  break;
+#endif
+	case 'O':
+	  op_stream_len = pow2roundup(atol(optarg));
+	  break;
+	case 'z':
+	  payload_spec = optarg;
+	  if (payload_parse(&payload, payload_spec, PAYLOAD_MAX))
+	    {
+	      exit(1);
+	    }
+	  break;
 	case '?':
 	default:
 	  printf("Use -h or --help for help\n");
@@ -558,6 +753,9 @@ main(int argc, char **argv)
   clht_t* hashtable = clht_create(num_buckets);
 
   assert(hashtable != NULL);
+  mem_process_t mem;
+  mem_process_sample(&mem);
+  mem_process_print("created", &mem);
 
   /* Initializes the local data */
   putting_succ = (ticks *) calloc(num_threads , sizeof(ticks));
@@ -580,6 +778,11 @@ main(int argc, char **argv)
     
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
+
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
     
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
@@ -654,14 +857,14 @@ main(int argc, char **argv)
     }
 
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
-  // printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  // printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
 
 #define LLU long long unsigned int
@@ -696,11 +899,23 @@ main(int argc, char **argv)
   kb = hashtable->ht->num_buckets * sizeof(bucket_t) / 1024.0;
   mb = kb / 1024.0;
   // printf("Sizeof   final: %10.2f KB = %10.2f MB\n", kb, mb);
+  mem_footprint_t footprint;
+  footprint_get(hashtable, &footprint);
+  mem_process_sample(&mem);
   clht_gc_destroy(hashtable);
 
   double throughput = (putting_count_total + getting_count_total + removing_count_total) / duration;
   printf(" %zu,\n", num_threads);
   printf("ops/ms: %.3f\n", throughput);
+  RETRY_STATS_PRINT(putting_count_total + getting_count_total + removing_count_total);
+  if (payload.dist != PAYLOAD_NONE)
+    {
+      payload_print(&payload, payload_spec, payload_written, payload_read);
+    }
+  ssmem_node_stats_print();
+  mem_process_print("measured", &mem);
+  mem_footprint_print(&footprint, size_after);
+  mem_efficiency_print(throughput, &mem, &footprint);
   /* Last thing that main() should do */
   //printf("Main: program completed. Exiting.\n");
   pthread_exit(NULL);
@@ -0,0 +1,515 @@
+/*
+ *   File: test_reclaim.c
+ *   Description: compares the memory-reclamation policies of reclaim.h on
+ *                CLHT-LF (its values are reclaimed) and on a lock-free chained
+ *                table (its nodes are), under a remove-heavy workload
+ *   test_reclaim.c is part of ASCYLIB
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *	      	      Distributed Programming Lab (LPD), EPFL
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The policy is fixed at compile time (make reclaim builds reclaim_<policy> for
+ * each), the table with -t. Half of the updates are puts and half removes, so
+ * the table keeps its size while the removes retire objects all the time. The
+ * main thread samples the bytes retired but not freed yet every millisecond.
+ * The reclamation latency is measured from retire to free (not with ssmem, whose
+ * frees are internal), and also estimated for every policy as the mean number
+ * of unreclaimed objects over the rate of retires (Little's law). A get checks
+ * the byte its value holds, so that a policy that frees too early shows up as
+ * bad reads (or a crash). With -S, the operations yield the processor while
+ * they hold an object, until the epoch moves on, so that the windows in which
+ * a policy can free it too early are wide enough to be hit. The epochs move on
+ * every RECLAIM_BATCH retires of a thread: build with a small one (make reclaim
+ * RECLAIM_BATCH=2) for them to do so within the window, and run with
+ * GLIBC_TUNABLES=glibc.malloc.tcache_count=0:glibc.malloc.perturb=165 for the
+ * freed values to be overwritten at once.
+ */
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "utils.h"
+#include "clht_lf_res.h"
+#include "lf_chain.h"
+#include "reclaim.h"
+
+#define TABLE_CLHT 0
+#define TABLE_LFC  1
+
+int table = TABLE_CLHT;
+size_t num_threads = 1;
+size_t initial = 1024;
+size_t range = 0;
+size_t num_buckets = 0;
+int duration = 1000;
+double update_rate = 0.8;
+size_t val_size = 8;
+size_t stress = 0;
+
+static clht_t* clht;
+static lfc_t* lfc;
+static volatile int stop;
+static pthread_barrier_t barrier;
+
+typedef struct ALIGNED(CACHE_LINE_SIZE) thread_data
+{
+  uint32_t id;
+  size_t ops;
+  size_t bad_reads;
+} thread_data_t;
+
+static inline int
+table_put(uintptr_t key, uintptr_t val)
+{
+  if (table == TABLE_CLHT)
+    {
+      return clht_put(clht, key, val);
+    }
+  return lfc_put(lfc, key, val);
+}
+
+static inline uintptr_t
+table_get(uintptr_t key)
+{
+  if (table == TABLE_CLHT)
+    {
+      return clht_get(clht->ht, key);
+    }
+  return lfc_get(lfc, key);
+}
+
+static inline uintptr_t
+table_remove(uintptr_t key)
+{
+  if (table == TABLE_CLHT)
+    {
+      return clht_remove(clht, key);
+    }
+  return lfc_remove(lfc, key);
+}
+
+/* the value of key: a reclaimed object with CLHT, the key with the chained
+   table (its nodes are reclaimed) */
+static inline uintptr_t
+make_val(uintptr_t key)
+{
+  if (table == TABLE_CLHT)
+    {
+      char* obj = (char*) reclaim_alloc(val_size);
+      *obj = (char) key;
+      return (uintptr_t) obj;
+    }
+  return key;
+}
+
+static inline int
+val_ok(uintptr_t key, uintptr_t val)
+{
+  if (table == TABLE_CLHT)
+    {
+      return *(volatile char*) val == (char) key;
+    }
+  return val == key;
+}
+
+/* -S: gives the processor away n times, when stress is on */
+static inline void
+stress_yield(size_t n)
+{
+  if (stress)
+    {
+      size_t i;
+      for (i = 0; i < n; i++)
+	{
+	  sched_yield();
+	}
+    }
+}
+
+/* -S: gives the processor away until the epoch gets to e, at most n times */
+static inline void
+stress_wait_epoch(uint64_t e, size_t n)
+{
+  if (stress)
+    {
+      size_t i;
+      for (i = 0; i < n && reclaim_epoch < e; i++)
+	{
+	  sched_yield();
+	}
+    }
+}
+
+/* puts val, in one operation */
+static inline int
+op_put(uintptr_t key, uintptr_t val)
+{
+  reclaim_begin();
+  const int res = table_put(key, val);
+  reclaim_end();
+  return res;
+}
+
+static void*
+test(void* thread)
+{
+  thread_data_t* td = (thread_data_t*) thread;
+  set_cpu(the_cores[td->id % (sizeof(the_cores) / sizeof(the_cores[0]))]);
+  reclaim_thread_init(td->id);
+  if (table == TABLE_CLHT)
+    {
+      clht_gc_thread_init(clht, td->id);
+    }
+  unsigned long* seeds = seed_rand();
+
+  size_t i, n = initial / num_threads + (td->id < initial % num_threads);
+  for (i = 0; i < n; )
+    {
+      const uintptr_t key = my_random(&seeds[0], &seeds[1], &seeds[2]) % range + 1;
+      const uintptr_t val = make_val(key);
+      if (op_put(key, val))
+	{
+	  i++;
+	}
+      else if (table == TABLE_CLHT)
+	{
+	  reclaim_unused((void*) val);
+	}
+    }
+
+  pthread_barrier_wait(&barrier);
+
+  const uint32_t scale_update = (uint32_t) (update_rate * UINT_MAX);
+  const uint32_t scale_put = scale_update / 2;
+  uintptr_t spare = 0;		/* a value whose put failed, for the next put */
+  size_t ops = 0, bad_reads = 0;
+  while (!stop)
+    {
+      const uint32_t c = (uint32_t) my_random(&seeds[0], &seeds[1], &seeds[2]);
+      const uintptr_t key = c % range + 1;
+      if (c < scale_put)
+	{
+	  if (spare == 0)
+	    {
+	      spare = make_val(key);
+	    }
+	  else if (table == TABLE_CLHT)
+	    {
+	      *(char*) spare = (char) key;
+	    }
+	  else
+	    {
+	      spare = key;
+	    }
+	  if (op_put(key, spare))
+	    {
+	      spare = 0;
+	    }
+	}
+      else if (c < scale_update)
+	{
+	  reclaim_begin();
+	  /* the epoch can move on before the unlink */
+	  stress_wait_epoch(reclaim_epoch + 1, stress);
+	  const uintptr_t val = table_remove(key);
+	  if (val != 0 && table == TABLE_CLHT)
+	    {
+	      reclaim_retire((void*) val);
+	    }
+	  reclaim_end();
+	}
+      else
+	{
+	  reclaim_begin();
+	  const uint64_t e = reclaim_epoch;
+	  const uintptr_t val = table_get(key);
+	  /* while the epoch moves on as far as it can, and the others reclaim */
+	  stress_wait_epoch(e + 2, stress);
+	  stress_yield(stress);
+	  if (val != 0 && !val_ok(key, val))
+	    {
+	      bad_reads++;
+	    }
+	  reclaim_end();
+	}
+      ops++;
+    }
+  if (spare != 0 && table == TABLE_CLHT)
+    {
+      reclaim_unused((void*) spare);
+    }
+  reclaim_thread_term();
+
+  td->ops = ops;
+  td->bad_reads = bad_reads;
+  pthread_barrier_wait(&barrier);
+  return NULL;
+}
+
+static double
+elapsed_ms(struct timeval* start, struct timeval* end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_usec - start->tv_usec) / 1000.0;
+}
+
+int
+main(int argc, char **argv)
+{
+  set_cpu(the_cores[0]);
+
+  struct option long_options[] = {
+    {"help",                      no_argument,       NULL, 'h'},
+    {"table",                     required_argument, NULL, 't'},
+    {"duration",                  required_argument, NULL, 'd'},
+    {"initial-size",              required_argument, NULL, 'i'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"range",                     required_argument, NULL, 'r'},
+    {"num-buckets",               required_argument, NULL, 'b'},
+    {"update-rate",               required_argument, NULL, 'u'},
+    {"value-size",                required_argument, NULL, 's'},
+    {"stress",                    required_argument, NULL, 'S'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int i, c;
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "ht:d:i:n:r:b:u:s:S:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      switch(c)
+	{
+	case 'h':
+	  printf("reclaim_%s -- reclamation policy benchmark\n"
+		 "\n"
+		 "Usage:\n"
+		 "  reclaim_<policy> [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -t, --table <clht|lfc>\n"
+		 "        CLHT-LF (the values are reclaimed) or the lock-free chained\n"
+		 "        table (the nodes are)\n"
+		 "  -d, --duration <int>\n"
+		 "        Test duration in milliseconds\n"
+		 "  -i, --initial-size <int>\n"
+		 "        Number of elements to insert before the test\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of threads\n"
+		 "  -r, --range <int>\n"
+		 "        Range of integer values inserted in the table (default 2 * initial)\n"
+		 "  -b, --num-buckets <int>\n"
+		 "        Number of buckets (default initial)\n"
+		 "  -u, --update-rate <int>\n"
+		 "        Percentage of update transactions, half puts, half removes\n"
+		 "  -s, --value-size <int>\n"
+		 "        Size of the values of CLHT-LF\n"
+		 "  -S, --stress <int>\n"
+		 "        Hold the value of each get until the epoch moved on twice, or across\n"
+		 "        <int> yields of the processor, and <int> yields more; wait the same for\n"
+		 "        the epoch to move on once in each remove before the unlink (0 disables)\n"
+		 , reclaim_name());
+	  exit(0);
+	case 't':
+	  if (!strcmp(optarg, "lfc"))
+	    {
+	      table = TABLE_LFC;
+	    }
+	  else if (!strcmp(optarg, "clht"))
+	    {
+	      table = TABLE_CLHT;
+	    }
+	  else
+	    {
+	      printf("Unknown table %s\n", optarg);
+	      exit(1);
+	    }
+	  break;
+	case 'd':
+	  duration = atoi(optarg);
+	  break;
+	case 'i':
+	  initial = atol(optarg);
+	  break;
+	case 'n':
+	  num_threads = atoi(optarg);
+	  break;
+	case 'r':
+	  range = atol(optarg);
+	  break;
+	case 'b':
+	  num_buckets = atol(optarg);
+	  break;
+	case 'u':
+	  update_rate = atoi(optarg) / 100.0;
+	  break;
+	case 's':
+	  val_size = atol(optarg);
+	  break;
+	case 'S':
+	  stress = atol(optarg);
+	  break;
+	case '?':
+	default:
+	  printf("Use -h or --help for help\n");
+	  exit(1);
+	}
+    }
+
+  if (range == 0)
+    {
+      range = 2 * initial;
+    }
+  if (num_buckets == 0)
+    {
+      num_buckets = initial;
+    }
+  if (initial > range)
+    {
+      initial = range;
+    }
+  if (val_size == 0)
+    {
+      val_size = 1;
+    }
+
+  if (table == TABLE_CLHT)
+    {
+      /* CLHT buckets hold KEY_BUCKT keys, and their number is a power of 2 */
+      clht = clht_create(pow2roundup((num_buckets + KEY_BUCKT - 1) / KEY_BUCKT));
+    }
+  else
+    {
+      lfc = lfc_create(num_buckets);
+    }
+
+  printf("#reclaim: policy %s | table %s | %zu threads | %.0f%% updates | initial %zu | range %zu\n",
+	 reclaim_name(), table == TABLE_CLHT ? "clht-lf" : "lfc", num_threads,
+	 update_rate * 100, initial, range);
+
+  pthread_t threads[num_threads];
+  thread_data_t* tds = (thread_data_t*) memalign(CACHE_LINE_SIZE, num_threads * sizeof(thread_data_t));
+  assert(tds != NULL);
+  pthread_barrier_init(&barrier, NULL, num_threads + 1);
+  size_t t;
+  for (t = 0; t < num_threads; t++)
+    {
+      tds[t].id = t;
+      tds[t].ops = 0;
+      tds[t].bad_reads = 0;
+      pthread_create(&threads[t], NULL, test, tds + t);
+    }
+
+  pthread_barrier_wait(&barrier);
+  reclaim_stats_t st0, st;
+  reclaim_stats_get(&st0);
+
+  /* samples the unreclaimed memory until the duration is over */
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+  const ticks ticks_start = getticks();
+  size_t samples = 0, peak_bytes = 0, peak_num = 0;
+  double sum_bytes = 0, sum_num = 0;
+  struct timespec period = { 0, 1000000 };
+  do
+    {
+      nanosleep(&period, NULL);
+      reclaim_stats_get(&st);
+      const size_t bytes = st.retired_bytes - st.freed_bytes;
+      const size_t num = st.retired_num - st.freed_num;
+      if (bytes > peak_bytes)
+	{
+	  peak_bytes = bytes;
+	}
+      if (num > peak_num)
+	{
+	  peak_num = num;
+	}
+      sum_bytes += bytes;
+      sum_num += num;
+      samples++;
+      gettimeofday(&now, NULL);
+    }
+  while (elapsed_ms(&start, &now) < duration);
+  stop = 1;
+  pthread_barrier_wait(&barrier);
+  gettimeofday(&now, NULL);
+  const double ms = elapsed_ms(&start, &now);
+  const double ticks_per_us = (getticks() - ticks_start) / (ms * 1000.0);
+
+  size_t ops = 0, bad_reads = 0;
+  for (t = 0; t < num_threads; t++)
+    {
+      pthread_join(threads[t], NULL);
+      ops += tds[t].ops;
+      bad_reads += tds[t].bad_reads;
+    }
+  reclaim_stats_get(&st);
+
+  const size_t size = table == TABLE_CLHT ? clht_size(clht->ht) : lfc_size(lfc);
+  const size_t retired = st.retired_num - st0.retired_num;
+  const double mb = 1024.0 * 1024;
+  printf("ops/ms: %.3f\n", ops / ms);
+  printf("#unreclaimed: peak %.2f MB (%zu objects) | mean %.2f MB | retired %zu (%.1f MB) | freed %zu\n",
+	 peak_bytes / mb, peak_num, samples ? sum_bytes / samples / mb : 0.0,
+	 retired, (st.retired_bytes - st0.retired_bytes) / mb, st.freed_num - st0.freed_num);
+
+  printf("#reclaim latency:");
+  const size_t freed_timed = st.freed_num - st0.freed_num;
+  if (RECLAIM != RECLAIM_NONE && RECLAIM != RECLAIM_SSMEM && freed_timed > 0)
+    {
+      printf(" mean %.1f us | max %.1f us |", (st.lat_sum - st0.lat_sum) / ticks_per_us / freed_timed,
+	     st.lat_max / ticks_per_us);
+    }
+  else
+    {
+      printf(" mean n/a | max n/a |");
+    }
+  /* Little's law: mean unreclaimed = retire rate * mean latency */
+  if (RECLAIM != RECLAIM_NONE && retired > 0 && samples > 0)
+    {
+      printf(" est. %.1f us\n", (sum_num / samples) / (retired / (ms * 1000.0)));
+    }
+  else
+    {
+      printf(" est. n/a\n");
+    }
+  printf("#size %zu | bad reads %zu%s\n", size, bad_reads, bad_reads ? " | ERROR" : "");
+
+  free(tds);
+  return 0;
+}
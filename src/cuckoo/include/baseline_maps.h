@@ -0,0 +1,645 @@
+/*
+ *   File: baseline_maps.h
+ *   Description: reference maps that the tables are measured against, with
+ *   the interface of libcuckoo, for the C++ drivers and for the CLHT driver
+ *   through src/clht_baseline.cc
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _BASELINE_MAPS_H_
+#define _BASELINE_MAPS_H_
+
+/* The only copy of the baselines: the hopscotch driver's BaselineMaps.h adapts
+   them to its maps, and the other drivers are built around one of them with
+   -DBASELINE=<kind> and reach it through baseline_map<kind, K, V>::type:
+
+   BASELINE_NULL        - next to no work: the cost of the harness alone
+   BASELINE_PRIVATE_STD - a std::unordered_map per thread: no sharing at all
+   BASELINE_PRIVATE_OA  - a linear-probing table per thread: no sharing, and
+                          one cache miss per operation at most
+   BASELINE_LOCKED_STD  - one std::unordered_map behind one spinlock
+   BASELINE_SHARDED_RW  - std::unordered_map shards, each behind a
+                          reader-writer lock that lookups share
+
+   A thread of the private maps only sees the keys it added itself; size() and
+   footprint() sum the maps of all the threads. The keys are integers, and the
+   key 0, that the drivers never draw, marks the free buckets of
+   BASELINE_PRIVATE_OA. */
+
+#define BASELINE_NULL        1
+#define BASELINE_PRIVATE_STD 2
+#define BASELINE_PRIVATE_OA  3
+#define BASELINE_LOCKED_STD  4
+#define BASELINE_SHARDED_RW  5
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include "mem_footprint.h"
+
+#define BASELINE_CACHE_LINE  64
+#define BASELINE_MAX_THREADS 256 /* threads of the private maps, as slots */
+
+/* the slot of the private maps that the calling thread takes the first time
+   it uses one (not static, so that all the files of a driver share the slots) */
+inline unsigned int
+baseline_slot()
+{
+  static volatile unsigned int next = 0;
+  static __thread int slot = -1;
+  if (slot < 0)
+    {
+      slot = (int) (__sync_fetch_and_add(&next, 1) % BASELINE_MAX_THREADS);
+    }
+  return (unsigned int) slot;
+}
+
+/* multiplicative hashing: the high bits are the well mixed ones */
+static inline uint64_t
+baseline_hash(uint64_t key)
+{
+  return key * 0x9E3779B97F4A7C15ULL;
+}
+
+/* arrays of cache-line aligned elements, that new does not align before C++17 */
+template <class T>
+static T*
+baseline_new_array(size_t num)
+{
+  void* mem;
+  if (posix_memalign(&mem, BASELINE_CACHE_LINE, num * sizeof(T)))
+    {
+      throw std::bad_alloc();
+    }
+  T* array = static_cast<T*>(mem);
+  for (size_t i = 0; i < num; i++)
+    {
+      new (array + i) T();
+    }
+  return array;
+}
+
+template <class T>
+static void
+baseline_delete_array(T* array, size_t num)
+{
+  for (size_t i = 0; i < num; i++)
+    {
+      array[i].~T();
+    }
+  free(array);
+}
+
+/* a std::unordered_map: its bucket array goes to table, and a node per key, a
+   next pointer and the pair (libstdc++ doesn't cache the hashes of integer
+   keys), to overflow */
+template <class Map>
+static void
+baseline_footprint_std(const Map& map, mem_footprint_t* f)
+{
+  f->table += map.bucket_count() * sizeof(void*);
+  f->overflow += map.size() * (sizeof(void*) + sizeof(typename Map::value_type));
+}
+
+/* Every key is added and none is found or removed. Each thread counts its adds
+   on a cache line of its own, so that the driver can fill the map and check
+   its size. */
+template <class K, class V>
+class baseline_null_map
+{
+  struct alignas(BASELINE_CACHE_LINE) slot_t
+  {
+    size_t count;
+  };
+
+  slot_t* slots_;
+
+public:
+  static const char* name() { return "null"; }
+
+  baseline_null_map(size_t, size_t)
+    : slots_(baseline_new_array<slot_t>(BASELINE_MAX_THREADS)) {}
+  ~baseline_null_map() { baseline_delete_array(slots_, BASELINE_MAX_THREADS); }
+
+  bool contains(const K&) const { return false; }
+  bool find(const K&, V&) const { return false; }
+  bool insert(const K&, const V&)
+  {
+    slots_[baseline_slot()].count++;
+    return true;
+  }
+  bool erase(const K&) { return false; }
+  bool erase(const K&, V&) { return false; }
+
+  size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	count += slots_[i].count;
+      }
+    return count;
+  }
+
+  void footprint(mem_footprint_t* f) const
+  {
+    f->table += sizeof(*this) + BASELINE_MAX_THREADS * sizeof(slot_t);
+  }
+};
+
+template <class K, class V>
+class baseline_private_std_map
+{
+  typedef std::unordered_map<K, V> map_t;
+
+  struct alignas(BASELINE_CACHE_LINE) slot_t
+  {
+    map_t map;
+  };
+
+  slot_t* slots_;
+
+  map_t& mine() const { return slots_[baseline_slot()].map; }
+
+public:
+  static const char* name() { return "private-std"; }
+
+  baseline_private_std_map(size_t, size_t)
+    : slots_(baseline_new_array<slot_t>(BASELINE_MAX_THREADS)) {}
+  ~baseline_private_std_map() { baseline_delete_array(slots_, BASELINE_MAX_THREADS); }
+
+  bool contains(const K& key) const { return mine().count(key) != 0; }
+  bool find(const K& key, V& val) const
+  {
+    const map_t& map = mine();
+    typename map_t::const_iterator it = map.find(key);
+    if (it == map.end())
+      {
+	return false;
+      }
+    val = it->second;
+    return true;
+  }
+  bool insert(const K& key, const V& val)
+  {
+    return mine().insert(std::make_pair(key, val)).second;
+  }
+  bool erase(const K& key) { return mine().erase(key) != 0; }
+  bool erase(const K& key, V& val)
+  {
+    map_t& map = mine();
+    typename map_t::iterator it = map.find(key);
+    if (it == map.end())
+      {
+	return false;
+      }
+    val = it->second;
+    map.erase(it);
+    return true;
+  }
+
+  size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	count += slots_[i].map.size();
+      }
+    return count;
+  }
+
+  void footprint(mem_footprint_t* f) const
+  {
+    f->table += sizeof(*this) + BASELINE_MAX_THREADS * sizeof(slot_t);
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	baseline_footprint_std(slots_[i].map, f);
+      }
+  }
+};
+
+/* Linear probing, with the key 0 marking the free buckets. Removes shift the
+   following keys of the run back, so there are no tombstones, and the table
+   of a thread doubles at half full. */
+template <class K, class V>
+class baseline_private_oa_map
+{
+  static_assert(std::is_integral<K>::value, "the free buckets hold the key 0");
+
+  static const size_t MIN_CAPACITY = 64;
+
+  struct bucket_t
+  {
+    K key;
+    V val;
+  };
+
+  struct alignas(BASELINE_CACHE_LINE) slot_t
+  {
+    bucket_t* buckets;
+    size_t mask;
+    size_t count;
+  };
+
+  slot_t* slots_;
+  size_t init_capacity_;
+
+  static bucket_t* new_buckets(size_t capacity)
+  {
+    bucket_t* buckets = static_cast<bucket_t*>(calloc(capacity, sizeof(bucket_t)));
+    if (buckets == NULL)
+      {
+	throw std::bad_alloc();
+      }
+    return buckets;
+  }
+
+  static size_t home(const slot_t& s, const K& key)
+  {
+    return (size_t) (baseline_hash((uint64_t) key) >> 32) & s.mask;
+  }
+
+  /* the bucket of key, or the free bucket that ends its run */
+  static bucket_t* lookup(const slot_t& s, const K& key)
+  {
+    size_t i = home(s, key);
+    while (s.buckets[i].key != 0 && s.buckets[i].key != key)
+      {
+	i = (i + 1) & s.mask;
+      }
+    return s.buckets + i;
+  }
+
+  static void grow(slot_t& s)
+  {
+    bucket_t* old_buckets = s.buckets;
+    const size_t old_capacity = s.mask + 1;
+    s.buckets = new_buckets(2 * old_capacity);
+    s.mask = 2 * old_capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++)
+      {
+	if (old_buckets[i].key != 0)
+	  {
+	    *lookup(s, old_buckets[i].key) = old_buckets[i];
+	  }
+      }
+    free(old_buckets);
+  }
+
+  slot_t& mine() const
+  {
+    slot_t& s = slots_[baseline_slot()];
+    if (s.buckets == NULL)
+      {
+	s.buckets = new_buckets(init_capacity_);
+	s.mask = init_capacity_ - 1;
+      }
+    return s;
+  }
+
+public:
+  static const char* name() { return "private-oa"; }
+
+  baseline_private_oa_map(size_t capacity, size_t)
+    : slots_(baseline_new_array<slot_t>(BASELINE_MAX_THREADS)),
+      init_capacity_(MIN_CAPACITY)
+  {
+    while (init_capacity_ < 2 * capacity)
+      {
+	init_capacity_ <<= 1;
+      }
+  }
+  ~baseline_private_oa_map()
+  {
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	free(slots_[i].buckets);
+      }
+    baseline_delete_array(slots_, BASELINE_MAX_THREADS);
+  }
+
+  bool contains(const K& key) const { return lookup(mine(), key)->key != 0; }
+  bool find(const K& key, V& val) const
+  {
+    const bucket_t* b = lookup(mine(), key);
+    if (b->key == 0)
+      {
+	return false;
+      }
+    val = b->val;
+    return true;
+  }
+  bool insert(const K& key, const V& val)
+  {
+    slot_t& s = mine();
+    bucket_t* b = lookup(s, key);
+    if (b->key != 0)
+      {
+	return false;
+      }
+    if (2 * (s.count + 1) > s.mask + 1)
+      {
+	grow(s);
+	b = lookup(s, key);
+      }
+    b->key = key;
+    b->val = val;
+    s.count++;
+    return true;
+  }
+  bool erase(const K& key)
+  {
+    V val;
+    return erase(key, val);
+  }
+  bool erase(const K& key, V& val)
+  {
+    slot_t& s = mine();
+    size_t hole = lookup(s, key) - s.buckets;
+    if (s.buckets[hole].key == 0)
+      {
+	return false;
+      }
+    val = s.buckets[hole].val;
+    /* move back the keys of the run that the hole separates from their home */
+    for (size_t i = (hole + 1) & s.mask; s.buckets[i].key != 0; i = (i + 1) & s.mask)
+      {
+	const size_t h = home(s, s.buckets[i].key);
+	if (((i - h) & s.mask) >= ((i - hole) & s.mask))
+	  {
+	    s.buckets[hole] = s.buckets[i];
+	    hole = i;
+	  }
+      }
+    memset((void*) (s.buckets + hole), 0, sizeof(bucket_t));
+    s.count--;
+    return true;
+  }
+
+  size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	count += slots_[i].count;
+      }
+    return count;
+  }
+
+  void footprint(mem_footprint_t* f) const
+  {
+    f->table += sizeof(*this) + BASELINE_MAX_THREADS * sizeof(slot_t);
+    for (size_t i = 0; i < BASELINE_MAX_THREADS; i++)
+      {
+	if (slots_[i].buckets != NULL)
+	  {
+	    f->table += (slots_[i].mask + 1) * sizeof(bucket_t);
+	  }
+      }
+  }
+};
+
+template <class K, class V>
+class baseline_locked_std_map
+{
+  typedef std::unordered_map<K, V> map_t;
+
+  pthread_spinlock_t lock_;
+  char pad_[BASELINE_CACHE_LINE];
+  map_t map_;
+
+public:
+  static const char* name() { return "locked-std"; }
+
+  baseline_locked_std_map(size_t capacity, size_t)
+  {
+    pthread_spin_init(&lock_, PTHREAD_PROCESS_PRIVATE);
+    map_.reserve(capacity);
+  }
+  ~baseline_locked_std_map() { pthread_spin_destroy(&lock_); }
+
+  bool contains(const K& key)
+  {
+    pthread_spin_lock(&lock_);
+    const bool found = map_.count(key) != 0;
+    pthread_spin_unlock(&lock_);
+    return found;
+  }
+  bool find(const K& key, V& val)
+  {
+    pthread_spin_lock(&lock_);
+    typename map_t::const_iterator it = map_.find(key);
+    const bool found = it != map_.end();
+    if (found)
+      {
+	val = it->second;
+      }
+    pthread_spin_unlock(&lock_);
+    return found;
+  }
+  bool insert(const K& key, const V& val)
+  {
+    pthread_spin_lock(&lock_);
+    const bool added = map_.insert(std::make_pair(key, val)).second;
+    pthread_spin_unlock(&lock_);
+    return added;
+  }
+  bool erase(const K& key)
+  {
+    pthread_spin_lock(&lock_);
+    const bool found = map_.erase(key) != 0;
+    pthread_spin_unlock(&lock_);
+    return found;
+  }
+  bool erase(const K& key, V& val)
+  {
+    pthread_spin_lock(&lock_);
+    typename map_t::iterator it = map_.find(key);
+    const bool found = it != map_.end();
+    if (found)
+      {
+	val = it->second;
+	map_.erase(it);
+      }
+    pthread_spin_unlock(&lock_);
+    return found;
+  }
+
+  size_t size() const { return map_.size(); }
+
+  void footprint(mem_footprint_t* f) const
+  {
+    f->table += sizeof(*this) - sizeof(pthread_spinlock_t);
+    f->locks += sizeof(pthread_spinlock_t);
+    baseline_footprint_std(map_, f);
+  }
+};
+
+/* The shards take the high bits of baseline_hash, so that the buckets that
+   std::hash picks inside a shard don't follow them. The reader-writer locks
+   are pthread_rwlock_t, which std::shared_mutex wraps in C++17. */
+template <class K, class V>
+class baseline_sharded_rw_map
+{
+  typedef std::unordered_map<K, V> map_t;
+
+  static const size_t SHARDS_PER_THREAD = 4;
+
+  struct alignas(BASELINE_CACHE_LINE) shard_t
+  {
+    pthread_rwlock_t lock;
+    map_t map;
+  };
+
+  shard_t* shards_;
+  size_t num_shards_;
+  unsigned int shift_;
+
+  shard_t& shard(const K& key) const
+  {
+    return shards_[baseline_hash((uint64_t) key) >> shift_];
+  }
+
+public:
+  static const char* name() { return "sharded-rw"; }
+
+  baseline_sharded_rw_map(size_t capacity, size_t num_threads)
+    : num_shards_(1), shift_(64)
+  {
+    while (num_shards_ < SHARDS_PER_THREAD * num_threads)
+      {
+	num_shards_ <<= 1;
+	shift_--;
+      }
+    if (num_shards_ == 1)
+      {
+	/* a shift of 64 is undefined */
+	num_shards_ = 2;
+	shift_ = 63;
+      }
+    shards_ = baseline_new_array<shard_t>(num_shards_);
+    for (size_t i = 0; i < num_shards_; i++)
+      {
+	pthread_rwlock_init(&shards_[i].lock, NULL);
+	shards_[i].map.reserve(capacity / num_shards_);
+      }
+  }
+  ~baseline_sharded_rw_map()
+  {
+    for (size_t i = 0; i < num_shards_; i++)
+      {
+	pthread_rwlock_destroy(&shards_[i].lock);
+      }
+    baseline_delete_array(shards_, num_shards_);
+  }
+
+  bool contains(const K& key) const
+  {
+    shard_t& s = shard(key);
+    pthread_rwlock_rdlock(&s.lock);
+    const bool found = s.map.count(key) != 0;
+    pthread_rwlock_unlock(&s.lock);
+    return found;
+  }
+  bool find(const K& key, V& val) const
+  {
+    shard_t& s = shard(key);
+    pthread_rwlock_rdlock(&s.lock);
+    typename map_t::const_iterator it = s.map.find(key);
+    const bool found = it != s.map.end();
+    if (found)
+      {
+	val = it->second;
+      }
+    pthread_rwlock_unlock(&s.lock);
+    return found;
+  }
+  bool insert(const K& key, const V& val)
+  {
+    shard_t& s = shard(key);
+    pthread_rwlock_wrlock(&s.lock);
+    const bool added = s.map.insert(std::make_pair(key, val)).second;
+    pthread_rwlock_unlock(&s.lock);
+    return added;
+  }
+  bool erase(const K& key)
+  {
+    shard_t& s = shard(key);
+    pthread_rwlock_wrlock(&s.lock);
+    const bool found = s.map.erase(key) != 0;
+    pthread_rwlock_unlock(&s.lock);
+    return found;
+  }
+  bool erase(const K& key, V& val)
+  {
+    shard_t& s = shard(key);
+    pthread_rwlock_wrlock(&s.lock);
+    typename map_t::iterator it = s.map.find(key);
+    const bool found = it != s.map.end();
+    if (found)
+      {
+	val = it->second;
+	s.map.erase(it);
+      }
+    pthread_rwlock_unlock(&s.lock);
+    return found;
+  }
+
+  size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < num_shards_; i++)
+      {
+	count += shards_[i].map.size();
+      }
+    return count;
+  }
+
+  void footprint(mem_footprint_t* f) const
+  {
+    f->table += sizeof(*this) + num_shards_ * (sizeof(shard_t) - sizeof(pthread_rwlock_t));
+    f->locks += num_shards_ * sizeof(pthread_rwlock_t);
+    for (size_t i = 0; i < num_shards_; i++)
+      {
+	baseline_footprint_std(shards_[i].map, f);
+      }
+  }
+};
+
+template <int kind, class K, class V> struct baseline_map;
+template <class K, class V> struct baseline_map<BASELINE_NULL, K, V>
+{ typedef baseline_null_map<K, V> type; };
+template <class K, class V> struct baseline_map<BASELINE_PRIVATE_STD, K, V>
+{ typedef baseline_private_std_map<K, V> type; };
+template <class K, class V> struct baseline_map<BASELINE_PRIVATE_OA, K, V>
+{ typedef baseline_private_oa_map<K, V> type; };
+template <class K, class V> struct baseline_map<BASELINE_LOCKED_STD, K, V>
+{ typedef baseline_locked_std_map<K, V> type; };
+template <class K, class V> struct baseline_map<BASELINE_SHARDED_RW, K, V>
+{ typedef baseline_sharded_rw_map<K, V> type; };
+
+#endif	/* _BASELINE_MAPS_H_ */
@@ -8,14 +8,46 @@
 //! The default maximum number of keys per bucket
 const size_t DEFAULT_SLOT_PER_BUCKET = 4;
 
+//! The default maximum number of slots in a cuckoo path. Longer paths let an
+//! insert find room in fuller tables, at the cost of a wider search and more
+//! items moved per insert.
+const size_t DEFAULT_MAX_BFS_PATH_LEN = 5;
+
 //! The default number of elements in an empty hash table
 const size_t DEFAULT_SIZE = (1U << 16) * DEFAULT_SLOT_PER_BUCKET;
 
-//! On a scale of 0 to 16, the memory granularity of the locks array. 0 is the
-//! least granular, meaning the array is a contiguous array and thus offers the
-//! best performance but the greatest memory overhead. 16 is the most granular,
-//! offering the least memory overhead but worse performance.
-const size_t LOCK_ARRAY_GRANULARITY = 0;
+//! Pass as the number of locks to let the table size its own lock stripes.
+//! The stripe count then follows the core count and the hashpower, and is
+//! doubled on expansion whenever waiting on the stripes took more than \ref
+//! LOCK_CONTENTION_THRESHOLD of the threads' time.
+const size_t AUTO_NUM_LOCKS = 0;
+
+//! The maximum number of lock stripes a table will use
+const size_t MAX_NUM_LOCKS = 1UL << 16;
+
+//! The number of lock stripes per core a self-sized table starts with (never
+//! more than the number of buckets)
+const size_t DEFAULT_LOCKS_PER_CORE = 64;
+
+//! The number of buckets per lock stripe a self-sized table keeps as it grows
+const size_t DEFAULT_BUCKETS_PER_LOCK = 64;
+
+//! The fraction of thread time spent waiting on lock stripes above which a
+//! self-sized table doubles its stripe count
+const double LOCK_CONTENTION_THRESHOLD = 0.01;
+
+//! The memory layout of the lock stripes. padded gives every stripe its own
+//! cache line, so stripes never falsely share. compact packs the stripes one
+//! byte apart, for tables where lock memory matters more than false sharing.
+enum class cuckoo_lock_layout { padded, compact };
+
+//! The default lock stripe layout
+const cuckoo_lock_layout DEFAULT_LOCK_LAYOUT = cuckoo_lock_layout::padded;
+
+//! The highest load factor \ref cuckoohash_map::bulk_load grows the table
+//! for. Past it, too many keys find both their buckets full and have to go
+//! through the regular, locked insert path.
+const double BULK_LOAD_MAXIMUM_LOAD_FACTOR = 0.75;
 
 //! The default minimum load factor that the table allows for automatic
 //! expansion. It must be a number between 0.0 and 1.0. The table will throw
@@ -13,31 +13,8 @@ extern "C" {
 
 #include "getticks.h"
 
-#ifndef REF_SPEED_GHZ
-#  if defined(PLATFORM_MCORE) | defined(XEON) | defined(OPTERON)
-#    define REF_SPEED_GHZ           2.1
-#  elif defined(HASWELL)
-#    define REF_SPEED_GHZ           3
-#  elif defined(LPDXEON)
-#    define REF_SPEED_GHZ           2.8
-#  elif defined(SCC)
-#    define REF_SPEED_GHZ           0.533
-#  elif defined(MAGLITE)
-#    define REF_SPEED_GHZ           1.2
-#  elif defined(T44)
-#    define REF_SPEED_GHZ           2.998
-#  elif defined(__tilepro__)
-#    define REF_SPEED_GHZ           0.7
-#  elif defined(__tilegx__)
-#    define REF_SPEED_GHZ           1.2
-#  elif defined(LAPTOP) | defined(IGORLAPTOPLINUX) | defined(OANALAPTOPLINUX)
-#    define REF_SPEED_GHZ           2.4
-#  elif defined(LPDPC4)
-#    define REF_SPEED_GHZ           3.5
-#  else
-#    define REF_SPEED_GHZ          FREQ_GHZ
-#  endif
-#endif  /* REF_SPEED_GHZ */
+/* Ticks are converted to time with the rate that getticks.h calibrates
+   against CLOCK_MONOTONIC_RAW (ticks_to_ns()), not with a nominal frequency. */
 
   /* 
 #DO_TIMINGS_TICKS
@@ -166,13 +143,13 @@ extern "C" {
 
 #  define ENTRY_TIME_POS(position)		\
   do {						\
-    entry_time[position] = getticks();		\
+    entry_time[position] = getticks_start();	\
     entry_time_valid[position] = M_TRUE;	\
   } while (0);
 
 #  define EXIT_TIME_POS(position)					\
   do {									\
-    ticks exit_time = getticks();					\
+    ticks exit_time = getticks_stop();					\
     if (entry_time_valid[position]) {					\
       entry_time_valid[position] = M_FALSE;				\
       total_sum_ticks[position] += (exit_time - entry_time[position] - getticks_correction); \
@@ -201,8 +178,9 @@ extern "C" {
     for (i = start; i < end; i++) {					\
       if (total_samples[i]) {						\
 	printf("[%02d]%s:\n", i, measurement_msgs[i]);			\
-	printf("  samples: %-16llu| ticks: %-16llu| avg ticks: %-16llu\n", \
-	       total_samples[i], total_sum_ticks[i], total_sum_ticks[i] / total_samples[i]); \
+	printf("  samples: %-16llu| ticks: %-16llu| avg ticks: %-16llu| avg ns: %.1f\n", \
+	       total_samples[i], total_sum_ticks[i], total_sum_ticks[i] / total_samples[i], \
+	       ticks_to_ns(total_sum_ticks[i]) / total_samples[i]);	\
       }									\
     }                                                                   \
   }									\
@@ -216,9 +194,9 @@ extern "C" {
     for (i = start; i < end; i++) {					\
       if (total_samples[i]) {						\
 	printf("[%02d]%s:\n", i, measurement_msgs[i]);			\
-	printf("  samples: %-16llu | secs: %-4.10f | avg ticks: %-4.10f\n", \
-	       total_samples[i], total_sum_ticks[i] / (REF_SPEED_GHZ * 1.e9), \
-	       (total_sum_ticks[i] / total_samples[i])/ (REF_SPEED_GHZ * 1.e9)); \
+	printf("  samples: %-16llu | secs: %-4.10f | avg ns: %-4.1f\n", \
+	       total_samples[i], ticks_to_ns(total_sum_ticks[i]) / 1.e9, \
+	       ticks_to_ns(total_sum_ticks[i]) / total_samples[i]); \
       }									\
     }                                                                   \
   }									\
@@ -261,13 +239,13 @@ extern "C" {
 
 #  define ENTRY_TIME_POS(position)		\
   do {						\
-    entry_time[position] = getticks();		\
+    entry_time[position] = getticks_start();	\
   } while (0);
 
 #  define EXIT_TIME_POS(position)					\
   do {									\
     total_sum_ticks[position] +=					\
-      (getticks() - entry_time[position] - getticks_correction);	\
+      (getticks_stop() - entry_time[position] - getticks_correction);	\
     total_samples[position]++;						\
   } while (0);
 
@@ -288,8 +266,9 @@ extern "C" {
     for (i = start; i < end; i++) {					\
       if (total_samples[i]) {						\
 	printf("[%02d]%s:\n", i, measurement_msgs[i]);			\
-	printf("  samples: %-16llu| ticks: %-16llu| avg ticks: %-16llu\n", \
-	       total_samples[i], total_sum_ticks[i], total_sum_ticks[i] / total_samples[i]); \
+	printf("  samples: %-16llu| ticks: %-16llu| avg ticks: %-16llu| avg ns: %.1f\n", \
+	       total_samples[i], total_sum_ticks[i], total_sum_ticks[i] / total_samples[i], \
+	       ticks_to_ns(total_sum_ticks[i]) / total_samples[i]);	\
       }									\
     }                                                                   \
   }									\
@@ -303,9 +282,9 @@ extern "C" {
     for (i = start; i < end; i++) {					\
       if (total_samples[i]) {						\
 	printf("[%02d]%s:\n", i, measurement_msgs[i]);			\
-	printf("  samples: %-16llu | secs: %-4.10f | avg ticks: %-4.10f\n", \
-	       total_samples[i], total_sum_ticks[i] / (REF_SPEED_GHZ * 1.e9), \
-	       (total_sum_ticks[i] / total_samples[i])/ (REF_SPEED_GHZ * 1.e9)); \
+	printf("  samples: %-16llu | secs: %-4.10f | avg ns: %-4.1f\n", \
+	       total_samples[i], ticks_to_ns(total_sum_ticks[i]) / 1.e9, \
+	       ticks_to_ns(total_sum_ticks[i]) / total_samples[i]); \
       }									\
     }                                                                   \
   }									\
@@ -0,0 +1,171 @@
+/*
+ *   File: op_stream.h
+ *   Description: per-thread sequences of operations, generated before the
+ *   measurements, and the null backend that times the harness alone
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _OP_STREAM_H_
+#define _OP_STREAM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/* An op stream holds the operations of one thread, drawn with my_random() from
+   the thread's seeds before the measurements start, so that the measured loop
+   only reads them. An entry packs the key (upper 32 bits) with the random number
+   c that picks the operation (lower 32 bits): the loop keeps its c <= scale_put
+   and c <= scale_rem tests and runs the same mix of operations as with
+   my_random(). The length is a power of two and the loop wraps around.
+
+   The streams take huge pages (MAP_HUGETLB) when some are reserved, and
+   transparent huge pages otherwise, so that reading them costs few TLB misses.
+
+   Include this file after my_random() and getticks() are defined. */
+
+typedef uint64_t op_stream_t;
+
+#define OP_STREAM_HUGE_PAGE      (2 * 1024 * 1024L)
+#define OP_STREAM_NULL_OPS       (1 << 20) /* operations the null backend is timed on */
+
+static inline size_t
+op_stream_bytes(size_t len)
+{
+  const size_t bytes = len * sizeof(op_stream_t);
+  return (bytes + OP_STREAM_HUGE_PAGE - 1) & ~(OP_STREAM_HUGE_PAGE - 1);
+}
+
+/* a stream of len operations (len: a power of two) on the keys key_min +
+   (c & key_mask), or NULL if they do not fit in 32 bits or there is no memory */
+static inline op_stream_t*
+op_stream_new(size_t len, unsigned long* seeds, uint64_t key_mask, uint64_t key_min)
+{
+  if (key_min + key_mask > UINT32_MAX)
+    {
+      fprintf(stderr, "op_stream: keys up to %llu do not fit in 32 bits\n",
+	      (unsigned long long) (key_min + key_mask));
+      return NULL;
+    }
+
+  const size_t bytes = op_stream_bytes(len);
+  void* mem = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+  mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (mem == MAP_FAILED)
+    {
+      mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mem == MAP_FAILED)
+	{
+	  perror("op_stream: mmap");
+	  return NULL;
+	}
+#if defined(MADV_HUGEPAGE)
+      madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+  op_stream_t* g = (op_stream_t*) mem;
+  size_t i;
+  for (i = 0; i < len; i++)
+    {
+      const uint32_t c = (uint32_t) my_random(&(seeds[0]), &(seeds[1]), &(seeds[2]));
+      const uint64_t key = (c & key_mask) + key_min;
+      g[i] = (key << 32) | c;
+    }
+  return g;
+}
+
+static inline void
+op_stream_free(op_stream_t* g, size_t len)
+{
+  if (g != NULL)
+    {
+      munmap((void*) g, op_stream_bytes(len));
+    }
+}
+
+/* the next operation of the stream g of mask + 1 entries */
+#define OP_STREAM_NXT(g, idx, mask, c, key)	\
+  {						\
+    const op_stream_t __op = g[idx++ & (mask)];	\
+    c = (uint32_t) __op;			\
+    key = __op >> 32;				\
+  }
+
+/* the next operation, from the stream g if there is one, else from my_random() */
+#define OP_STREAM_OR_RAND_NXT(g, idx, mask, c, key, seeds, key_mask, key_min) \
+  if (g != NULL)							\
+    {									\
+      OP_STREAM_NXT(g, idx, mask, c, key);				\
+    }									\
+  else									\
+    {									\
+      c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));	\
+      key = (c & (key_mask)) + (key_min);				\
+    }
+
+/* The null backend: each operation is a call that returns at once, but that the
+   compiler can neither drop nor inline. */
+static __attribute__ ((noinline)) int
+op_stream_null_op(uint64_t key, int op)
+{
+  __asm__ __volatile__ ("" ::: "memory");
+  return (int) ((key + op) & 1);
+}
+
+/* Cycles per operation of the measured loop around the null backend: the ops
+   come from g (mask + 1 entries) or, when g is NULL, from my_random() on seeds.
+   Subtract it from the cycles per operation of a table to get the table's own. */
+static inline double
+op_stream_null_cycles(const op_stream_t* g, size_t mask, unsigned long* seeds,
+		      uint64_t key_mask, uint64_t key_min,
+		      uint32_t scale_put, uint32_t scale_rem)
+{
+  size_t idx = 0, succ = 0, i;
+  uint32_t c;
+  uint64_t key;
+  const ticks start = getticks();
+  for (i = 0; i < OP_STREAM_NULL_OPS; i++)
+    {
+      OP_STREAM_OR_RAND_NXT(g, idx, mask, c, key, seeds, key_mask, key_min);
+      if (c <= scale_put)
+	{
+	  succ += op_stream_null_op(key, 1);
+	}
+      else if (c <= scale_rem)
+	{
+	  succ += op_stream_null_op(key, 2);
+	}
+      else
+	{
+	  succ += op_stream_null_op(key, 0);
+	}
+    }
+  const ticks stop = getticks();
+  __asm__ __volatile__ ("" :: "r" (succ));
+  return (double) (stop - start) / OP_STREAM_NULL_OPS;
+}
+
+#endif	/* _OP_STREAM_H_ */
@@ -4,6 +4,8 @@
 #include <city.h>
 #include <string>
 
+#include "default_hasher.hh"
+
 /*! CityHasher is a std::hash-style wrapper around CityHash. We
  *  encourage using CityHasher instead of the default std::hash if
  *  possible. */
@@ -22,18 +24,33 @@ public:
 };
 
 /*! This is a template specialization of CityHasher for
- *  std::string. */
+ *  std::string. It also hashes a \ref string_key_view or a C string, to the
+ *  same value as a std::string of the same characters. */
 template <>
 class CityHasher<std::string> {
-public:
-    size_t operator()(const std::string& k) const {
+    static size_t hash(const char* s, size_t n) {
         if (sizeof(size_t) < 8) {
-            return CityHash32(k.c_str(), k.size());
+            return CityHash32(s, n);
         }
         /* Although the following line should be optimized away on 32-bit
          * builds, the cast is still necessary to stop MSVC emitting a
          * truncation warning. */
-        return static_cast<size_t>(CityHash64(k.c_str(), k.size()));
+        return static_cast<size_t>(CityHash64(s, n));
+    }
+
+public:
+    typedef void is_transparent;
+
+    size_t operator()(const std::string& k) const {
+        return hash(k.data(), k.size());
+    }
+
+    size_t operator()(const string_key_view& k) const {
+        return hash(k.data(), k.size());
+    }
+
+    size_t operator()(const char* k) const {
+        return hash(k, std::strlen(k));
     }
 };
 
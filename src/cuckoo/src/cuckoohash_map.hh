@@ -13,6 +13,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <iterator>
 #include <limits>
@@ -20,6 +21,7 @@
 #include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <type_traits>
@@ -28,16 +30,18 @@
 
 #include "cuckoohash_config.hh"
 #include "cuckoohash_util.hh"
-#include "lazy_array.hh"
+#include "lock_array.hh"
 #include "default_hasher.hh"
+#include "retry_stats.h"
 
 //! cuckoohash_map is the hash table class.
 template < class Key,
            class T,
            class Hash = DefaultHasher<Key>,
-           class Pred = std::equal_to<Key>,
+           class Pred = DefaultKeyEqual<Key>,
            class Alloc = std::allocator<std::pair<const Key, T>>,
-           size_t SLOT_PER_BUCKET = DEFAULT_SLOT_PER_BUCKET
+           size_t SLOT_PER_BUCKET = DEFAULT_SLOT_PER_BUCKET,
+           size_t BFS_PATH_LEN = DEFAULT_MAX_BFS_PATH_LEN
            >
 class cuckoohash_map {
 public:
@@ -57,6 +61,11 @@ public:
     //! slot_per_bucket is the number of items each bucket in the table can hold
     static const size_t slot_per_bucket = SLOT_PER_BUCKET;
 
+    //! max_bfs_path_len is the longest cuckoo path, in slots, an insert can
+    //! search for. The depth actually searched can be lowered at runtime with
+    //! \ref bfs_path_len(size_t).
+    static const size_t max_bfs_path_len = BFS_PATH_LEN;
+
     //! For any update operations, the callable passed in must be convertible to
     //! the following type
     typedef std::function<void(mapped_type&)> updater_type;
@@ -112,16 +121,19 @@ public:
     private:
         // private constructor which initializes the owner and key
         reference(
-            cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket>& owner,
+            cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket,
+                           max_bfs_path_len>& owner,
             const key_type& key) : owner_(owner), key_(key) {}
 
         // reference to the hash map instance
-        cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket>& owner_;
+        cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket,
+                       max_bfs_path_len>& owner_;
         // the referenced key
         const key_type& key_;
 
         // cuckoohash_map needs to call the private constructor
-        friend class cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket>;
+        friend class cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket,
+                                    max_bfs_path_len>;
     };
 
     typedef const mapped_type const_reference;
@@ -140,38 +152,12 @@ private:
     static const bool value_copy_assignable = std::is_copy_assignable<
         mapped_type>::value;
 
-    // number of locks in the locks array
-    static const size_t kNumLocks = 1 << 16;
-
     // number of cores on the machine
     static size_t kNumCores() {
         static size_t cores = std::thread::hardware_concurrency();
         return cores;
     }
 
-    // A fast, lightweight spinlock
-    LIBCUCKOO_SQUELCH_PADDING_WARNING
-    class LIBCUCKOO_ALIGNAS(64) spinlock {
-        std::atomic_flag lock_;
-    public:
-        spinlock() {
-            lock_.clear();
-        }
-
-        inline void lock() {
-            while (lock_.test_and_set(std::memory_order_acquire));
-        }
-
-        inline void unlock() {
-            lock_.clear(std::memory_order_release);
-        }
-
-        inline bool try_lock() {
-            return !lock_.test_and_set(std::memory_order_acquire);
-        }
-
-    };
-
     typedef enum {
         ok,
         failure,
@@ -280,14 +266,11 @@ private:
         Bucket, typename allocator_type::template rebind<Bucket>::other>
     buckets_t;
 
-    // The type of the locks container
-    static_assert(LOCK_ARRAY_GRANULARITY >= 0 && LOCK_ARRAY_GRANULARITY <= 16,
-                  "LOCK_ARRAY_GRANULARITY constant must be between 0 and 16,"
-                  " inclusive");
-    typedef lazy_array<
-        16 - LOCK_ARRAY_GRANULARITY, LOCK_ARRAY_GRANULARITY,
-        spinlock,
-        typename allocator_type::template rebind<spinlock>::other> locks_t;
+    // The type of the locks container. A table replaces its locks_t with a
+    // larger one as it grows, but keeps the old ones allocated until it is
+    // destroyed, since other threads may still be spinning on them.
+    typedef lock_array<allocator_type> locks_t;
+    typedef std::list<locks_t> all_locks_t;
 
     // The type of the expansion lock
     typedef std::mutex expansion_lock_t;
@@ -310,6 +293,41 @@ private:
         }
     };
 
+    // path_counters holds one core's counts of the cuckoo hashing done by
+    // run_cuckoo, cache-aligned like cacheint. Only inserts that find both of
+    // their buckets full touch them. See cuckoo_path_stats for what each one
+    // counts.
+    LIBCUCKOO_SQUELCH_PADDING_WARNING
+    struct LIBCUCKOO_ALIGNAS(64) path_counters {
+        std::atomic<size_t> searches;
+        std::array<std::atomic<size_t>, BFS_PATH_LEN> path_lengths;
+        std::atomic<size_t> bfs_queue_full;
+        std::atomic<size_t> bfs_exhausted;
+        std::atomic<size_t> move_retries;
+        std::atomic<size_t> failure_under_expansion;
+        std::atomic<size_t> table_full;
+
+        path_counters() {
+            clear();
+        }
+
+        void clear() {
+            searches.store(0, std::memory_order_relaxed);
+            for (std::atomic<size_t>& c : path_lengths) {
+                c.store(0, std::memory_order_relaxed);
+            }
+            bfs_queue_full.store(0, std::memory_order_relaxed);
+            bfs_exhausted.store(0, std::memory_order_relaxed);
+            move_retries.store(0, std::memory_order_relaxed);
+            failure_under_expansion.store(0, std::memory_order_relaxed);
+            table_full.store(0, std::memory_order_relaxed);
+        }
+
+        static void bump(std::atomic<size_t>& c) {
+            c.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
     // Helper methods to read and write hashpower_ with the correct memory
     // barriers
     size_t get_hashpower() const {
@@ -320,6 +338,17 @@ private:
         hashpower_.store(val, std::memory_order_release);
     }
 
+    // Helper methods to read and swap the lock stripes currently guarding the
+    // buckets. A new stripe array is only installed while every stripe of the
+    // current one is held.
+    locks_t& get_current_locks() const {
+        return *current_locks_.load(std::memory_order_acquire);
+    }
+
+    void set_current_locks(locks_t* locks) {
+        current_locks_.store(locks, std::memory_order_release);
+    }
+
     // get_counterid returns the counterid for the current thread.
     static inline int get_counterid() {
         // counterid stores the per-thread counter index of each thread. Each
@@ -352,6 +381,33 @@ private:
         return blog2;
     }
 
+    // next_pow2 rounds n up to a power of two
+    static size_t next_pow2(const size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    // locks_for_hashpower returns the number of lock stripes the table should
+    // have at hashpower hp. A requested stripe count is honored once the table
+    // has that many buckets. A self-sized table uses DEFAULT_LOCKS_PER_CORE
+    // stripes per core, or one stripe per DEFAULT_BUCKETS_PER_LOCK buckets if
+    // that is more, doubled once for every time it was found contended.
+    size_t locks_for_hashpower(const size_t hp) const {
+        size_t target;
+        if (num_locks_hint_ != AUTO_NUM_LOCKS) {
+            target = num_locks_hint_;
+        } else {
+            target = std::max(kNumCores() * DEFAULT_LOCKS_PER_CORE,
+                              hashsize(hp) / DEFAULT_BUCKETS_PER_LOCK);
+            target = std::min(target, MAX_NUM_LOCKS) << lock_boost_;
+        }
+        return std::min(next_pow2(std::min(target, MAX_NUM_LOCKS)),
+                        std::min(hashsize(hp), MAX_NUM_LOCKS));
+    }
+
 public:
     /**
      * Creates a new cuckohash_map instance
@@ -361,6 +417,10 @@ public:
      * table allows for automatic expansion.
      * @param mhp the maximum hashpower that the table can take on (pass in 0
      * for no limit)
+     * @param nl the number of lock stripes, rounded up to a power of two and
+     * capped at \ref MAX_NUM_LOCKS (pass in \ref AUTO_NUM_LOCKS to let the
+     * table size and grow them itself)
+     * @param ll the memory layout of the lock stripes
      * @throw std::invalid_argument if the given minimum load factor is invalid,
      * or if the initial space exceeds the maximum hashpower
      */
@@ -368,8 +428,12 @@ public:
                    double mlf = DEFAULT_MINIMUM_LOAD_FACTOR,
                    size_t mhp = NO_MAXIMUM_HASHPOWER,
                    const hasher& hf = hasher(),
-                   const key_equal eql = key_equal())
-        : hash_fn(hf), eq_fn(eql) {
+                   const key_equal eql = key_equal(),
+                   size_t nl = AUTO_NUM_LOCKS,
+                   cuckoo_lock_layout ll = DEFAULT_LOCK_LAYOUT)
+        : num_locks_hint_(nl), lock_layout_(ll), lock_boost_(0),
+          path_counters_(kNumCores()), bfs_path_len_(MAX_BFS_PATH_LEN),
+          hash_fn(hf), eq_fn(eql) {
         minimum_load_factor(mlf);
         maximum_hashpower(mhp);
         size_t hp = reserve_calc(n);
@@ -380,7 +444,11 @@ public:
         }
         set_hashpower(hp);
         buckets_.resize(hashsize(hp));
-        locks_.allocate(std::min(locks_t::size(), hashsize(hp)));
+        all_locks_.emplace_back(locks_for_hashpower(hp), lock_layout_, false);
+        set_current_locks(&all_locks_.back());
+        lock_memory_.store(all_locks_.back().memory());
+        lock_tune_ticks_ = libcuckoo_ticks();
+        lock_tune_wait_cycles_ = 0;
         num_inserts_.resize(kNumCores(), 0);
         num_deletes_.resize(kNumCores(), 0);
     }
@@ -471,11 +539,81 @@ public:
         return maximum_hashpower_.load(std::memory_order_acquire);
     }
 
+    /**
+     * Sets the maximum number of slots in the cuckoo paths inserts search for
+     * when both of their buckets are full. Shorter paths make the search and
+     * the moves cheaper, but make the table expand at a lower load factor.
+     *
+     * @param len the path length to set
+     * @throw std::invalid_argument if the given length is 0 or greater than
+     * \ref max_bfs_path_len
+     */
+    void bfs_path_len(const size_t len) {
+        if (len == 0 || len > MAX_BFS_PATH_LEN) {
+            throw std::invalid_argument(
+                "BFS path length " + std::to_string(len) + " must be between"
+                " 1 and " + std::to_string(MAX_BFS_PATH_LEN));
+        }
+        bfs_path_len_.store(len, std::memory_order_release);
+    }
+
+    /**
+     * @return the maximum number of slots in a cuckoo path
+     */
+    size_t bfs_path_len() const noexcept {
+        return bfs_path_len_.load(std::memory_order_acquire);
+    }
+
+    //! path_stats returns the cuckoo hashing done by inserts since the table
+    //! was created or the stats were last reset, summed over all cores. The
+    //! counters are read without locking, so a snapshot taken while inserts
+    //! are running may be slightly inconsistent.
+    cuckoo_path_stats path_stats() const {
+        cuckoo_path_stats stats = {};
+        stats.path_lengths.resize(MAX_BFS_PATH_LEN, 0);
+        for (const path_counters& pc : path_counters_) {
+            stats.searches += pc.searches.load(std::memory_order_relaxed);
+            for (size_t d = 0; d < MAX_BFS_PATH_LEN; ++d) {
+                stats.path_lengths[d] +=
+                    pc.path_lengths[d].load(std::memory_order_relaxed);
+            }
+            stats.bfs_queue_full +=
+                pc.bfs_queue_full.load(std::memory_order_relaxed);
+            stats.bfs_exhausted +=
+                pc.bfs_exhausted.load(std::memory_order_relaxed);
+            stats.move_retries +=
+                pc.move_retries.load(std::memory_order_relaxed);
+            stats.failure_under_expansion +=
+                pc.failure_under_expansion.load(std::memory_order_relaxed);
+            stats.table_full += pc.table_full.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    //! reset_path_stats sets all the counters reported by \ref path_stats
+    //! back to zero.
+    void reset_path_stats() noexcept {
+        for (path_counters& pc : path_counters_) {
+            pc.clear();
+        }
+    }
+
     //! find searches through the table for \p key, and stores the associated
-    //! value it finds in \p val. must be copy assignable.
+    //! value it finds in \p val. must be copy assignable. \p key may be of
+    //! any type the hasher and key_equal take, such as a \ref string_key_view
+    //! for a table of strings with the default hasher and key_equal.
     template <typename K>
     bool find(const K& key, mapped_type& val) const {
-        size_t hv = hashed_key(key);
+        return find_hashed(hashed_key(key), key, val);
+    }
+
+    //! find_hashed is \ref find for a key whose hash value \p hv the caller
+    //! already computed with \ref hash_function. Debug builds assert that
+    //! \p hv is the hash of \p key. The same goes for the other _hashed
+    //! operations.
+    template <typename K>
+    bool find_hashed(const size_t hv, const K& key, mapped_type& val) const {
+        check_hashed_key(hv, key);
         auto b = snapshot_and_lock_two(hv);
         const cuckoo_status st = cuckoo_find(key, val, hv, b.i[0], b.i[1]);
         return (st == ok);
@@ -486,8 +624,15 @@ public:
     //! exception if the key isn't in the table.
     template <typename K>
     mapped_type find(const K& key) const {
+        return find_hashed(hashed_key(key), key);
+    }
+
+    //! \ref find for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K>
+    mapped_type find_hashed(const size_t hv, const K& key) const {
         mapped_type val;
-        bool done = find(key, val);
+        bool done = find_hashed(hv, key, val);
         if (done) {
             return val;
         } else {
@@ -499,7 +644,14 @@ public:
     //! finds it in the table, and false otherwise.
     template <typename K>
     bool contains(const K& key) const {
-        size_t hv = hashed_key(key);
+        return contains_hashed(hashed_key(key), key);
+    }
+
+    //! \ref contains for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K>
+    bool contains_hashed(const size_t hv, const K& key) const {
+        check_hashed_key(hv, key);
         auto b = snapshot_and_lock_two(hv);
         const bool result = cuckoo_contains(key, hv, b.i[0], b.i[1]);
         return result;
@@ -520,7 +672,17 @@ public:
      */
     template <typename K, typename... Args>
     bool insert(K&& key, Args&&... val) {
-        return cuckoo_insert_loop(hashed_key(key), std::forward<K>(key),
+        const size_t hv = hashed_key(key);
+        return insert_hashed(hv, std::forward<K>(key),
+                             std::forward<Args>(val)...);
+    }
+
+    //! \ref insert for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K, typename... Args>
+    bool insert_hashed(const size_t hv, K&& key, Args&&... val) {
+        check_hashed_key(hv, key);
+        return cuckoo_insert_loop(hv, std::forward<K>(key),
                                   std::forward<Args>(val)...);
     }
 
@@ -529,7 +691,14 @@ public:
     //! it returns true.
     template <typename K>
     bool erase(const K& key) {
-        size_t hv = hashed_key(key);
+        return erase_hashed(hashed_key(key), key);
+    }
+
+    //! \ref erase for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K>
+    bool erase_hashed(const size_t hv, const K& key) {
+        check_hashed_key(hv, key);
         auto b = snapshot_and_lock_two(hv);
         const cuckoo_status st = cuckoo_delete(key, hv, b.i[0], b.i[1]);
         return (st == ok);
@@ -539,7 +708,14 @@ public:
     //! not there, it returns false, otherwise it returns true.
     template <typename K, typename V>
     bool update(const K& key, V&& val) {
-        size_t hv = hashed_key(key);
+        return update_hashed(hashed_key(key), key, std::forward<V>(val));
+    }
+
+    //! \ref update for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K, typename V>
+    bool update_hashed(const size_t hv, const K& key, V&& val) {
+        check_hashed_key(hv, key);
         auto b = snapshot_and_lock_two(hv);
         const cuckoo_status st = cuckoo_update(hv, b.i[0], b.i[1],
                                                key, std::forward<V>(val));
@@ -554,7 +730,17 @@ public:
     typename std::enable_if<
         std::is_convertible<Updater, updater_type>::value,
         bool>::type update_fn(const K& key, Updater fn) {
-        size_t hv = hashed_key(key);
+        return update_fn_hashed(hashed_key(key), key, fn);
+    }
+
+    //! \ref update_fn for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename K,typename Updater>
+    typename std::enable_if<
+        std::is_convertible<Updater, updater_type>::value,
+        bool>::type update_fn_hashed(const size_t hv, const K& key,
+                                     Updater fn) {
+        check_hashed_key(hv, key);
         auto b = snapshot_and_lock_two(hv);
         const cuckoo_status st = cuckoo_update_fn(key, fn, hv, b.i[0], b.i[1]);
         return (st == ok);
@@ -569,7 +755,19 @@ public:
     typename std::enable_if<
         std::is_convertible<Updater, updater_type>::value,
         void>::type upsert(K&& key, Updater fn, Args&&... val) {
-        size_t hv = hashed_key(key);
+        const size_t hv = hashed_key(key);
+        upsert_hashed(hv, std::forward<K>(key), fn,
+                      std::forward<Args>(val)...);
+    }
+
+    //! \ref upsert for a key with a precomputed hash value (see \ref
+    //! find_hashed).
+    template <typename Updater, typename K, typename... Args>
+    typename std::enable_if<
+        std::is_convertible<Updater, updater_type>::value,
+        void>::type upsert_hashed(const size_t hv, K&& key, Updater fn,
+                                  Args&&... val) {
+        check_hashed_key(hv, key);
         cuckoo_status st;
         do {
             auto b = snapshot_and_lock_two(hv);
@@ -637,6 +835,266 @@ public:
         return cuckoo_expand_simple(new_hp, new_hp > hp) == ok;
     }
 
+    /**
+     * Inserts the key-value pairs in [first, last) using several threads. The
+     * table is first grown, if needed, to hold its current and new elements at
+     * a load factor of at most \ref BULK_LOAD_MAXIMUM_LOAD_FACTOR. Then, with
+     * every lock stripe held, the pairs are partitioned by the range of
+     * buckets their first bucket falls in, and each thread stores the pairs
+     * of its own range into a free slot of one of their two buckets, as long
+     * as that bucket is in its range too. This needs no locks and no cuckoo
+     * hashing. The pairs left over are then inserted with \ref insert. Like
+     * insert, bulk_load never overwrites a key already in the table, and it
+     * inserts the first occurrence of a key that appears more than once.
+     *
+     * @param first the start of a random-access range of pairs (or of objects
+     * with a first and a second member) to insert
+     * @param last the end of the range
+     * @param num_threads the number of threads to use (pass in 0 for one per
+     * core)
+     * @return the number of pairs inserted
+     * @throw libcuckoo_maximum_hashpower_exceeded if the table would have to
+     * grow beyond the maximum hashpower
+     */
+    template <typename RandomIt>
+    size_t bulk_load(RandomIt first, RandomIt last, size_t num_threads = 0) {
+        static_assert(
+            std::is_base_of<
+            std::random_access_iterator_tag,
+            typename std::iterator_traits<RandomIt>::iterator_category>::value,
+            "bulk_load needs random-access iterators");
+        const size_t n = static_cast<size_t>(std::distance(first, last));
+        if (n == 0) {
+            return 0;
+        }
+        if (num_threads == 0) {
+            num_threads = kNumCores();
+        }
+        const size_t new_hp = reserve_calc(static_cast<size_t>(
+            (cuckoo_size() + n) / BULK_LOAD_MAXIMUM_LOAD_FACTOR));
+        if (new_hp > get_hashpower()) {
+            cuckoo_expand_simple(new_hp, true);
+        }
+
+        std::vector<std::vector<size_t> > leftovers(num_threads);
+        size_t inserted;
+        {
+            auto unlocker = snapshot_and_lock_all();
+            inserted = bulk_load_owned(first, n, leftovers);
+        }
+
+        // Each thread inserts its own leftovers, in input order, so that the
+        // first occurrence of a key still wins.
+        std::vector<size_t> leftover_inserted(num_threads, 0);
+        parallel_exec(
+            0, num_threads, num_threads,
+            [this, first, &leftovers, &leftover_inserted]
+            (size_t t, size_t, std::exception_ptr& eptr) {
+                try {
+                    for (const size_t i : leftovers[t]) {
+                        if (insert(first[i].first, first[i].second)) {
+                            ++leftover_inserted[t];
+                        }
+                    }
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+            });
+        for (const size_t c : leftover_inserted) {
+            inserted += c;
+        }
+        return inserted;
+    }
+
+    /**
+     * Inserts the elements of a snapshot written by \ref
+     * locked_table::write_snapshot. The table is first grown, if needed, to
+     * hold its current and new elements at a load factor of at most \ref
+     * BULK_LOAD_MAXIMUM_LOAD_FACTOR. Then the parts of the file are read by
+     * several threads, each through its own stream, and inserted with \ref
+     * insert as they are read, so the table can be used while it is being
+     * loaded. Keys already in the table are not overwritten.
+     *
+     * @param path the snapshot file to read
+     * @param num_threads the number of threads to use (pass in 0 for one per
+     * core)
+     * @return the number of elements inserted
+     * @throw std::runtime_error if the file could not be read, or was not
+     * written by a table with the same key and value sizes
+     * @throw libcuckoo_maximum_hashpower_exceeded if the table would have to
+     * grow beyond the maximum hashpower
+     */
+    size_t load_snapshot(const std::string& path, size_t num_threads = 0) {
+        check_snapshot_types();
+        std::vector<uint64_t> counts;
+        {
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            const std::streamoff file_size = in.tellg();
+            in.seekg(0);
+            snapshot_header h;
+            in.read(reinterpret_cast<char*>(&h), sizeof(h));
+            const snapshot_header expected = make_snapshot_header(0);
+            if (!in || std::memcmp(h.magic, expected.magic,
+                                   sizeof(h.magic)) != 0) {
+                throw snapshot_error(path, "not a snapshot file");
+            }
+            if (h.version != expected.version ||
+                h.key_size != expected.key_size ||
+                h.mapped_size != expected.mapped_size) {
+                throw snapshot_error(path, "written for another table type");
+            }
+            // Every count, and every element it announces, must fit in the
+            // file, so a corrupt header cannot size the allocations below
+            uint64_t left = static_cast<uint64_t>(file_size) - sizeof(h);
+            if (h.num_parts > left / sizeof(uint64_t)) {
+                throw snapshot_error(path, "truncated header");
+            }
+            counts.resize(static_cast<size_t>(h.num_parts));
+            in.read(reinterpret_cast<char*>(counts.data()),
+                    static_cast<std::streamsize>(
+                        counts.size() * sizeof(uint64_t)));
+            if (!in) {
+                throw snapshot_error(path, "truncated header");
+            }
+            left -= counts.size() * sizeof(uint64_t);
+            for (size_t p = 0; p < counts.size(); ++p) {
+                if (counts[p] > left / SNAPSHOT_RECORD_SIZE) {
+                    throw snapshot_error(
+                        path, "truncated part " + std::to_string(p));
+                }
+                left -= counts[p] * SNAPSHOT_RECORD_SIZE;
+            }
+        }
+        uint64_t total = 0;
+        for (const uint64_t c : counts) {
+            total += c;
+        }
+        if (total == 0) {
+            return 0;
+        }
+        if (num_threads == 0) {
+            num_threads = kNumCores();
+        }
+        num_threads = std::min(num_threads, counts.size());
+        const size_t new_hp = reserve_calc(static_cast<size_t>(
+            (cuckoo_size() + total) / BULK_LOAD_MAXIMUM_LOAD_FACTOR));
+        if (new_hp > get_hashpower()) {
+            cuckoo_expand_simple(new_hp, true);
+        }
+
+        // Thread t reads parts t, t + num_threads, ...
+        const std::vector<uint64_t> offsets = snapshot_offsets(counts);
+        std::vector<size_t> inserted(num_threads, 0);
+        parallel_exec(
+            0, num_threads, num_threads,
+            [this, &path, &counts, &offsets, &inserted, num_threads]
+            (size_t t, size_t, std::exception_ptr& eptr) {
+                try {
+                    std::ifstream in(path, std::ios::binary);
+                    std::vector<char> buf(SNAPSHOT_BUFFER_SIZE /
+                                          SNAPSHOT_RECORD_SIZE *
+                                          SNAPSHOT_RECORD_SIZE +
+                                          SNAPSHOT_RECORD_SIZE);
+                    const uint64_t per_buf = buf.size() / SNAPSHOT_RECORD_SIZE;
+                    for (size_t p = t; p < counts.size(); p += num_threads) {
+                        in.seekg(static_cast<std::streamoff>(offsets[p]));
+                        for (uint64_t left = counts[p]; left > 0;) {
+                            const uint64_t n = std::min(left, per_buf);
+                            in.read(buf.data(), static_cast<std::streamsize>(
+                                        n * SNAPSHOT_RECORD_SIZE));
+                            if (!in) {
+                                throw snapshot_error(
+                                    path, "truncated part " +
+                                    std::to_string(p));
+                            }
+                            const char* rec = buf.data();
+                            for (uint64_t r = 0; r < n; ++r) {
+                                key_type k;
+                                mapped_type v;
+                                std::memcpy(&k, rec, sizeof(key_type));
+                                std::memcpy(&v, rec + sizeof(key_type),
+                                            sizeof(mapped_type));
+                                rec += SNAPSHOT_RECORD_SIZE;
+                                if (insert(k, v)) {
+                                    ++inserted[t];
+                                }
+                            }
+                            left -= n;
+                        }
+                    }
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+            });
+        size_t total_inserted = 0;
+        for (const size_t c : inserted) {
+            total_inserted += c;
+        }
+        return total_inserted;
+    }
+
+    //! lock_count returns the number of lock stripes currently guarding the
+    //! table.
+    size_t lock_count() const noexcept {
+        return get_current_locks().size();
+    }
+
+    //! lock_layout returns the memory layout of the table's lock stripes.
+    cuckoo_lock_layout lock_layout() const noexcept {
+        return lock_layout_;
+    }
+
+    //! lock_memory returns the number of bytes allocated for lock stripes and
+    //! their wait counters, including stripe arrays that were outgrown but
+    //! are kept until the table is destroyed.
+    size_t lock_memory() const noexcept {
+        return lock_memory_.load(std::memory_order_relaxed);
+    }
+
+    //! stale_lock_memory returns the part of \ref lock_memory in stripe
+    //! arrays that were outgrown, and that no thread locks any more.
+    size_t stale_lock_memory() const noexcept {
+        return lock_memory() - get_current_locks().memory();
+    }
+
+    //! bucket_memory returns the number of bytes allocated for the buckets,
+    //! which hold the keys and values in place.
+    size_t bucket_memory() const noexcept {
+        return buckets_.capacity() * sizeof(Bucket);
+    }
+
+    //! lock_stats returns the wait counters of the current lock stripes, one
+    //! entry per group of \ref lock_stripes_per_stat consecutive stripes. The
+    //! counters start over whenever the stripes are resized.
+    std::vector<lock_stripe_stats> lock_stats() const {
+        std::vector<lock_stripe_stats> stats;
+        get_current_locks().stats(std::back_inserter(stats));
+        return stats;
+    }
+
+    //! lock_stripes_per_stat returns the number of consecutive stripes whose
+    //! waits are counted together in \ref lock_stats: one in the padded
+    //! layout, and a cache line's worth in the compact layout.
+    size_t lock_stripes_per_stat() const noexcept {
+        return get_current_locks().stripes_per_group();
+    }
+
+    /**
+     * Doubles the lock stripes of a self-sized table if waiting on them has
+     * taken more than \ref LOCK_CONTENTION_THRESHOLD of the threads' time since
+     * they were last resized. Expansions do this automatically, so it only
+     * needs calling, periodically, on tables that stop growing.
+     *
+     * @return true if the number of stripes changed, false otherwise
+     */
+    bool rebalance_locks() {
+        std::lock_guard<expansion_lock_t> l(expansion_lock_);
+        auto unlocker = snapshot_and_lock_all();
+        const size_t nl = get_current_locks().size();
+        maybe_resize_locks(get_hashpower());
+        return get_current_locks().size() != nl;
+    }
+
     //! hash_function returns the hash function object used by the table.
     hasher hash_function() const noexcept {
         return hash_fn;
@@ -710,33 +1168,38 @@ private:
         }
 
     private:
-        // unlocks the given bucket index.
+        // unlocks the given bucket index. The stripes cannot have been
+        // replaced while we hold one of them, so the current ones are the ones
+        // we locked.
         void unlock(std::array<size_t, 1> inds) const {
-            map->locks_[lock_ind(inds[0])].unlock();
+            locks_t& locks = map->get_current_locks();
+            locks.unlock(lock_ind(locks, inds[0]));
         }
 
         // unlocks both of the given bucket indexes, or only one if they are
         // equal. Order doesn't matter here.
         void unlock(std::array<size_t, 2> inds) const {
-            const size_t l0 = lock_ind(inds[0]);
-            const size_t l1 = lock_ind(inds[1]);
-            map->locks_[l0].unlock();
+            locks_t& locks = map->get_current_locks();
+            const size_t l0 = lock_ind(locks, inds[0]);
+            const size_t l1 = lock_ind(locks, inds[1]);
+            locks.unlock(l0);
             if (l0 != l1) {
-                map->locks_[l1].unlock();
+                locks.unlock(l1);
             }
         }
 
         // unlocks the three given buckets
         void unlock(std::array<size_t, 3> inds) const {
-            const size_t l0 = lock_ind(inds[0]);
-            const size_t l1 = lock_ind(inds[1]);
-            const size_t l2 = lock_ind(inds[2]);
-            map->locks_[l0].unlock();
+            locks_t& locks = map->get_current_locks();
+            const size_t l0 = lock_ind(locks, inds[0]);
+            const size_t l1 = lock_ind(locks, inds[1]);
+            const size_t l2 = lock_ind(locks, inds[2]);
+            locks.unlock(l0);
             if (l1 != l0) {
-                map->locks_[l1].unlock();
+                locks.unlock(l1);
             }
             if (l2 != l0 && l2 != l1) {
-                map->locks_[l2].unlock();
+                locks.unlock(l2);
             }
         }
     };
@@ -746,16 +1209,17 @@ private:
     typedef BucketContainer<3> ThreeBuckets;
 
     // This exception is thrown whenever we try to lock a bucket, but the
-    // hashpower is not what was expected
+    // hashpower or the lock stripes are not what was expected
     class hashpower_changed {};
 
     // After taking a lock on the table for the given bucket, this function will
     // check the hashpower to make sure it is the same as what it was before the
-    // lock was taken. If it isn't unlock the bucket and throw a
-    // hashpower_changed exception.
-    inline void check_hashpower(const size_t hp, const size_t lock) const {
-        if (get_hashpower() != hp) {
-            locks_[lock].unlock();
+    // lock was taken, and that the stripes we locked are still the current
+    // ones. If not, unlock the bucket and throw a hashpower_changed exception.
+    inline void check_hashpower(const size_t hp, locks_t& locks,
+                                const size_t lock) const {
+        if (get_hashpower() != hp || &get_current_locks() != &locks) {
+            locks.unlock(lock);
             LIBCUCKOO_DBG("%s", "hashpower changed\n");
             throw hashpower_changed();
         }
@@ -765,9 +1229,10 @@ private:
     //
     // throws hashpower_changed if it changed after taking the lock.
     inline OneBucket lock_one(const size_t hp, const size_t i) const {
-        const size_t l = lock_ind(i);
-        locks_[l].lock();
-        check_hashpower(hp, l);
+        locks_t& locks = get_current_locks();
+        const size_t l = lock_ind(locks, i);
+        locks.lock(l);
+        check_hashpower(hp, locks, l);
         return OneBucket{this, i};
     }
 
@@ -777,15 +1242,16 @@ private:
     // throws hashpower_changed if it changed after taking the lock.
     TwoBuckets lock_two(const size_t hp, const size_t i1,
                         const size_t i2) const {
-        size_t l1 = lock_ind(i1);
-        size_t l2 = lock_ind(i2);
+        locks_t& locks = get_current_locks();
+        size_t l1 = lock_ind(locks, i1);
+        size_t l2 = lock_ind(locks, i2);
         if (l2 < l1) {
             std::swap(l1, l2);
         }
-        locks_[l1].lock();
-        check_hashpower(hp, l1);
+        locks.lock(l1);
+        check_hashpower(hp, locks, l1);
         if (l2 != l1) {
-            locks_[l2].lock();
+            locks.lock(l2);
         }
         return TwoBuckets{this, i1, i2};
     }
@@ -798,22 +1264,24 @@ private:
     std::pair<TwoBuckets, OneBucket>
     lock_three(const size_t hp, const size_t i1,
                const size_t i2, const size_t i3) const {
+        locks_t& locks = get_current_locks();
         std::array<size_t, 3> l{{
-                lock_ind(i1), lock_ind(i2), lock_ind(i3)}};
+                lock_ind(locks, i1), lock_ind(locks, i2),
+                lock_ind(locks, i3)}};
         std::sort(l.begin(), l.end());
-        locks_[l[0]].lock();
-        check_hashpower(hp, l[0]);
+        locks.lock(l[0]);
+        check_hashpower(hp, locks, l[0]);
         if (l[1] != l[0]) {
-            locks_[l[1]].lock();
+            locks.lock(l[1]);
         }
         if (l[2] != l[1]) {
-            locks_[l[2]].lock();
+            locks.lock(l[2]);
         }
         return std::make_pair(
             TwoBuckets{this, i1, i2},
             OneBucket{
-                (lock_ind(i3) == lock_ind(i1) ||
-                 lock_ind(i3) == lock_ind(i2)) ?
+                (lock_ind(locks, i3) == lock_ind(locks, i1) ||
+                 lock_ind(locks, i3) == lock_ind(locks, i2)) ?
                     nullptr : this, i3});
     }
 
@@ -834,39 +1302,54 @@ private:
                 return lock_two(hp, i1, i2);
             } catch (hashpower_changed&) {
                 // The hashpower changed while taking the locks. Try again.
+                RETRY_STAT_INC(HASHPOWER_RETRY);
                 continue;
             }
         }
     }
 
     // A resource manager which releases all the locks upon destruction. It can
-    // only be moved, not copied.
+    // only be moved, not copied. Besides the stripes that were locked, it
+    // releases every stripe array installed after them, since those are
+    // created locked.
     class AllUnlocker {
     private:
         // If nullptr, do nothing
-        locks_t* locks_;
+        all_locks_t* all_locks_;
+        // The first stripe array that was locked
+        locks_t* first_;
     public:
-        AllUnlocker(locks_t* locks): locks_(locks) {}
+        AllUnlocker(all_locks_t* all_locks, locks_t* first)
+            : all_locks_(all_locks), first_(first) {}
 
         AllUnlocker(const AllUnlocker&) = delete;
-        AllUnlocker(AllUnlocker&& au) : locks_(au.locks_) {
-            au.locks_ = nullptr;
+        AllUnlocker(AllUnlocker&& au)
+            : all_locks_(au.all_locks_), first_(au.first_) {
+            au.all_locks_ = nullptr;
         }
 
         AllUnlocker& operator=(const AllUnlocker&) = delete;
         AllUnlocker& operator=(AllUnlocker&& au) {
-            locks_ = au.locks_;
-            au.locks_ = nullptr;
+            all_locks_ = au.all_locks_;
+            first_ = au.first_;
+            au.all_locks_ = nullptr;
+            return *this;
         }
 
         void deactivate() {
-            locks_ = nullptr;
+            all_locks_ = nullptr;
         }
 
         void release() {
-            if (locks_) {
-                for (size_t i = 0; i < locks_->allocated_size(); ++i) {
-                    (*locks_)[i].unlock();
+            if (all_locks_) {
+                auto it = all_locks_->begin();
+                while (&*it != first_) {
+                    ++it;
+                }
+                for (; it != all_locks_->end(); ++it) {
+                    for (size_t i = 0; i < it->size(); ++i) {
+                        it->unlock(i);
+                    }
                 }
                 deactivate();
             }
@@ -880,17 +1363,64 @@ private:
     // snapshot_and_lock_all takes all the locks, and returns a deleter object,
     // that releases the locks upon destruction. Note that after taking all the
     // locks, it is okay to change the buckets_ vector and the hashpower_, since
-    // no other threads should be accessing the buckets.
+    // no other threads should be accessing the buckets. If the stripes are
+    // replaced while we are taking them, we let them go and start over on the
+    // new ones.
     AllUnlocker snapshot_and_lock_all() const noexcept {
-        for (size_t i = 0; i < locks_.allocated_size(); ++i) {
-            locks_[i].lock();
+        while (true) {
+            locks_t& locks = get_current_locks();
+            for (size_t i = 0; i < locks.size(); ++i) {
+                locks.lock(i);
+            }
+            if (&get_current_locks() == &locks) {
+                return AllUnlocker(&all_locks_, &locks);
+            }
+            for (size_t i = 0; i < locks.size(); ++i) {
+                locks.unlock(i);
+            }
         }
-        return AllUnlocker(&locks_);
+    }
+
+    // maybe_resize_locks grows the lock stripes to what the table should have
+    // at hashpower hp. For a self-sized table it first checks how much of the
+    // threads' time went into waiting on the stripes since they were last
+    // resized, and doubles the target if that is above
+    // LOCK_CONTENTION_THRESHOLD. The caller must hold every current stripe.
+    // The new stripes are installed locked, and are released along with the
+    // old ones by the caller's AllUnlocker. The old stripes stay allocated,
+    // since threads may still be spinning on them; whoever gets one will fail
+    // check_hashpower and retry on the new stripes.
+    void maybe_resize_locks(const size_t hp) {
+        locks_t& current = get_current_locks();
+        const uint64_t now = libcuckoo_ticks();
+        const size_t waited = current.wait_cycles() - lock_tune_wait_cycles_;
+        const double elapsed = static_cast<double>(now - lock_tune_ticks_);
+        if (num_locks_hint_ == AUTO_NUM_LOCKS &&
+            locks_for_hashpower(hp) <
+                std::min(hashsize(hp), MAX_NUM_LOCKS) &&
+            waited > LOCK_CONTENTION_THRESHOLD * elapsed * kNumCores()) {
+            LIBCUCKOO_DBG("lock stripes contended (%zu of %.0f cycles)\n",
+                          waited, elapsed * kNumCores());
+            ++lock_boost_;
+        }
+        lock_tune_ticks_ = now;
+        lock_tune_wait_cycles_ = current.wait_cycles();
+
+        const size_t nl = locks_for_hashpower(hp);
+        if (nl <= current.size()) {
+            return;
+        }
+        all_locks_.emplace_back(nl, lock_layout_, true);
+        lock_memory_.fetch_add(all_locks_.back().memory(),
+                               std::memory_order_relaxed);
+        set_current_locks(&all_locks_.back());
+        lock_tune_wait_cycles_ = 0;
     }
 
     // lock_ind converts an index into buckets to an index into locks.
-    static inline size_t lock_ind(const size_t bucket_ind) {
-        return bucket_ind & (kNumLocks - 1);
+    static inline size_t lock_ind(const locks_t& locks,
+                                  const size_t bucket_ind) {
+        return bucket_ind & (locks.size() - 1);
     }
 
     // hashsize returns the number of buckets corresponding to a given
@@ -911,6 +1441,15 @@ private:
         return hash_function()(key);
     }
 
+    // check_hashed_key asserts that hv is the hash value of key, for the
+    // _hashed operations. It compiles to nothing when NDEBUG is defined.
+    template <typename K>
+    void check_hashed_key(const size_t hv, const K& key) const {
+        (void)hv;
+        (void)key;
+        assert(hv == hashed_key(key));
+    }
+
     // index_hash returns the first possible bucket that the given hashed key
     // could be.
     static inline size_t index_hash(const size_t hp, const size_t hv) {
@@ -945,7 +1484,9 @@ private:
     }
 
     // The maximum number of items in a BFS path.
-    static const uint8_t MAX_BFS_PATH_LEN = 5;
+    static const size_t MAX_BFS_PATH_LEN = BFS_PATH_LEN;
+    static_assert(MAX_BFS_PATH_LEN >= 1,
+                  "A cuckoo path must hold at least one slot");
 
     // CuckooRecord holds one position in a cuckoo path. Since cuckoopath
     // elements only define a sequence of alternate hashings for different hash
@@ -977,7 +1518,8 @@ private:
         // be less than MAX_BFS_PATH_LEN, and also able to hold negative values.
         int_fast8_t depth;
         static_assert(MAX_BFS_PATH_LEN - 1 <=
-                      std::numeric_limits<decltype(depth)>::max(),
+                      static_cast<size_t>(
+                          std::numeric_limits<decltype(depth)>::max()),
                       "The depth type must able to hold a value of"
                       " MAX_BFS_PATH_LEN - 1");
         static_assert(-1 >= std::numeric_limits<decltype(depth)>::min(),
@@ -985,7 +1527,7 @@ private:
         b_slot() {}
         b_slot(const size_t b, const size_t p, const decltype(depth) d)
             : bucket(b), pathcode(p), depth(d) {
-            assert(d < MAX_BFS_PATH_LEN);
+            assert(d < static_cast<int>(MAX_BFS_PATH_LEN));
         }
     };
     #pragma pack(pop)
@@ -1039,12 +1581,16 @@ private:
 
     // slot_search searches for a cuckoo path using breadth-first search. It
     // starts with the i1 and i2 buckets, and, until it finds a bucket with an
-    // empty slot, adds each slot of the bucket in the b_slot. If the queue runs
-    // out of space, it fails.
+    // empty slot, adds each slot of the bucket in the b_slot. Paths are at most
+    // bfs_path_len() slots long. If the queue runs out of space, or every path
+    // of that length has been tried, it fails, and counts which of the two
+    // happened in the given counters.
     //
     // throws hashpower_changed if it changed during the search
     b_slot slot_search(const size_t hp, const size_t i1,
-                       const size_t i2) {
+                       const size_t i2, path_counters& pc) {
+        const int max_depth = static_cast<int>(
+            bfs_path_len_.load(std::memory_order_relaxed)) - 1;
         b_queue q;
         // The initial pathcode informs cuckoopath_search which bucket the path
         // starts on
@@ -1069,15 +1615,22 @@ private:
                 // create a new b_slot item, that represents the bucket we would
                 // have come from if we kicked out the item at this slot.
                 const partial_t partial = b.partial(slot);
-                if (x.depth < MAX_BFS_PATH_LEN - 1) {
+                if (x.depth < max_depth) {
                     b_slot y(alt_index(hp, partial, x.bucket),
                              x.pathcode * slot_per_bucket + slot, x.depth+1);
                     q.enqueue(y);
                 }
             }
         }
-        // We didn't find a short-enough cuckoo path, so the queue ran out of
-        // space. Return a failure value.
+        // We didn't find a short-enough cuckoo path, either because the queue
+        // ran out of space or because there are no more paths within the
+        // depth limit. Return a failure value.
+        if (q.full()) {
+            path_counters::bump(pc.bfs_queue_full);
+        } else {
+            path_counters::bump(pc.bfs_exhausted);
+        }
+        RETRY_STAT_INC(BFS_FAIL);
         return b_slot(0, 0, -1);
     }
 
@@ -1091,8 +1644,9 @@ private:
     // throws hashpower_changed if it changed during the search
     int cuckoopath_search(const size_t hp,
                           CuckooRecords& cuckoo_path,
-                          const size_t i1, const size_t i2) {
-        b_slot x = slot_search(hp, i1, i2);
+                          const size_t i1, const size_t i2,
+                          path_counters& pc) {
+        b_slot x = slot_search(hp, i1, i2, pc);
         if (x.depth == -1) {
             return -1;
         }
@@ -1206,6 +1760,7 @@ private:
             }
 
             Bucket::move_to_bucket(fb, fs, tb, ts);
+            RETRY_STAT_INC(DISPLACE);
             if (depth == 1) {
                 // Hold onto the locks contained in twob
                 b = std::move(twob);
@@ -1246,29 +1801,38 @@ private:
         assert(b.is_active());
         b.release();
         CuckooRecords cuckoo_path;
+        path_counters& pc = path_counters_[get_counterid()];
+        path_counters::bump(pc.searches);
         bool done = false;
         try {
             while (!done) {
-                int depth = cuckoopath_search(hp, cuckoo_path, b.i[0], b.i[1]);
+                int depth = cuckoopath_search(hp, cuckoo_path, b.i[0], b.i[1],
+                                              pc);
                 if (depth < 0) {
                     break;
                 }
 
                 if (cuckoopath_move(hp, cuckoo_path, depth, b)) {
+                    path_counters::bump(pc.path_lengths[depth]);
                     insert_bucket = cuckoo_path[0].bucket;
                     insert_slot = cuckoo_path[0].slot;
                     assert(insert_bucket == b.i[0] || insert_bucket == b.i[1]);
-                    assert(!locks_[lock_ind(b.i[0])].try_lock());
-                    assert(!locks_[lock_ind(b.i[1])].try_lock());
+                    assert(!get_current_locks().try_lock(
+                               lock_ind(get_current_locks(), b.i[0])));
+                    assert(!get_current_locks().try_lock(
+                               lock_ind(get_current_locks(), b.i[1])));
                     assert(!buckets_[insert_bucket].occupied(insert_slot));
                     done = true;
                     break;
                 }
+                path_counters::bump(pc.move_retries);
             }
         } catch (hashpower_changed&) {
             // The hashpower changed while we were trying to cuckoo, which means
             // we want to retry. b.i[0] and b.i[1] should not be locked in this
             // case.
+            path_counters::bump(pc.failure_under_expansion);
+            RETRY_STAT_INC(HASHPOWER_RETRY);
             return failure_under_expansion;
         }
         return done ? ok : failure;
@@ -1498,8 +2062,10 @@ private:
             // to try again by returning failure_under_expansion.
             return failure_under_expansion;
         } else if (st == ok) {
-            assert(!locks_[lock_ind(b.i[0])].try_lock());
-            assert(!locks_[lock_ind(b.i[1])].try_lock());
+            assert(!get_current_locks().try_lock(
+                       lock_ind(get_current_locks(), b.i[0])));
+            assert(!get_current_locks().try_lock(
+                       lock_ind(get_current_locks(), b.i[1])));
             assert(!buckets_[insert_bucket].occupied(insert_slot));
             assert(insert_bucket == index_hash(get_hashpower(), hv) ||
                    insert_bucket == alt_index(get_hashpower(), partial,
@@ -1519,6 +2085,7 @@ private:
                       "load factor = %.2f), need to increase hashpower\n",
                       get_hashpower(), cuckoo_size(),
                       cuckoo_loadfactor(get_hashpower()));
+        path_counters::bump(path_counters_[get_counterid()].table_full);
         return failure_table_full;
     }
 
@@ -1639,10 +2206,11 @@ private:
 
     void move_buckets(size_t current_hp, size_t new_hp,
                       size_t start_lock_ind, size_t end_lock_ind) {
+        locks_t& locks = get_current_locks();
         for (; start_lock_ind < end_lock_ind; ++start_lock_ind) {
             for (size_t bucket_i = start_lock_ind;
                  bucket_i < hashsize(current_hp);
-                 bucket_i += locks_t::size()) {
+                 bucket_i += locks.size()) {
                 // By doubling the table size, the index_hash and alt_index of
                 // each key got one bit added to the top, at position
                 // current_hp, which means anything we have to move will either
@@ -1682,7 +2250,7 @@ private:
             }
             // Now we can unlock the lock, because all the buckets corresponding
             // to it have been unlocked
-            locks_[start_lock_ind].unlock();
+            locks.unlock(start_lock_ind);
         }
     }
 
@@ -1710,11 +2278,21 @@ private:
             return failure_under_expansion;
         }
 
-        locks_.allocate(std::min(locks_t::size(), hashsize(new_hp)));
         auto unlocker = snapshot_and_lock_all();
+        locks_t& old_locks = get_current_locks();
         buckets_.resize(buckets_.size() * 2);
+        maybe_resize_locks(new_hp);
         set_hashpower(new_hp);
 
+        // If the stripes grew, the old ones can go right away: with the
+        // hashpower changed, anyone who takes one of them will retry.
+        locks_t& locks = get_current_locks();
+        if (&locks != &old_locks) {
+            for (size_t i = 0; i < old_locks.size(); ++i) {
+                old_locks.unlock(i);
+            }
+        }
+
         // We gradually unlock the new table, by processing each of the buckets
         // corresponding to each lock we took. For each slot in an old bucket,
         // we either leave it in the old bucket, or move it to the corresponding
@@ -1723,7 +2301,7 @@ private:
         // gradually. We only unlock the locks being used by the old table,
         // because unlocking new locks would enable operations on the table
         // before we want them.
-        const size_t locks_to_move = std::min(locks_t::size(),
+        const size_t locks_to_move = std::min(locks.size(),
                                               hashsize(current_hp));
         parallel_exec(0, locks_to_move, kNumCores(),
                       [this, current_hp, new_hp]
@@ -1734,10 +2312,10 @@ private:
                               eptr = std::current_exception();
                           }
                       });
-        parallel_exec(locks_to_move, locks_.allocated_size(), kNumCores(),
-                      [this](size_t i, size_t end, std::exception_ptr&) {
+        parallel_exec(locks_to_move, locks.size(), kNumCores(),
+                      [&locks](size_t i, size_t end, std::exception_ptr&) {
                           for (; i < end; ++i) {
-                              locks_[i].unlock();
+                              locks.unlock(i);
                           }
                       });
         // Since we've unlocked the buckets ourselves, we don't need the
@@ -1773,8 +2351,11 @@ private:
 
         // Creates a new hash table with hashpower new_hp and adds all
         // the elements from the old buckets
-        cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket> new_map(
-            hashsize(new_hp) * slot_per_bucket);
+        cuckoohash_map<Key, T, Hash, Pred, Alloc, slot_per_bucket,
+                       max_bfs_path_len> new_map(
+            hashsize(new_hp) * slot_per_bucket, DEFAULT_MINIMUM_LOAD_FACTOR,
+            NO_MAXIMUM_HASHPOWER, hash_fn, eq_fn, num_locks_hint_, lock_layout_);
+        new_map.bfs_path_len(bfs_path_len());
         parallel_exec(
             0, hashsize(hp), kNumCores(),
             [this, &new_map]
@@ -1801,10 +2382,201 @@ private:
         // deleted when new_map is deleted. All the locks should be released by
         // the unlocker as well.
         std::swap(buckets_, new_map.buckets_);
+        maybe_resize_locks(new_map.hashpower_);
         set_hashpower(new_map.hashpower_);
         return ok;
     }
 
+    // bulk_load_owned places the n pairs starting at first into the table,
+    // using one thread per element of leftovers. The caller must hold every
+    // lock stripe. Thread t owns the buckets [t * 2^hp / T, (t + 1) * 2^hp /
+    // T), and takes the pairs whose first bucket it owns. It stores each one
+    // in a free slot of its first bucket, or of its second if it owns that
+    // one too, and otherwise adds it to leftovers[t]. Since no thread reads or
+    // writes a bucket it doesn't own, none of this needs locks. Pairs whose
+    // key is already in the table are dropped in the first pass, while every
+    // bucket is still only being read. Returns the number of pairs placed.
+    template <typename RandomIt>
+    size_t bulk_load_owned(RandomIt first, const size_t n,
+                           std::vector<std::vector<size_t> >& leftovers) {
+        const size_t num_threads = leftovers.size();
+        const size_t hp = get_hashpower();
+        const bool check_existing = cuckoo_size() > 0;
+        auto owner = [hp, num_threads](size_t bucket) {
+            return (bucket * num_threads) >> hp;
+        };
+        // The input chunk of thread t is [n * t / T, n * (t + 1) / T).
+        // counts[t * (T + 1) + o] first counts the pairs in chunk t owned by
+        // o, where o == T stands for the dropped pairs, and then holds where
+        // they go in order, so that each owner's pairs are contiguous and in
+        // input order.
+        std::vector<size_t> hvs(n);
+        std::vector<uint8_t> dropped(check_existing ? n : 0, 0);
+        std::vector<size_t> order(n);
+        std::vector<size_t> counts(num_threads * (num_threads + 1), 0);
+        std::vector<size_t> placed(num_threads, 0);
+
+        parallel_exec(
+            0, num_threads, num_threads,
+            [&](size_t t, size_t, std::exception_ptr& eptr) {
+                try {
+                    size_t* my_counts = &counts[t * (num_threads + 1)];
+                    const size_t end = n * (t + 1) / num_threads;
+                    for (size_t i = n * t / num_threads; i < end; ++i) {
+                        const size_t hv = hashed_key(first[i].first);
+                        const size_t i1 = index_hash(hp, hv);
+                        hvs[i] = hv;
+                        if (check_existing &&
+                            cuckoo_contains(first[i].first, hv, i1,
+                                            alt_index(hp, partial_key(hv),
+                                                      i1))) {
+                            dropped[i] = 1;
+                            ++my_counts[num_threads];
+                        } else {
+                            ++my_counts[owner(i1)];
+                        }
+                    }
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+            });
+
+        std::vector<size_t> owner_start(num_threads + 1);
+        size_t offset = 0;
+        for (size_t o = 0; o < num_threads; ++o) {
+            owner_start[o] = offset;
+            for (size_t t = 0; t < num_threads; ++t) {
+                size_t& c = counts[t * (num_threads + 1) + o];
+                const size_t count = c;
+                c = offset;
+                offset += count;
+            }
+        }
+        owner_start[num_threads] = offset;
+
+        parallel_exec(
+            0, num_threads, num_threads,
+            [&](size_t t, size_t, std::exception_ptr&) {
+                size_t* my_counts = &counts[t * (num_threads + 1)];
+                const size_t end = n * (t + 1) / num_threads;
+                for (size_t i = n * t / num_threads; i < end; ++i) {
+                    if (check_existing && dropped[i]) {
+                        continue;
+                    }
+                    order[my_counts[owner(index_hash(hp, hvs[i]))]++] = i;
+                }
+            });
+
+        parallel_exec(
+            0, num_threads, num_threads,
+            [&](size_t t, size_t, std::exception_ptr& eptr) {
+                try {
+                    for (size_t j = owner_start[t]; j < owner_start[t + 1];
+                         ++j) {
+                        const size_t i = order[j];
+                        const size_t hv = hvs[i];
+                        const partial_t partial = partial_key(hv);
+                        const size_t i1 = index_hash(hp, hv);
+                        const size_t i2 = alt_index(hp, partial, i1);
+                        const bool own_i2 = owner(i2) == t;
+                        int res1, res2 = -1;
+                        if (!try_find_insert_bucket(partial, first[i].first,
+                                                    buckets_[i1], res1)) {
+                            continue;
+                        }
+                        if (own_i2 &&
+                            !try_find_insert_bucket(partial, first[i].first,
+                                                    buckets_[i2], res2)) {
+                            continue;
+                        }
+                        Bucket* b = nullptr;
+                        int slot = -1;
+                        if (res1 != -1) {
+                            b = &buckets_[i1];
+                            slot = res1;
+                        } else if (res2 != -1) {
+                            b = &buckets_[i2];
+                            slot = res2;
+                        } else {
+                            leftovers[t].push_back(i);
+                            continue;
+                        }
+                        b->partial(slot) = partial;
+                        b->setKV(slot, first[i].first, first[i].second);
+                        ++placed[t];
+                    }
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+                num_inserts_[get_counterid()].num.fetch_add(
+                    placed[t], std::memory_order_relaxed);
+            });
+
+        size_t total = 0;
+        for (const size_t p : placed) {
+            total += p;
+        }
+        return total;
+    }
+
+    // A snapshot file starts with a snapshot_header, followed by num_parts
+    // uint64_t element counts, one per bucket range, followed by the elements
+    // of each range in order. Each element is stored as the raw bytes of its
+    // key followed by the raw bytes of its value, in the byte order of the
+    // machine that wrote it.
+    struct snapshot_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t key_size;
+        uint32_t mapped_size;
+        uint32_t reserved;
+        uint64_t num_parts;
+    };
+
+    static constexpr const char* SNAPSHOT_MAGIC = "LCKSNAP";
+    static const uint32_t SNAPSHOT_VERSION = 1;
+    // The number of bytes each thread buffers between reads and writes of a
+    // snapshot file
+    static const size_t SNAPSHOT_BUFFER_SIZE = 1UL << 20;
+    static const size_t SNAPSHOT_RECORD_SIZE =
+        sizeof(key_type) + sizeof(mapped_type);
+
+    static void check_snapshot_types() {
+        static_assert(std::is_trivially_copyable<key_type>::value &&
+                      std::is_trivially_copyable<mapped_type>::value,
+                      "snapshots need trivially copyable keys and values");
+    }
+
+    static snapshot_header make_snapshot_header(const size_t num_parts) {
+        snapshot_header h;
+        std::memset(&h, 0, sizeof(h));
+        std::strncpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+        h.version = SNAPSHOT_VERSION;
+        h.key_size = static_cast<uint32_t>(sizeof(key_type));
+        h.mapped_size = static_cast<uint32_t>(sizeof(mapped_type));
+        h.num_parts = num_parts;
+        return h;
+    }
+
+    static std::runtime_error snapshot_error(const std::string& path,
+                                             const std::string& what) {
+        return std::runtime_error("snapshot " + path + ": " + what);
+    }
+
+    // snapshot_offsets returns the byte offset in the snapshot file at which
+    // the elements of each part start, given the element counts of the parts
+    static std::vector<uint64_t> snapshot_offsets(
+        const std::vector<uint64_t>& counts) {
+        std::vector<uint64_t> offsets(counts.size());
+        uint64_t offset = sizeof(snapshot_header) +
+            counts.size() * sizeof(uint64_t);
+        for (size_t p = 0; p < counts.size(); ++p) {
+            offsets[p] = offset;
+            offset += counts[p] * SNAPSHOT_RECORD_SIZE;
+        }
+        return offsets;
+    }
+
 public:
     //! A locked_table is an ownership wrapper around a \ref cuckoohash_map
     //! table instance. When given a table instance, it takes all the locks on
@@ -1829,7 +2601,7 @@ public:
         // expose it to the cuckoohash_map class), since we don't want users
         // calling it.
         locked_table(cuckoohash_map<Key, T, Hash, Pred, Alloc,
-                     SLOT_PER_BUCKET>& hm)
+                     SLOT_PER_BUCKET, BFS_PATH_LEN>& hm)
             : unlocker_(std::move(hm.snapshot_and_lock_all())),
               buckets_(hm.buckets_),
               has_table_lock_(new bool(true)) {}
@@ -2049,7 +2821,7 @@ public:
             }
 
             friend class cuckoohash_map<Key, T, Hash, Pred,
-                                        Alloc, SLOT_PER_BUCKET>;
+                                        Alloc, SLOT_PER_BUCKET, BFS_PATH_LEN>;
         };
 
     public:
@@ -2096,6 +2868,151 @@ public:
             return end();
         }
 
+        //! for_each calls \p f on every element of the table, as f(value_type&),
+        //! using several threads. The buckets are split into one contiguous
+        //! range per thread, so \p f is called concurrently, but never twice at
+        //! once on the same element. It may modify the values in place.
+        //!
+        //! @param f the function to call on each element
+        //! @param num_threads the number of threads to use (pass in 0 for one
+        //! per core)
+        template <typename F>
+        void for_each(F f, size_t num_threads = 0) {
+            check_table();
+            buckets_t& buckets = buckets_.get();
+            run_parts(
+                num_parts(num_threads),
+                [&buckets, &f](size_t, size_t i, const size_t end) {
+                    for (; i < end; ++i) {
+                        Bucket& b = buckets[i];
+                        for (size_t j = 0; j < slot_per_bucket; ++j) {
+                            if (b.occupied(j)) {
+                                f(b.kvpair(j));
+                            }
+                        }
+                    }
+                });
+        }
+
+        //! scan is a read-only \ref for_each that also tells \p f which bucket
+        //! range it is scanning, as f(part, const value_type&), where part is
+        //! in [0, num_parts). Each part is scanned by a single thread in bucket
+        //! order, so \p f can accumulate per-part results without
+        //! synchronizing.
+        //!
+        //! @param f the function to call on each element
+        //! @param num_threads the number of threads to use (pass in 0 for one
+        //! per core)
+        //! @return the number of parts the buckets were split into
+        template <typename F>
+        size_t scan(F f, size_t num_threads = 0) const {
+            check_table();
+            const buckets_t& buckets = buckets_.get();
+            const size_t parts = num_parts(num_threads);
+            run_parts(
+                parts,
+                [&buckets, &f](size_t part, size_t i, const size_t end) {
+                    for (; i < end; ++i) {
+                        const Bucket& b = buckets[i];
+                        for (size_t j = 0; j < slot_per_bucket; ++j) {
+                            if (b.occupied(j)) {
+                                f(part, b.kvpair(j));
+                            }
+                        }
+                    }
+                });
+            return parts;
+        }
+
+        //! write_snapshot writes every element of the table to the binary file
+        //! at \p path, which \ref cuckoohash_map::load_snapshot can read back.
+        //! Each thread counts the elements of its range of buckets, and then
+        //! writes them at their own offset in the file, through its own stream.
+        //! Keys and values must be trivially copyable, and are stored as raw
+        //! bytes, so the file can only be read on a machine with the same byte
+        //! order and type layouts.
+        //!
+        //! @param path the file to write, which is truncated if it exists
+        //! @param num_threads the number of threads to use (pass in 0 for one
+        //! per core)
+        //! @return the number of elements written
+        //! @throw std::runtime_error if the file could not be written
+        size_t write_snapshot(const std::string& path,
+                              size_t num_threads = 0) const {
+            check_snapshot_types();
+            check_table();
+            const buckets_t& buckets = buckets_.get();
+            const size_t parts = num_parts(num_threads);
+            std::vector<uint64_t> counts(parts, 0);
+            run_parts(
+                parts,
+                [&buckets, &counts](size_t part, size_t i, const size_t end) {
+                    uint64_t count = 0;
+                    for (; i < end; ++i) {
+                        for (size_t j = 0; j < slot_per_bucket; ++j) {
+                            count += buckets[i].occupied(j);
+                        }
+                    }
+                    counts[part] = count;
+                });
+
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                const snapshot_header h = make_snapshot_header(parts);
+                out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+                out.write(reinterpret_cast<const char*>(counts.data()),
+                          static_cast<std::streamsize>(
+                              parts * sizeof(uint64_t)));
+                if (!out) {
+                    throw snapshot_error(path, "could not write the header");
+                }
+            }
+
+            const std::vector<uint64_t> offsets = snapshot_offsets(counts);
+            run_parts(
+                parts,
+                [&buckets, &offsets, &path]
+                (size_t part, size_t i, const size_t end) {
+                    std::fstream out(path, std::ios::binary | std::ios::in |
+                                     std::ios::out);
+                    out.seekp(static_cast<std::streamoff>(offsets[part]));
+                    std::vector<char> buf;
+                    buf.reserve(SNAPSHOT_BUFFER_SIZE + SNAPSHOT_RECORD_SIZE);
+                    for (; i < end; ++i) {
+                        const Bucket& b = buckets[i];
+                        for (size_t j = 0; j < slot_per_bucket; ++j) {
+                            if (!b.occupied(j)) {
+                                continue;
+                            }
+                            const char* k = reinterpret_cast<const char*>(
+                                &b.key(j));
+                            const char* v = reinterpret_cast<const char*>(
+                                &b.val(j));
+                            buf.insert(buf.end(), k, k + sizeof(key_type));
+                            buf.insert(buf.end(), v, v + sizeof(mapped_type));
+                        }
+                        if (buf.size() >= SNAPSHOT_BUFFER_SIZE) {
+                            out.write(buf.data(), static_cast<std::streamsize>(
+                                          buf.size()));
+                            buf.clear();
+                        }
+                    }
+                    out.write(buf.data(),
+                              static_cast<std::streamsize>(buf.size()));
+                    out.flush();
+                    if (!out) {
+                        throw snapshot_error(path, "could not write part " +
+                                             std::to_string(part));
+                    }
+                });
+
+            size_t total = 0;
+            for (const uint64_t c : counts) {
+                total += static_cast<size_t>(c);
+            }
+            return total;
+        }
+
     private:
         // Throws an exception if the locked_table has been invalidated because
         // it lost ownership of the table info.
@@ -2106,7 +3023,36 @@ public:
             }
         }
 
-        friend class cuckoohash_map<Key, T, Hash, Pred, Alloc, SLOT_PER_BUCKET>;
+        // num_parts returns the number of bucket ranges to split the table
+        // into for the given number of threads (0 for one per core)
+        size_t num_parts(size_t num_threads) const {
+            if (num_threads == 0) {
+                num_threads = kNumCores();
+            }
+            return std::max<size_t>(
+                1, std::min(num_threads, buckets_.get().size()));
+        }
+
+        // run_parts splits the buckets into num_parts contiguous ranges of
+        // nearly equal size, and calls f(part, first_bucket, last_bucket) on
+        // each range from its own thread. The first exception thrown by f is
+        // rethrown once all the threads are done.
+        template <typename F>
+        void run_parts(const size_t parts, F f) const {
+            const size_t n = buckets_.get().size();
+            parallel_exec(
+                0, parts, parts,
+                [n, parts, &f](size_t part, size_t, std::exception_ptr& eptr) {
+                    try {
+                        f(part, part * n / parts, (part + 1) * n / parts);
+                    } catch (...) {
+                        eptr = std::current_exception();
+                    }
+                });
+        }
+
+        friend class cuckoohash_map<Key, T, Hash, Pred, Alloc, SLOT_PER_BUCKET,
+                                    BFS_PATH_LEN>;
     };
 
     //! lock_table construct a \ref locked_table object that owns all the locks
@@ -2131,10 +3077,33 @@ private:
     // to access the buckets_ vector when you have at least one lock held.
     buckets_t buckets_;
 
-    // array of locks. marked mutable, so that const methods can take locks.
-    // Even though it's a vector, it should not ever change in size after the
-    // initial allocation.
-    mutable locks_t locks_;
+    // every lock stripe array the table has used, oldest first. marked
+    // mutable, so that const methods can take locks. Arrays are only appended,
+    // while all the current stripes are held, and are never freed before the
+    // table, so that threads spinning on an outgrown array stay safe.
+    mutable all_locks_t all_locks_;
+
+    // the stripe array currently guarding the buckets, which is always the
+    // last one in all_locks_
+    std::atomic<locks_t*> current_locks_;
+
+    // the requested number of stripes, or AUTO_NUM_LOCKS
+    const size_t num_locks_hint_;
+
+    // the memory layout of the stripes
+    const cuckoo_lock_layout lock_layout_;
+
+    // how many times a self-sized table doubled its stripes because of
+    // contention. Only changed while all the stripes are held.
+    size_t lock_boost_;
+
+    // the time, and the total wait cycles of the current stripes, at the last
+    // stripe resize check. Only changed while all the stripes are held.
+    uint64_t lock_tune_ticks_;
+    size_t lock_tune_wait_cycles_;
+
+    // the bytes allocated for all the arrays in all_locks_
+    std::atomic<size_t> lock_memory_;
 
     // a lock to synchronize expansions
     expansion_lock_t expansion_lock_;
@@ -2144,6 +3113,16 @@ private:
         cacheint, typename allocator_type::template rebind<cacheint>::other>
     num_inserts_, num_deletes_;
 
+    // per-core counters of the cuckoo hashing done by inserts
+    std::vector<
+        path_counters,
+        typename allocator_type::template rebind<path_counters>::other>
+    path_counters_;
+
+    // the maximum number of slots in the cuckoo paths slot_search looks for,
+    // between 1 and MAX_BFS_PATH_LEN
+    std::atomic<size_t> bfs_path_len_;
+
     // stores the minimum load factor allowed for automatic expansions. Whenever
     // an automatic expansion is triggered (during an insertion where cuckoo
     // hashing fails, for example), we check the load factor against this
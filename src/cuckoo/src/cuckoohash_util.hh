@@ -3,9 +3,14 @@
 #ifndef _CUCKOOHASH_UTIL_HH
 #define _CUCKOOHASH_UTIL_HH
 
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <thread>
 #include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#endif
 #include "cuckoohash_config.hh" // for LIBCUCKOO_DEBUG
 
 #if LIBCUCKOO_DEBUG
@@ -54,6 +59,17 @@
 #  endif
 #endif
 
+// Returns a cheap timestamp used to time lock waits: the cycle counter on x86,
+// and steady_clock nanoseconds elsewhere.
+inline uint64_t libcuckoo_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 // For enabling certain methods based on a condition. Here's an example.
 // ENABLE_IF(some_cond, type, static, inline) method() {
 //     ...
@@ -124,6 +140,30 @@ private:
     const size_t hashpower_;
 };
 
+//! cuckoo_path_stats is a snapshot of the cuckoo hashing done by the inserts
+//! into a table that found both of their buckets full.
+struct cuckoo_path_stats {
+    //! The number of inserts that searched for a cuckoo path
+    size_t searches;
+    //! path_lengths[d] is the number of paths that were carried out by moving
+    //! d items. It has one entry per possible path length.
+    std::vector<size_t> path_lengths;
+    //! The number of searches that ran out of BFS queue space
+    size_t bfs_queue_full;
+    //! The number of searches that explored every path up to the maximum depth
+    //! without finding an empty slot
+    size_t bfs_exhausted;
+    //! The number of paths that were changed by another writer between the
+    //! search and the move, so that the search had to be run again
+    size_t move_retries;
+    //! The number of inserts whose cuckoo hashing was abandoned because the
+    //! table was resized underneath it (failure_under_expansion)
+    size_t failure_under_expansion;
+    //! The number of inserts that found no cuckoo path and had to expand the
+    //! table
+    size_t table_full;
+};
+
 // Allocates an array of the given size and value-initializes each element with
 // the 0-argument constructor
 template <class T, class Alloc>
@@ -1,9 +1,74 @@
 #ifndef _DEFAULT_HASHER_HH
 #define _DEFAULT_HASHER_HH
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <type_traits>
 
+/*! string_key_view is a non-owning view of a string key, which lets a table
+ *  keyed by std::string be probed with a C string or a (pointer, length)
+ *  pair without building a std::string. It is only meant for lookups (find,
+ *  contains, erase, update): the characters must stay valid for the duration
+ *  of the call, and a view cannot be inserted. A table can only be probed
+ *  with views if its hasher and key_equal take them, as \ref
+ *  DefaultHasher<std::string>, \ref CityHasher<std::string> and \ref
+ *  DefaultKeyEqual<std::string> do. */
+class string_key_view {
+    const char* data_;
+    size_t size_;
+
+public:
+    string_key_view(const char* s): data_(s), size_(std::strlen(s)) {}
+    string_key_view(const char* s, size_t n): data_(s), size_(n) {}
+    string_key_view(const std::string& s): data_(s.data()), size_(s.size()) {}
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+inline bool operator==(const string_key_view& a, const string_key_view& b) {
+    return a.size() == b.size() &&
+        std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator==(const std::string& a, const string_key_view& b) {
+    return string_key_view(a) == b;
+}
+
+inline bool operator==(const string_key_view& a, const std::string& b) {
+    return a == string_key_view(b);
+}
+
+/*! libcuckoo_hash_bytes hashes \p n bytes a word at a time, with the
+ *  multiplier \ref DefaultHasher uses for integers. */
+inline size_t libcuckoo_hash_bytes(const char* s, size_t n) {
+    // This constant is found in the CityHash code
+    const uint64_t kMul = 0x9ddfea08eb382d69ULL;
+    uint64_t h = n * kMul;
+    for (; n >= sizeof(uint64_t); s += sizeof(uint64_t),
+             n -= sizeof(uint64_t)) {
+        uint64_t w;
+        std::memcpy(&w, s, sizeof(w));
+        h = (h ^ w) * kMul;
+        h ^= h >> 47;
+    }
+    if (n > 0) {
+        uint64_t w = 0;
+        std::memcpy(&w, s, n);
+        h = (h ^ w) * kMul;
+        h ^= h >> 47;
+    }
+    h *= kMul;
+    h ^= h >> 47;
+    return static_cast<size_t>(h);
+}
+
 /*! DefaultHasher is the default hash class used in the table. It overloads a
  *  few types that std::hash does badly on (namely integers), and falls back to
  *  std::hash for anything else. */
@@ -26,4 +91,56 @@ public:
     }
 };
 
+/*! This is a template specialization of DefaultHasher for std::string. It
+ *  hashes a std::string and a \ref string_key_view of the same characters to
+ *  the same value, so tables can be probed with views. */
+template <>
+class DefaultHasher<std::string> {
+public:
+    typedef void is_transparent;
+
+    size_t operator()(const std::string& k) const {
+        return libcuckoo_hash_bytes(k.data(), k.size());
+    }
+
+    size_t operator()(const string_key_view& k) const {
+        return libcuckoo_hash_bytes(k.data(), k.size());
+    }
+
+    size_t operator()(const char* k) const {
+        return libcuckoo_hash_bytes(k, std::strlen(k));
+    }
+};
+
+/*! DefaultKeyEqual is the default equality predicate used in the table. It
+ *  behaves like std::equal_to. */
+template <class Key>
+class DefaultKeyEqual {
+public:
+    bool operator()(const Key& a, const Key& b) const {
+        return a == b;
+    }
+};
+
+/*! This is a template specialization of DefaultKeyEqual for std::string. It
+ *  also compares a stored key to a \ref string_key_view or a C string,
+ *  without building a std::string. */
+template <>
+class DefaultKeyEqual<std::string> {
+public:
+    typedef void is_transparent;
+
+    bool operator()(const std::string& a, const std::string& b) const {
+        return a == b;
+    }
+
+    bool operator()(const std::string& a, const string_key_view& b) const {
+        return a == b;
+    }
+
+    bool operator()(const std::string& a, const char* b) const {
+        return a == b;
+    }
+};
+
 #endif // _DEFAULT_HASHER_HH
@@ -0,0 +1,183 @@
+/** \file */
+
+#ifndef _LOCK_ARRAY_HH
+#define _LOCK_ARRAY_HH
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "cuckoohash_config.hh"
+#include "cuckoohash_util.hh"
+#include "retry_stats.h"
+
+//! lock_stripe_stats is a snapshot of the contention seen by one group of lock
+//! stripes: how many acquisitions had to wait, and how many cycles (as counted
+//! by \ref libcuckoo_ticks) were spent waiting in total.
+struct lock_stripe_stats {
+    size_t waits;
+    size_t wait_cycles;
+};
+
+// lock_array. A fixed-size array of byte-sized spinlocks ("stripes"), laid out
+// either one per cache line (padded) or back to back (compact). The size is a
+// power of two, so that a bucket index can be masked into a stripe index.
+// Acquisitions that have to wait are counted, along with the cycles they
+// waited, per stats group. A stats group is a single stripe in the padded
+// layout, and the stripes sharing a cache line in the compact layout, since
+// those also share their contention. Only the waiting path touches the
+// counters.
+template <class Alloc = std::allocator<char> >
+class lock_array {
+    typedef std::atomic<uint8_t> flag_t;
+
+    struct stats_t {
+        std::atomic<size_t> waits;
+        std::atomic<size_t> wait_cycles;
+        stats_t(): waits(0), wait_cycles(0) {}
+    };
+
+    typedef typename Alloc::template rebind<char>::other byte_allocator_t;
+    typedef typename Alloc::template rebind<stats_t>::other stats_allocator_t;
+
+    static const size_t kCacheLineShift = 6;
+    static const size_t kCacheLineSize = 1UL << kCacheLineShift;
+
+    size_t size_;
+    cuckoo_lock_layout layout_;
+    // log2 of the distance in bytes between two consecutive stripes
+    size_t stride_shift_;
+    // log2 of the number of stripes sharing a stats group
+    size_t group_shift_;
+    // the raw allocation, and the cache-aligned start of the stripes in it
+    char* raw_;
+    size_t raw_size_;
+    char* flags_;
+    stats_t* stats_;
+
+    size_t num_groups() const {
+        return size_ >> group_shift_;
+    }
+
+    flag_t& flag(size_t i) const {
+        assert(i < size_);
+        return *reinterpret_cast<flag_t*>(flags_ + (i << stride_shift_));
+    }
+
+    // Spins until the stripe is free, keeping the cache line shared while it
+    // waits, and charges the wait to the stripe's stats group.
+    void lock_contended(flag_t& f, const size_t i) {
+        const uint64_t start = libcuckoo_ticks();
+        do {
+            while (f.load(std::memory_order_relaxed)) {}
+        } while (f.exchange(1, std::memory_order_acquire));
+        RETRY_STAT_INC(LOCK_RETRY);
+        stats_t& s = stats_[i >> group_shift_];
+        s.waits.fetch_add(1, std::memory_order_relaxed);
+        s.wait_cycles.fetch_add(libcuckoo_ticks() - start,
+                                std::memory_order_relaxed);
+    }
+
+public:
+    //! Creates \p n stripes in the given layout. \p n must be a power of two.
+    //! If \p locked is true every stripe starts out held by the caller.
+    lock_array(size_t n, cuckoo_lock_layout layout, bool locked)
+        : size_(n), layout_(layout),
+          stride_shift_(layout == cuckoo_lock_layout::padded ?
+                        kCacheLineShift : 0),
+          group_shift_(layout == cuckoo_lock_layout::padded ?
+                       0 : kCacheLineShift) {
+        assert(n > 0 && (n & (n - 1)) == 0);
+        if (group_shift_ > 0 && size_ < (1UL << group_shift_)) {
+            group_shift_ = 0;
+            for (size_t s = size_; s > 1; s >>= 1) {
+                ++group_shift_;
+            }
+        }
+        raw_size_ = (size_ << stride_shift_) + kCacheLineSize - 1;
+        byte_allocator_t byte_allocator;
+        raw_ = byte_allocator.allocate(raw_size_);
+        flags_ = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(raw_) + kCacheLineSize - 1) &
+            ~static_cast<uintptr_t>(kCacheLineSize - 1));
+        for (size_t i = 0; i < size_; ++i) {
+            new (flags_ + (i << stride_shift_)) flag_t(locked ? 1 : 0);
+        }
+        try {
+            stats_ = create_array<stats_t, stats_allocator_t>(num_groups());
+        } catch (...) {
+            byte_allocator.deallocate(raw_, raw_size_);
+            throw;
+        }
+    }
+
+    // No copying or moving, since threads may be spinning on the stripes
+    lock_array(const lock_array&) = delete;
+    lock_array& operator=(const lock_array&) = delete;
+
+    ~lock_array() {
+        destroy_array<stats_t, stats_allocator_t>(stats_, num_groups());
+        byte_allocator_t byte_allocator;
+        byte_allocator.deallocate(raw_, raw_size_);
+    }
+
+    inline void lock(size_t i) {
+        flag_t& f = flag(i);
+        RETRY_STAT_INC(LOCK_TRY);
+        if (!f.exchange(1, std::memory_order_acquire)) {
+            return;
+        }
+        lock_contended(f, i);
+    }
+
+    inline void unlock(size_t i) {
+        flag(i).store(0, std::memory_order_release);
+    }
+
+    inline bool try_lock(size_t i) {
+        return !flag(i).exchange(1, std::memory_order_acquire);
+    }
+
+    //! The number of stripes in the array
+    size_t size() const {
+        return size_;
+    }
+
+    cuckoo_lock_layout layout() const {
+        return layout_;
+    }
+
+    //! The number of bytes allocated for the stripes and their counters
+    size_t memory() const {
+        return raw_size_ + num_groups() * sizeof(stats_t);
+    }
+
+    //! The number of consecutive stripes sharing one stats group
+    size_t stripes_per_group() const {
+        return 1UL << group_shift_;
+    }
+
+    //! Returns a snapshot of the counters of every stats group, in stripe
+    //! order
+    template <class OutputIt>
+    void stats(OutputIt out) const {
+        for (size_t g = 0; g < num_groups(); ++g) {
+            *out++ = lock_stripe_stats{
+                stats_[g].waits.load(std::memory_order_relaxed),
+                stats_[g].wait_cycles.load(std::memory_order_relaxed)};
+        }
+    }
+
+    //! The sum of the wait cycles over all the stripes
+    size_t wait_cycles() const {
+        size_t total = 0;
+        for (size_t g = 0; g < num_groups(); ++g) {
+            total += stats_[g].wait_cycles.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
+
+#endif // _LOCK_ARRAY_HH
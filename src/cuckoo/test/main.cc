@@ -30,7 +30,16 @@
 //#include "rapl_read.h"
 
 #include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <vector>
 #include "cuckoohash_map.hh"
+#include "op_stream.h"
+#include "value_payload.h"
+#include "mem_footprint.h"
+#if defined(BASELINE)
+#  include "baseline_maps.h"
+#endif
 
 #ifdef __sparc__
 #  include <sys/types.h>
@@ -47,19 +56,42 @@
  * Definition of macros: per data structure
  * ################################################################### */
 
-//! A concurrent hash table that maps ints to ints
-typedef cuckoohash_map<uint32_t,uint32_t> IntTable;
-IntTable mset;
+#if !defined(PAYLOAD_INLINE_BYTES)
+#  define PAYLOAD_INLINE_BYTES 0
+#endif
 
-#define DS_CONTAINS(s,k)    s.contains(k);
-#define DS_ADD(s,a,k)       s.insert(a, k)
-#define DS_REMOVE(s,k)      s.erase(k)
-#define DS_SIZE(s)          s.size()
-//#define DS_NEW()            ;
+//! A concurrent hash table that maps ints to ints, or, built with
+//! PAYLOAD_INLINE_BYTES (PAYLOAD=<bytes> with make), to arrays of that many
+//! bytes stored in the buckets, that hold the payloads of -z
+#if PAYLOAD_INLINE_BYTES > 0
+typedef std::array<uint64_t, PAYLOAD_WORDS(PAYLOAD_INLINE_BYTES)> IntValue;
+#else
+typedef uint32_t IntValue;
+#endif
+#if defined(BASELINE)
+//! or, built with BASELINE=<kind> (make), one of the reference maps of
+//! baseline_maps.h, sized for the initial keys
+typedef baseline_map<BASELINE, uint32_t, IntValue>::type IntTable;
+#else
+typedef cuckoohash_map<uint32_t,IntValue> IntTable;
+#endif
+IntTable* mset;
+
+#define DS_CONTAINS(s,k)    s->contains(k);
+#define DS_GET(s,k,v)       s->find(k, v)
+#define DS_ADD(s,a,k)       s->insert(a, k)
+#define DS_REMOVE(s,k)      s->erase(k)
+#define DS_SIZE(s)          s->size()
+#if defined(BASELINE)
+#define DS_NEW(nl,ll)       new IntTable(initial, num_threads)
+#else
+#define DS_NEW(nl,ll)       new IntTable(DEFAULT_SIZE, DEFAULT_MINIMUM_LOAD_FACTOR, \
+                                     NO_MAXIMUM_HASHPOWER, IntTable::hasher(), \
+                                     IntTable::key_equal(), nl, ll)
+#endif
 
 
 #define DS_TYPE             void*
-#define DS_NODE             void*
 
 /* ################################################################### *
  * GLOBALS
@@ -76,6 +108,18 @@ size_t density = 50;
 
 size_t print_vals_num = 100; 
 size_t pf_vals_num = 1023;
+size_t num_locks = AUTO_NUM_LOCKS;
+cuckoo_lock_layout lock_layout = DEFAULT_LOCK_LAYOUT;
+int print_lock_stats = 0;
+size_t lock_stats_num = 100;	/* stripes that -S prints */
+int bulk_load = 0;
+int print_path_stats = 0;
+size_t bfs_path_len = 0;
+const char* snapshot_path = NULL;
+size_t op_stream_len = 0;
+const char* payload_spec = NULL;
+payload_conf_t payload;
+volatile uint64_t payload_written = 0, payload_read = 0, payload_checksum = 0;
 size_t put, put_explicit = false;
 double update_rate, put_rate, get_rate, filling_rate;
 
@@ -124,6 +168,167 @@ extern __thread uint32_t put_num_failed_on_new;
 
 barrier_t barrier, barrier_global;
 
+/* the value of key: the key itself, or a payload of the -z sizes, whose bytes
+   are added to *written. Inline values are copied in full into the table
+   whatever the size of their payload. */
+static inline IntValue
+value_of(uint64_t key, uint64_t* written)
+{
+#if PAYLOAD_INLINE_BYTES > 0
+  IntValue v;
+  const uint32_t bytes = payload_size(&payload, seeds);
+  payload_write(v.data(), bytes, key);
+  *written += bytes;
+  return v;
+#else
+  return (IntValue) key;
+#endif
+}
+
+#if defined(BASELINE)
+/* the footprint of the reference map, whose nodes and buckets come from malloc */
+static void
+footprint_get(IntTable* set, mem_footprint_t* f)
+{
+  memset(f, 0, sizeof(mem_footprint_t));
+  set->footprint(f);
+  mem_footprint_malloc(f);
+}
+#else
+/* prints the lock memory of the table and the wait counters of its num_print
+   most contended lock stripes (or stripe groups, with compact locks) */
+static void
+print_lock_wait_stats(IntTable* set, size_t num_print)
+{
+  std::vector<lock_stripe_stats> stats = set->lock_stats();
+  size_t per_stat = set->lock_stripes_per_stat();
+  size_t waits = 0, wait_cycles = 0;
+  for (size_t i = 0; i < stats.size(); i++)
+    {
+      waits += stats[i].waits;
+      wait_cycles += stats[i].wait_cycles;
+    }
+
+  printf("#locks: %zu stripes (%s) | memory: %.2f KB | waits: %zu | wait cycles: %zu\n",
+	 set->lock_count(),
+	 set->lock_layout() == cuckoo_lock_layout::compact ? "compact" : "padded",
+	 set->lock_memory() / 1024.0, waits, wait_cycles);
+
+  std::vector<size_t> order(stats.size());
+  for (size_t i = 0; i < order.size(); i++)
+    {
+      order[i] = i;
+    }
+  num_print = std::min(num_print, order.size());
+  std::partial_sort(order.begin(), order.begin() + num_print, order.end(),
+		    [&stats](size_t a, size_t b)
+		    { return stats[a].wait_cycles > stats[b].wait_cycles; });
+  printf("#stripe     waits      wait_cycles\n");
+  for (size_t i = 0; i < num_print && stats[order[i]].waits > 0; i++)
+    {
+      printf("#%-10zu %-10zu %zu\n", order[i] * per_stat,
+	     stats[order[i]].waits, stats[order[i]].wait_cycles);
+    }
+}
+
+/* prints how many inserts had to cuckoo, the lengths of the paths they moved
+   items along, and why the searches that found no path failed */
+/* the footprint of the table: the values are in the buckets, and the buckets
+   and the locks come from malloc. Lock arrays that were outgrown are garbage. */
+static void
+footprint_get(IntTable* set, mem_footprint_t* f)
+{
+  memset(f, 0, sizeof(mem_footprint_t));
+  f->table = sizeof(IntTable) + set->bucket_memory();
+  f->garbage = set->stale_lock_memory();
+  f->locks = set->lock_memory() - f->garbage;
+  mem_footprint_malloc(f);
+}
+
+static void
+print_cuckoo_path_stats(IntTable* set)
+{
+  cuckoo_path_stats ps = set->path_stats();
+  size_t moved = 0;
+  for (size_t d = 0; d < ps.path_lengths.size(); d++)
+    {
+      moved += ps.path_lengths[d];
+    }
+  printf("#cuckoo: max path: %zu | searches: %zu | moved: %zu | queue full: %zu"
+	 " | exhausted: %zu | move retries: %zu | under expansion: %zu"
+	 " | table full: %zu\n",
+	 set->bfs_path_len(), ps.searches, moved, ps.bfs_queue_full,
+	 ps.bfs_exhausted, ps.move_retries, ps.failure_under_expansion,
+	 ps.table_full);
+  printf("#path_len   paths      %%\n");
+  for (size_t d = 0; d < ps.path_lengths.size(); d++)
+    {
+      printf("#%-10zu %-10zu %.2f\n", d, ps.path_lengths[d],
+	     moved ? 100.0 * ps.path_lengths[d] / moved : 0.0);
+    }
+}
+
+/* fills the table with initial * filling_rate random keys through
+   bulk_load, instead of having each thread insert its share. Keys that are
+   drawn twice are only inserted once, so it loads again until the table
+   holds enough of them. */
+static void
+bulk_load_initial(IntTable* set)
+{
+  size_t num = (size_t) (initial * filling_rate);
+  std::vector<std::pair<uint32_t, IntValue> > kvs;
+  kvs.reserve(num);
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  size_t loaded = 0, rounds = 0;
+  uint64_t written = 0;
+  while (loaded < num)
+    {
+      kvs.clear();
+      for (size_t i = loaded; i < num; i++)
+	{
+	  uint32_t key = (my_random(&(seeds[0]), &(seeds[1]), &(seeds[2])) % (rand_max + 1)) + rand_min;
+	  kvs.push_back(std::make_pair(key, value_of(key, &written)));
+	}
+      loaded += set->bulk_load(kvs.begin(), kvs.end(), num_threads);
+      rounds++;
+    }
+
+  gettimeofday(&end, NULL);
+  double ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+  printf("#bulk load: %zu keys in %zu round(s), %.3f ms (%.1f keys/ms)\n",
+	 loaded, rounds, ms, ms > 0 ? loaded / ms : 0.0);
+}
+
+/* writes the table to a snapshot file with every thread, while holding all its
+   locks, and reads it back into a new table, timing both */
+static void
+snapshot_round_trip(IntTable* set, const char* path)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  size_t written;
+  {
+    auto lt = set->lock_table();
+    written = lt.write_snapshot(path, num_threads);
+  }
+  gettimeofday(&end, NULL);
+  double write_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+
+  IntTable* copy = DS_NEW(num_locks, lock_layout);
+  gettimeofday(&start, NULL);
+  size_t loaded = copy->load_snapshot(path, num_threads);
+  gettimeofday(&end, NULL);
+  double load_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+
+  printf("#snapshot: %zu keys | write (table locked): %.3f ms | load: %.3f ms%s\n",
+	 written, write_ms, load_ms, loaded == written ? "" : " | MISMATCH");
+  delete copy;
+}
+#endif	/* BASELINE */
+
 typedef struct thread_data
 {
   uint8_t id;
@@ -155,10 +360,14 @@ test(void* thread)
   uint64_t my_putting_count_succ = 0;
   uint64_t my_getting_count_succ = 0;
   uint64_t my_removing_count_succ = 0;
+
+  uint64_t my_payload_written = 0;
+  uint64_t my_payload_read = 0;
+  uint64_t my_payload_sum = 0;
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -183,24 +392,54 @@ test(void* thread)
 #if INITIALIZE_FROM_ONE == 1
   num_elems_thread = (ID == 0) * initial * filling_rate;
 #endif
+
+  if (bulk_load)
+    {
+      num_elems_thread = 0;
+    }
     
   for(i = 0; i < num_elems_thread; i++) 
     {
       key = (my_random(&(seeds[0]), &(seeds[1]), &(seeds[2])) % (rand_max + 1)) + rand_min;
       
 //      IntTable::accessor a;
-      if(DS_ADD(mset, key, key) == false)
+      if(DS_ADD(mset, key, value_of(key, &my_payload_written)) == false)
 	{
 	  i--;
 	}
     }
   MEM_BARRIER;
 
+  /* the operations of the measured phase, drawn before it starts */
+  op_stream_t* ops = NULL;
+  size_t ops_idx = 0;
+  if (op_stream_len)
+    {
+      ops = op_stream_new(op_stream_len, seeds, rand_max, rand_min);
+    }
+  if (!ID)
+    {
+      printf("#null backend: %.1f cycles/op (%s)\n",
+	     op_stream_null_cycles(ops, op_stream_len - 1, seeds, rand_max, rand_min,
+				   scale_put, scale_rem),
+	     ops != NULL ? "op stream" : "my_random");
+    }
+
+  /* count the retries and the payload bytes of the measured phase only */
+  RETRY_STATS_THREAD_INIT(ID);
+  my_payload_written = 0;
+
   barrier_cross(&barrier);
 
   if (!ID)
     {
       // printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(mset));
+      mem_footprint_t f;
+      mem_process_t m;
+      footprint_get(mset, &f);
+      mem_process_sample(&m);
+      mem_process_print("filled", &m);
+      mem_footprint_print(&f, DS_SIZE(mset));
     }
 
 
@@ -210,15 +449,14 @@ test(void* thread)
 
   while (stop == 0) 
     {
-      c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));
-      key = (c & rand_max) + rand_min;
+      OP_STREAM_OR_RAND_NXT(ops, ops_idx, op_stream_len - 1, c, key, seeds, rand_max, rand_min);
 
       if (unlikely(c <= scale_put))
 	{
 	  int res;
 //	  IntTable::accessor a;
 	  START_TS(1);
-	  res = DS_ADD(mset, key, key);
+	  res = DS_ADD(mset, key, value_of(key, &my_payload_written));
 	  if(res)
 	    {
 //	      a->second = key;
@@ -251,7 +489,17 @@ test(void* thread)
 	{ 
 	  int res;
 	  START_TS(0);
+#if PAYLOAD_INLINE_BYTES > 0
+	  IntValue v;
+	  res = DS_GET(mset, key, v);
+	  if (res)
+	    {
+	      my_payload_sum += payload_sum(v.data());
+	      my_payload_read += payload_bytes(v.data());
+	    }
+#else
 	  res = DS_CONTAINS(mset, key);
+#endif
 	  END_TS(0, my_getting_count);
 	  if(res != 0) 
 	    {
@@ -268,6 +516,10 @@ test(void* thread)
 
   barrier_cross(&barrier);
   RR_STOP_SIMPLE();
+  op_stream_free(ops, op_stream_len);
+  __sync_fetch_and_add(&payload_written, my_payload_written);
+  __sync_fetch_and_add(&payload_read, my_payload_read);
+  __sync_fetch_and_xor(&payload_checksum, my_payload_sum);
 
   if (!ID)
     {
@@ -326,6 +578,15 @@ main(int argc, char **argv)
     {"vals-pf",                   required_argument, NULL, 'V'},
     {"table-density",             required_argument, NULL, 'f'},
     {"load-factor",               required_argument, NULL, 'l'},
+    {"lock-stripes",              required_argument, NULL, 'k'},
+    {"compact-locks",             no_argument,       NULL, 'c'},
+    {"lock-stats",                optional_argument, NULL, 'S'},
+    {"bulk-load",                 no_argument,       NULL, 'B'},
+    {"path-stats",                no_argument,       NULL, 'P'},
+    {"bfs-depth",                 required_argument, NULL, 'D'},
+    {"snapshot",                  required_argument, NULL, 'W'},
+    {"op-stream",                 required_argument, NULL, 'O'},
+    {"value-size",                required_argument, NULL, 'z'},
     {NULL, 0, NULL, 0}
   };
 
@@ -333,7 +594,7 @@ main(int argc, char **argv)
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:V:f:", long_options, &i);
+      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:V:f:k:cS::BPD:W:O:z:", long_options, &i);
 		
       if(c == -1)
 	break;
@@ -378,6 +639,28 @@ main(int argc, char **argv)
      "        When using detailed profiling, how many values to keep track of.\n"
      "  -f, --table-density<int>\n"
      "        Table density.\n"
+		 "  -k, --lock-stripes <int>\n"
+		 "        Number of lock stripes (0 lets the table size them)\n"
+		 "  -c, --compact-locks\n"
+		 "        Pack lock stripes one byte apart instead of one per cache line\n"
+		 "  -S[<int>], --lock-stats[=<int>]\n"
+		 "        Print lock memory and the wait cycles of the <int> (default 100) most\n"
+		 "        contended stripes\n"
+		 "  -B, --bulk-load\n"
+		 "        Fill the table with a parallel bulk load before the test\n"
+		 "  -P, --path-stats\n"
+		 "        Print the cuckoo path lengths and search failures of the inserts\n"
+		 "  -D, --bfs-depth <int>\n"
+		 "        Longest cuckoo path inserts search for, at most the table maximum\n"
+		 "        (0 keeps it)\n"
+		 "  -W, --snapshot <file>\n"
+		 "        After the test, time a parallel snapshot of the table to file and its reload\n"
+		 "  -O, --op-stream <int>\n"
+		 "        Draw the operations of each thread before the test, into a buffer of <int>\n"
+		 "        operations (rounded up to a power of two) that the test loops over\n"
+		 "  -z, --value-size <fixed:B|uniform:min:max|bimodal:small:large:pct|trace:file>\n"
+		 "        Sizes of the payloads in bytes; puts write them and gets read them\n"
+		 "        back (needs a build with PAYLOAD=<bytes>, the room for each value)\n"
 		 );
 	  exit(0);
 	case 'd':
@@ -414,6 +697,37 @@ main(int argc, char **argv)
   case 'f':
     density = atoi(optarg);
     break;
+	case 'k':
+	  num_locks = atol(optarg);
+	  break;
+	case 'c':
+	  lock_layout = cuckoo_lock_layout::compact;
+	  break;
+	case 'S':
+	  print_lock_stats = 1;
+	  if (optarg != NULL)
+	    {
+	      lock_stats_num = atol(optarg);
+	    }
+	  break;
+	case 'B':
+	  bulk_load = 1;
+	  break;
+	case 'P':
+	  print_path_stats = 1;
+	  break;
+	case 'D':
+	  bfs_path_len = atol(optarg);
+	  break;
+	case 'W':
+	  snapshot_path = optarg;
+	  break;
+	case 'O':
+	  op_stream_len = pow2roundup(atol(optarg));
+	  break;
+	case 'z':
+	  payload_spec = optarg;
+	  break;
 	case '?':
 	default:
 	  // printf("Use -h or --help for help\n");
@@ -422,6 +736,44 @@ main(int argc, char **argv)
     }
 
 
+#if PAYLOAD_INLINE_BYTES > 0
+  static char payload_fixed[32];
+  if (payload_spec == NULL)
+    {
+      snprintf(payload_fixed, sizeof(payload_fixed), "fixed:%zu", sizeof(IntValue));
+      payload_spec = payload_fixed;
+    }
+  if (payload_parse(&payload, payload_spec, sizeof(IntValue)))
+    {
+      exit(1);
+    }
+#else
+  if (payload_spec != NULL)
+    {
+      printf("** -z needs values with room for the payloads: build with PAYLOAD=<bytes>\n");
+      exit(1);
+    }
+#endif
+
+#if defined(BASELINE)
+  if (num_locks != AUTO_NUM_LOCKS || lock_layout != DEFAULT_LOCK_LAYOUT
+      || print_lock_stats || bulk_load || print_path_stats || bfs_path_len
+      || snapshot_path != NULL)
+    {
+      printf("** -k, -c, -S, -B, -P, -D and -W are options of the cuckoo table, not of the %s baseline\n",
+	     IntTable::name());
+      exit(1);
+    }
+#else
+  if (bfs_path_len > IntTable::max_bfs_path_len)
+    {
+      printf("** -D takes a path length of at most %zu slots (0 keeps it)\n",
+	     IntTable::max_bfs_path_len);
+      printf("Use -h or --help for help\n");
+      exit(1);
+    }
+#endif
+
   if (!is_power_of_two(initial))
     {
       size_t initial_pow2 = pow2roundup(initial);
@@ -436,10 +788,6 @@ main(int argc, char **argv)
 
   // printf("## Initial: %zu / Range: %zu / Load factor: %zu\n", initial, range, load_factor);
 
-  double kb = initial * sizeof(DS_NODE) / 1024.0;
-  double mb = kb / 1024.0;
-  // printf("Sizeof initial: %.2f KB = %.2f MB\n", kb, mb);
-
   if (!is_power_of_two(range))
     {
       size_t range_pow2 = pow2roundup(range);
@@ -483,6 +831,25 @@ main(int argc, char **argv)
 
   maxhtlength = (unsigned int) initial / load_factor;
 
+  mset = DS_NEW(num_locks, lock_layout);
+#if !defined(BASELINE)
+  if (bfs_path_len)
+    {
+      mset->bfs_path_len(bfs_path_len);
+    }
+#endif
+
+  mem_process_t mem;
+  mem_process_sample(&mem);
+  mem_process_print("created", &mem);
+
+#if !defined(BASELINE)
+  if (bulk_load)
+    {
+      bulk_load_initial(mset);
+    }
+#endif
+
   /* Initializes the local data */
   putting_succ = (ticks *) calloc(num_threads , sizeof(ticks));
   putting_fail = (ticks *) calloc(num_threads , sizeof(ticks));
@@ -505,6 +872,11 @@ main(int argc, char **argv)
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -545,6 +917,9 @@ main(int argc, char **argv)
     }
 
   free(tds);
+  mem_footprint_t footprint;
+  footprint_get(mset, &footprint);
+  mem_process_sample(&mem);
     
   volatile ticks putting_suc_total = 0;
   volatile ticks putting_fal_total = 0;
@@ -576,14 +951,14 @@ main(int argc, char **argv)
     }
 
 #if defined(COMPUTE_LATENCY)
-  // printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  // printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
@@ -613,6 +988,31 @@ main(int argc, char **argv)
   double throughput = (putting_count_total + getting_count_total + removing_count_total) / duration;
   printf("%zu,\n", num_threads);
   printf("ops/ms:%.3f\n", throughput);
+  RETRY_STATS_PRINT(putting_count_total + getting_count_total + removing_count_total);
+  if (payload.dist != PAYLOAD_NONE)
+    {
+      payload_print(&payload, payload_spec, payload_written, payload_read);
+    }
+  mem_process_print("measured", &mem);
+  mem_footprint_print(&footprint, size_after);
+  mem_efficiency_print(throughput, &mem, &footprint);
+
+#if !defined(BASELINE)
+  if (print_lock_stats)
+    {
+      print_lock_wait_stats(mset, lock_stats_num);
+    }
+
+  if (print_path_stats)
+    {
+      print_cuckoo_path_stats(mset);
+    }
+
+  if (snapshot_path != NULL)
+    {
+      snapshot_round_trip(mset, snapshot_path);
+    }
+#endif
 
   RR_PRINT_UNPROTECTED(RAPL_PRINT_POW);
   RR_PRINT_CORRECTED();    
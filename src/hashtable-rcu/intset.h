@@ -28,26 +28,68 @@
 #include "common.h"
 #include "ssmem.h"
 
-#define RCU_SIGNAL
-#include <urcu.h>		/* RCU flavor */
-/* #include <urcu-qsbr.h> */
+/* RCU flavor, chosen at compile time (RCU_FLAVOR in the Makefile):
+ * RCU_MEMB  - read-side barriers turned into membarrier() on the update side
+ * RCU_QSBR  - empty read-side critical sections; every thread has to announce
+ *             a quiescent state every rcu_qs_period operations
+ * RCU_SIGNAL (default) - read-side barriers turned into signals */
+#if defined(RCU_QSBR)
+#  include <urcu-qsbr.h>
+#  define RCU_FLAVOR_NAME "qsbr"
+#elif defined(RCU_MEMB)
+#  define RCU_MEMBARRIER
+#  include <urcu.h>
+#  define RCU_FLAVOR_NAME "memb"
+#else
+#  if !defined(RCU_SIGNAL)
+#    define RCU_SIGNAL
+#  endif
+#  include <urcu.h>
+#  define RCU_FLAVOR_NAME "signal"
+#endif
 #include <urcu/rculfhash.h>	/* RCU Lock-free hash table */
 
+/* The cds_lfht_node comes first and the key right after it, so a lookup that
+ * walks a chain reads the link, the stored (reversed) hash and the key from
+ * one cache line. The lookup rejects a node on the stored hash before it
+ * calls match, so match only sees nodes whose hash is equal to the key's. */
 typedef struct node
 {
+  struct cds_lfht_node node;	/* Chaining in hash table */
   skey_t key;
   sval_t val;
-  struct cds_lfht_node node;	/* Chaining in hash table */
 } node_t;
 
 typedef struct cds_lfht cds_lfht_t;
 
+/* the key is passed by value, in the pointer argument of match */
+#define KEY_ARG(k) ((const void*) (uintptr_t) (k))
+
 static inline int
 match(struct cds_lfht_node* ht_node, const void *_key)
 {
   node_t* node = caa_container_of(ht_node, node_t, node);
-  skey_t key  = *(skey_t*) _key;
-  return node->key == key;
+  return node->key == (skey_t) (uintptr_t) _key;
+}
+
+/* The hash of a key: the key itself (the default), or the key with its bits
+ * mixed (the finalizer of MurmurHash3), for key sets that are not uniform in
+ * the low bits that pick a bucket. */
+extern int hash_mix;
+
+static inline unsigned long
+hash_key(skey_t key)
+{
+  unsigned long h = (unsigned long) key;
+  if (hash_mix)
+    {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdUL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53UL;
+      h ^= h >> 33;
+    }
+  return h;
 }
 
 static inline int
@@ -80,6 +122,152 @@ cds_lfht_size(cds_lfht_t* ht)
 #  define RCU_RUNLOCK()
 #endif
 
+/* QSBR readers never tell when they leave a critical section: a thread has to
+ * pass through a quiescent state every so often (RCU_QUIESCENT_TICK, once
+ * every rcu_qs_period operations), and must be offline while it blocks, e.g.,
+ * on a barrier, or a grace period waits for it forever. */
+#if defined(RCU_QSBR)
+#  define RCU_INIT()
+#  define RCU_QUIESCENT_TICK(ops)		\
+  if (++(ops) >= rcu_qs_period)			\
+    {						\
+      (ops) = 0;				\
+      rcu_quiescent_state();			\
+    }
+#  define RCU_OFFLINE()  rcu_thread_offline()
+#  define RCU_ONLINE()   rcu_thread_online()
+#else
+#  define RCU_INIT()  rcu_init()
+#  define RCU_QUIESCENT_TICK(ops)  (void) (ops)
+#  define RCU_OFFLINE()
+#  define RCU_ONLINE()
+#endif
+
+/* Reclamation of the removed nodes (RCU_RECLAIM in the Makefile):
+ * RCU_RECLAIM_SYNC     - wait for a grace period after every removal
+ * RCU_RECLAIM_BATCH    - (default) gather rcu_batch_size nodes per thread and
+ *                        wait once for the whole batch; the thread frees them
+ *                        to its own ssalloc free list
+ * RCU_RECLAIM_CALL_RCU - hand each full batch to call_rcu; the nodes are freed
+ *                        by the call_rcu thread, so they come from malloc */
+#define RCU_RECLAIM_SYNC     0
+#define RCU_RECLAIM_BATCH    1
+#define RCU_RECLAIM_CALL_RCU 2
+
+#if !defined(RCU_RECLAIM)
+#  define RCU_RECLAIM RCU_RECLAIM_BATCH
+#endif
+
+#if RCU_RECLAIM == RCU_RECLAIM_SYNC
+#  define RCU_RECLAIM_NAME "sync"
+#elif RCU_RECLAIM == RCU_RECLAIM_BATCH
+#  define RCU_RECLAIM_NAME "batch"
+#else
+#  define RCU_RECLAIM_NAME "call_rcu"
+#endif
+
+/* ssalloc keeps at most 255 freed objects per thread */
+#define RCU_BATCH_MAX 128
+
+typedef struct rcu_retired
+{
+  void* obj;
+  unsigned int allocator;
+} rcu_retired_t;
+
+typedef struct rcu_batch
+{
+  struct rcu_head head;
+  size_t num;
+  rcu_retired_t objs[RCU_BATCH_MAX];
+} rcu_batch_t;
+
+extern size_t rcu_qs_period, rcu_batch_size;
+extern __thread rcu_batch_t* rcu_batch;
+/* nodes removed but not freed yet, and the most there ever were: a node
+ * counts from the moment it is queued in the batch of its thread */
+extern volatile size_t rcu_pending, rcu_pending_max;
+
+static inline void
+rcu_pending_add(size_t num)
+{
+  size_t pending = __sync_add_and_fetch(&rcu_pending, num);
+  size_t max = rcu_pending_max;
+  while (pending > max && !__sync_bool_compare_and_swap(&rcu_pending_max, max, pending))
+    {
+      max = rcu_pending_max;
+    }
+}
+
+static inline void
+rcu_object_free(rcu_retired_t* r)
+{
+#if RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+  free(r->obj);
+#else
+  ssfree_alloc(r->allocator, r->obj);
+#endif
+}
+
+#if RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+static void
+rcu_batch_free_cb(struct rcu_head* head)
+{
+  rcu_batch_t* b = caa_container_of(head, rcu_batch_t, head);
+  size_t i;
+  for (i = 0; i < b->num; i++)
+    {
+      rcu_object_free(&b->objs[i]);
+    }
+  __sync_sub_and_fetch(&rcu_pending, b->num);
+  free(b);
+}
+#endif
+
+/* frees, or hands to call_rcu, the batch of the thread. Must not be called
+ * in a read-side critical section. */
+static inline void
+rcu_batch_flush()
+{
+  rcu_batch_t* b = rcu_batch;
+  if (b == NULL || b->num == 0)
+    {
+      return;
+    }
+#if RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+  rcu_batch = NULL;
+  call_rcu(&b->head, rcu_batch_free_cb);
+#else
+  RCU_WAIT();
+  size_t i;
+  for (i = 0; i < b->num; i++)
+    {
+      rcu_object_free(&b->objs[i]);
+    }
+  __sync_sub_and_fetch(&rcu_pending, b->num);
+  b->num = 0;
+#endif
+}
+
+static inline void
+rcu_retire(void* obj, unsigned int allocator)
+{
+  rcu_batch_t* b = rcu_batch;
+  if (b == NULL)
+    {
+      b = rcu_batch = (rcu_batch_t*) malloc(sizeof(rcu_batch_t));
+      assert(b != NULL);
+      b->num = 0;
+    }
+  b->objs[b->num].obj = obj;
+  b->objs[b->num].allocator = allocator;
+  rcu_pending_add(1);
+  if (++b->num >= rcu_batch_size)
+    {
+      rcu_batch_flush();
+    }
+}
+
 extern __thread ssmem_allocator_t *alloc, *alloc_data;
 
 static inline void
@@ -89,6 +277,8 @@ node_init(node_t** node)
     {
 #if GC == 1 && USE_RCU_GC != 1
       *node = (node_t*) ssmem_alloc(alloc, sizeof(node_t));
+#elif RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+      *node = (node_t*) malloc(sizeof(node_t));
 #else
       *node = (node_t*) ssalloc(sizeof(node_t));
 #endif
@@ -102,6 +292,8 @@ value_init(size_t** val, size_t size)
     {
 #if GC == 1 && USE_RCU_GC != 1
       *val = (size_t*) ssmem_alloc(alloc_data, size);
+#elif RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+      *val = (size_t*) malloc(size);
 #else
       *val = (size_t*) ssalloc_alloc(1, size);
 #endif
@@ -113,8 +305,12 @@ node_free(struct cds_lfht_node* ht_node)
 {
   UNUSED node_t* node = caa_container_of(ht_node, node_t, node);
 #if USE_RCU_GC == 1
+#  if RCU_RECLAIM == RCU_RECLAIM_SYNC
   RCU_WAIT();
   ssfree(node);
+#  else
+  rcu_retire(node, 0);
+#  endif
 #else
   ssmem_free(alloc, node);
 #endif
@@ -124,8 +320,12 @@ static inline void
 value_free(size_t* val)
 {
 #if USE_RCU_GC == 1
+#  if RCU_RECLAIM == RCU_RECLAIM_SYNC
   RCU_WAIT();
   ssfree_alloc(1, val);
+#  else
+  rcu_retire(val, 1);
+#  endif
 #else
   ssmem_free(alloc_data, val);
 #endif
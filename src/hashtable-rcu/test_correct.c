@@ -52,8 +52,8 @@
  * Definition of macros: per data structure
  * ################################################################### */
 
-#define DS_CONTAINS(s,k,i)  cds_lfht_lookup(set, key, match, &key, &i)
-#define DS_ADD(s,k)         (cds_lfht_add_unique(s, k->key, match, &k->key, &k->node) == &k->node) /* k is a node_t* */
+#define DS_CONTAINS(s,k,i)  cds_lfht_lookup(s, hash_key(k), match, KEY_ARG(k), &i)
+#define DS_ADD(s,k)         (cds_lfht_add_unique(s, hash_key(k->key), match, KEY_ARG(k->key), &k->node) == &k->node) /* k is a node_t* */
 #define DS_REMOVE(s,k)      (cds_lfht_del(s, k) == 0)
 #define DS_SIZE(s)          cds_lfht_size(s)
 #define DS_NEW()            cds_lfht_new(maxhtlength, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL)
@@ -74,6 +74,11 @@ size_t load_factor = DEFAULT_LOAD;
 size_t update = DEFAULT_UPDATE;
 size_t num_threads = DEFAULT_NB_THREADS; 
 size_t duration = DEFAULT_DURATION;
+int hash_mix = 0;
+size_t rcu_qs_period = 64;
+size_t rcu_batch_size = 64;
+__thread rcu_batch_t* rcu_batch;
+volatile size_t rcu_pending = 0, rcu_pending_max = 0;
 
 size_t print_vals_num = 100; 
 size_t pf_vals_num = 1023;
@@ -161,7 +166,7 @@ test(void* thread)
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -214,15 +219,23 @@ test(void* thread)
     }
   MEM_BARRIER;
 
+  RCU_OFFLINE();
   barrier_cross(&barrier);
 
   if (!ID)
     {
+      RCU_ONLINE();
+      RCU_RLOCK();
       printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(set));
+      RCU_RUNLOCK();
+      RCU_OFFLINE();
     }
 
 
   barrier_cross(&barrier_global);
+  RCU_ONLINE();
+
+  size_t qs_ops = 0;
 
   while (stop == 0) 
     {
@@ -303,18 +316,28 @@ test(void* thread)
 	  ADD_DUR_FAIL(my_getting_fail);
 	  my_getting_count++;
 	}
+      RCU_QUIESCENT_TICK(qs_ops);
     }
 
+  rcu_batch_flush();
+  RCU_OFFLINE();
   barrier_cross(&barrier);
 
   if (!ID)
     {
+      RCU_ONLINE();
+      RCU_RLOCK();
       size_after = DS_SIZE(set);
+      RCU_RUNLOCK();
+      RCU_OFFLINE();
       printf("#AFTER  size is: %zu\n", size_after);
     }
 
   barrier_cross(&barrier);
   
+  RCU_ONLINE();
+  free(rcu_batch);
+  rcu_batch = NULL;
   rcu_unregister_thread();
 
 
@@ -522,7 +545,7 @@ main(int argc, char **argv)
 
   maxhtlength = (unsigned int) initial / load_factor;
 
-  rcu_init();
+  RCU_INIT();
     
   DS_TYPE* set = DS_NEW();
   assert(set != NULL);
@@ -549,6 +572,11 @@ main(int argc, char **argv)
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -622,14 +650,14 @@ main(int argc, char **argv)
     }
 
 #if defined(COMPUTE_LATENCY)
-  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
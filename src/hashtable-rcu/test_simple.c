@@ -38,6 +38,7 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <malloc.h>
+#include <sys/resource.h>
 #include "utils.h"
 #include "atomic_ops.h"
 #include "rapl_read.h"
@@ -48,16 +49,17 @@
 #endif
 
 #include "intset.h"
+#include "mem_footprint.h"
 
 /* ################################################################### *
  * Definition of macros: per data structure
  * ################################################################### */
 
-#define DS_CONTAINS(s,k,i)  cds_lfht_lookup(set, key, match, &key, &i)
-#define DS_ADD(s,k)         (cds_lfht_add_unique(s, k->key, match, &k->key, &k->node) == &k->node) /* k is a node_t* */
+#define DS_CONTAINS(s,k,i)  cds_lfht_lookup(s, hash_key(k), match, KEY_ARG(k), &i)
+#define DS_ADD(s,k)         (cds_lfht_add_unique(s, hash_key(k->key), match, KEY_ARG(k->key), &k->node) == &k->node) /* k is a node_t* */
 #define DS_REMOVE(s,k)      (cds_lfht_del(s, k) == 0)
 #define DS_SIZE(s)          cds_lfht_size(s)
-#define DS_NEW()            cds_lfht_new(maxhtlength, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL)
+#define DS_NEW()            cds_lfht_new(maxhtlength, min_alloc, max_buckets, lfht_flags, resize_attr)
 
 
 #define DS_TYPE             cds_lfht_t
@@ -76,6 +78,19 @@ double update = DEFAULT_UPDATE;
 size_t num_threads = DEFAULT_NB_THREADS; 
 size_t duration = DEFAULT_DURATION;
 size_t density = 50;
+size_t num_buckets = 0;
+/* cds_lfht configuration: see cds_lfht_new() */
+unsigned long min_alloc = 1;	/* buckets allocated in one go, the least there are */
+unsigned long max_buckets = 0;	/* 0: no limit */
+int lfht_flags = CDS_LFHT_AUTO_RESIZE;
+int presize = 0;
+int resize_core = -1;
+pthread_attr_t* resize_attr = NULL;
+int hash_mix = 0;
+size_t rcu_qs_period = 64;
+size_t rcu_batch_size = 64;
+__thread rcu_batch_t* rcu_batch;
+volatile size_t rcu_pending = 0, rcu_pending_max = 0;
 
 size_t print_vals_num = 100; 
 size_t pf_vals_num = 1023;
@@ -161,7 +176,7 @@ test(void* thread)
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -215,16 +230,22 @@ test(void* thread)
     }
   MEM_BARRIER;
 
+  RCU_OFFLINE();
   barrier_cross(&barrier);
 
   if (!ID)
     {
       // printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(set));
+      mem_process_t m;
+      mem_process_sample(&m);
+      mem_process_print("filled", &m);
     }
 
 
   barrier_cross(&barrier_global);
+  RCU_ONLINE();
 
+  size_t qs_ops = 0;
   RR_START_SIMPLE();
 
   while (stop == 0) 
@@ -293,19 +314,29 @@ test(void* thread)
 		      my_getting_fail);					
 	  my_getting_count++;
 	}
+      RCU_QUIESCENT_TICK(qs_ops);
     }
 
+  rcu_batch_flush();
+  RCU_OFFLINE();
   barrier_cross(&barrier);
   RR_STOP_SIMPLE();
 
   if (!ID)
     {
+      RCU_ONLINE();
+      RCU_RLOCK();
       size_after = DS_SIZE(set);
+      RCU_RUNLOCK();
+      RCU_OFFLINE();
       // printf("#AFTER  size is: %zu\n", size_after);
     }
 
   barrier_cross(&barrier);
   
+  RCU_ONLINE();
+  free(rcu_batch);
+  rcu_batch = NULL;
   rcu_unregister_thread();
 
 
@@ -360,6 +391,15 @@ main(int argc, char **argv)
     {"vals-pf",                   required_argument, NULL, 'V'},
     {"table-density",             required_argument, NULL, 'f'},
     {"load-factor",               required_argument, NULL, 'l'},
+    {"min-alloc",                 required_argument, NULL, 'm'},
+    {"max-buckets",               required_argument, NULL, 'M'},
+    {"accounting",                no_argument,       NULL, 'c'},
+    {"no-auto-resize",            no_argument,       NULL, 'N'},
+    {"presize",                   no_argument,       NULL, 'P'},
+    {"resize-core",               required_argument, NULL, 'w'},
+    {"hash-mix",                  no_argument,       NULL, 'H'},
+    {"qs-period",                 required_argument, NULL, 'q'},
+    {"rcu-batch",                 required_argument, NULL, 'B'},
     {NULL, 0, NULL, 0}
   };
 
@@ -367,7 +407,7 @@ main(int argc, char **argv)
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:V:f:", long_options, &i);
+      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:M:cNPw:Ha:l:p:b:v:V:f:q:B:", long_options, &i);
 		
       if(c == -1)
 	break;
@@ -412,7 +452,25 @@ main(int argc, char **argv)
      "        When using detailed profiling, how many values to keep track of.\n"
      "  -f, --table-density<int>\n"
      "        Table density.\n"
-		 , argv[0]);
+		 "  -m, --min-alloc <int>\n"
+		 "        Buckets cds_lfht allocates in one go, and never shrinks below (default 1)\n"
+		 "  -M, --max-buckets <int>\n"
+		 "        Most buckets cds_lfht grows to (default 0: no limit)\n"
+		 "  -c, --accounting\n"
+		 "        Count the elements (CDS_LFHT_ACCOUNTING), to resize on the load and not on chain lengths\n"
+		 "  -N, --no-auto-resize\n"
+		 "        Keep the initial number of buckets\n"
+		 "  -P, --presize\n"
+		 "        Allocate the buckets for the initial size in one go and never shrink below them\n"
+		 "  -w, --resize-core <int>\n"
+		 "        Pin the threads that split a large resize on this core\n"
+		 "  -H, --hash-mix\n"
+		 "        Mix the bits of the keys for the hash (default: the key itself)\n"
+		 "  -q, --qs-period <int>\n"
+		 "        QSBR flavor: operations between two quiescent states (default 64)\n"
+		 "  -B, --rcu-batch <int>\n"
+		 "        Removed nodes a thread gathers before a grace period (1-%d, default 64)\n"
+		 , argv[0], RCU_BATCH_MAX);
 	  exit(0);
 	case 'd':
 	  duration = atoi(optarg);
@@ -445,6 +503,36 @@ main(int argc, char **argv)
   case 'f':
     density = atoi(optarg);
     break;
+	case 'b':
+	  num_buckets = atol(optarg);
+	  break;
+	case 'm':
+	  min_alloc = atol(optarg);
+	  break;
+	case 'M':
+	  max_buckets = atol(optarg);
+	  break;
+	case 'c':
+	  lfht_flags |= CDS_LFHT_ACCOUNTING;
+	  break;
+	case 'N':
+	  lfht_flags &= ~CDS_LFHT_AUTO_RESIZE;
+	  break;
+	case 'P':
+	  presize = 1;
+	  break;
+	case 'w':
+	  resize_core = atoi(optarg);
+	  break;
+	case 'H':
+	  hash_mix = 1;
+	  break;
+	case 'q':
+	  rcu_qs_period = atol(optarg);
+	  break;
+	case 'B':
+	  rcu_batch_size = atol(optarg);
+	  break;
 	case '?':
 	default:
 	  printf("Use -h or --help for help\n");
@@ -467,10 +555,6 @@ main(int argc, char **argv)
 
   // printf("## Initial: %zu / Range: %zu / Load factor: %zu\n", initial, range, load_factor);
 
-  double kb = initial * sizeof(DS_NODE) / 1024.0;
-  double mb = kb / 1024.0;
-  // printf("Sizeof initial: %.2f KB = %.2f MB\n", kb, mb);
-
   if (!is_power_of_two(range))
     {
       size_t range_pow2 = pow2roundup(range);
@@ -478,6 +562,15 @@ main(int argc, char **argv)
       range = range_pow2;
     }
 
+  if (rcu_qs_period == 0)
+    {
+      rcu_qs_period = 1;
+    }
+  if (rcu_batch_size == 0 || rcu_batch_size > RCU_BATCH_MAX)
+    {
+      rcu_batch_size = rcu_batch_size ? RCU_BATCH_MAX : 1;
+    }
+
   if (put > update)
     {
       put = update;
@@ -507,11 +600,62 @@ main(int argc, char **argv)
   stop = 0;
 
   maxhtlength = (unsigned int) initial / load_factor;
+  if (num_buckets > 0)
+    {
+      maxhtlength = num_buckets;
+    }
+  /* cds_lfht wants powers of two */
+  maxhtlength = pow2roundup(maxhtlength ? maxhtlength : 1);
+  if (presize)
+    {
+      min_alloc = maxhtlength;
+    }
+  min_alloc = pow2roundup(min_alloc ? min_alloc : 1);
+  if (max_buckets > 0)
+    {
+      max_buckets = pow2roundup(max_buckets);
+      if (max_buckets < maxhtlength)
+	{
+	  max_buckets = maxhtlength;
+	}
+      if (min_alloc > max_buckets)
+	{
+	  min_alloc = max_buckets;
+	}
+    }
+
+  pthread_attr_t resize_attr_core;
+  if (resize_core >= 0)
+    {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(resize_core, &cpus);
+      pthread_attr_init(&resize_attr_core);
+      pthread_attr_setaffinity_np(&resize_attr_core, sizeof(cpus), &cpus);
+      resize_attr = &resize_attr_core;
+    }
 
-  rcu_init();
+  RCU_INIT();
+  printf("## RCU flavor: %s / reclamation: %s (batch %zu)", RCU_FLAVOR_NAME, RCU_RECLAIM_NAME,
+	 RCU_RECLAIM == RCU_RECLAIM_SYNC ? (size_t) 1 : rcu_batch_size);
+#if defined(RCU_QSBR)
+  printf(" / quiescent state every %zu ops", rcu_qs_period);
+#endif
+  printf("\n");
+  printf("## cds_lfht: %u buckets / min alloc %lu / max %lu / auto-resize %s / accounting %s / hash %s",
+	 maxhtlength, min_alloc, max_buckets, (lfht_flags & CDS_LFHT_AUTO_RESIZE) ? "on" : "off",
+	 (lfht_flags & CDS_LFHT_ACCOUNTING) ? "on" : "off", hash_mix ? "mix" : "key");
+  if (resize_core >= 0)
+    {
+      printf(" / resize core %d", resize_core);
+    }
+  printf("\n");
     
   DS_TYPE* set = DS_NEW();
   assert(set != NULL);
+  mem_process_t mem;
+  mem_process_sample(&mem);
+  mem_process_print("created", &mem);
 
   /* Initializes the local data */
   putting_succ = (ticks *) calloc(num_threads , sizeof(ticks));
@@ -535,6 +679,11 @@ main(int argc, char **argv)
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -577,6 +726,7 @@ main(int argc, char **argv)
     }
 
   free(tds);
+  mem_process_sample(&mem);
     
   volatile ticks putting_suc_total = 0;
   volatile ticks putting_fal_total = 0;
@@ -608,14 +758,14 @@ main(int argc, char **argv)
     }
 
 #if defined(COMPUTE_LATENCY)
-  // printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  // printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
@@ -646,6 +796,28 @@ main(int argc, char **argv)
   //printf("%zu,\t", num_threads);
   printf("ops/ms:%.3f\n", throughput);
 
+#if RCU_RECLAIM == RCU_RECLAIM_CALL_RCU
+  rcu_barrier();
+#endif
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("## RCU pending nodes: max %zu (%.1f KB) | max RSS: %.1f MB\n", (size_t) rcu_pending_max,
+	 rcu_pending_max * sizeof(DS_NODE) / 1024.0, usage.ru_maxrss / 1024.0);
+
+  /* cds_lfht keeps its bucket index to itself, so only the nodes are counted:
+     those in the chains as overflow, and those waiting for a grace period (at
+     their peak) as garbage */
+  mem_footprint_t footprint;
+  memset(&footprint, 0, sizeof(mem_footprint_t));
+  footprint.overflow = size_after * sizeof(DS_NODE);
+  footprint.garbage = rcu_pending_max * sizeof(DS_NODE);
+#if RCU_RECLAIM == RCU_RECLAIM_CALL_RCU && !(GC == 1 && USE_RCU_GC != 1)
+  mem_footprint_malloc(&footprint);
+#endif
+  mem_process_print("measured", &mem);
+  mem_footprint_print(&footprint, size_after);
+  mem_efficiency_print(throughput, &mem, &footprint);
+
   RR_PRINT_UNPROTECTED(RAPL_PRINT_POW);
   RR_PRINT_CORRECTED();    
 
@@ -297,68 +297,127 @@ private:
         ~TableInfo() {}
     };
 
-    // This is a hazard pointer, used to indicate which version of the TableInfo
-    // is currently being used in the thread. Since cuckoohash_map operations
-    // can run simultaneously in different threads, this variable is thread
-    // local. Note that this variable can be safely shared between different
-    // cuckoohash_map instances, since multiple operations cannot occur
-    // simultaneously in one thread. The hazard pointer variable points to a
-    // pointer inside a global list of pointers, that each map checks before
-    // deleting any old TableInfo pointers.
-    static __thread TableInfo** hazard_pointer;
-
-    // A GlobalHazardPointerList stores a list of pointers that cannot be
-    // deleted by an expansion thread. Each thread gets its own node in the
-    // list, whose data pointer it can modify without contention.
-    class GlobalHazardPointerList {
-        std::list<TableInfo*> hp_;
-        std::mutex lock_;
+    // Old TableInfos are reclaimed with epochs. Every operation runs inside an
+    // EpochGuard, which announces the global epoch in the thread's
+    // EpochRecord before the operation loads table_info. An expansion retires
+    // the TableInfo it replaced with the epoch it was unlinked in, and it is
+    // freed once the global epoch is two past that: the epoch can only advance
+    // when every thread inside an operation has announced the current one, so
+    // by then no thread can still hold the old pointer.
+
+    // EpochRecord is one thread's announcement, (epoch << 1) | active, on its
+    // own cache line. Records are never freed; a thread gives its record back
+    // when it exits, and the next new thread reuses it.
+    struct EpochRecord {
+        std::atomic<size_t> state;
+        std::atomic<bool> owned;
+        EpochRecord* next;
+        // nesting is only used by the owning thread: an operation can run
+        // others (insert expands, expand inserts into the new table), and
+        // only the outermost one announces and clears the epoch.
+        size_t nesting;
+
+        EpochRecord(): state(0), owned(true), next(nullptr), nesting(0) {}
+    } __attribute__((aligned(64)));
+
+    // A GlobalEpochList stores the global epoch and the list of every
+    // EpochRecord. Records are only ever pushed on the list, so it can be
+    // scanned without a lock.
+    class GlobalEpochList {
+        std::atomic<EpochRecord*> head_;
+        std::atomic<size_t> epoch_;
     public:
-        // new_hazard_pointer creates and returns a new hazard pointer for a
-        // thread.
-        TableInfo** new_hazard_pointer() {
-            std::unique_lock<std::mutex> ul(lock_);
-            hp_.emplace_back(nullptr);
-            return &hp_.back();
-        }
-
-        // delete_unused scans the list of hazard pointers, deleting any
-        // pointers in old_pointers that aren't in this list. If it does delete
-        // a pointer in old_pointers, it deletes that node from the list.
-        void delete_unused(std::list<std::unique_ptr<TableInfo>>&
-                           old_pointers) {
-            std::unique_lock<std::mutex> ul(lock_);
-            old_pointers.remove_if(
-                [this](const std::unique_ptr<TableInfo>& ptr) {
-                    return std::find(hp_.begin(), hp_.end(), ptr.get()) ==
-                        hp_.end();
-                });
+        GlobalEpochList(): head_(nullptr), epoch_(0) {}
+
+        // acquire returns a record for a new thread, reusing one whose
+        // thread has exited if there is one.
+        EpochRecord* acquire() {
+            for (EpochRecord* r = head_.load(); r != nullptr; r = r->next) {
+                bool owned = false;
+                if (!r->owned.load(std::memory_order_relaxed) &&
+                    r->owned.compare_exchange_strong(owned, true)) {
+                    return r;
+                }
+            }
+            EpochRecord* r = new EpochRecord();
+            r->next = head_.load();
+            while (!head_.compare_exchange_weak(r->next, r));
+            return r;
+        }
+
+        // release gives the record of an exiting thread back.
+        void release(EpochRecord* r) {
+            r->state.store(0, std::memory_order_relaxed);
+            r->owned.store(false, std::memory_order_release);
+        }
+
+        size_t epoch() const {
+            return epoch_.load();
+        }
+
+        // try_advance moves to the next epoch if every thread inside an
+        // operation has announced the current one, and returns the epoch.
+        size_t try_advance() {
+            size_t e = epoch_.load();
+            for (EpochRecord* r = head_.load(); r != nullptr; r = r->next) {
+                const size_t s = r->state.load();
+                if ((s & 1) && (s >> 1) != e) {
+                    return e;
+                }
+            }
+            epoch_.compare_exchange_strong(e, e + 1);
+            return epoch_.load();
         }
     };
 
-    // As long as the thread_local hazard_pointer is static, which means each
-    // template instantiation of a cuckoohash_map class gets its own per-thread
-    // hazard pointer, then each template instantiation of a cuckoohash_map
-    // class can get its own global_hazard_pointers list, since different
-    // template instantiations won't interfere with each other.
-    static GlobalHazardPointerList global_hazard_pointers;
+    // As with counterid, each template instantiation of a cuckoohash_map class
+    // gets its own global_epochs list and per-thread record, which all the
+    // maps of that instantiation share.
+    static GlobalEpochList global_epochs;
 
-    // check_hazard_pointer should be called before any public method that loads
-    // a table snapshot. It checks that the thread local hazard pointer pointer
-    // is not null, and gets a new pointer if it is null.
-    static inline void check_hazard_pointer() {
-        if (hazard_pointer == nullptr) {
-            hazard_pointer = global_hazard_pointers.new_hazard_pointer();
+    // EpochHandle holds the thread's record, taken on the thread's first
+    // operation and given back by its destructor when the thread exits.
+    class EpochHandle {
+        EpochRecord* rec_;
+    public:
+        EpochHandle(): rec_(nullptr) {}
+        ~EpochHandle() {
+            if (rec_ != nullptr) {
+                global_epochs.release(rec_);
+            }
         }
-    }
+        EpochRecord* get() {
+            if (rec_ == nullptr) {
+                rec_ = global_epochs.acquire();
+            }
+            return rec_;
+        }
+    };
 
-    // Once a function is finished with a version of the table, it will want to
-    // unset the hazard pointer it set so that it can be freed if it needs to.
-    // This is an object which, upon destruction, will unset the hazard pointer.
-    class HazardPointerUnsetter {
+    static thread_local EpochHandle epoch_handle;
+
+    // EpochGuard should be declared before any public method that loads a
+    // table snapshot, and keeps the snapshot alive until its destruction.
+    // Leaving the outermost guard frees the retired TableInfos that have
+    // become safe, if there are any.
+    class EpochGuard {
+        const cuckoohash_map<Key, T, Hash, Pred>& hm_;
+        EpochRecord* rec_;
     public:
-        ~HazardPointerUnsetter() {
-            *hazard_pointer = nullptr;
+        EpochGuard(const cuckoohash_map<Key, T, Hash, Pred>& hm)
+            : hm_(hm), rec_(epoch_handle.get()) {
+            if (rec_->nesting++ == 0) {
+                rec_->state.store((global_epochs.epoch() << 1) | 1);
+            }
+        }
+        ~EpochGuard() {
+            if (--rec_->nesting == 0) {
+                rec_->state.store(rec_->state.load(std::memory_order_relaxed) &
+                                  ~(size_t)1, std::memory_order_release);
+                if (hm_.num_retired.load(std::memory_order_relaxed) != 0) {
+                    hm_.reclaim_retired();
+                }
+            }
         }
     };
 
@@ -399,7 +458,7 @@ private:
 public:
     //! The constructor creates a new hash table with enough space for \p n
     //! elements. If the constructor fails, it will throw an exception.
-    explicit cuckoohash_map(size_t n = DEFAULT_SIZE) {
+    explicit cuckoohash_map(size_t n = DEFAULT_SIZE) : num_retired(0) {
         cuckoo_init(reserve_calc(n));
     }
 
@@ -414,11 +473,10 @@ public:
     //! clear removes all the elements in the hash table, calling their
     //! destructors.
     void clear() {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         TableInfo* ti = snapshot_and_lock_all();
         assert(ti == table_info.load());
         AllUnlocker au(ti);
-        HazardPointerUnsetter hpu;
         cuckoo_clear(ti);
     }
 
@@ -426,9 +484,8 @@ public:
     //! doesn't lock the table, elements can be inserted during the computation,
     //! so the result may not necessarily be exact.
     size_t size() const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         const TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         const size_t s = cuckoo_size(ti);
         return s;
     }
@@ -441,18 +498,16 @@ public:
     //! hashpower returns the hashpower of the table, which is
     //! log<SUB>2</SUB>(the number of buckets).
     size_t hashpower() const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         const size_t hashpower = ti->hashpower_;
         return hashpower;
     }
 
     //! bucket_count returns the number of buckets in the table.
     size_t bucket_count() const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         size_t buckets = hashsize(ti->hashpower_);
         return buckets;
     }
@@ -460,9 +515,8 @@ public:
     //! load_factor returns the ratio of the number of items in the table to the
     //! total number of available slots in the table.
     double load_factor() const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         const TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         return cuckoo_loadfactor(ti);
     }
 
@@ -470,12 +524,11 @@ public:
     //! value it finds in \p val.
     ENABLE_IF(, value_copy_assignable, bool)
     find(const key_type& key, mapped_type& val) const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
 
         const cuckoo_status st = cuckoo_find(key, val, hv, ti, i1, i2);
         unlock_two(ti, i1, i2);
@@ -499,12 +552,11 @@ public:
     //! contains searches through the table for \p key, and returns true if it
     //! finds it in the table, and false otherwise.
     bool contains(const key_type& key) const {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
 
         const bool result = cuckoo_contains(key, hv, ti, i1, i2);
         unlock_two(ti, i1, i2);
@@ -521,13 +573,12 @@ public:
     typename std::enable_if<std::is_convertible<V, const mapped_type&>::value,
                             bool>::type
     insert(const key_type& key, V val) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         check_counterid();
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
         return cuckoo_insert_loop(key, std::forward<V>(val),
                                   hv, ti, i1, i2);
     }
@@ -536,13 +587,12 @@ public:
     //! their destructors. If \p key is not there, it returns false, otherwise
     //! it returns true.
     bool erase(const key_type& key) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         check_counterid();
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
 
         const cuckoo_status st = cuckoo_delete(key, hv, ti, i1, i2);
         unlock_two(ti, i1, i2);
@@ -553,12 +603,11 @@ public:
     //! not there, it returns false, otherwise it returns true.
     ENABLE_IF(, value_copy_assignable, bool)
     update(const key_type& key, const mapped_type& val) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
 
         const cuckoo_status st = cuckoo_update(key, val, hv, ti, i1, i2);
         unlock_two(ti, i1, i2);
@@ -571,12 +620,11 @@ public:
     //! there, it returns false, otherwise it returns true.
     template <typename Updater>
     bool update_fn(const key_type& key, Updater fn) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         size_t hv = hashed_key(key);
         TableInfo* ti;
         size_t i1, i2;
         std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-        HazardPointerUnsetter hpu;
 
         const cuckoo_status st = cuckoo_update_fn(key, fn, hv, ti, i1, i2);
         unlock_two(ti, i1, i2);
@@ -590,7 +638,7 @@ public:
     //! inserted, it can retry the update.
     template <typename Updater>
     void upsert(const key_type& key, Updater fn, const mapped_type& val) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         check_counterid();
         size_t hv = hashed_key(key);
         TableInfo* ti;
@@ -599,7 +647,6 @@ public:
         bool res;
         do {
             std::tie(ti, i1, i2) = snapshot_and_lock_two(hv);
-            HazardPointerUnsetter hpu;
             const cuckoo_status st = cuckoo_update_fn(key, fn, hv, ti, i1, i2);
             if (st == ok) {
                 unlock_two(ti, i1, i2);
@@ -625,9 +672,8 @@ public:
     //! expansion succeeded, and false otherwise. rehash can throw an exception
     //! if the expansion fails to allocate enough memory for the larger table.
     bool rehash(size_t n) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         if (n <= ti->hashpower_) {
             return false;
         }
@@ -642,9 +688,8 @@ public:
     //! was an expansion, and false otherwise. reserve can throw an exception if
     //! the expansion fails to allocate enough memory for the larger table.
     bool reserve(size_t n) {
-        check_hazard_pointer();
+        EpochGuard eg(*this);
         TableInfo* ti = snapshot_table_nolock();
-        HazardPointerUnsetter hpu;
         if (n <= hashsize(ti->hashpower_) * SLOT_PER_BUCKET) {
             return false;
         }
@@ -680,9 +725,39 @@ private:
     std::atomic<TableInfo*> table_info;
 
     // old_table_infos holds pointers to old TableInfos that were replaced
-    // during expansion. This keeps the memory alive for any leftover
-    // operations, until they are deleted by the global hazard pointer manager.
-    std::list<std::unique_ptr<TableInfo>> old_table_infos;
+    // during expansion, with the epoch they were retired in. This keeps the
+    // memory alive for any leftover operations, until reclaim_retired frees
+    // them. retire_lock protects the list, and is never taken by an operation
+    // unless num_retired is non-zero.
+    typedef std::pair<size_t, std::unique_ptr<TableInfo>> retired_table;
+    mutable std::list<retired_table> old_table_infos;
+    mutable std::mutex retire_lock;
+    mutable std::atomic<size_t> num_retired;
+
+    // retire_table_info adds an old TableInfo to old_table_infos. It must be
+    // called after the TableInfo has been replaced in table_info.
+    void retire_table_info(TableInfo* ti) {
+        std::unique_lock<std::mutex> ul(retire_lock);
+        old_table_infos.emplace_back(global_epochs.epoch(),
+                                     std::unique_ptr<TableInfo>(ti));
+        num_retired.store(old_table_infos.size());
+    }
+
+    // reclaim_retired tries to advance the epoch and frees the retired
+    // TableInfos that no thread can hold anymore, all at once. It gives up if
+    // another thread is already at it.
+    void reclaim_retired() const {
+        std::unique_lock<std::mutex> ul(retire_lock, std::try_to_lock);
+        if (!ul.owns_lock()) {
+            return;
+        }
+        const size_t epoch = global_epochs.try_advance();
+        old_table_infos.remove_if(
+            [epoch](const retired_table& r) {
+                return r.first + 2 <= epoch;
+            });
+        num_retired.store(old_table_infos.size());
+    }
 
     // lock locks the given bucket index.
     static inline void lock(TableInfo* ti, const size_t i) {
@@ -783,27 +858,11 @@ private:
         }
     }
 
-    // snapshot_table_nolock loads the table info pointer and sets the hazard
-    // pointer, whithout locking anything. There is a possibility that after
-    // loading a snapshot and setting the hazard pointer, an expansion runs and
-    // create a new version of the table, leaving the old one for deletion. To
-    // deal with that, we check that the table_info we loaded is the same as the
-    // current one, and if it isn't, we try again. Whenever we check if (ti !=
-    // table_info.load()) after setting the hazard pointer, there is an ABA
-    // issue, where the address of the new table_info equals the address of a
-    // previously deleted one, however it doesn't matter, since we would still
-    // be looking at the most recent table_info in that case.
+    // snapshot_table_nolock loads the table info pointer, whithout locking
+    // anything. It must be called inside an EpochGuard, which keeps the
+    // snapshot from being deleted if an expansion replaces it meanwhile.
     TableInfo* snapshot_table_nolock() const {
-        while (true) {
-            TableInfo* ti = table_info.load();
-            *hazard_pointer = ti;
-            // If the table info has changed in the time we set the hazard
-            // pointer, ti could have been deleted, so try again.
-            if (ti != table_info.load()) {
-                continue;
-            }
-            return ti;
-        }
+        return table_info.load();
     }
 
     // snapshot_and_lock_two loads the table_info pointer and locks the buckets
@@ -817,12 +876,6 @@ private:
         size_t i1, i2;
         while (true) {
             ti = table_info.load();
-            *hazard_pointer = ti;
-            // If the table info has changed in the time we set the hazard
-            // pointer, ti could have been deleted, so try again.
-            if (ti != table_info.load()) {
-                continue;
-            }
             i1 = index_hash(ti, hv);
             i2 = alt_index(ti, hv, i1);
             lock_two(ti, i1, i2);
@@ -855,12 +908,6 @@ private:
     TableInfo* snapshot_and_lock_all() const {
         while (true) {
             TableInfo* ti = table_info.load();
-            *hazard_pointer = ti;
-            // If the table info has changed, ti could have been deleted, so try
-            // again
-            if (ti != table_info.load()) {
-                continue;
-            }
             for (size_t i = 0; i < kNumLocks; ++i) {
                 ti->locks_[i].lock();
             }
@@ -1271,9 +1318,9 @@ private:
             return failure;
         } else if (ti != table_info.load()) {
             // Unlock i1 and i2 and signal to cuckoo_insert to try again. Since
-            // we set the hazard pointer to be ti, this check isn't susceptible
-            // to an ABA issue, since a new pointer can't have the same address
-            // as ti.
+            // the EpochGuard keeps ti from being freed, this check isn't
+            // susceptible to an ABA issue, since a new pointer can't have the
+            // same address as ti.
             unlock_two(ti, i1, i2);
             return failure_under_expansion;
         }
@@ -1522,8 +1569,7 @@ private:
 
     // We run cuckoo_insert in a loop until it succeeds in insert and upsert, so
     // we pulled out the loop to avoid duplicating it. This should be called
-    // directly after snapshot_and_lock_two, and by the end of the function, the
-    // hazard pointer will have been unset.
+    // directly after snapshot_and_lock_two, inside the caller's EpochGuard.
     template <class V>
     bool cuckoo_insert_loop(const key_type& key, V val,
                             size_t hv, TableInfo* ti, size_t i1, size_t i2) {
@@ -1665,7 +1711,6 @@ private:
         TableInfo* ti = snapshot_and_lock_all();
         assert(ti == table_info.load());
         AllUnlocker au(ti);
-        HazardPointerUnsetter hpu;
         if (n <= ti->hashpower_) {
             // Most likely another expansion ran before this one could grab the
             // locks
@@ -1696,10 +1741,9 @@ private:
         table_info.store(new_map.table_info.load());
         new_map.table_info.store(nullptr);
 
-        // Rather than deleting ti now, we store it in old_table_infos. We then
-        // run a delete_unused routine to delete all the old table pointers.
-        old_table_infos.push_back(std::move(std::unique_ptr<TableInfo>(ti)));
-        global_hazard_pointers.delete_unused(old_table_infos);
+        // Rather than deleting ti now, we store it in old_table_infos. It is
+        // deleted once every operation that might still use it has finished.
+        retire_table_info(ti);
         return ok;
     }
 
@@ -1732,8 +1776,12 @@ public:
         // want users calling it.
         const_iterator(const cuckoohash_map<Key, T, Hash, Pred>& hm,
                        bool is_end) : hm_(hm) {
-            cuckoohash_map<Key, T, Hash, Pred>::check_hazard_pointer();
-            ti_ = hm_.snapshot_and_lock_all();
+            // The locks keep ti_ from being replaced once taken, so the
+            // guard is only needed while taking them.
+            {
+                EpochGuard eg(hm_);
+                ti_ = hm_.snapshot_and_lock_all();
+            }
             assert(ti_ == hm_.table_info.load());
 
             has_table_lock = true;
@@ -1783,7 +1831,6 @@ public:
         void release() {
             if (has_table_lock) {
                 AllUnlocker au(ti_);
-                cuckoohash_map<Key, T, Hash, Pred>::HazardPointerUnsetter hpu;
                 has_table_lock = false;
             }
         }
@@ -2111,15 +2158,15 @@ public:
 
 // Initializing the static members
 template <class Key, class T, class Hash, class Pred>
-    __thread typename cuckoohash_map<Key, T, Hash, Pred>::TableInfo**
-    cuckoohash_map<Key, T, Hash, Pred>::hazard_pointer = nullptr;
+    thread_local typename cuckoohash_map<Key, T, Hash, Pred>::EpochHandle
+    cuckoohash_map<Key, T, Hash, Pred>::epoch_handle;
 
 template <class Key, class T, class Hash, class Pred>
     __thread int cuckoohash_map<Key, T, Hash, Pred>::counterid = -1;
 
 template <class Key, class T, class Hash, class Pred>
-    typename cuckoohash_map<Key, T, Hash, Pred>::GlobalHazardPointerList
-    cuckoohash_map<Key, T, Hash, Pred>::global_hazard_pointers;
+    typename cuckoohash_map<Key, T, Hash, Pred>::GlobalEpochList
+    cuckoohash_map<Key, T, Hash, Pred>::global_epochs;
 
 template <class Key, class T, class Hash, class Pred>
     const std::out_of_range
@@ -27,6 +27,7 @@
 #endif
 
 #include "intset.h"
+#include "mem_footprint.h"
 
 using namespace tbb;
 using namespace std;
@@ -63,7 +64,6 @@ IntTable mset;
 	
 
 #define DS_TYPE             void*
-#define DS_NODE             void*
 
 /* ################################################################### *
  * GLOBALS
@@ -125,6 +125,21 @@ typedef struct thread_data
   uint8_t id;
 } thread_data_t;
 
+/* concurrent_hash_map keeps its buckets and nodes private: this follows the
+   layout of TBB 4.x, where a bucket is a spin_rw_mutex and the head of its
+   chain, and a node adds its own spin_rw_mutex and a next pointer to the pair.
+   They come from tbb_allocator, which is malloc unless tbbmalloc is loaded. */
+static void
+footprint_get(IntTable& set, mem_footprint_t* f)
+{
+  const size_t buckets = DS_BUCKETCOUNT(set), nodes = DS_SIZE(set);
+  memset(f, 0, sizeof(mem_footprint_t));
+  f->table = sizeof(IntTable) + buckets * sizeof(void*);
+  f->locks = (buckets + nodes) * sizeof(tbb::spin_rw_mutex);
+  f->overflow = nodes * (sizeof(void*) + sizeof(IntTable::value_type));
+  mem_footprint_malloc(f);
+}
+
 void*
 test(void* thread) 
 {
@@ -154,7 +169,7 @@ test(void* thread)
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -200,6 +215,12 @@ test(void* thread)
   if (!ID)
     {
       // printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(mset));
+      mem_footprint_t f;
+      mem_process_t m;
+      footprint_get(mset, &f);
+      mem_process_sample(&m);
+      mem_process_print("filled", &m);
+      mem_footprint_print(&f, DS_SIZE(mset));
     }
 
 
@@ -437,10 +458,6 @@ main(int argc, char **argv)
 
   // printf("## Initial: %zu / Range: %zu / Load factor: %zu\n", initial, range, load_factor);
 
-  double kb = initial * sizeof(DS_NODE) / 1024.0;
-  double mb = kb / 1024.0;
-  // printf("Sizeof initial: %.2f KB = %.2f MB\n", kb, mb);
-
   if (!is_power_of_two(range))
     {
       size_t range_pow2 = pow2roundup(range);
@@ -504,9 +521,18 @@ main(int argc, char **argv)
   int rc;
   void *status;
 
+  mem_process_t mem;
+  mem_process_sample(&mem);
+  mem_process_print("created", &mem);
+
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -549,6 +575,9 @@ main(int argc, char **argv)
     }
 
   free(tds);
+  mem_footprint_t footprint;
+  footprint_get(mset, &footprint);
+  mem_process_sample(&mem);
     
   volatile ticks putting_suc_total = 0;
   volatile ticks putting_fal_total = 0;
@@ -580,14 +609,14 @@ main(int argc, char **argv)
     }
 
 #if defined(COMPUTE_LATENCY)
-  // printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  // printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
@@ -619,6 +648,9 @@ main(int argc, char **argv)
   //printf("",)
   printf("%.2f\t%.3f,\n", put_rate,filling_rate);
   printf("ops/ms:%.3f\n", throughput);
+  mem_process_print("measured", &mem);
+  mem_footprint_print(&footprint, size_after);
+  mem_efficiency_print(throughput, &mem, &footprint);
 
   RR_PRINT_UNPROTECTED(RAPL_PRINT_POW);
   RR_PRINT_CORRECTED();    
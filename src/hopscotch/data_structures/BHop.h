@@ -105,7 +105,7 @@ private:
 					move_backet->_hopInfo &= ~(1U << move_new_free_distance);
 
 					*free_backet = new_free_backet;
-					*free_distance -= move_free_dist;
+					*free_distance -= (move_free_dist - move_new_free_distance);
 
 					if(start_seg != move_segment)
 						move_segment->_lock.unlock();	
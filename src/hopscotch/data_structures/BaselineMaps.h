@@ -0,0 +1,120 @@
+#ifndef __BASELINE_MAPS__
+#define __BASELINE_MAPS__
+
+//------------------------------------------------------------------------------
+// File    : BaselineMaps.h
+//
+// Reference maps that the concurrent tables are measured against. The maps
+// are those of include/baseline_maps.h, which the other drivers use too; the
+// classes here only give them the template parameters of the other maps and
+// their putIfAbsent, containsKey, remove, size and memory(), so that they run
+// through the same DS_* macros of the driver:
+//
+//  NullMap        - next to no work: the cost of the harness alone
+//  PrivateStdMap  - a std::unordered_map per thread: no sharing at all
+//  PrivateOpenMap - a linear-probing table per thread: no sharing, and one
+//                   cache miss per operation at most
+//  LockedStdMap   - one std::unordered_map behind one spinlock
+//  ShardedRWMap   - std::unordered_map shards, each behind a reader-writer
+//                   lock that lookups share
+//
+// None of them takes _tLock or _tMemory. A thread of the private maps only
+// sees the keys it added itself; size() and memory() sum the maps of all the
+// threads.
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include "../framework/cpp_framework.h"
+#include "MapMemory.h"
+#include "baseline_maps.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS: BaselineAdapter
+////////////////////////////////////////////////////////////////////////////////
+
+// The interface of the hopscotch maps over a map of baseline_maps.h.
+// concurrencyLevel is the number of threads the map is sized for, at least one.
+template <int _kind, typename _tKey, typename _tData, typename _tHash>
+class BaselineAdapter {
+private:
+	typedef typename baseline_map<_kind, _tKey, _tData>::type Map;
+
+	Map _map;
+
+public:
+	BaselineAdapter(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	_map(inCapacity, concurrencyLevel > 0 ? concurrencyLevel : 1)
+	{}
+
+	inline_ bool containsKey(const _tKey& key) {
+		return _map.contains(key);
+	}
+	// the data of key if it is there, or _EMPTY_DATA once data was added
+	inline_ _tData putIfAbsent(const _tKey& key, const _tData& data) {
+		_tData rc;
+		while (!_map.insert(key, data)) {
+			if (_map.find(key, rc))
+				return rc;
+		}
+		return _tHash::_EMPTY_DATA;
+	}
+	inline_ _tData remove(const _tKey& key) {
+		_tData rc;
+		return _map.erase(key, rc) ? rc : _tHash::_EMPTY_DATA;
+	}
+	unsigned int size() {
+		return (unsigned int) _map.size();
+	}
+	MapMemory memory() {
+		mem_footprint_t f;
+		memset(&f, 0, sizeof(f));
+		_map.footprint(&f);
+		MapMemory mem;
+		mem._table = f.table;
+		mem._locks = f.locks;
+		mem._overflow = f.overflow;
+		mem._garbage = f.garbage;
+		return mem;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASSES: the baselines, with the template parameters of the other maps
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename _tKey, typename _tData, typename _tHash, typename _tLock, typename _tMemory>
+class NullMap : public BaselineAdapter<BASELINE_NULL, _tKey, _tData, _tHash> {
+public:
+	NullMap(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	BaselineAdapter<BASELINE_NULL, _tKey, _tData, _tHash>(inCapacity, concurrencyLevel) {}
+};
+
+template <typename _tKey, typename _tData, typename _tHash, typename _tLock, typename _tMemory>
+class PrivateStdMap : public BaselineAdapter<BASELINE_PRIVATE_STD, _tKey, _tData, _tHash> {
+public:
+	PrivateStdMap(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	BaselineAdapter<BASELINE_PRIVATE_STD, _tKey, _tData, _tHash>(inCapacity, concurrencyLevel) {}
+};
+
+template <typename _tKey, typename _tData, typename _tHash, typename _tLock, typename _tMemory>
+class PrivateOpenMap : public BaselineAdapter<BASELINE_PRIVATE_OA, _tKey, _tData, _tHash> {
+public:
+	PrivateOpenMap(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	BaselineAdapter<BASELINE_PRIVATE_OA, _tKey, _tData, _tHash>(inCapacity, concurrencyLevel) {}
+};
+
+template <typename _tKey, typename _tData, typename _tHash, typename _tLock, typename _tMemory>
+class LockedStdMap : public BaselineAdapter<BASELINE_LOCKED_STD, _tKey, _tData, _tHash> {
+public:
+	LockedStdMap(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	BaselineAdapter<BASELINE_LOCKED_STD, _tKey, _tData, _tHash>(inCapacity, concurrencyLevel) {}
+};
+
+template <typename _tKey, typename _tData, typename _tHash, typename _tLock, typename _tMemory>
+class ShardedRWMap : public BaselineAdapter<BASELINE_SHARDED_RW, _tKey, _tData, _tHash> {
+public:
+	ShardedRWMap(_u32 inCapacity = 0, _u32 concurrencyLevel = 0)
+	:	BaselineAdapter<BASELINE_SHARDED_RW, _tKey, _tData, _tHash>(inCapacity, concurrencyLevel) {}
+};
+
+#endif //__BASELINE_MAPS__
@@ -38,11 +38,21 @@
 #include <limits.h>
 #include "math.h"
 #include "memory.h"
+#include "HopscotchTraits.h"
+#include "MapMemory.h"
+#include "retry_stats.h"
+#include <type_traits>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "../framework/cpp_framework.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 //INNER CLASSES
 ////////////////////////////////////////////////////////////////////////////////
+#ifndef __HASH_INT__
+#define __HASH_INT__
 class HASH_INT {
 public:
 	//you must define the following fields and properties
@@ -73,57 +83,199 @@ public:
 		left = right;
 	}
 };
+const unsigned int HASH_INT::_EMPTY_HASH = 0;
+const unsigned int HASH_INT::_BUSY_HASH  = 1;
+const int HASH_INT::_EMPTY_KEY  = 0;
+const int HASH_INT::_EMPTY_DATA = 0;
+#endif
 ////////////////////////////////////////////////////////////////////////////////
 // CLASS: ConcurrentHopscotchHashMap
 ////////////////////////////////////////////////////////////////////////////////
+// _tSoA picks the layout of the table. By default each bucket holds its key
+// (an array of structures). With _tSoA the keys are kept in an array of their
+// own, next to the buckets, so that the keys of a neighbourhood are contiguous
+// and a lookup of a 32 bit integer key compares all of them with a few SIMD
+// instructions, masking the result with _hopInfo. _tOutOfLineData keeps the
+// values behind a pointer instead of in the bucket.
 template <typename	_tKey,
 		    typename	_tData,
 			 typename	_tHash,
 			 typename	_tLock,
-			 typename	_tMemory>
+			 typename	_tMemory,
+			 bool			_tSoA = false,
+			 bool			_tOutOfLineData = false>
 class BitmapHopscotchHashMap {
 private:
 
 	// Inner Classes ............................................................
-	struct Bucket {
+	typedef HopValue<_tData, _tMemory, _tOutOfLineData>	Value;
+	typedef typename Value::_tSlot								ValueSlot;
+	typedef typename HopStorage<_tKey>::type					KeySlot;
+
+	struct KeyInBucket {
+		KeySlot				_key;
+	};
+	struct KeyInArray {
+	};
+
+	struct Bucket : std::conditional<_tSoA, KeyInArray, KeyInBucket>::type {
 		_u32   volatile	_hopInfo;
 		_u32	 volatile	_hash;
-		_tKey  volatile	_key;
-		_tData volatile	_data;
+		ValueSlot			_data;
 		void init() {
 			_hopInfo	= 0U;
 			_hash		= _tHash::_EMPTY_HASH;
-			_key		= _tHash::_EMPTY_KEY;
-			_data		= _tHash::_EMPTY_DATA;
+			_data		= Value::empty_slot(_tHash::_EMPTY_DATA);
 		}
 	};
 
+	// A bucket array, and in the SoA layout the array of their keys. When the
+	// table grows, each segment's keys are moved to the new table in turn,
+	// and the tables they left are chained through _retired. Those are only
+	// freed with the map, since readers don't lock and may still be scanning
+	// them.
+	struct Table {
+		Bucket*	_buckets;
+		KeySlot*	_keys;
+		_u32		_bucketMask;
+		Table*	_retired;
+	};
+
+	// A key's segment is picked by the low bits of its hash, which are also
+	// the low bits of its home bucket, so it does not change when the table
+	// grows. _table is the table the segment's keys are in.
 	struct Segment {
-		_u32 volatile	_timestamp;
+		_u32   volatile	_timestamp;
+		Table* volatile	_table;
 		_tLock			_lock;
 
-		void init() {
+		void init(Table* const table) {
 			_timestamp = 0;
+			_table = table;
 			_lock.init();
 		}
 	};
 
 	// Fields ...................................................................
-	_u32 volatile		_segmentShift;
 	_u32 volatile		_segmentMask;
-	_u32 volatile		_bucketMask;
 	Segment*	volatile	_segments;
-	Bucket* volatile	_table;
+	Table* volatile	_table;
+	_tLock				_resizeLock;
+	_u32 volatile		_numResizes;
 
 	// Constants ................................................................
 	static const _u32 _HOP_RANGE		= 32;
 	static const _u32	_INSERT_RANGE	= 4*1024;
 	static const _u32 _RESIZE_FACTOR = 2;
+	static const _u32 _MAX_BACKOFF	= 1024;
 
 	// Small Utilities ..........................................................
-	void find_closer_free_backet(const Segment* const start_seg, Bucket** free_backet, _u32* free_distance) {
-		Bucket* move_backet( *free_backet - (_HOP_RANGE - 1) );
-		for (int move_free_dist(_HOP_RANGE - 1); move_free_dist > 0; --move_free_dist) {
+	typedef std::integral_constant<bool, _tSoA> soa_layout;
+
+	// How a key was placed. CONTENDED: the only keys that could move out of the
+	// way are of segments that other writers hold, so the caller backs off and
+	// tries again, rather than grow a table that is not full.
+	enum Placement {
+		PLACED,
+		FULL,
+		CONTENDED
+	};
+
+	// Spins for backoff pauses, twice as many the next time
+	static void back_off(_u32& backoff) {
+		RETRY_STAT_INC(LOCK_RETRY);
+		for (_u32 i(0); i < backoff; ++i)
+			CMDR::spin_pause();
+		if(backoff < _MAX_BACKOFF)
+			backoff <<= 1;
+	}
+
+	// The neighbourhood of 32 bit integer keys can be compared at once
+	static const bool _SIMD_LOOKUP = _tSoA && std::is_integral<_tKey>::value && 4 == sizeof(_tKey);
+
+	static KeySlot& key_of(const Table* const table, const Bucket* const bucket, std::false_type) {
+		return const_cast<Bucket*>(bucket)->_key;
+	}
+
+	static KeySlot& key_of(const Table* const table, const Bucket* const bucket, std::true_type) {
+		return table->_keys[bucket - table->_buckets];
+	}
+
+	static KeySlot& key_of(const Table* const table, const Bucket* const bucket) {
+		return key_of(table, bucket, soa_layout());
+	}
+
+	// The hash of a key, also kept in its bucket as a fingerprint. The hashes
+	// that mark a bucket free or busy are moved to the next value.
+	static unsigned int calc_hash(const _tKey& key) {
+		unsigned int hash( _tHash::Calc(key) );
+		while(_tHash::_EMPTY_HASH == hash || _tHash::_BUSY_HASH == hash)
+			++hash;
+		return hash;
+	}
+
+	// Empties a bucket whose hopInfo bit was cleared, releasing it to be
+	// claimed again only once its key and data are cleared. An out of line
+	// value is not freed, it may have moved to another bucket.
+	static void release_bucket(const Table* const table, Bucket* const bucket) {
+		key_of(table, bucket) = _tHash::_EMPTY_KEY;
+		bucket->_data = Value::empty_slot(_tHash::_EMPTY_DATA);
+		_tMemory::write_barrier();
+		bucket->_hash = _tHash::_EMPTY_HASH;
+	}
+
+	// Returns the bits of hopInfo whose bucket holds key, by comparing the
+	// whole neighbourhood's keys at once. Only for _SIMD_LOOKUP.
+	static _u32 match_neighbourhood(const Table* const table, const Bucket* const elmAry, const _tKey key, const _u32 hopInfo) {
+		const int* const keys( (const int*)(table->_keys + (elmAry - table->_buckets)) );
+		_u32 match(0);
+#ifdef __AVX2__
+		const __m256i pattern( _mm256_set1_epi32((int)key) );
+		for (int i(0); i < (int)_HOP_RANGE; i += 8) {
+			const __m256i ks( _mm256_loadu_si256((const __m256i*)(keys + i)) );
+			match |= ((_u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(ks, pattern)))) << i;
+		}
+#else
+		const __m128i pattern( _mm_set1_epi32((int)key) );
+		for (int i(0); i < (int)_HOP_RANGE; i += 4) {
+			const __m128i ks( _mm_loadu_si128((const __m128i*)(keys + i)) );
+			match |= ((_u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ks, pattern)))) << i;
+		}
+#endif
+		return match & hopInfo;
+	}
+
+	// Returns true if a bucket of elmAry's neighbourhood that hopInfo points
+	// to holds key.
+	static bool find_in_neighbourhood(const Table* const table, const Bucket* const elmAry, const unsigned int hash, const _tKey& key, _u32 hopInfo) {
+		return find_in_neighbourhood(table, elmAry, hash, key, hopInfo, std::integral_constant<bool, _SIMD_LOOKUP>());
+	}
+
+	static bool find_in_neighbourhood(const Table* const table, const Bucket* const elmAry, const unsigned int hash, const _tKey& key, _u32 hopInfo, std::true_type) {
+		return 0U != match_neighbourhood(table, elmAry, key, hopInfo);
+	}
+
+	static bool find_in_neighbourhood(const Table* const table, const Bucket* const elmAry, const unsigned int hash, const _tKey& key, _u32 hopInfo, std::false_type) {
+		while(0U != hopInfo) {
+			register const int i( first_lsb_bit_indx(hopInfo) );
+			register const Bucket* currElm( elmAry + i);
+			if(hash == currElm->_hash && _tHash::IsEqual(key, key_of(table, currElm)))
+				return true;
+			hopInfo &= ~(1U << i);
+		}
+		return false;
+	}
+
+	// Moves a key to *free_backet to free a bucket closer to the home bucket.
+	// Returns PLACED if it did, or else clears *free_backet.
+	Placement find_closer_free_backet(const Segment* const start_seg, const Table* const table, Bucket** free_backet, _u32* free_distance) {
+		bool contended( false );
+		//don't look before the start of the table
+		int max_free_dist(_HOP_RANGE - 1);
+		if (*free_backet - table->_buckets < max_free_dist)
+			max_free_dist = (int)(*free_backet - table->_buckets);
+		Bucket* move_backet( *free_backet - max_free_dist );
+		for (int move_free_dist(max_free_dist); move_free_dist > 0; --move_free_dist) {
 			_u32 start_hop_info(move_backet->_hopInfo);
 			int move_new_free_distance(-1);
 			_u32 mask(1);
@@ -134,29 +286,39 @@ private:
 				}
 			}
 			if (-1 != move_new_free_distance) {
-				Segment*	const move_segment(&(_segments[((move_backet - _table) >> _segmentShift) & _segmentMask]));
+				Segment*	const move_segment(&(_segments[(move_backet - table->_buckets) & _segmentMask]));
 				
-				if(start_seg != move_segment)
-					move_segment->_lock.lock();	
+				//don't wait for another segment while holding ours, two writers
+				//moving keys of each other's segments would deadlock
+				if(start_seg != move_segment && !move_segment->_lock.tryLock()) {
+					contended = true;
+					++move_backet;
+					continue;
+				}
 
 				if (start_hop_info == move_backet->_hopInfo) {
 					Bucket* new_free_backet(move_backet + move_new_free_distance);
 					(*free_backet)->_data  = new_free_backet->_data;
-					(*free_backet)->_key   = new_free_backet->_key;
+					key_of(table, *free_backet) = key_of(table, new_free_backet);
 					(*free_backet)->_hash  = new_free_backet->_hash;
 
-					++(move_segment->_timestamp);
 					_tMemory::write_barrier();
-
 					move_backet->_hopInfo |= (1U << move_free_dist);
 					move_backet->_hopInfo &= ~(1U << move_new_free_distance);
 
+					//bump the timestamp only once hopInfo points at the copy: a
+					//reader that saw the old hopInfo read the old timestamp too,
+					//and sees the change if the old bucket is reused meanwhile
+					_tMemory::write_barrier();
+					++(move_segment->_timestamp);
+					RETRY_STAT_INC(DISPLACE);
+
 					*free_backet = new_free_backet;
-					*free_distance -= move_free_dist;
+					*free_distance -= (move_free_dist - move_new_free_distance);
 
 					if(start_seg != move_segment)
 						move_segment->_lock.unlock();	
-					return;
+					return PLACED;
 				}
 				if(start_seg != move_segment)
 					move_segment->_lock.unlock();	
@@ -165,6 +327,109 @@ private:
 		}
 		*free_backet = 0; 
 		*free_distance = 0;
+		return contended ? CONTENDED : FULL;
+	}
+
+	static size_t table_bytes(const Table* const table) {
+		return sizeof(Table) + (table->_bucketMask + 1 + _INSERT_RANGE + 1) * (sizeof(Bucket) + (_tSoA ? sizeof(KeySlot) : 0));
+	}
+
+	Table* new_table(const _u32 capacity) {
+		Table* const table( (Table*) _tMemory::byte_malloc(sizeof(Table)) );
+		const _u32 num_buckets( capacity + _INSERT_RANGE + 1);
+		table->_bucketMask = capacity - 1;
+		table->_retired = NULL;
+		table->_buckets = (Bucket*) _tMemory::byte_aligned_malloc( num_buckets * sizeof(Bucket) );
+		table->_keys = _tSoA ? (KeySlot*) _tMemory::byte_aligned_malloc( num_buckets * sizeof(KeySlot) ) : NULL;
+
+		Bucket* curr_bucket = table->_buckets;
+		for (_u32 iElm=0; iElm < num_buckets; ++iElm, ++curr_bucket) {
+			curr_bucket->init();
+			key_of(table, curr_bucket) = _tHash::_EMPTY_KEY;
+		}
+		return table;
+	}
+
+	// Places a key that is not in the table within _HOP_RANGE of its home
+	// bucket, startBucket. The key's segment must be locked. Returns FULL if
+	// no free bucket could be moved close enough, and the table has to grow.
+	Placement add_key(Segment& segment, Table* const table, Bucket* const startBucket, const _u32 hash, const _tKey& key, const ValueSlot& data) {
+		//LOOK FOR FREE BUCKET ....................
+		register Bucket* free_bucket( startBucket );
+		register _u32 free_distance(0);
+		for(; free_distance < _INSERT_RANGE; ++free_distance, ++free_bucket) {
+			if( (_tHash::_EMPTY_HASH == free_bucket->_hash) &&	(_tHash::_EMPTY_HASH == _tMemory::compare_and_set(&(free_bucket->_hash), _tHash::_EMPTY_HASH, _tHash::_BUSY_HASH)) )
+				break;
+		}
+
+		//PLACE THE NEW KEY .......................
+		if (free_distance < _INSERT_RANGE) {
+			do {
+				if (free_distance < _HOP_RANGE) {
+					free_bucket->_data   = data;
+					key_of(table, free_bucket) = key;
+					free_bucket->_hash   = hash;
+					startBucket->_hopInfo |= (1U << free_distance);
+					return PLACED;
+				}
+				Bucket* const claimed_bucket( free_bucket );
+				const Placement moved( find_closer_free_backet(&segment, table, &free_bucket, &free_distance) );
+				if (0 == free_bucket) {
+					//release the bucket we hold, or the one a move left behind
+					release_bucket(table, claimed_bucket);
+					return moved;
+				}
+			} while (true);
+		}
+		return FULL;
+	}
+
+	// Grows the table by _RESIZE_FACTOR, unless another thread has already
+	// replaced full_table. The keys are moved one segment at a time, under
+	// that segment's lock, so the other segments keep running on the old or
+	// the new table meanwhile. Must be called without a segment lock held.
+	void resize(Table* const full_table) {
+		_resizeLock.lock();
+		if(full_table != _table) {
+			_resizeLock.unlock();
+			return;
+		}
+
+		Table* const old_table( full_table );
+		Table* const table( new_table((old_table->_bucketMask + 1) * _RESIZE_FACTOR) );
+		table->_retired = old_table;
+		_table = table;
+
+		for (_u32 iSeg = 0; iSeg <= _segmentMask; ++iSeg) {
+			Segment& segment(_segments[iSeg]);
+			segment._lock.lock();
+			for (_u32 iElm = iSeg; iElm <= old_table->_bucketMask; iElm += _segmentMask + 1) {
+				const Bucket* const elmAry( &(old_table->_buckets[iElm]) );
+				_u32 hopInfo( elmAry->_hopInfo );
+				while(0U != hopInfo) {
+					const int i( first_lsb_bit_indx(hopInfo) );
+					const Bucket* const currElm( elmAry + i );
+					const _u32 hash( currElm->_hash );
+					//the writers of the segments moved already only try our lock,
+					//and let theirs go when they fail
+					_u32 backoff( 1 );
+					Placement placed;
+					while( CONTENDED == (placed = add_key(segment, table, &(table->_buckets[hash & table->_bucketMask]), hash, (const _tKey&) key_of(old_table, currElm), currElm->_data)) )
+						back_off(backoff);
+					if( FULL == placed ) {
+						fprintf(stderr, "ERROR - RESIZE could not place a key - capacity %u\n", table->_bucketMask + 1);
+						exit(1);
+					}
+					hopInfo &= ~(1U << i);
+				}
+			}
+			_tMemory::write_barrier();
+			segment._table = table;
+			++(segment._timestamp);
+			segment._lock.unlock();
+		}
+		++_numResizes;
+		_resizeLock.unlock();
 	}
 
 	
@@ -172,170 +437,162 @@ public:// Ctors ................................................................
 
 	BitmapHopscotchHashMap(_u32 inCapacity, _u32 concurrencyLevel) 
 	:	_segmentMask  ( NearestPowerOfTwo(concurrencyLevel) - 1),
-		_segmentShift ( CalcDivideShift(NearestPowerOfTwo(concurrencyLevel/(NearestPowerOfTwo(concurrencyLevel)))-1) )
+		_numResizes	  ( 0 )
 	{
 		//ADJUST INPUT ............................
-		const _u32 adjInitCap = NearestPowerOfTwo(inCapacity);
-		const _u32 adjConcurrencyLevel = NearestPowerOfTwo(concurrencyLevel);
-		const _u32 num_buckets( adjInitCap + _INSERT_RANGE + 1);
-		_bucketMask = adjInitCap - 1;
-		//_segmentShift = first_msb_bit_indx(_bucketMask) - first_msb_bit_indx(_SEGMENTS_MASK);
+		_u32 adjInitCap = NearestPowerOfTwo(inCapacity);
+		if(adjInitCap <= _segmentMask)
+			adjInitCap = _segmentMask + 1;
 
 		//ALLOCATE THE SEGMENTS ...................
+		_table = new_table(adjInitCap);
 		_segments = (Segment*) _tMemory::byte_aligned_malloc( (_segmentMask + 1) * sizeof(Segment) );
-		_table = (Bucket*) _tMemory::byte_aligned_malloc( num_buckets * sizeof(Bucket) );
+		_resizeLock.init();
 
 		Segment* curr_seg = _segments;
 		for (_u32 iSeg = 0; iSeg <= _segmentMask; ++iSeg, ++curr_seg) {
-			curr_seg->init();
-		}
-
-		Bucket* curr_bucket = _table;
-		for (_u32 iElm=0; iElm < num_buckets; ++iElm, ++curr_bucket) {
-			curr_bucket->init();
+			curr_seg->init(_table);
 		}
 	}
 
 	~BitmapHopscotchHashMap() {
-		_tMemory::byte_aligned_free(_table);
+		if(_tOutOfLineData) {
+			Bucket* curr_bucket( _table->_buckets );
+			for (_u32 iElm=0; iElm <= _table->_bucketMask + _INSERT_RANGE; ++iElm, ++curr_bucket) {
+				if(_tHash::_EMPTY_HASH != curr_bucket->_hash)
+					Value::release(curr_bucket->_data, _tHash::_EMPTY_DATA);
+			}
+		}
+
+		Table* table( _table );
+		while (NULL != table) {
+			Table* const retired( table->_retired );
+			_tMemory::byte_aligned_free(table->_buckets);
+			if(NULL != table->_keys)
+				_tMemory::byte_aligned_free((void*) table->_keys);
+			_tMemory::byte_free(table);
+			table = retired;
+		}
 		_tMemory::byte_aligned_free(_segments);
 	}
 
 	// Query Operations .........................................................
-	inline_ bool containsKey(const _tKey key) {
+	inline_ bool containsKey(const _tKey& key) {
 		//CALCULATE HASH ..........................
-		const unsigned int hash( _tHash::Calc(key) );
+		const unsigned int hash( calc_hash(key) );
 
 		//CHECK IF ALREADY CONTAIN ................
-		const	Segment&	segment(_segments[(hash >> _segmentShift) & _segmentMask]);
-		register const Bucket* const elmAry( &(_table[hash & _bucketMask]) );
-		register _u32 hopInfo( elmAry->_hopInfo );
-
-		if(0U ==hopInfo)
-			return false;
-		else if(1U == hopInfo ) {
-			if(hash == elmAry->_hash && _tHash::IsEqual(key, elmAry->_key))
-				return true;
-			else return false;
-		} /*else if(2U == hopInfo) {
-			const Bucket* currElm( elmAry);  ++currElm;
-			if(hash == currElm->_hash && _tHash::IsEqual(key, currElm->_key))
-				return true;
-			else return false;
-		}*/
-
-		const	_u32 startTimestamp( segment._timestamp );
-		while(0U != hopInfo) {
-			register const int i( first_lsb_bit_indx(hopInfo) );
-			register const Bucket* currElm( elmAry + i);
-			if(hash == currElm->_hash && _tHash::IsEqual(key, currElm->_key))
+		//look again whenever a key of the segment moved, or the segment moved
+		//to a new table, while we looked
+		const	Segment&	segment(_segments[hash & _segmentMask]);
+		_u32 startTimestamp;
+		const Table* table;
+		do {
+			startTimestamp = segment._timestamp;
+			table = segment._table;
+			register const Bucket* const elmAry( &(table->_buckets[hash & table->_bucketMask]) );
+			register const _u32 hopInfo( elmAry->_hopInfo );
+
+			if(1U == hopInfo) {
+				if(hash == elmAry->_hash && _tHash::IsEqual(key, key_of(table, elmAry)))
+					return true;
+			} else if(0U != hopInfo && find_in_neighbourhood(table, elmAry, hash, key, hopInfo))
 				return true;
-			hopInfo &= ~(1U << i);
-		} 
 
-		//-----------------------------------------
-		if( segment._timestamp == startTimestamp)
-			return false;
-
-		//-----------------------------------------
-		register const	Bucket* currBucket( &(_table[hash & _bucketMask]) );
-		for(int i(0); i<_HOP_RANGE; ++i, ++currBucket) {
-			if(hash == currBucket->_hash && _tHash::IsEqual(key, currBucket->_key))
-				return true;
-		}
-		return false;
+			if(startTimestamp == segment._timestamp && table == segment._table)
+				return false;
+			RETRY_STAT_INC(TS_RETRY);
+		} while(true);
 	}
 
 	//modification Operations ...................................................
-	inline_ _tData putIfAbsent(const _tKey key,  const _tData data) {
+	inline_ _tData putIfAbsent(const _tKey& key,  const _tData& data) {
 		//CALCULATE HASH ..........................
-		const unsigned int hash( _tHash::Calc(key) );
+		const unsigned int hash( calc_hash(key) );
 
 		//LOCK KEY HASH ENTERY ....................
-		Segment&	segment(_segments[(hash >> _segmentShift) & _segmentMask]);
-		segment._lock.lock();
-		Bucket* const startBucket( &(_table[hash & _bucketMask]) );
-
-		//CHECK IF ALREADY CONTAIN ................
-		register _u32 hopInfo( startBucket->_hopInfo );
-		while(0 != hopInfo) {
-			register const int i( first_lsb_bit_indx(hopInfo) );
-			const Bucket* currElm( startBucket + i);
-			if(hash == currElm->_hash && _tHash::IsEqual(key, currElm->_key)) {
-				register const _tData rc(currElm->_data);
-				segment._lock.unlock();
-				return rc;
+		Segment&	segment(_segments[hash & _segmentMask]);
+		ValueSlot slot( Value::empty_slot(_tHash::_EMPTY_DATA) );
+		bool made( false );
+		_u32 backoff( 1 );
+		do {
+			segment._lock.lock();
+			Table* const table( segment._table );
+			Bucket* const startBucket( &(table->_buckets[hash & table->_bucketMask]) );
+
+			//CHECK IF ALREADY CONTAIN ................
+			register _u32 hopInfo( startBucket->_hopInfo );
+			while(0 != hopInfo) {
+				register const int i( first_lsb_bit_indx(hopInfo) );
+				const Bucket* currElm( startBucket + i);
+				if(hash == currElm->_hash && _tHash::IsEqual(key, key_of(table, currElm))) {
+					const _tData rc( Value::get(currElm->_data) );
+					segment._lock.unlock();
+					if(made)
+						Value::release(slot, _tHash::_EMPTY_DATA);
+					return rc;
+				}
+				hopInfo &= ~(1U << i);
 			}
-			hopInfo &= ~(1U << i);
-		}
 
-		//LOOK FOR FREE BUCKET ....................
-		register Bucket* free_bucket( startBucket );
-		register _u32 free_distance(0);
-		for(; free_distance < _INSERT_RANGE; ++free_distance, ++free_bucket) {
-			if( (_tHash::_EMPTY_HASH == free_bucket->_hash) &&	(_tHash::_EMPTY_HASH == _tMemory::compare_and_set(&(free_bucket->_hash), _tHash::_EMPTY_HASH, _tHash::_BUSY_HASH)) )
-				break;
-		}
+			//PLACE THE NEW KEY .......................
+			if(!made) {
+				slot = Value::make(data);
+				made = true;
+			}
+			const Placement placed( add_key(segment, table, startBucket, hash, key, slot) );
+			segment._lock.unlock();
+			if( PLACED == placed )
+				return _tHash::_EMPTY_DATA;
 
-		//PLACE THE NEW KEY .......................
-		if (free_distance < _INSERT_RANGE) {
-			do {
-				if (free_distance < _HOP_RANGE) {
-					free_bucket->_data   = data;
-					free_bucket->_key		= key;
-					free_bucket->_hash   = hash;
-					startBucket->_hopInfo |= (1U << free_distance);
-					segment._lock.unlock();
-					return _tHash::_EMPTY_DATA;
-				}
-				find_closer_free_backet(&segment, &free_bucket, &free_distance);
-			} while (0 != free_bucket);
-		}
+			//ANOTHER WRITER HOLDS THE KEYS TO MOVE ...
+			if( CONTENDED == placed ) {
+				back_off(backoff);
+				continue;
+			}
 
-		//NEED TO RESIZE ..........................
-		fprintf(stderr, "ERROR - RESIZE is not implemented - size %u\n", size());
-		exit(1);
-		return _tHash::_EMPTY_DATA;
+			//NEED TO RESIZE ..........................
+			resize(table);
+		} while(true);
 	}
 
-	inline_ _tData remove( const _tKey key ) {
+	inline_ _tData remove( const _tKey& key ) {
 		//CALCULATE HASH ..........................
-		const unsigned int hash( _tHash::Calc(key) );
+		const unsigned int hash( calc_hash(key) );
 
 		//CHECK IF ALREADY CONTAIN ................
-		Segment&	segment( _segments[(hash >> _segmentShift) & _segmentMask] );
+		Segment&	segment( _segments[hash & _segmentMask] );
 		segment._lock.lock();
-		Bucket* const	startBucket( &(_table[hash & _bucketMask]) );
+		Table* const	table( segment._table );
+		Bucket* const	startBucket( &(table->_buckets[hash & table->_bucketMask]) );
 		register _u32 hopInfo( startBucket->_hopInfo );
 
 		if(0U ==hopInfo) {
 			segment._lock.unlock();
-			return false;
+			return _tHash::_EMPTY_DATA;
 		} else if(1U == hopInfo) {
-			if(hash == startBucket->_hash && _tHash::IsEqual(key, startBucket->_key)) {
+			if(hash == startBucket->_hash && _tHash::IsEqual(key, key_of(table, startBucket))) {
 				startBucket->_hopInfo &= ~1U;
-				startBucket->_hash = _tHash::_EMPTY_HASH;
-				startBucket->_key = _tHash::_EMPTY_KEY;
-				register const _tData rc(startBucket->_data);
-				startBucket->_data = _tHash::_EMPTY_DATA;
+				const _tData rc( Value::get(startBucket->_data) );
+				Value::release(startBucket->_data, _tHash::_EMPTY_DATA);
+				release_bucket(table, startBucket);
 				segment._lock.unlock();
 				return rc;
 			} else {
 				segment._lock.unlock();
-				return false;
+				return _tHash::_EMPTY_DATA;
 			}
 		}
 
 		do {
 			register const int i( first_lsb_bit_indx(hopInfo) );
 			Bucket* currElm( startBucket + i);
-			if(hash == currElm->_hash && _tHash::IsEqual(key, currElm->_key)) {
+			if(hash == currElm->_hash && _tHash::IsEqual(key, key_of(table, currElm))) {
 				register _u32 mask(1); mask <<= i;
 				startBucket->_hopInfo &= ~(mask);
-				currElm->_hash = _tHash::_EMPTY_HASH;
-				currElm->_key = _tHash::_EMPTY_KEY;
-				register const _tData rc(currElm->_data);
-				currElm->_data = _tHash::_EMPTY_DATA;
+				const _tData rc( Value::get(currElm->_data) );
+				Value::release(currElm->_data, _tHash::_EMPTY_DATA);
+				release_bucket(table, currElm);
 				segment._lock.unlock();
 				return rc;
 			}
@@ -351,15 +608,39 @@ public:// Ctors ................................................................
 	//status Operations .........................................................
 	_u32 size()	{
 		_u32 counter = 0;
-		const _u32 num_elm( _bucketMask + _INSERT_RANGE );
+		const Table* const table( _table );
+		const _u32 num_elm( table->_bucketMask + _INSERT_RANGE );
 		for(_u32 iElm=0; iElm < num_elm; ++iElm) {
-			if( _tHash::_EMPTY_HASH != _table[iElm]._hash ) {
+			if( _tHash::_EMPTY_HASH != table->_buckets[iElm]._hash ) {
 				++counter;
 			}
 		}
 		return counter;
 	}   
 
+	//number of buckets in the current table, and number of times it grew
+	_u32 capacity() {
+		return _table->_bucketMask + 1;
+	}
+
+	_u32 numResizes() {
+		return _numResizes;
+	}
+
+	//the bytes of the map, by part (see MapMemory.h); quiesce the writers first
+	MapMemory memory() {
+		MapMemory mem;
+		const _u32 num_segments( _segmentMask + 1 );
+		mem._table = sizeof(*this) - sizeof(_tLock) + table_bytes(_table)
+		           + num_segments * (sizeof(Segment) - sizeof(_tLock));
+		mem._locks = (num_segments + 1) * sizeof(_tLock);
+		if(_tOutOfLineData)
+			mem._overflow = size() * sizeof(_tData);
+		for (const Table* table( _table->_retired ); NULL != table; table = table->_retired)
+			mem._garbage += table_bytes(table);
+		return mem;
+	}
+
 	//public final boolean isEmpty();
 
 private:
@@ -27,6 +27,8 @@
 // CLASS: ConcurrentHashMap
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "MapMemory.h"
+
 #define MINIMUM_CAPACITY 		(32) 
 #define MAXIMUM_CAPACITY 		(1 << 30) 
 #define DEFAULT_LOAD_FACTOR   (3) 
@@ -38,6 +40,12 @@ template <typename _tKey,
 			 typename _tMemory>
 class ChainedHashMap {
 private:
+	// CONSTANTS ...............................................................
+	// Entries are taken from a per segment pool, which is refilled with blocks
+	// of _MIN_BATCH entries, doubling with every refill up to _MAX_BATCH.
+	static const unsigned int _MIN_BATCH = 64;
+	static const unsigned int _MAX_BATCH = 4096;
+
 	// INNER CLASSES ...........................................................
 	struct Entry {
 		unsigned int	volatile	_hash;
@@ -46,10 +54,44 @@ private:
 		_tData			volatile	_value;
 	};
 
+	// A block of entries; the header fills a cache-line, so the entries of
+	// a block start on one.
+	struct Block {
+		Block*	_next;
+		char		_pad[CACHE_LINE_SIZE - sizeof(Block*)];
+
+		Entry* entries() {
+			return (Entry*)(this + 1);
+		}
+	};
+
+	// The bins of a table, and the tables it replaced. Those are only freed
+	// with the map, since containsKey doesn't lock; so are the entries a
+	// resize cloned out of a retired table's lists, _cloned of them, which
+	// never go back to the pools.
+	struct Table {
+		Entry**			_bins;
+		unsigned int	_mask;
+		Table*			_retired;
+		unsigned int	_cloned;
+	};
+
+	// A key belongs to the segment of the low bits of its hash, so its segment
+	// is the same in every table. The pool is a LIFO of free entries linked by
+	// _next; it is only used under the segment lock, and its entries are only
+	// returned to the system with the map. Entries are thus type stable, and
+	// a lookup never reads freed memory: one that races the remove of an entry
+	// may follow it into the pool, or into the list it was reused in, and
+	// miss. A resize reuses no entry, so a lookup still walking the retired
+	// table finds every key that was in it.
 	struct Segment {
 		unsigned int volatile	_count;
-		unsigned int volatile	_start_indx;
-		_tLock _lock;
+		bool volatile				_voted;
+		_tLock						_lock;
+		Entry*						_free;
+		Block*						_blocks;
+		unsigned int				_batch;
+		size_t						_blockBytes;
 
 		void Lock() {
 			_lock.lock();
@@ -57,22 +99,18 @@ private:
 		void Unlock() {
 			_lock.unlock();
 		}
-	};
+	} __attribute__((aligned(CACHE_LINE_SIZE)));
 
 	// PROPERTIES ..............................................................
-	float				_loadFactor;
-	int				_threshold;
-	int volatile	_votesForResize;
-	unsigned int	_freeSegSize;
-	int				_bucketMask;
+	float						_loadFactor;
+	int						_threshold;
+	_u32 volatile			_votesForResize;
+	unsigned int			_resizeQuorum;
+	unsigned int volatile	_numResizes;
 
-	unsigned int				_segmentShift;
-	unsigned int volatile*	_iFree;
-	Entry** volatile		   _table;
-	unsigned int volatile	_tablesize;
+	Table* volatile		_table;
 
 	int				_segmentMask;
-	Entry**			_freeList;
 	Segment*			_segments;
 
 	// UTILITIES ................................................................
@@ -86,112 +124,98 @@ private:
 		return rc;
 	}
 
-	inline_ static unsigned int CalcDivideShift(const unsigned int _value) {
-		unsigned int numShift( 0 );
-		unsigned int curr( 1 );
-		while (curr < _value) {
-			curr <<= 1;
-			++numShift;
-		}
-		return numShift;
-	}
-
-	static int bitcount(int w)
-	{
-		w -= (0xaaaaaaaa & w) >> 1;
-		w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
-		w = (w + (w >> 4)) & 0x0f0f0f0f;
-		w += w >> 8;
-		w += w >> 16;
-		return w & 0xff;
+	Table* CreateNewTable(int capacity) {
+		if(_loadFactor > 0)
+			_threshold = (int)( (capacity * _loadFactor) / (_segmentMask+1)) + 1;
+		else
+			_threshold = INT_MAX;
+		//fprintf(stderr, "	CreateNewTable: capacity = %d, _threshold = %d\n", capacity, _threshold);
+		Table* newTable = (Table*)_tMemory::byte_malloc( sizeof(Table) + capacity * sizeof(Entry*) );
+		newTable->_bins = (Entry**)(newTable + 1);
+		newTable->_mask = capacity - 1;
+		newTable->_retired = NULL;
+		newTable->_cloned = 0;
+		memset(newTable->_bins, 0, capacity * sizeof(Entry *));
+		return newTable;
 	}
 
-	static int p2capacity(int initialCapacity)
-	{
-		int cap = initialCapacity;
-
-		// Compute the appropriate capacity
-		int result;
-		if (cap > MAXIMUM_CAPACITY || cap < 0) {
-			result = MAXIMUM_CAPACITY;
-		} else {
-			result = MINIMUM_CAPACITY;
-			while (result < cap)
-				result <<= 1;
+	// Pushes a block of num_entries new entries to the pool of the segment, in
+	// reverse so that they are handed out in address order.
+	void RefillEntries(Segment& segment, const unsigned int num_entries) {
+		const size_t bytes( sizeof(Block) + num_entries * sizeof(Entry) );
+		Block* const block( (Block*)_tMemory::byte_aligned_malloc(bytes) );
+		segment._blockBytes += bytes;
+		block->_next = segment._blocks;
+		segment._blocks = block;
+
+		Entry* const entries( block->entries() );
+		for (unsigned int iElm(num_entries); iElm > 0; --iElm) {
+			entries[iElm - 1]._next = segment._free;
+			segment._free = &(entries[iElm - 1]);
 		}
-		return result;
-	}
-
-	Entry** CreateNewTable(int capacity) {
-		_threshold = (int)( (capacity * _loadFactor) / (_segmentMask+1)) + 1;
-		//fprintf(stderr, "	CreateNewTable: capacity = %d, _threshold = %d\n", capacity, _threshold);
-		Entry **newTable = (Entry **)_tMemory::byte_malloc( capacity * sizeof(Entry*) );
-		memset(newTable, 0, capacity * sizeof(Entry *));
-		return newTable;
 	}
 
 	inline_ Entry* GetNewEntry(const unsigned int iSegment) {
-		if(0 != _freeList) {
-			unsigned int numChecked( 0 );
-			unsigned int iCheckFree( _iFree[iSegment] );
-			unsigned int iFoundFree(0);
-			bool isFound(false);
-			do {
-				if(0 == _freeList[iSegment][iCheckFree]._hash && 0 == _freeList[iSegment][iCheckFree]._key && 0 == _freeList[iSegment][iCheckFree]._value) {
-					iFoundFree = iCheckFree;
-					isFound = true;
-				}
-
-				++iCheckFree;
-				if(iCheckFree >= _freeSegSize)
-					iCheckFree = 0;
-				++numChecked;
-			} while( /*numChecked < 20 ||*/ !isFound);
-
-			_iFree[iSegment] = iFoundFree;
-			return &(_freeList[iSegment][iFoundFree]);
-		}
-		else {
-			return (Entry*) _tMemory::byte_malloc(sizeof(Entry));
+		Segment& segment( _segments[iSegment] );
+		if(NULL == segment._free) {
+			RefillEntries(segment, segment._batch);
+			if(segment._batch < _MAX_BATCH)
+				segment._batch <<= 1;
 		}
+		Entry* const ent( segment._free );
+		segment._free = ent->_next;
+		return ent;
 	}
 
-	inline_ void FreeEntry(Entry* ent) {
-		if(0 == _freeList) {
-			_tMemory::byte_free(ent);
-		}
-		else {
-			ent->_hash  = 0;
-			ent->_key   = 0;
-			ent->_next  = 0;
-			ent->_value = 0;
-		}
+	inline_ void FreeEntry(const unsigned int iSegment, Entry* ent) {
+		Segment& segment( _segments[iSegment] );
+		ent->_next = segment._free;
+		segment._free = ent;
 	}
 
-	void resize() {
-		fprintf(stderr, "	resize\n");
+	// Grows the table, unless another thread has already replaced full_table.
+	// Must be called without a segment lock held.
+	void resize(Table* const full_table) {
+		//fprintf(stderr, "	resize\n");
 		int i, j;
 
-		Entry **assumedTable = _table;
 		for (i = 0; i < (_segmentMask+1); ++i) {
-			if (assumedTable != _table)
+			if (full_table != _table)
 				break;
 			_segments[i].Lock();
 		}
 
-		if (i == (_segmentMask+1))
+		if (i == (_segmentMask+1) && full_table == _table)
 			rehash();
 
 		for (j = 0; j < i; ++j)
 			_segments[j].Unlock();
 	}
 
+	// The trailing run of e's list whose entries all go to the same bin of a
+	// table of mask + 1 bins; it moves as is, the entries before it are cloned.
+	inline_ static Entry* LastRun(Entry* e, const int mask) {
+		Entry *lastRun = e;
+		int lastIdx = e->_hash & mask;
+		for (Entry *last = e->_next; last != NULL; last = last->_next) {
+			int k = last->_hash & mask;
+			if (k != lastIdx) {
+				lastIdx = k;
+				lastRun = last;
+			}
+		}
+		return lastRun;
+	}
+
 	void rehash() {
-		fprintf(stderr, "	rehash\n");
+		//fprintf(stderr, "	rehash\n");
 		_votesForResize = 0; // reset
+		for (int i = 0; i < (_segmentMask+1); ++i)
+			_segments[i]._voted = false;
 
-		Entry **oldTable = _table;
-		int oldCapacity = _tablesize;
+		Table* oldTable = _table;
+		Entry **oldBins = oldTable->_bins;
+		int oldCapacity = oldTable->_mask + 1;
 
 		if (oldCapacity >= MAXIMUM_CAPACITY) {
 			_threshold = INT_MAX; // avoid re-triggering
@@ -199,122 +223,95 @@ private:
 		}
 
 		int newCapacity = oldCapacity << 1;
-		Entry **newTable = CreateNewTable(newCapacity);
+		Table* newTable = CreateNewTable(newCapacity);
+		Entry **newBins = newTable->_bins;
 		int mask = newCapacity - 1;
 
 		for (int i = 0; i < oldCapacity ; i++) {
 			// We need to guarantee that any existing reads of old Map can
 			//  proceed. So we cannot yet null out each bin.  
-			Entry *e = oldTable[i];
+			Entry *e = oldBins[i];
 
 			if (e != NULL) {
-				int idx = e->_hash & mask;
-				Entry *_next = e->_next;
-
-				//  Single node on list
-				if (_next == NULL) {
-					newTable[idx] = e;
-					oldTable[i] = NULL;
+				// Reuse trailing consecutive sequence of all same bit
+				Entry *lastRun = LastRun(e, mask);
+				newBins[lastRun->_hash & mask] = lastRun;
+
+				// Clone all remaining nodes
+				for (Entry *p = e; p != lastRun; p = p->_next) {
+					int k = p->_hash & mask;
+					Entry *newnode = GetNewEntry(p->_hash & _segmentMask);
+					newnode->_hash = p->_hash;
+					newnode->_key = p->_key;
+					newnode->_value = p->_value;
+					newnode->_next = newBins[k];
+					newBins[k] = newnode;
+					++(oldTable->_cloned);
 				}
-				else {    
-					// Reuse trailing consecutive sequence of all same bit
-					Entry *lastRun = e;
-					int lastIdx = idx;
-					for (Entry *last = _next; last != NULL; last = last->_next) {
-						int k = last->_hash & mask;
-						if (k != lastIdx) {
-							lastIdx = k;
-							lastRun = last;
-						}
-					}
-					newTable[lastIdx] = lastRun;
-
-					// Clone all remaining nodes
-					Entry *beforep = NULL;
-					Entry *newnode;
-					for (Entry *p = e; p != lastRun; beforep = p, p = p->_next) {
-						int k = p->_hash & mask;
-						newnode = (Entry*) _tMemory::byte_malloc(sizeof(Entry));
-						newnode->_key = p->_key;
-						newnode->_next = newTable[k];
-						newTable[k] = newnode;
-					}
-					if (beforep)
-						beforep->_next = NULL;
-					else
-						oldTable[i] = NULL;
-				}
-			}
-			Entry *head = oldTable[i];
-			Entry *_next;
-			while (head) {
-				_next = head->_next;
-				_tMemory::byte_free(head);
-				head = _next;
 			}
 		}
 
-		delete [] oldTable;
+		// The old bins and the cloned nodes stay as they are, lookups may
+		// still be walking them
+		newTable->_retired = oldTable;
+		_tMemory::write_barrier();
 		_table = newTable;
-		_tablesize = newCapacity;
+		++_numResizes;
 	}
 
 public:
 	// Ctors ...................................................................
 	ChainedHashMap(const int	initial_capacity	= 32*1024,	//Use the maximum number of keys you are going to use
 						const int	concurrency_level	= 16,		//Number of updating threads
-						float			loadFactor			= 0.75,
-						bool			isPreAlloc			= false)
-	:	_segmentMask  ( NearestPowerOfTwo(concurrency_level) - 1),
-		_segmentShift ( CalcDivideShift(NearestPowerOfTwo(initial_capacity/(NearestPowerOfTwo(concurrency_level)))-1) ),
-		_bucketMask	  ( NearestPowerOfTwo(initial_capacity/(NearestPowerOfTwo(concurrency_level)))-1 )
+						float			loadFactor			= 0.75,	//Keys per bin that make a segment vote to resize, 0 never resizes
+						bool			isPreAlloc			= false,	//Fill the entry pools for 2*initial_capacity keys upfront
+						const int	resize_quorum		= 0)		//Votes that start a resize, 0 for a quarter of the segments
+	:	_segmentMask  ( NearestPowerOfTwo(concurrency_level) - 1)
 	{
 		_loadFactor = loadFactor;
+		_votesForResize = 0;
+		_numResizes = 0;
+		_resizeQuorum = (resize_quorum > 0) ? resize_quorum : (_segmentMask+1) / 4;
+		if (_resizeQuorum < 1)
+			_resizeQuorum = 1;
+		if (_resizeQuorum > (unsigned int)(_segmentMask+1))
+			_resizeQuorum = _segmentMask+1;
 
-		_segments =  (Segment*) _tMemory::byte_malloc((_segmentMask+1)*sizeof(Segment));
-		int curr_seg_start_indx=0;
-		for (int i = 0; i <= _segmentMask; ++i) {
-			_segments[i]._lock.init();
-			_segments[i]._count = 0;
-			_segments[i]._start_indx = curr_seg_start_indx;
-			curr_seg_start_indx += (_bucketMask+1);
-		}
 		int cap = NearestPowerOfTwo(initial_capacity);
+		if (cap < _segmentMask+1)
+			cap = _segmentMask+1;
 		_table = CreateNewTable(cap);
-		_tablesize = cap;
-		_votesForResize = 0;
 
-		if(isPreAlloc) {
-			_freeSegSize = (unsigned int) (((2*cap)/(_segmentMask+1)));
-			_freeList	= (Entry**)_tMemory::byte_malloc((_segmentMask+1)*sizeof(Entry*));
-			_iFree		= (unsigned int*)_tMemory::byte_malloc((_segmentMask+1)*sizeof(unsigned int));
-			for (int iSeg(0); iSeg < (_segmentMask+1); ++iSeg) {
-				_freeList[iSeg] = (Entry*)_tMemory::byte_malloc(_freeSegSize*sizeof(Entry));
-				_iFree[iSeg] = 0;
-				for (unsigned int iElm(0); iElm < _freeSegSize; ++iElm) {
-					_freeList[iSeg][iElm]._hash  = 0;
-					_freeList[iSeg][iElm]._key   = 0;
-					_freeList[iSeg][iElm]._next  = 0;
-					_freeList[iSeg][iElm]._value = 0;
-				}
-			}
+		_segments =  (Segment*) _tMemory::byte_aligned_malloc((_segmentMask+1)*sizeof(Segment));
+		for (int i = 0; i <= _segmentMask; ++i) {
+			_segments[i]._lock.init();
+			_segments[i]._count = 0;
+			_segments[i]._voted = false;
+			_segments[i]._free = NULL;
+			_segments[i]._blocks = NULL;
+			_segments[i]._batch = _MIN_BATCH;
+			_segments[i]._blockBytes = 0;
+			if(isPreAlloc)
+				RefillEntries(_segments[i], (unsigned int) ((2*cap)/(_segmentMask+1)));
 		}
-		else _freeList=0;
 	}
 
 	~ChainedHashMap() {
-		clear();
 		for (int i = 0; i <= _segmentMask; ++i) {
-			_segments[i]._lock.init();
-		}
-		_tMemory::byte_free(_segments);
-		_tMemory::byte_free(_table);
-		if(0 != _freeList) {
-			for (int i(0); i < (_segmentMask+1); ++i) {
-				_tMemory::byte_free(_freeList[i]);
-				_iFree[i] = 0;
+			Block* block( _segments[i]._blocks );
+			while(NULL != block) {
+				Block* const next_block( block->_next );
+				_tMemory::byte_aligned_free(block);
+				block = next_block;
 			}
-			_tMemory::byte_free(_freeList);
+		}
+		_tMemory::byte_aligned_free(_segments);
+
+		Table* table( _table );
+		while(NULL != table) {
+			Table* const retired( table->_retired );
+			_tMemory::byte_free(table);
+			table = retired;
 		}
 	}
 
@@ -323,9 +320,8 @@ public:
 		const unsigned int hkey( _tHash::Calc(key) ); 
 
 		// Try first without locking...
-		const unsigned int iSegment(( hkey >> _segmentShift) & _segmentMask);
-		Segment& segment( _segments[iSegment] );
-		Entry *first = _table[ (hkey & _bucketMask) + _segments[iSegment]._start_indx];
+		const Table* const table( _table );
+		Entry *first = table->_bins[hkey & table->_mask];
 		Entry *e;
 
 		for (e = first; e != NULL; e = e->_next) {
@@ -338,14 +334,15 @@ public:
 	// Modification Operations .................................................
 	inline_ _tData putIfAbsent(const _tKey& key,  const _tData& data) {
 		const unsigned int hkey( _tHash::Calc(key) ); 
-		const unsigned int iSegment(( hkey >> _segmentShift) & _segmentMask);
+		const unsigned int iSegment( hkey & _segmentMask );
 		Segment& segment( _segments[iSegment] );
 		segment.Lock();
 
 		int segcount;
-		int votes;
-		int index = (hkey & _bucketMask) + _segments[iSegment]._start_indx;
-		Entry *first = _table[index];
+		unsigned int votes;
+		Table* const table( _table );
+		int index = hkey & table->_mask;
+		Entry *first = table->_bins[index];
 
 		for (Entry *e = first; e != NULL; e = e->_next) {
 			if (hkey == e->_hash && e->_key == key) {
@@ -361,95 +358,91 @@ public:
 		newEntry->_key = key;
 		newEntry->_value = data;
 		newEntry->_next = first;
-		_table[index] = newEntry;
+		_tMemory::write_barrier();
+		table->_bins[index] = newEntry;
 
-		if ((segcount = ++_segments[iSegment]._count) < _threshold) {
+		if ((segcount = ++segment._count) < _threshold) {
 			segment.Unlock();
-			return NULL;
+			return _tHash::_EMPTY_DATA;
 		}
 
-		int bit = (1 << (hkey & _segmentMask));
+		// Each segment votes once per table
 		votes = _votesForResize;
-		if ((votes & bit) == 0)
-			votes = _votesForResize |= bit;
+		if (!segment._voted) {
+			segment._voted = true;
+			do {
+				votes = _votesForResize;
+			} while (votes != _tMemory::compare_and_set(&_votesForResize, votes, votes + 1));
+			++votes;
+		}
 
 		segment.Unlock();
 
-		// Attempt resize if 1/4 segments vote,
+		// Attempt resize if _resizeQuorum segments vote,
 		// or if this segment itself reaches the overall _threshold.
 		// (The latter check is just a safeguard to avoid pathological cases.)
-		if (bitcount(votes) >= ((_segmentMask+1) / 4)  || segcount > (_threshold * (_segmentMask+1))) 
-			resize();
+		if (votes >= _resizeQuorum  || segcount > (_threshold * (_segmentMask+1))) 
+			resize(table);
 
-		return NULL;
+		return _tHash::_EMPTY_DATA;
 	}
 
 	inline_ _tData remove(const _tKey& key) {
 		const unsigned int hkey( _tHash::Calc(key) ); 
-		const unsigned int  iSegment  (( hkey >> _segmentShift) & _segmentMask);
+		const unsigned int  iSegment  ( hkey & _segmentMask );
 		Segment&            segment   ( _segments[iSegment] );
 		segment.Lock();
 
-		int index = (hkey & _bucketMask) + _segments[iSegment]._start_indx;
-		Entry *first = _table[index];
-		Entry *e = first;
+		Table* const table( _table );
+		int index = hkey & table->_mask;
+		Entry* volatile* prev = &(table->_bins[index]);
+		Entry *e = *prev;
 
 		for (;;) {
 			if (e == NULL) {
 				segment.Unlock();
-				return NULL;
+				return _tHash::_EMPTY_DATA;
 			}
 			if (hkey == e->_hash && e->_key == key)
 				break;
+			prev = &(e->_next);
 			e = e->_next;
 		}
 
-		// All entries following removed node can stay in list, 
-		// but all preceding ones need to be cloned.
+		// Unlink in place; a lookup standing on e still finds the rest of
+		// the list through it, until e is reused.
 		_tData rc(e->_value);
-		Entry* newFirst = e->_next;
-		Entry* needDel[16];
-		int	   numNeedDel(1);
-		needDel[0] = e;
-		for (Entry* p = first; p != e; ) {
-			Entry* newEntry		= GetNewEntry(iSegment);
-			newEntry->_hash		= p->_hash;
-			newEntry->_key			= p->_key;
-			newEntry->_value		= p->_value;
-			newEntry->_next		= newFirst;
-			newFirst = newEntry;
-			needDel[numNeedDel++] = p;
-			p = p->_next;
-		}
-		_table[index] = newFirst;
-		--(_segments[iSegment]._count);
-		//
-		// IMPORTANT: here we need to ALIGNED_FREE "e", but there is no memory management
-		//
-		for (int i(0); i<numNeedDel; ++i) {
-			FreeEntry(needDel[i]);
-		}
+		*prev = e->_next;
+		--(segment._count);
+		FreeEntry(iSegment, e);
 		segment.Unlock();
 		return rc;
 	}
 
 	// .........................................................................
 	void clear() {
-		for (unsigned int iElm(0); iElm <_tablesize; ++iElm) {
-			Entry* elm = _table[iElm];
+		for (int i = 0; i <= _segmentMask; ++i)
+			_segments[i].Lock();
+
+		Table* const table( _table );
+		for (unsigned int iElm(0); iElm <= table->_mask; ++iElm) {
+			Entry* elm = table->_bins[iElm];
+			table->_bins[iElm] = NULL;
 			while(NULL != elm) {
 				Entry* nextElm = elm->_next;
-				FreeEntry(elm);
+				FreeEntry(elm->_hash & _segmentMask, elm);
 				elm = nextElm ;
 			}
 		}
 
 		for (int i(0); i < (_segmentMask+1); ++i) {
-			_segments[i]._lock.init();
 			_segments[i]._count = 0;
+			_segments[i]._voted = false;
 		}
+		_votesForResize = 0;
 
-		memset(_table, 0, _tablesize * sizeof(Entry *));
+		for (int i = 0; i <= _segmentMask; ++i)
+			_segments[i].Unlock();
 	}
 
 	unsigned int size() {
@@ -468,6 +461,32 @@ public:
 		return true;
 	}
 
+	unsigned int capacity() {
+		return _table->_mask + 1;
+	}
+
+	unsigned int numResizes() {
+		return _numResizes;
+	}
+
+	//the bytes of the map, by part (see MapMemory.h): the entry pools, free
+	//entries included, are _overflow, but for the entries that resizes cloned,
+	//which are _garbage. Quiesce the writers first.
+	MapMemory memory() {
+		MapMemory mem;
+		const size_t num_segments( _segmentMask + 1 );
+		mem._table = sizeof(*this) + sizeof(Table) + (_table->_mask + 1) * sizeof(Entry*)
+		           + num_segments * (sizeof(Segment) - sizeof(_tLock));
+		mem._locks = num_segments * sizeof(_tLock);
+		for (size_t i = 0; i < num_segments; ++i)
+			mem._overflow += _segments[i]._blockBytes;
+		for (const Table* table( _table->_retired ); NULL != table; table = table->_retired) {
+			mem._garbage  += sizeof(Table) + (table->_mask + 1) * sizeof(Entry*) + table->_cloned * sizeof(Entry);
+			mem._overflow -= table->_cloned * sizeof(Entry);
+		}
+		return mem;
+	}
+
 };
 
 #endif
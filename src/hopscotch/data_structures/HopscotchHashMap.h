@@ -35,8 +35,12 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <stdio.h>
 #include <limits.h>
+#include <stdlib.h>
 #include "math.h"
 #include "memory.h"
+#include "HopscotchTraits.h"
+#include "MapMemory.h"
+#include "retry_stats.h"
 #include<iostream>
 using namespace std;
 ////////////////////////////////////////////////////////////////////////////////
@@ -46,6 +50,8 @@ using namespace std;
 ////////////////////////////////////////////////////////////////////////////////
 //INNER CLASSES
 ////////////////////////////////////////////////////////////////////////////////
+#ifndef __HASH_INT__
+#define __HASH_INT__
 class HASH_INT {
 public:
 	//you must define the following fields and properties
@@ -62,90 +68,154 @@ public:
 		key ^= (key <<  2) + (key << 14);
 		key ^= (key >> 16);
 		return key;
-	}
+	} 
 
 	inline static bool IsEqual(int left_key, int right_key) {
 		return left_key == right_key;
-	}
+	} 
 
 	inline static void relocate_key_reference(int volatile& left, const int volatile& right) {
 		left = right;
-	}
+	} 
 
 	inline static void relocate_data_reference(int volatile& left, const int volatile& right) {
 		left = right;
-	}
+	} 
 };
 const unsigned int HASH_INT::_EMPTY_HASH = 0;
 const unsigned int HASH_INT::_BUSY_HASH  = 1;
 const int HASH_INT::_EMPTY_KEY  = 0;
 const int HASH_INT::_EMPTY_DATA = 0;
+#endif
 template <typename	_tKey, 
           typename	_tData,
 			 typename	_tHash,
           typename	_tLock,
-			 typename	_tMemory>
+			 typename	_tMemory,
+			 bool			_tOutOfLineData = false>
 class HopscotchHashMap {
 private:
 
 	// Inner Classes ............................................................
+	// Values are kept in the bucket, or with _tOutOfLineData behind a pointer
+	typedef HopValue<_tData, _tMemory, _tOutOfLineData>	Value;
+	typedef typename Value::_tSlot								ValueSlot;
+	typedef typename HopStorage<_tKey>::type					KeySlot;
+
 	struct Bucket {
 		short				volatile _first_delta;
 		short				volatile _next_delta;
 		unsigned int	volatile _hash;
-		_tKey				volatile _key;
-		_tData			volatile _data;
+		KeySlot					 _key;
+		ValueSlot				 _data;
 
 		void init() {
 			_first_delta	= _NULL_DELTA;
 			_next_delta		= _NULL_DELTA;
 			_hash				= _tHash::_EMPTY_HASH;
 			_key				= _tHash::_EMPTY_KEY;
-			_data				= _tHash::_EMPTY_DATA;
+			_data				= Value::empty_slot(_tHash::_EMPTY_DATA);
 		}
 	};
 
+	// A bucket array. When the table grows, each segment's keys are moved to
+	// the new table in turn, and the tables they left are chained through
+	// _retired. Those are only freed with the map, since readers don't lock
+	// and may still be scanning them.
+	struct Table {
+		Bucket*	_buckets;
+		_u32		_bucketMask;
+		Table*	_retired;
+	};
+
+	// A key's segment is picked by the low bits of its hash, which are also
+	// the low bits of its home bucket, so it does not change when the table
+	// grows. _table is the table the segment's keys are in.
 	struct Segment {
-		_u32 volatile	_timestamp;
+		_u32   volatile	_timestamp;
+		Table* volatile	_table;
 		_tLock	      _lock;
 
-		void init() {
+		void init(Table* const table) {
 			_timestamp = 0;
+			_table = table;
 			_lock.init();
 		}
 	};
 
 	// Fields ...................................................................
-	_u32 volatile		_segmentShift;
 	_u32 volatile		_segmentMask;
-	_u32 volatile		_bucketMask;
 	Segment*	volatile	_segments;
-	Bucket* volatile	_table;
+	Table* volatile	_table;
+	_tLock				_resizeLock;
+	_u32 volatile		_numResizes;
 
 	const int			_cache_mask;
 	const bool			_is_cacheline_alignment;
 
 	// Constants ................................................................
 	static const _u32 _INSERT_RANGE  = 1024*4;
-	//static const _u32 _NUM_SEGMENTS	= 1024*1;
-	//static const _u32 _SEGMENTS_MASK = _NUM_SEGMENTS-1;
 	static const _u32 _RESIZE_FACTOR = 2;
 
 	// Small Utilities ..........................................................
-	Bucket* get_start_cacheline_bucket(Bucket* const bucket) {
-		return (bucket - ((bucket - _table) & _cache_mask)); //can optimize 
+	// The hash of a key, also kept in its bucket as a fingerprint. The hashes
+	// that mark a bucket free or busy are moved to the next value.
+	static unsigned int calc_hash(const _tKey& key) {
+		unsigned int hash( _tHash::Calc(key) );
+		while(_tHash::_EMPTY_HASH == hash || _tHash::_BUSY_HASH == hash)
+			++hash;
+		return hash;
+	} 
+
+	Bucket* get_start_cacheline_bucket(const Table* const table, Bucket* const bucket) {
+		return (bucket - ((bucket - table->_buckets) & _cache_mask)); //can optimize
+	} 
+
+	Segment& get_segment(const Table* const table, const Bucket* const bucket) {
+		return _segments[(bucket - table->_buckets) & _segmentMask];
+	} 
+
+	// Buckets are shared by all the segments, so a free bucket is claimed by
+	// moving its hash from empty to busy before the new key is written in.
+	static bool claim_bucket(Bucket* const bucket) {
+		return _tHash::_EMPTY_HASH == bucket->_hash &&
+		       _tHash::_EMPTY_HASH == _tMemory::compare_and_set(&(bucket->_hash), _tHash::_EMPTY_HASH, _tHash::_BUSY_HASH);
+	} 
+
+	// Empties a bucket, releasing it to be claimed again only once its other
+	// fields are cleared.
+	static void release_bucket(Bucket* const bucket) {
+		_tHash::relocate_key_reference(bucket->_key, _tHash::_EMPTY_KEY);
+		bucket->_data = Value::empty_slot(_tHash::_EMPTY_DATA);
+		bucket->_next_delta = _NULL_DELTA;
+		_tMemory::write_barrier();
+		bucket->_hash = _tHash::_EMPTY_HASH;
+	} 
+
+	static size_t table_bytes(const Table* const table) {
+		return sizeof(Table) + (table->_bucketMask + 1 + _INSERT_RANGE + 1) * sizeof(Bucket);
 	}
 
+	Table* new_table(const _u32 capacity) {
+		Table* const table( (Table*) _tMemory::byte_malloc(sizeof(Table)) );
+		const _u32 num_buckets( capacity + _INSERT_RANGE + 1);
+		table->_bucketMask = capacity - 1;
+		table->_retired = NULL;
+		table->_buckets = (Bucket*) _tMemory::byte_aligned_malloc( num_buckets * sizeof(Bucket) );
+
+		Bucket* curr_bucket = table->_buckets;
+		for (_u32 iElm=0; iElm < num_buckets; ++iElm, ++curr_bucket) {
+			curr_bucket->init();
+		}
+		return table;
+	} 
+
 	void remove_key(Segment&			  segment,
                    Bucket* const		  from_bucket,
 						 Bucket* const		  key_bucket, 
 						 Bucket* const		  prev_key_bucket, 
 						 const unsigned int hash) 
 	{
-		key_bucket->_hash  = _tHash::_EMPTY_HASH;
-		key_bucket->_key   = _tHash::_EMPTY_KEY;
-		key_bucket->_data  = _tHash::_EMPTY_DATA;
-
 		if(NULL == prev_key_bucket) {
 			if (_NULL_DELTA == key_bucket->_next_delta)
 				from_bucket->_first_delta = _NULL_DELTA;
@@ -159,13 +229,13 @@ private:
 		}
 
 		++(segment._timestamp);
-		key_bucket->_next_delta = _NULL_DELTA;
-	}
+		release_bucket(key_bucket);
+	} 
 	void add_key_to_begining_of_list(Bucket*	const     keys_bucket, 
 										      Bucket*	const		 free_bucket,
 												const unsigned int hash,
                                     const _tKey&		 key, 
-                                    const _tData& 		 data) 
+                                    const ValueSlot&	 data) 
 	{
 		free_bucket->_data = data;
 		free_bucket->_key  = key;
@@ -174,49 +244,117 @@ private:
 		if(0 == keys_bucket->_first_delta) {
 			if(_NULL_DELTA == keys_bucket->_next_delta)
 				free_bucket->_next_delta = _NULL_DELTA;
-			else
+			else 
 				free_bucket->_next_delta = (short)((keys_bucket +  keys_bucket->_next_delta) -  free_bucket);
 			keys_bucket->_next_delta = (short)(free_bucket - keys_bucket);
 		} else {
 			if(_NULL_DELTA ==  keys_bucket->_first_delta)
 				free_bucket->_next_delta = _NULL_DELTA;
-			else
+			else 
 				free_bucket->_next_delta = (short)((keys_bucket +  keys_bucket->_first_delta) -  free_bucket);
 			keys_bucket->_first_delta = (short)(free_bucket - keys_bucket);
 		}
-	}
+	} 
 
 	void add_key_to_end_of_list(Bucket* const      keys_bucket, 
                                Bucket* const		  free_bucket,
                                const unsigned int hash,
                                const _tKey&		  key, 
-										 const _tData&		  data,
+										 const ValueSlot&	  data,
                                Bucket* const		  last_bucket)
 	{
 		free_bucket->_data		 = data;
 		free_bucket->_key			 = key;
-		free_bucket->_hash		 = hash;
 		free_bucket->_next_delta = _NULL_DELTA;
+		free_bucket->_hash		 = hash;
 
 		if(NULL == last_bucket)
 			keys_bucket->_first_delta = (short)(free_bucket - keys_bucket);
 		else 
 			last_bucket->_next_delta = (short)(free_bucket - last_bucket);
-	}
+	} 
+
+	// Places a key that is not in the table into a free bucket near its home
+	// bucket, start_bucket, whose list ends at last_bucket. The key's segment
+	// must be locked. Returns false if there is no free bucket in range, and
+	// the table has to grow.
+	bool add_key(Table* const			table,
+	             Bucket* const		   start_bucket,
+	             Bucket* const		   last_bucket,
+	             const unsigned int	hash,
+	             const _tKey&			key,
+	             const ValueSlot&		data)
+	{
+		//try to place the key in the same cache-line, if the key it will be
+		//linked to is close enough for a delta
+		const short first_delta( start_bucket->_first_delta );
+		const short link_delta( 0 == first_delta ? start_bucket->_next_delta : first_delta );
+		if(_is_cacheline_alignment &&
+		   (_NULL_DELTA == link_delta || abs(link_delta) < SHRT_MAX - _cache_mask)) {
+			Bucket*	free_bucket( start_bucket );
+			Bucket*	start_cacheline_bucket(get_start_cacheline_bucket(table, start_bucket));
+			Bucket*	end_cacheline_bucket(start_cacheline_bucket + _cache_mask);
+			do {
+				if( claim_bucket(free_bucket) ) {
+					add_key_to_begining_of_list(start_bucket, free_bucket, hash, key, data);
+					return true;
+				}
+				++free_bucket;
+				if(free_bucket > end_cacheline_bucket)
+					free_bucket = start_cacheline_bucket;
+			} while(start_bucket != free_bucket);
+		}
+
+		//place key in arbitrary free forward bucket, no farther than a delta
+		//from both the home bucket and the list's tail
+		Bucket* const tail_bucket( NULL == last_bucket ? start_bucket : last_bucket );
+		Bucket* max_bucket( (tail_bucket < start_bucket ? tail_bucket : start_bucket) + (SHRT_MAX-1) );
+		Bucket* last_table_bucket(table->_buckets + table->_bucketMask);
+		if(max_bucket > last_table_bucket)
+			max_bucket = last_table_bucket;
+		Bucket* free_max_bucket( start_bucket + (_cache_mask + 1) );
+		while (free_max_bucket <= max_bucket) {
+			if( claim_bucket(free_max_bucket) ) {
+				add_key_to_end_of_list(start_bucket, free_max_bucket, hash, key, data, last_bucket);
+				return true;
+			}
+			++free_max_bucket;
+		}
 
-	void optimize_cacheline_use(Segment& segment, Bucket* const free_bucket) {
-		Bucket* const start_cacheline_bucket(get_start_cacheline_bucket(free_bucket));
+		//place key in arbitrary free backward bucket
+		Bucket* min_bucket( (tail_bucket > start_bucket ? tail_bucket : start_bucket) - (SHRT_MAX-1) );
+		if(min_bucket < table->_buckets)
+			min_bucket = table->_buckets;
+		Bucket* free_min_bucket( start_bucket - (_cache_mask + 1) );
+		while (free_min_bucket >= min_bucket) {
+			if( claim_bucket(free_min_bucket) ) {
+				add_key_to_end_of_list(start_bucket, free_min_bucket, hash, key, data, last_bucket);
+				return true;
+			}
+			--free_min_bucket;
+		}
+		return false;
+	} 
+
+	// Moves a key of the segment that is listed outside its home cache-line
+	// into free_bucket, which the segment just emptied. Only the lists of the
+	// segment's own home buckets are touched.
+	void optimize_cacheline_use(Segment& segment, Table* const table, Bucket* const free_bucket) {
+		if( !claim_bucket(free_bucket) )
+			return;
+
+		Bucket* const start_cacheline_bucket(get_start_cacheline_bucket(table, free_bucket));
 		Bucket* const end_cacheline_bucket(start_cacheline_bucket + _cache_mask);
 		Bucket* opt_bucket(start_cacheline_bucket);
 
 		do {
-			if( _NULL_DELTA != opt_bucket->_first_delta) {
+			if( _NULL_DELTA != opt_bucket->_first_delta && &segment == &get_segment(table, opt_bucket) ) {
 				Bucket* relocate_key_last (NULL);
 				int curr_delta(opt_bucket->_first_delta);
 				Bucket* relocate_key ( opt_bucket + curr_delta);
 				do {
 					if( curr_delta < 0 || curr_delta > _cache_mask ) {
-						_tHash::relocate_data_reference(free_bucket->_data, relocate_key->_data);
+						free_bucket->_data = relocate_key->_data;
 						_tHash::relocate_key_reference(free_bucket->_key, relocate_key->_key);
 						free_bucket->_hash  = relocate_key->_hash;
 
@@ -231,10 +369,8 @@ private:
 							relocate_key_last->_next_delta = (short)( free_bucket - relocate_key_last );
 
 						++(segment._timestamp);
-						relocate_key->_hash			= _tHash::_EMPTY_HASH;
-						_tHash::relocate_key_reference(relocate_key->_key, _tHash::_EMPTY_KEY);
-						_tHash::relocate_data_reference(relocate_key->_data, _tHash::_EMPTY_DATA);
-						relocate_key->_next_delta	= _NULL_DELTA;
+						release_bucket(relocate_key);
+						RETRY_STAT_INC(DISPLACE);
 						return;
 					}
 
@@ -247,7 +383,54 @@ private:
 			}
 			++opt_bucket;
 		} while (opt_bucket <= end_cacheline_bucket);
-	}
+
+		free_bucket->_hash = _tHash::_EMPTY_HASH;
+	} 
+
+	// Grows the table by _RESIZE_FACTOR, unless another thread has already
+	// replaced full_table. The keys are moved one segment at a time, under
+	// that segment's lock, so the other segments keep running on the old or
+	// the new table meanwhile. Must be called without a segment lock held.
+	void resize(Table* const full_table) {
+		_resizeLock.lock();
+		if(full_table != _table) {
+			_resizeLock.unlock();
+			return;
+		}
+
+		Table* const old_table( full_table );
+		Table* const table( new_table((old_table->_bucketMask + 1) * _RESIZE_FACTOR) );
+		table->_retired = old_table;
+		_table = table;
+
+		for (_u32 iSeg = 0; iSeg <= _segmentMask; ++iSeg) {
+			Segment& segment(_segments[iSeg]);
+			segment._lock.lock();
+			for (_u32 iElm = iSeg; iElm <= old_table->_bucketMask; iElm += _segmentMask + 1) {
+				const Bucket* key_bucket( &(old_table->_buckets[iElm]) );
+				short next_delta( key_bucket->_first_delta );
+				while (_NULL_DELTA != next_delta) {
+					key_bucket += next_delta;
+					const unsigned int hash( key_bucket->_hash );
+					Bucket* const start_bucket( &(table->_buckets[hash & table->_bucketMask]) );
+					Bucket* last_bucket( NULL );
+					for (short delta( start_bucket->_first_delta ); _NULL_DELTA != delta; delta = last_bucket->_next_delta)
+						last_bucket = (NULL == last_bucket ? start_bucket : last_bucket) + delta;
+					if( !add_key(table, start_bucket, last_bucket, hash, (const _tKey&)(key_bucket->_key), key_bucket->_data) ) {
+						fprintf(stderr, "ERROR - RESIZE could not place a key - capacity %u\n", table->_bucketMask + 1);
+						exit(1);
+					}
+					next_delta = key_bucket->_next_delta;
+				}
+			}
+			_tMemory::write_barrier();
+			segment._table = table;
+			++(segment._timestamp);
+			segment._lock.unlock();
+		}
+		++_numResizes;
+		_resizeLock.unlock();
+	} 
 
 public:// Ctors ................................................................
 	HopscotchHashMap(
@@ -255,35 +438,43 @@ public:// Ctors ................................................................
 				_u32 concurrencyLevel	   = 16,			//num of updating threads
 				_u32 cache_line_size       = 64,			//Cache-line size of machine
 				bool is_optimize_cacheline = true)		
-	:	_cache_mask					( (cache_line_size / sizeof(Bucket)) - 1 ),
-		_is_cacheline_alignment	( is_optimize_cacheline ),
-		_segmentMask  ( NearestPowerOfTwo(concurrencyLevel) - 1),
-		_segmentShift ( CalcDivideShift(NearestPowerOfTwo(concurrencyLevel/(NearestPowerOfTwo(concurrencyLevel)))-1) )
+	:	_segmentMask  ( NearestPowerOfTwo(concurrencyLevel) - 1),
+		_numResizes	  ( 0 ),
+		_cache_mask					( (cache_line_size / sizeof(Bucket)) - 1 ),
+		_is_cacheline_alignment	( is_optimize_cacheline )
 	{
 		//ADJUST INPUT ............................
-		const _u32 adjInitCap = NearestPowerOfTwo(inCapacity);
-		const _u32 adjConcurrencyLevel = NearestPowerOfTwo(concurrencyLevel);
-		const _u32 num_buckets( adjInitCap + _INSERT_RANGE + 1);
-		_bucketMask = adjInitCap - 1;
-		_segmentShift = first_msb_bit_indx(_bucketMask) - first_msb_bit_indx(_segmentMask);
+		_u32 adjInitCap = NearestPowerOfTwo(inCapacity);
+		if(adjInitCap <= _segmentMask)
+			adjInitCap = _segmentMask + 1;
 
 		//ALLOCATE THE SEGMENTS ...................
+		_table = new_table(adjInitCap);
 		_segments = (Segment*) _tMemory::byte_aligned_malloc( (_segmentMask + 1) * sizeof(Segment) );
-		_table = (Bucket*) _tMemory::byte_aligned_malloc( num_buckets * sizeof(Bucket) );
+		_resizeLock.init();
 
 		Segment* curr_seg = _segments;
 		for (_u32 iSeg = 0; iSeg <= _segmentMask; ++iSeg, ++curr_seg) {
-			curr_seg->init();
+			curr_seg->init(_table);
 		}
+	} 
 
-		Bucket* curr_bucket = _table;
-		for (_u32 iElm=0; iElm < num_buckets; ++iElm, ++curr_bucket) {
-			curr_bucket->init();
+	~HopscotchHashMap() {
+		if(_tOutOfLineData) {
+			Bucket* curr_bucket( _table->_buckets );
+			for (_u32 iElm=0; iElm <= _table->_bucketMask + _INSERT_RANGE; ++iElm, ++curr_bucket) {
+				if(_tHash::_EMPTY_HASH != curr_bucket->_hash)
+					Value::release(curr_bucket->_data, _tHash::_EMPTY_DATA);
+			}
 		}
-	}
 
-	~HopscotchHashMap() {
-		_tMemory::byte_aligned_free(_table);
+		Table* table( _table );
+		while (NULL != table) {
+			Table* const retired( table->_retired );
+			_tMemory::byte_aligned_free(table->_buckets);
+			_tMemory::byte_free(table);
+			table = retired;
+		}
 		_tMemory::byte_aligned_free(_segments);
 	} 
 
@@ -291,16 +482,19 @@ public:// Ctors ................................................................
 	inline_ bool containsKey( const _tKey& key ) {
 
 		//CALCULATE HASH ..........................
-		const unsigned int hash( _tHash::Calc(key) );
+		const unsigned int hash( calc_hash(key) );
 
 		//CHECK IF ALREADY CONTAIN ................
-		const	Segment&	segment(_segments[(hash >> _segmentShift) & _segmentMask]);
+		const	Segment&	segment(_segments[hash & _segmentMask]);
 
-     //go over the list and look for key
+     //go over the list and look for key, again if the segment changed or
+     //moved to a new table meanwhile
 		unsigned int start_timestamp;
+		const Table* table;
       do {
 			start_timestamp = segment._timestamp;
-			const Bucket* curr_bucket( &(_table[hash & _bucketMask]) );
+			table = segment._table;
+			const Bucket* curr_bucket( &(table->_buckets[hash & table->_bucketMask]) );
 			short next_delta( curr_bucket->_first_delta );
          while( _NULL_DELTA != next_delta ) {
 				curr_bucket += next_delta;
@@ -308,98 +502,68 @@ public:// Ctors ................................................................
 					return true;
 				next_delta = curr_bucket->_next_delta;
 			}
-		} while(start_timestamp != segment._timestamp);
-
-		return false;
-	}
+			if(start_timestamp == segment._timestamp && table == segment._table)
+				return false;
+			RETRY_STAT_INC(TS_RETRY);
+		} while(true);
+	} 
 
 	//modification Operations ...................................................
 	inline_ _tData putIfAbsent(const _tKey& key, const _tData& data) {
-		const unsigned int hash( _tHash::Calc(key) );
-		Segment&	segment(_segments[(hash >> _segmentShift) & _segmentMask]);
-
-		//go over the list and look for key
-		segment._lock.lock();
-		Bucket* const start_bucket( &(_table[hash & _bucketMask]) );
-
-		Bucket* last_bucket( NULL );
-		Bucket* compare_bucket( start_bucket );
-		short next_delta( compare_bucket->_first_delta );
-		while (_NULL_DELTA != next_delta) {
-			compare_bucket += next_delta;
-			if( hash == compare_bucket->_hash && _tHash::IsEqual(key, compare_bucket->_key) ) {
-				const _tData rc((_tData&)(compare_bucket->_data));
-				segment._lock.unlock();
-				return rc;
-			}
-			last_bucket = compare_bucket;
-			next_delta = compare_bucket->_next_delta;
-		}
+		const unsigned int hash( calc_hash(key) );
+		Segment&	segment(_segments[hash & _segmentMask]);
+		ValueSlot slot( Value::empty_slot(_tHash::_EMPTY_DATA) );
+		bool made( false );
 
-		//try to place the key in the same cache-line
-		if(_is_cacheline_alignment) {
-			Bucket*	free_bucket( start_bucket );
-			Bucket*	start_cacheline_bucket(get_start_cacheline_bucket(start_bucket));
-			Bucket*	end_cacheline_bucket(start_cacheline_bucket + _cache_mask);
-			do {
-				if( _tHash::_EMPTY_HASH == free_bucket->_hash ) {
-					add_key_to_begining_of_list(start_bucket, free_bucket, hash, key, data);
+		do {
+			//go over the list and look for key
+			segment._lock.lock();
+			Table* const table( segment._table );
+			Bucket* const start_bucket( &(table->_buckets[hash & table->_bucketMask]) );
+
+			Bucket* last_bucket( NULL );
+			Bucket* compare_bucket( start_bucket );
+			short next_delta( compare_bucket->_first_delta );
+			while (_NULL_DELTA != next_delta) {
+				compare_bucket += next_delta;
+				if( hash == compare_bucket->_hash && _tHash::IsEqual(key, compare_bucket->_key) ) {
+					const _tData rc( Value::get(compare_bucket->_data) );
 					segment._lock.unlock();
-					return _tHash::_EMPTY_DATA;
+					if(made)
+						Value::release(slot, _tHash::_EMPTY_DATA);
+					return rc;
 				}
-				++free_bucket;
-				if(free_bucket > end_cacheline_bucket)
-					free_bucket = start_cacheline_bucket;
-			} while(start_bucket != free_bucket);
-		}
-
-		//place key in arbitrary free forward bucket
-		Bucket* max_bucket( start_bucket + (SHRT_MAX-1) );
-		Bucket* last_table_bucket(_table + _bucketMask);
-		if(max_bucket > last_table_bucket)
-			max_bucket = last_table_bucket;
-		Bucket* free_max_bucket( start_bucket + (_cache_mask + 1) );
-		while (free_max_bucket <= max_bucket) {
-			if( _tHash::_EMPTY_HASH == free_max_bucket->_hash ) {
-				add_key_to_end_of_list(start_bucket, free_max_bucket, hash, key, data, last_bucket);
-				segment._lock.unlock();
-				return _tHash::_EMPTY_DATA;
+				last_bucket = compare_bucket;
+				next_delta = compare_bucket->_next_delta;
 			}
-			++free_max_bucket;
-		}
 
-		//place key in arbitrary free backward bucket
-		Bucket* min_bucket( start_bucket - (SHRT_MAX-1) );
-		if(min_bucket < _table)
-			min_bucket = _table;
-		Bucket* free_min_bucket( start_bucket - (_cache_mask + 1) );
-		while (free_min_bucket >= min_bucket) {
-			if( _tHash::_EMPTY_HASH == free_min_bucket->_hash ) {
-				add_key_to_end_of_list(start_bucket, free_min_bucket, hash, key, data, last_bucket);
+			if(!made) {
+				slot = Value::make(data);
+				made = true;
+			}
+			if( add_key(table, start_bucket, last_bucket, hash, key, slot) ) {
 				segment._lock.unlock();
 				return _tHash::_EMPTY_DATA;
 			}
-			--free_min_bucket;
-		}
-//		cout<<"putifabsent"<<endl;
-		//NEED TO RESIZE ..........................
-		fprintf(stderr, "ERROR - RESIZE is not implemented - size %u\n", size());
-		exit(1);
-		return _tHash::_EMPTY_DATA;
-	}
+
+			//NEED TO RESIZE ..........................
+			segment._lock.unlock();
+			resize(table);
+		} while(true);
+	} 
 
 	inline_ _tData remove(const _tKey& key) {
 		//CALCULATE HASH ..........................
-		const unsigned int hash( _tHash::Calc(key) );
+		const unsigned int hash( calc_hash(key) );
 
 		//CHECK IF ALREADY CONTAIN ................
-		Segment&	segment(_segments[(hash >> _segmentShift) & _segmentMask]);
+		Segment&	segment(_segments[hash & _segmentMask]);
 		segment._lock.lock();
-		Bucket* const start_bucket( &(_table[hash & _bucketMask]) );
+		Table* const table( segment._table );
+		Bucket* const start_bucket( &(table->_buckets[hash & table->_bucketMask]) );
 		Bucket* last_bucket( NULL );
 		Bucket* curr_bucket( start_bucket );
 		short	  next_delta (curr_bucket->_first_delta);
-//		cout<<"removeStart"<<endl;
 		do {
 			if(_NULL_DELTA == next_delta) {
 				segment._lock.unlock();
@@ -408,42 +572,67 @@ public:// Ctors ................................................................
 			curr_bucket += next_delta;
 
 			if( hash == curr_bucket->_hash && _tHash::IsEqual(key, curr_bucket->_key) ) {
-				_tData const rc((_tData&)(curr_bucket->_data));
+				_tData const rc( Value::get(curr_bucket->_data) );
+				Value::release(curr_bucket->_data, _tHash::_EMPTY_DATA);
 				remove_key(segment, start_bucket, curr_bucket, last_bucket, hash);
 				if( _is_cacheline_alignment )
-					optimize_cacheline_use(segment, curr_bucket);
+					optimize_cacheline_use(segment, table, curr_bucket);
 				segment._lock.unlock();
 				return rc;
 			}
 			last_bucket = curr_bucket;
 			next_delta = curr_bucket->_next_delta;
 		} while(true);
-//		cout<<"remove return value "<<_tHash::_EMPTY_DATA<<endl;
 
 		return _tHash::_EMPTY_DATA;
-	}
+	} 
 
 	//status Operations .........................................................
 	unsigned int size() {
 		_u32 counter = 0;
-		const _u32 num_elm( _bucketMask + _INSERT_RANGE );
+		const Table* const table( _table );
+		const _u32 num_elm( table->_bucketMask + _INSERT_RANGE );
 		for(_u32 iElm=0; iElm < num_elm; ++iElm) {
-			if( _tHash::_EMPTY_HASH != _table[iElm]._hash ) {
+			if( _tHash::_EMPTY_HASH != table->_buckets[iElm]._hash ) {
 				++counter;
 			}
 		}
 		return counter;
-	}   
+	} 
+
+	//number of buckets in the current table, and number of times it grew
+	_u32 capacity() {
+		return _table->_bucketMask + 1;
+	} 
+
+	_u32 numResizes() {
+		return _numResizes;
+	} 
+
+	//the bytes of the map, by part (see MapMemory.h); quiesce the writers first
+	MapMemory memory() {
+		MapMemory mem;
+		const _u32 num_segments( _segmentMask + 1 );
+		mem._table = sizeof(*this) - sizeof(_tLock) + table_bytes(_table)
+		           + num_segments * (sizeof(Segment) - sizeof(_tLock));
+		mem._locks = (num_segments + 1) * sizeof(_tLock);
+		if(_tOutOfLineData)
+			mem._overflow = size() * sizeof(_tData);
+		for (const Table* table( _table->_retired ); NULL != table; table = table->_retired)
+			mem._garbage += table_bytes(table);
+		return mem;
+	}
 
 	double percentKeysInCacheline() {
 		unsigned int total_in_cache( 0 );
 		unsigned int total( 0 );
 
-		Bucket* curr_bucket(_table);
-		for(int iElm(0); iElm <= _bucketMask; ++iElm, ++curr_bucket) {
+		Table* const table( _table );
+		Bucket* curr_bucket(table->_buckets);
+		for(_u32 iElm(0); iElm <= table->_bucketMask; ++iElm, ++curr_bucket) {
 
 			if(_NULL_DELTA != curr_bucket->_first_delta) {
-				Bucket* const startCacheLineBucket( get_start_cacheline_bucket(curr_bucket) );
+				Bucket* const startCacheLineBucket( get_start_cacheline_bucket(table, curr_bucket) );
 				Bucket* check_bucket(curr_bucket + curr_bucket->_first_delta);
 				int currDist( curr_bucket->_first_delta );
 				do {
@@ -460,7 +649,7 @@ public:// Ctors ................................................................
 
 		//return percent in cache
 		return (((double)total_in_cache)/((double)total)*100.0);
-	}
+	} 
 
 private:
 	// Private Static Utilities .................................................
@@ -470,7 +659,7 @@ private:
 			rc <<= 1;
 		}
 		return rc;
-	}
+	} 
 
 	static unsigned int CalcDivideShift(const unsigned int _value) {
 		unsigned int numShift( 0 );
@@ -480,7 +669,7 @@ private:
 			++numShift;
 		}
 		return numShift;
-	}
+	} 
 
 };
 
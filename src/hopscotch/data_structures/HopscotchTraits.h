@@ -0,0 +1,183 @@
+#ifndef __HOPSCOTCH_TRAITS__
+#define __HOPSCOTCH_TRAITS__
+
+////////////////////////////////////////////////////////////////////////////////
+// Key and value support shared by HopscotchHashMap and BitmapHopscotchHashMap
+//
+// HopStorage  - how a key or value is kept in a bucket
+// HopValue    - values kept in the bucket, or out of line behind a pointer
+// HASH_INTEGER - hash traits of integer keys of any width (HASH_INT64)
+// HASH_STRING  - hash traits of FixedString keys, short strings kept inline
+//
+// A bucket is free or taken according to its hash, never its key, so every
+// key value is usable. The maps remap the hashes that equal _EMPTY_HASH or
+// _BUSY_HASH, and the stored hash then doubles as a fingerprint: keys are
+// only compared with IsEqual when the fingerprints match.
+////////////////////////////////////////////////////////////////////////////////
+#include <string.h>
+#include <new>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////
+//INNER CLASSES
+////////////////////////////////////////////////////////////////////////////////
+
+// Scalars are kept volatile, as the maps read them without locks; other types
+// are copied as a whole, and IsEqual only trusts them on a fingerprint match.
+// Buckets are never constructed, so both have to be trivially copyable.
+template <typename _tType>
+struct HopStorage {
+	static_assert(std::is_trivially_copyable<_tType>::value, "buckets are copied and cleared bytewise");
+	typedef typename std::conditional<std::is_scalar<_tType>::value, _tType volatile, _tType>::type type;
+};
+
+// Values kept in the bucket (the default). _tSlot is what the bucket holds.
+template <typename _tData, typename _tMemory, bool _tOutOfLine>
+struct HopValue {
+	typedef typename HopStorage<_tData>::type _tSlot;
+
+	static _tData make(const _tData& data) {
+		return data;
+	}
+	static _tData get(const _tSlot& slot) {
+		return (const _tData&) slot;
+	}
+	static void release(_tSlot& slot, const _tData& empty) {
+		slot = empty;
+	}
+	static _tData empty_slot(const _tData& empty) {
+		return empty;
+	}
+};
+
+// Values kept out of line, so that large values don't spread the buckets of a
+// neighbourhood over more cache-lines. The bucket holds a pointer to a copy of
+// the value, which moves with the key when the key is relocated or the table
+// grows, and is freed when the key is removed.
+template <typename _tData, typename _tMemory>
+struct HopValue<_tData, _tMemory, true> {
+	typedef _tData* volatile _tSlot;
+
+	static _tData* make(const _tData& data) {
+		return new (_tMemory::byte_malloc(sizeof(_tData))) _tData(data);
+	}
+	static _tData get(const _tSlot& slot) {
+		return *slot;
+	}
+	static void release(_tSlot& slot, const _tData&) {
+		_tData* const value( slot );
+		slot = NULL;
+		if(NULL != value) {
+			value->~_tData();
+			_tMemory::byte_free(value);
+		}
+	}
+	static _tData* empty_slot(const _tData&) {
+		return NULL;
+	}
+};
+
+// Mixes the bits of a 64 bit value (the finalizer of MurmurHash3)
+inline static unsigned long long hop_mix64(unsigned long long h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS: HASH_INTEGER
+////////////////////////////////////////////////////////////////////////////////
+template <typename _tInt, typename _tData = int>
+class HASH_INTEGER {
+public:
+	static const unsigned int _EMPTY_HASH;
+	static const unsigned int _BUSY_HASH;
+	static const _tInt _EMPTY_KEY;
+	static const _tData _EMPTY_DATA;
+
+	inline static unsigned int Calc(const _tInt key) {
+		const unsigned long long h( hop_mix64((unsigned long long) key) );
+		return (unsigned int)(h ^ (h >> 32));
+	}
+
+	inline static bool IsEqual(const _tInt left_key, const _tInt right_key) {
+		return left_key == right_key;
+	}
+
+	inline static void relocate_key_reference(_tInt volatile& left, const _tInt volatile& right) {
+		left = right;
+	}
+};
+template <typename _tInt, typename _tData> const unsigned int HASH_INTEGER<_tInt, _tData>::_EMPTY_HASH = 0;
+template <typename _tInt, typename _tData> const unsigned int HASH_INTEGER<_tInt, _tData>::_BUSY_HASH  = 1;
+template <typename _tInt, typename _tData> const _tInt HASH_INTEGER<_tInt, _tData>::_EMPTY_KEY = 0;
+template <typename _tInt, typename _tData> const _tData HASH_INTEGER<_tInt, _tData>::_EMPTY_DATA = _tData();
+
+typedef HASH_INTEGER<long long> HASH_INT64;
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS: FixedString
+////////////////////////////////////////////////////////////////////////////////
+// A string of up to _N bytes, zero padded, kept inline in the bucket.
+template <size_t _N>
+struct FixedString {
+	char _chars[_N];
+
+	FixedString() {
+		memset(_chars, 0, _N);
+	}
+
+	FixedString(const char* const str) {
+		strncpy(_chars, str, _N);
+	}
+
+	FixedString(const void* const bytes, const size_t len) {
+		memset(_chars, 0, _N);
+		memcpy(_chars, bytes, len < _N ? len : _N);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS: HASH_STRING
+////////////////////////////////////////////////////////////////////////////////
+template <size_t _N, typename _tData = int>
+class HASH_STRING {
+public:
+	static const unsigned int _EMPTY_HASH;
+	static const unsigned int _BUSY_HASH;
+	static const FixedString<_N> _EMPTY_KEY;
+	static const _tData _EMPTY_DATA;
+
+	inline static unsigned int Calc(const FixedString<_N>& key) {
+		unsigned long long h( _N );
+		size_t i( 0 );
+		for(; i + sizeof(h) <= _N; i += sizeof(h)) {
+			unsigned long long word;
+			memcpy(&word, key._chars + i, sizeof(word));
+			h = hop_mix64(h ^ word);
+		}
+		if(i < _N) {
+			unsigned long long word( 0 );
+			memcpy(&word, key._chars + i, _N - i);
+			h = hop_mix64(h ^ word);
+		}
+		return (unsigned int)(h ^ (h >> 32));
+	}
+
+	inline static bool IsEqual(const FixedString<_N>& left_key, const FixedString<_N>& right_key) {
+		return 0 == memcmp(left_key._chars, right_key._chars, _N);
+	}
+
+	inline static void relocate_key_reference(FixedString<_N>& left, const FixedString<_N>& right) {
+		left = right;
+	}
+};
+template <size_t _N, typename _tData> const unsigned int HASH_STRING<_N, _tData>::_EMPTY_HASH = 0;
+template <size_t _N, typename _tData> const unsigned int HASH_STRING<_N, _tData>::_BUSY_HASH  = 1;
+template <size_t _N, typename _tData> const FixedString<_N> HASH_STRING<_N, _tData>::_EMPTY_KEY;
+template <size_t _N, typename _tData> const _tData HASH_STRING<_N, _tData>::_EMPTY_DATA = _tData();
+
+#endif
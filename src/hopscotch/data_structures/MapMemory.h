@@ -0,0 +1,43 @@
+#ifndef __MAP_MEMORY__
+#define __MAP_MEMORY__
+
+//------------------------------------------------------------------------------
+// File    : MapMemory.h
+//
+// The memory of a map, in bytes, as its memory() reports it. The parts are
+// disjoint and their sum is the footprint of the map; everything is counted at
+// the size the map asked _tMemory (or std::allocator) for, so the headers and
+// rounding of malloc are left to the driver's view of the heap.
+//
+//  _table    - the map object, its bucket arrays and segments, without locks
+//  _locks    - the locks, in the segments or next to the shards
+//  _overflow - what the keys take outside of the buckets: chained entries and
+//              their pools, std::unordered_map nodes, out of line values
+//  _garbage  - bucket arrays that resizes retired, kept until the map is freed
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+
+struct MapMemory {
+	size_t _table;
+	size_t _locks;
+	size_t _overflow;
+	size_t _garbage;
+
+	MapMemory() : _table(0), _locks(0), _overflow(0), _garbage(0) {}
+
+	size_t total() const {
+		return _table + _locks + _overflow + _garbage;
+	}
+
+	// A std::unordered_map: its bucket array goes to _table, and a node per
+	// key, a next pointer and the pair (libstdc++ doesn't cache the hashes of
+	// integer keys), to _overflow.
+	template <class Map>
+	void add_std_map(const Map& map) {
+		_table    += map.bucket_count() * sizeof(void*);
+		_overflow += map.size() * (sizeof(void*) + sizeof(typename Map::value_type));
+	}
+};
+
+#endif //__MAP_MEMORY__
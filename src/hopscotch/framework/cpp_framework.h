@@ -290,6 +290,132 @@ namespace CMDR {
 		}
 	};
 
+	inline_ static void spin_pause() {
+#if defined(__i386__) || defined(__x86_64__)
+		__asm__ __volatile__ ("pause" ::: "memory");
+#endif
+	}
+
+	// FIFO spin lock: threads are served in the order they took a ticket
+	class TicketLock {
+	public:
+		_u32 volatile _next;
+		_u32 volatile _owner;
+
+		TicketLock() : _next(0), _owner(0) {}
+		~TicketLock() {}
+
+		inline_ void init() {_next = 0; _owner = 0;}
+
+		inline_ void lock() {
+			const _u32 ticket( __sync_fetch_and_add(&_next, 1) );
+			while(ticket != _owner) {
+				spin_pause();
+			}
+		}
+
+		inline_ bool tryLock() {
+			const _u32 owner( _owner );
+			return ( owner == _next && owner == CAS32(&_next, owner, owner + 1) );
+		}
+
+		inline_ bool isLocked() {
+			return _owner != _next;
+		}
+
+		inline_ void unlock() {
+			Memory::write_barrier();
+			_owner = _owner + 1;
+		}
+	};
+
+	// FIFO queue lock (Mellor-Crummey & Scott): each waiter spins on its own
+	// node. The nodes come from a per-thread free list, so a thread can hold
+	// any number of MCS locks; they are not freed when the thread exits.
+	class MCSLock {
+	private:
+		struct Node {
+			Node* volatile	_next;
+			_u32 volatile	_locked;
+			char				_pad[CACHE_LINE_SIZE - sizeof(Node*) - sizeof(_u32)];
+		};
+
+		inline_ static Node*& free_nodes() {
+			static __thread__ Node* nodes( NULL );
+			return nodes;
+		}
+
+		inline_ static Node* get_node() {
+			Node* node( free_nodes() );
+			if(NULL == node)
+				return (Node*) Memory::byte_aligned_malloc(sizeof(Node));
+			free_nodes() = node->_next;
+			return node;
+		}
+
+		inline_ static void put_node(Node* node) {
+			node->_next = free_nodes();
+			free_nodes() = node;
+		}
+
+	public:
+		Node* volatile	_tail;
+		Node*				_owner;
+
+		MCSLock() : _tail(NULL), _owner(NULL) {}
+		~MCSLock() {}
+
+		inline_ void init() {_tail = NULL; _owner = NULL;}
+
+		inline_ void lock() {
+			Node* const node( get_node() );
+			node->_next = NULL;
+			node->_locked = 1;
+			Node* const pred( (Node*) SWAPPO((void* volatile*) &_tail, (void*) node) );
+			if(NULL != pred) {
+				pred->_next = node;
+				while(0 != node->_locked) {
+					spin_pause();
+				}
+			}
+			_owner = node;
+		}
+
+		inline_ bool tryLock() {
+			if(NULL != _tail)
+				return false;
+			Node* const node( get_node() );
+			node->_next = NULL;
+			if(NULL == CASPO(&_tail, NULL, node)) {
+				_owner = node;
+				return true;
+			}
+			put_node(node);
+			return false;
+		}
+
+		inline_ bool isLocked() {
+			return NULL != _tail;
+		}
+
+		inline_ void unlock() {
+			Node* const node( _owner );
+			if(NULL == node->_next) {
+				if(node == CASPO(&_tail, node, NULL)) {
+					put_node(node);
+					return;
+				}
+				//a successor is linking itself in
+				while(NULL == node->_next) {
+					spin_pause();
+				}
+			}
+			Memory::write_barrier();
+			node->_next->_locked = 0;
+			put_node(node);
+		}
+	};
+
 	class ReentrantLock {
 	public:
 		ReentrantLock()	{pthread_mutex_init(&_mutex,0);}
@@ -0,0 +1,452 @@
+/* Grows a HopscotchHashMap or a BitmapHopscotchHashMap from a small initial
+   capacity to many keys, with num_threads inserting and, optionally, reader
+   threads looking up keys that are already in, to check that no lookup misses
+   a key while the table is being resized. Then times single-threaded lookups
+   of keys that are in the grown table (hits) and of keys that are not (misses),
+   which compares the bucket layouts of the bitmap map. The keys are ints,
+   64 bit integers or 16 byte strings; the values are ints in the buckets, or
+   std::strings out of line (the maps' _tOutOfLineData), and every value is
+   checked after the growth. */
+
+#include <iostream>
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "utils.h"
+#include "barrier.h"
+
+#include "../framework/cpp_framework.h"
+#include "../data_structures/HopscotchHashMap.h"
+#include "../data_structures/BitmapHopscotchHashMap.h"
+#include "../data_structures/HopscotchTraits.h"
+
+using namespace CMDR;
+using namespace std;
+
+typedef FixedString<16> String16;
+
+/* the key of number k, for each key type */
+template <class Key> struct key_traits;
+
+template <> struct key_traits<int>
+{
+  static const char* name() { return "int"; }
+  static int make(size_t k) { return (int) k; }
+};
+
+template <> struct key_traits<long long>
+{
+  static const char* name() { return "int64"; }
+  static long long make(size_t k) { return (long long) k << 32 | k; }
+};
+
+template <> struct key_traits<String16>
+{
+  static const char* name() { return "str16"; }
+  static String16 make(size_t k)
+  {
+    char chars[16];
+    memcpy(chars, "user", 4);
+    for (int i = 15; i >= 4; i--, k >>= 4)
+      {
+	chars[i] = "0123456789abcdef"[k & 15];
+      }
+    return String16(chars, 16);
+  }
+};
+
+/* the value of key number k, for each value type, and where the maps keep it */
+template <class Value> struct value_traits;
+
+template <> struct value_traits<int>
+{
+  static const bool out_of_line = false;
+  static const char* name() { return "int"; }
+  static int make(size_t k) { return (int) k; }
+};
+
+/* too long for the small string buffer, so every value owns a heap block that
+   the map has to copy, destroy and free along with it */
+template <> struct value_traits<string>
+{
+  static const bool out_of_line = true;
+  static const char* name() { return "str"; }
+  static string make(size_t k)
+  {
+    char chars[33];
+    snprintf(chars, sizeof(chars), "value-%026zx", k);
+    return string(chars);
+  }
+};
+
+/* the hash traits of a key and value type */
+template <class Key, class Value> struct hash_traits { typedef HASH_INTEGER<Key, Value> type; };
+template <> struct hash_traits<int, int> { typedef HASH_INT type; };
+template <class Value> struct hash_traits<String16, Value> { typedef HASH_STRING<16, Value> type; };
+
+size_t num_threads = 4;
+size_t num_readers = 0;
+size_t initial = 1024;
+size_t max_keys = 100000000;
+size_t concurrency = 16;
+const char* variant = "all";
+const char* key_type = "int";
+const char* value_type = "int";
+
+/* keys [1, inserted] are in the table; the writers insert (inserted, target] */
+static volatile size_t inserted;
+static volatile size_t target;
+static volatile int stop;
+
+barrier_t barrier_phase, barrier_done;
+
+typedef struct thread_data
+{
+  size_t id;
+  void* table;
+  size_t lookups;
+  size_t misses;
+} thread_data_t;
+
+template <class Table, class Key, class Value>
+void*
+writer(void* thread)
+{
+  thread_data_t* td = (thread_data_t*) thread;
+  Table* table = (Table*) td->table;
+  set_cpu(the_cores[td->id % (sizeof(the_cores) / sizeof(the_cores[0]))]);
+
+  while (1)
+    {
+      barrier_cross(&barrier_phase);
+      if (stop)
+	{
+	  break;
+	}
+      for (size_t k = inserted + 1 + td->id; k <= target; k += num_threads)
+	{
+	  table->putIfAbsent(key_traits<Key>::make(k), value_traits<Value>::make(k));
+	}
+      barrier_cross(&barrier_done);
+    }
+  return NULL;
+}
+
+template <class Table, class Key>
+void*
+reader(void* thread)
+{
+  thread_data_t* td = (thread_data_t*) thread;
+  Table* table = (Table*) td->table;
+  unsigned long* seeds = seed_rand();
+
+  while (!stop)
+    {
+      const size_t in = inserted;
+      if (in == 0)
+	{
+	  continue;
+	}
+      const size_t k = (my_random(&seeds[0], &seeds[1], &seeds[2]) % in) + 1;
+      td->lookups++;
+      if (!table->containsKey(key_traits<Key>::make(k)))
+	{
+	  td->misses++;
+	}
+    }
+  return NULL;
+}
+
+static double
+elapsed_ms(struct timeval* start, struct timeval* end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_usec - start->tv_usec) / 1000.0;
+}
+
+/* Looks up the keys first to last, and returns how many were found. The keys
+   are made ahead of the timed loop, a chunk at a time, since making a string
+   key inside it leaves less room for the lookups' cache misses to overlap.
+   The time of the lookups alone is added to ms. */
+template <class Table, class Key>
+size_t
+timed_lookups(Table* table, size_t first, size_t last, double* ms)
+{
+  const size_t chunk = 1 << 20;
+  vector<Key> keys;
+  keys.reserve(chunk);
+  size_t found = 0;
+  struct timeval start, end;
+  for (size_t k = first; k <= last; )
+    {
+      keys.clear();
+      for (; k <= last && keys.size() < chunk; k++)
+	{
+	  keys.push_back(key_traits<Key>::make(k));
+	}
+      gettimeofday(&start, NULL);
+      for (size_t i = 0; i < keys.size(); i++)
+	{
+	  found += table->containsKey(keys[i]);
+	}
+      gettimeofday(&end, NULL);
+      *ms += elapsed_ms(&start, &end);
+    }
+  return found;
+}
+
+/* Returns how many of the keys first to last are not in the table with their
+   own value: putIfAbsent() of a key that is in returns its value. */
+template <class Table, class Key, class Value>
+size_t
+wrong_values(Table* table, size_t first, size_t last)
+{
+  size_t wrong = 0;
+  for (size_t k = first; k <= last; k++)
+    {
+      wrong += !(table->putIfAbsent(key_traits<Key>::make(k), Value()) == value_traits<Value>::make(k));
+    }
+  return wrong;
+}
+
+template <class Table, class Key, class Value>
+void
+grow(const char* map_name)
+{
+  char name[64];
+  if (value_traits<Value>::out_of_line)
+    {
+      snprintf(name, sizeof(name), "%s<%s,%s>", map_name, key_traits<Key>::name(), value_traits<Value>::name());
+    }
+  else
+    {
+      snprintf(name, sizeof(name), "%s<%s>", map_name, key_traits<Key>::name());
+    }
+  Table* table = new Table((_u32) initial, (_u32) concurrency);
+  inserted = 0;
+  target = 0;
+  stop = 0;
+
+  const size_t num_all = num_threads + num_readers;
+  pthread_t threads[num_all];
+  thread_data_t tds[num_all];
+  barrier_init(&barrier_phase, num_threads + 1);
+  barrier_init(&barrier_done, num_threads + 1);
+  for (size_t t = 0; t < num_all; t++)
+    {
+      tds[t].id = t;
+      tds[t].table = table;
+      tds[t].lookups = 0;
+      tds[t].misses = 0;
+      pthread_create(&threads[t], NULL, t < num_threads ? writer<Table, Key, Value> : reader<Table, Key>, tds + t);
+    }
+
+  printf("#%s: %zu writers, %zu readers, initial capacity %zu\n", name, num_threads, num_readers, initial);
+  printf("#%-12s %-12s %-8s %-12s %-12s %s\n", "keys", "capacity", "resizes", "phase_ms", "total_ms", "keys/ms");
+  struct timeval start, phase, end;
+  gettimeofday(&start, NULL);
+  for (size_t milestone = 1000; inserted < max_keys; milestone *= 10)
+    {
+      target = milestone < max_keys ? milestone : max_keys;
+      gettimeofday(&phase, NULL);
+      barrier_cross(&barrier_phase);
+      barrier_cross(&barrier_done);
+      gettimeofday(&end, NULL);
+      const double phase_ms = elapsed_ms(&phase, &end);
+      printf(" %-12zu %-12u %-8u %-12.3f %-12.3f %.1f\n", (size_t) target, table->capacity(),
+	     table->numResizes(), phase_ms, elapsed_ms(&start, &end),
+	     phase_ms > 0 ? (target - inserted) / phase_ms : 0.0);
+      fflush(stdout);
+      inserted = target;
+    }
+  stop = 1;
+  barrier_cross(&barrier_phase);
+
+  size_t lookups = 0, misses = 0;
+  for (size_t t = 0; t < num_all; t++)
+    {
+      pthread_join(threads[t], NULL);
+      lookups += tds[t].lookups;
+      misses += tds[t].misses;
+    }
+
+  double hit_ms = 0, miss_ms = 0;
+  const size_t missing = max_keys - timed_lookups<Table, Key>(table, 1, max_keys, &hit_ms);
+  const size_t last_absent = 2 * max_keys < INT_MAX ? 2 * max_keys : INT_MAX;
+  const size_t found = timed_lookups<Table, Key>(table, max_keys + 1, last_absent, &miss_ms);
+
+  const size_t size = table->size();
+  const size_t wrong = wrong_values<Table, Key, Value>(table, 1, max_keys);
+  printf("#%s: size %zu (expected %zu) | missing keys %zu | wrong values %zu | concurrent lookups %zu, misses %zu%s\n",
+	 name, size, max_keys, missing, wrong, lookups, misses,
+	 (size == max_keys && missing == 0 && wrong == 0 && misses == 0 && found == 0) ? "" : " | ERROR");
+  printf("#%s: lookups/ms hits %.1f | misses %.1f\n", name,
+	 hit_ms > 0 ? max_keys / hit_ms : 0.0, miss_ms > 0 ? (last_absent - max_keys) / miss_ms : 0.0);
+  delete table;
+}
+
+template <class Key, class Value>
+void
+grow_all()
+{
+  typedef typename hash_traits<Key, Value>::type Hash;
+  const bool ool = value_traits<Value>::out_of_line;
+  if (!strcmp(variant, "hop") || !strcmp(variant, "all"))
+    {
+      grow<HopscotchHashMap<Key, Value, Hash, TTASLock, CMDR::Memory, ool>, Key, Value>("HopscotchHashMap");
+    }
+  if (!strcmp(variant, "bitmap") || !strcmp(variant, "all"))
+    {
+      grow<BitmapHopscotchHashMap<Key, Value, Hash, TTASLock, CMDR::Memory, false, ool>, Key, Value>("BitmapHopscotchHashMap");
+    }
+  if (!strcmp(variant, "soa") || !strcmp(variant, "all"))
+    {
+      grow<BitmapHopscotchHashMap<Key, Value, Hash, TTASLock, CMDR::Memory, true, ool>, Key, Value>("BitmapHopscotchHashMap-SoA");
+    }
+}
+
+template <class Value>
+void
+grow_keys()
+{
+  if (!strcmp(key_type, "int") || !strcmp(key_type, "all"))
+    {
+      grow_all<int, Value>();
+    }
+  if (!strcmp(key_type, "int64") || !strcmp(key_type, "all"))
+    {
+      grow_all<long long, Value>();
+    }
+  if (!strcmp(key_type, "str16") || !strcmp(key_type, "all"))
+    {
+      grow_all<String16, Value>();
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] = {
+    {"help",                      no_argument,       NULL, 'h'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"readers",                   required_argument, NULL, 'r'},
+    {"initial-size",              required_argument, NULL, 'i'},
+    {"max-keys",                  required_argument, NULL, 'm'},
+    {"concurrency",               required_argument, NULL, 'c'},
+    {"variant",                   required_argument, NULL, 't'},
+    {"keys",                      required_argument, NULL, 'k'},
+    {"values",                    required_argument, NULL, 'v'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int i, c;
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hn:r:i:m:c:t:k:v:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      switch(c)
+	{
+	case 'h':
+	  printf("hopscotch_grow -- resize benchmark\n"
+		 "\n"
+		 "Usage:\n"
+		 "  hopscotch_grow [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of inserting threads\n"
+		 "  -r, --readers <int>\n"
+		 "        Number of threads looking up inserted keys during the growth\n"
+		 "  -i, --initial-size <int>\n"
+		 "        Initial capacity of the table\n"
+		 "  -m, --max-keys <int>\n"
+		 "        Number of keys to grow the table to\n"
+		 "  -c, --concurrency <int>\n"
+		 "        Number of segments (locks) of the table\n"
+		 "  -t, --variant <hop|bitmap|soa|all>\n"
+		 "        Which table to grow: soa is the bitmap map with its keys in\n"
+		 "        an array of their own\n"
+		 "  -k, --keys <int|int64|str16|all>\n"
+		 "        Key type: ints, 64 bit integers or 16 byte strings\n"
+		 "  -v, --values <int|str|all>\n"
+		 "        Value type: ints in the buckets, or 32 byte std::strings kept\n"
+		 "        out of line, behind a pointer in the bucket\n"
+		 );
+	  exit(0);
+	case 'n':
+	  num_threads = atoi(optarg);
+	  break;
+	case 'r':
+	  num_readers = atoi(optarg);
+	  break;
+	case 'i':
+	  initial = atol(optarg);
+	  break;
+	case 'm':
+	  max_keys = atol(optarg);
+	  break;
+	case 'c':
+	  concurrency = atoi(optarg);
+	  break;
+	case 't':
+	  variant = optarg;
+	  break;
+	case 'k':
+	  key_type = optarg;
+	  break;
+	case 'v':
+	  value_type = optarg;
+	  break;
+	case '?':
+	default:
+	  printf("Use -h or --help for help\n");
+	  exit(1);
+	}
+    }
+
+  if (strcmp(variant, "hop") && strcmp(variant, "bitmap") && strcmp(variant, "soa") && strcmp(variant, "all"))
+    {
+      printf("** unknown variant: %s; available: hop, bitmap, soa, all\n", variant);
+      exit(1);
+    }
+  if (strcmp(key_type, "int") && strcmp(key_type, "int64") && strcmp(key_type, "str16") && strcmp(key_type, "all"))
+    {
+      printf("** unknown key type: %s; available: int, int64, str16, all\n", key_type);
+      exit(1);
+    }
+  if (strcmp(value_type, "int") && strcmp(value_type, "str") && strcmp(value_type, "all"))
+    {
+      printf("** unknown value type: %s; available: int, str, all\n", value_type);
+      exit(1);
+    }
+
+  if (max_keys > INT_MAX)
+    {
+      max_keys = INT_MAX;
+    }
+
+  if (!strcmp(value_type, "int") || !strcmp(value_type, "all"))
+    {
+      grow_keys<int>();
+    }
+  if (!strcmp(value_type, "str") || !strcmp(value_type, "all"))
+    {
+      grow_keys<string>();
+    }
+  return 0;
+}
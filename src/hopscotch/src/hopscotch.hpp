@@ -38,6 +38,12 @@ using namespace std;
 #include<immintrin.h>
 #include<malloc.h>
 #include<atomic>
+#include<unistd.h>
+#include<sys/syscall.h>
+#include<linux/futex.h>
+#include<cpuid.h>
+#include<stdlib.h>
+#include<string.h>
 
 // This is one of eight implementations we created for the workshop.
 // In this implementation we used a transactional memory method.
@@ -46,14 +52,34 @@ using namespace std;
 // When executing an action that changes the data, 
 // we initially try to run it as an atomic action,
 // if this attempt fails, we run the action using the fine-grained locking method.
+// Whether the CPU has RTM is checked with CPUID when the table is built, and
+// without it (or with TSX disabled) only the locking method is used, so the
+// same binary runs on every host.
 
 class Hopscotch {
 private:
 	static const int HOP_RANGE = 32;
 	static const int ADD_RANGE = 256;
 	static const int MAX_SEGMENTS = 1048576; // Including neighbourhood for last hash location
+	static const int LOCK_SPINS = 128; // Tries before a waiter sleeps on a bucket lock
+	static const int HTM_RETRIES = 4; // Transactions tried before taking the bucket lock
+	static const int MAX_THREADS = 128; // Threads with their own transaction counters
 	int* BUSY;
 
+public:
+	/*The outcome of the transactions of one or all threads.
+	An operation that gives up on transactions is counted in fallbacks*/
+	struct htm_stats {
+		unsigned long commits;
+		unsigned long conflict;
+		unsigned long capacity;
+		unsigned long explicit_abort;
+		unsigned long other;
+		unsigned long fallbacks;
+	};
+
+private:
+
 	/*Bucket is the table object.
 	Each bucket contains a key and data pairing (as in a usual hashmap),
 	and an "hop_info" variable, containing the information 
@@ -61,49 +87,57 @@ private:
 	struct Bucket {
 	
 		volatile atomic_uint _hop_info;
+		/*_lock is a futex word: 0 when free, 1 when held, and 2 when held
+		with threads sleeping on it. It sits in the padding after _hop_info,
+		so the lock costs no space and a bucket is 24 bytes.
+		The locking and unlocking methods are a part of the Bucket class*/
+		volatile atomic_int _lock;
 		volatile atomic_intptr_t _key;
 		volatile atomic_intptr_t _data;
-		/*We used lock_mutex, lock_cv and a volatile variable
-		in order to implement a reentrant lock.
-		The locking and unlocking methods are a part of the Bucket class*/
-		volatile bool _lock;
-		pthread_mutex_t lock_mutex;
-		pthread_cond_t lock_cv;
 
 		/*The Bucket class constructor*/
 		Bucket() {
 			_hop_info.store(0);
-			_lock = false;
+			_lock.store(0);
 			_key.store(-1);
 			_data.store(-1);
-			pthread_mutex_init(&lock_mutex, NULL);
-			pthread_cond_init(&lock_cv, NULL);
 		}
 
-		/*The Bucket class destructor*/
-		~Bucket() {
-			pthread_mutex_destroy(&lock_mutex);
-			pthread_cond_destroy(&lock_cv);
+		static void futex(volatile atomic_int* word, int op, int val) {
+			syscall(SYS_futex, (int*)word, op, val, NULL, NULL, 0);
 		}
 
+		/*Takes the lock, spinning for a while first since the holder is
+		most likely running on another core, then sleeping on the futex*/
 		void lock() {
-			pthread_mutex_lock(&lock_mutex);
-
-			while(1) {
-				if(_lock == false) {
-					_lock = true;
-					pthread_mutex_unlock(&lock_mutex);
-					break;
+			int c = 0;
+			if(_lock.compare_exchange_strong(c, 1, memory_order_acquire)) {
+				return;
+			}
+			for(int i = 0; i < LOCK_SPINS; ++i) {
+				_mm_pause();
+				c = 0;
+				if(0 == _lock.load(memory_order_relaxed) &&
+				   _lock.compare_exchange_strong(c, 1, memory_order_acquire)) {
+					return;
 				}
-				pthread_cond_wait(&lock_cv, &lock_mutex);
+			}
+			/*Marks the lock contended, so that unlock() wakes us up*/
+			while(0 != _lock.exchange(2, memory_order_acquire)) {
+				futex(&_lock, FUTEX_WAIT_PRIVATE, 2);
 			}
 		}
 
 		void unlock() {
-			pthread_mutex_lock(&lock_mutex);
-			_lock = false;
-			pthread_cond_signal(&lock_cv);
-			pthread_mutex_unlock(&lock_mutex);
+			if(2 == _lock.exchange(0, memory_order_release)) {
+				futex(&_lock, FUTEX_WAKE_PRIVATE, 1);
+			}
+		}
+
+		/*A transaction reads the lock of the bucket it works on, so that
+		it aborts when a thread on the locking path takes it meanwhile*/
+		bool is_locked() {
+			return 0 != _lock.load(memory_order_relaxed);
 		}
 
 	};
@@ -111,10 +145,145 @@ private:
 	/*A pointer to the table*/
 	Bucket* segments_arys;
 
+	/*Whether the transactional path is used, and the counters of its
+	outcome, one cache line per thread*/
+	struct alignas(64) thread_htm_stats {
+		htm_stats s;
+	};
+	bool use_htm;
+	thread_htm_stats* htm_stats_arys;
+
+	/*bool cpu_has_rtm()
+	Returns true if CPUID reports RTM. Setting HOPSCOTCH_HTM=0 in the
+	environment turns the transactional path off on such CPUs too*/
+	static bool cpu_has_rtm() {
+		unsigned int eax, ebx, ecx, edx;
+		const char* env = getenv("HOPSCOTCH_HTM");
+		if(NULL != env && 0 == strcmp(env, "0")) {
+			return false;
+		}
+		if(__get_cpuid_max(0, NULL) < 7) {
+			return false;
+		}
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		return 0 != (ebx & bit_RTM);
+	}
+
+	/*The counters of the calling thread. Threads are numbered on first use,
+	and the ones past MAX_THREADS share counters, which may then be off*/
+	htm_stats& my_htm_stats() {
+		static atomic_int num_threads(0);
+		static __thread int thread_id = -1;
+		if(-1 == thread_id) {
+			thread_id = num_threads.fetch_add(1) % MAX_THREADS;
+		}
+		return htm_stats_arys[thread_id].s;
+	}
+
+	/*bool begin_tx(Bucket* lock_bucket)
+	Starts a transaction that elides the lock of lock_bucket, retrying the
+	aborts that may succeed on a retry, and waiting out the lock if it was
+	held. Returns true inside the transaction, and false if the caller has
+	to take the lock instead*/
+	__attribute__((target("rtm"))) bool begin_tx(Bucket* lock_bucket) {
+		if(!use_htm) {
+			return false;
+		}
+		htm_stats& stats = my_htm_stats();
+		for(int i = 0; i < HTM_RETRIES; ++i) {
+			unsigned int status = _xbegin();
+			if(_XBEGIN_STARTED == status) {
+				if(lock_bucket->is_locked()) {
+					_xabort(0xff);
+				}
+				return true;
+			}
+			if(status & _XABORT_EXPLICIT) {
+				++stats.explicit_abort;
+				while(lock_bucket->is_locked()) {
+					_mm_pause();
+				}
+				continue;
+			}
+			if(status & _XABORT_CONFLICT) {
+				++stats.conflict;
+			} else if(status & _XABORT_CAPACITY) {
+				++stats.capacity;
+			} else {
+				++stats.other;
+			}
+			if(0 == (status & _XABORT_RETRY)) {
+				break;
+			}
+		}
+		++stats.fallbacks;
+		return false;
+	}
+
+	__attribute__((target("rtm"))) void end_tx() {
+		_xend();
+		++my_htm_stats().commits;
+	}
+
 public:
 	Hopscotch();
 	~Hopscotch();
 
+	bool htm_enabled() const {
+		return use_htm;
+	}
+
+	/*htm_stats get_htm_stats()
+	Returns the transaction counters summed over all threads*/
+	htm_stats get_htm_stats() const {
+		htm_stats total;
+		memset(&total, 0, sizeof(total));
+		for(int i = 0; i < MAX_THREADS; i++) {
+			const htm_stats& s = htm_stats_arys[i].s;
+			total.commits += s.commits;
+			total.conflict += s.conflict;
+			total.capacity += s.capacity;
+			total.explicit_abort += s.explicit_abort;
+			total.other += s.other;
+			total.fallbacks += s.fallbacks;
+		}
+		return total;
+	}
+
+	/*inline void print_htm_stats(const htm_stats& since)
+	Prints whether RTM is used, and the abort rates by cause, as a percent
+	of the transactions started since get_htm_stats() returned since*/
+	inline void print_htm_stats(const htm_stats& since) {
+		if(!use_htm) {
+			cout << "HTM: off (no RTM), every update takes the bucket lock" << endl;
+			return;
+		}
+		htm_stats s = get_htm_stats();
+		s.commits -= since.commits;
+		s.conflict -= since.conflict;
+		s.capacity -= since.capacity;
+		s.explicit_abort -= since.explicit_abort;
+		s.other -= since.other;
+		s.fallbacks -= since.fallbacks;
+		const unsigned long aborts = s.conflict + s.capacity + s.explicit_abort + s.other;
+		const double started = (s.commits + aborts) ? (double)(s.commits + aborts) : 1.0;
+		cout << "HTM: on | transactions " << (s.commits + aborts)
+		     << " | commits " << 100.0 * s.commits / started << "%"
+		     << " | aborts: conflict " << 100.0 * s.conflict / started << "%"
+		     << ", capacity " << 100.0 * s.capacity / started << "%"
+		     << ", explicit " << 100.0 * s.explicit_abort / started << "%"
+		     << ", other " << 100.0 * s.other / started << "%"
+		     << " | lock fallbacks " << s.fallbacks << endl;
+	}
+
+	/*inline void print_htm_stats()
+	The same, for all the transactions*/
+	inline void print_htm_stats() {
+		htm_stats none;
+		memset(&none, 0, sizeof(none));
+		print_htm_stats(none);
+	}
+
 	/*inline void trial()
 	This is a method used for debugging purposes*/
 	inline void trial() {
@@ -170,11 +339,15 @@ Hopscotch::Hopscotch() {
 	segments_arys = new Bucket[MAX_SEGMENTS+256];
 	BUSY = (int *)malloc(sizeof(int));
 	*BUSY = -1;
+	use_htm = cpu_has_rtm();
+	htm_stats_arys = (thread_htm_stats*)memalign(64, MAX_THREADS * sizeof(thread_htm_stats));
+	memset(htm_stats_arys, 0, MAX_THREADS * sizeof(thread_htm_stats));
 }
 
 /*Destructor for the Hopscotch class*/
 Hopscotch::~Hopscotch() {
 	delete [] segments_arys;
+	free(htm_stats_arys);
 	free(BUSY);
 }
 
@@ -188,7 +361,6 @@ bool Hopscotch::contains(int *key) {
 			if(mask & hop_info) {
 				Bucket* check_bucket = start_bucket+i;
 				if(*key == (check_bucket->_key).load()) {
-					start_bucket->unlock();
 					return true;
 				}
 			}
@@ -209,9 +381,9 @@ int Hopscotch::remove(int *key) {
 		if(mask & hop_info) {
 			Bucket* check_bucket = start_bucket+i;
 			
-				if (_xbegin() == 0xFFFFFFFF) {
+				if (begin_tx(start_bucket)) {
 					if (-1 == (check_bucket->_key).load()) {
-						_xend();
+						end_tx();
 						return -1;
 					}
 					if(*key == (check_bucket->_key).load()) {
@@ -219,12 +391,12 @@ int Hopscotch::remove(int *key) {
 						check_bucket->_key.store(-1);
 						check_bucket->_data.store(-1);
 						start_bucket->_hop_info.fetch_and(~(1<<i));
-						_xend();
+						end_tx();
 						cout<<"rc1 = "<<rc<<endl;
 						return rc;
 					}
 					else {
-						_xend();
+						end_tx();
 						return -1;
 					}
 				} else {
@@ -277,7 +449,7 @@ void Hopscotch::find_closer_bucket(Bucket** free_bucket, int* free_distance, int
 		}
 		/*When a suitable bucket is found, it's content is moved to the old free_bucket*/
 		if(-1 != move_free_distance) {
-			if(_xbegin() == 0xFFFFFFFF) {
+			if(begin_tx(move_bucket)) {
 				if(start_hop_info == move_bucket->_hop_info.load()) {
 					Bucket* new_free_bucket = move_bucket + move_free_distance;
 					/*Updates move_bucket's hop_info, to indicate the newly inserted bucket*/
@@ -290,9 +462,10 @@ void Hopscotch::find_closer_bucket(Bucket** free_bucket, int* free_distance, int
 					move_bucket->_hop_info.fetch_and(~(1<<move_free_distance));
 					*free_bucket = new_free_bucket;
 					*free_distance = *free_distance - free_dist + move_free_distance;
-					_xend();
+					end_tx();
 					return;
 				}
+				end_tx();
 			} else {
 				move_bucket->lock();
 				if(start_hop_info == move_bucket->_hop_info.load()) {
@@ -341,14 +514,15 @@ bool Hopscotch::add(int *key, int *data) {
 		do{
 			if(free_distance < HOP_RANGE) {
 				/*Inserts the new bucket to the free space*/
-				if (_xbegin() == 0xFFFFFFFF) {
+				if (begin_tx(start_bucket)) {
 					if(contains(key) == false) {
 						start_bucket->_hop_info.fetch_or(1<<free_distance);
 						free_bucket->_data.exchange(*data);
 						free_bucket->_key.exchange(*key);
-						_xend();
+						end_tx();
 						return true;
 					}
+					end_tx();
 				} else {
 					start_bucket->lock();
 					if(contains(key) == false) {
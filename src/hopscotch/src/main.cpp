@@ -26,9 +26,14 @@
 #include "ssmem.h"
 #include "ssalloc.h"
 #include "rapl_read.h"
+#include "op_stream.h"
+#include "mem_footprint.h"
 
 #include "../framework/cpp_framework.h"
 #include "../data_structures/HopscotchHashMap.h"
+#include "../data_structures/BitmapHopscotchHashMap.h"
+#include "../data_structures/ChainedHashMap.h"
+#include "../data_structures/BaselineMaps.h"
 
 
 #ifdef __sparc__
@@ -46,20 +51,111 @@ using namespace std;
  * Definition of macros: per data structure
  * ################################################################### */
 
-//! A concurrent hash table that maps ints to ints
-typedef HopscotchHashMap<int, int, HASH_INT, TTASLock, CMDR::Memory> IntTable;
-IntTable mset;
-
-#define DS_CONTAINS(s,k)    s.containsKey(k);
-#define DS_ADD(s,a,k)       s.putIfAbsent(a, k)
-#define DS_REMOVE(s,k)      s.remove(k)
-#define DS_SIZE(s)          s.size()
+/* Every map variant is compiled with every lock type, and -t / -k pick
+   one of them at run time. A variant gives the concrete map of a lock, and
+   makes one for the initial capacity and number of updating threads. */
+struct hopscotch_variant
+{
+  static const char* name() { return "hopscotch"; }
+  template <class Lock> struct table { typedef HopscotchHashMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct bitmap_variant
+{
+  static const char* name() { return "bitmap"; }
+  template <class Lock> struct table { typedef BitmapHopscotchHashMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct bitmap_soa_variant
+{
+  static const char* name() { return "bitmap-soa"; }
+  template <class Lock> struct table { typedef BitmapHopscotchHashMap<int, int, HASH_INT, Lock, CMDR::Memory, true> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct chained_variant
+{
+  static const char* name() { return "chained"; }
+  template <class Lock> struct table { typedef ChainedHashMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((int) capacity, (int) concurrency);
+  }
+};
+
+/* The baselines of BaselineMaps.h, that the tables are plotted against. They
+   take no lock of -k: they are registered once, under the lock "none", and
+   run with any -k. */
+struct null_variant
+{
+  static const char* name() { return "null"; }
+  template <class Lock> struct table { typedef NullMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct private_std_variant
+{
+  static const char* name() { return "private-std"; }
+  template <class Lock> struct table { typedef PrivateStdMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct private_oa_variant
+{
+  static const char* name() { return "private-oa"; }
+  template <class Lock> struct table { typedef PrivateOpenMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct locked_std_variant
+{
+  static const char* name() { return "locked-std"; }
+  template <class Lock> struct table { typedef LockedStdMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+struct sharded_rw_variant
+{
+  static const char* name() { return "sharded-rw"; }
+  template <class Lock> struct table { typedef ShardedRWMap<int, int, HASH_INT, Lock, CMDR::Memory> type; };
+  template <class Lock> static void* create(size_t capacity, size_t concurrency)
+  {
+    return new typename table<Lock>::type((_u32) capacity, (_u32) concurrency);
+  }
+};
+
+/* putIfAbsent returns the empty data (0) when it adds the key */
+#define DS_CONTAINS(s,k)    s->containsKey(k)
+#define DS_ADD(s,a,k)       (s->putIfAbsent(a, k) == 0)
+#define DS_REMOVE(s,k)      s->remove(k)
+#define DS_SIZE(s)          s->size()
 //#define DS_NEW()            ;
 
 
 #define DS_TYPE             void*
-#define DS_NODE             void*
-#define HASWELL				1
 
 /* ################################################################### *
  * GLOBALS
@@ -73,12 +169,16 @@ size_t update = DEFAULT_UPDATE;
 size_t num_threads = DEFAULT_NB_THREADS; 
 size_t duration = DEFAULT_DURATION;
 size_t density = 50;
+const char* table_name = "hopscotch";
+const char* lock_name = "ttas";
+size_t op_stream_len = 0;
 
 size_t print_vals_num = 100; 
 size_t pf_vals_num = 1023;
 size_t put, put_explicit = false;
 double update_rate, put_rate, get_rate, filling_rate;
 
+size_t size_before = 0;
 size_t size_after = 0;
 int seed = 0;
 __thread unsigned long  *seeds;
@@ -86,6 +186,7 @@ uint32_t rand_max;
 #define rand_min 1
 
 static volatile int stop;
+void* the_table;
 
 volatile ticks *putting_succ;
 volatile ticks *putting_fail;
@@ -114,15 +215,29 @@ extern __thread uint32_t put_num_failed_on_new;
 
 barrier_t barrier, barrier_global;
 
+/* the footprint of a map; its nodes and values come from malloc */
+static void
+footprint_of(const MapMemory& mem, mem_footprint_t* f)
+{
+  memset(f, 0, sizeof(mem_footprint_t));
+  f->table = mem._table;
+  f->locks = mem._locks;
+  f->overflow = mem._overflow;
+  f->garbage = mem._garbage;
+  mem_footprint_malloc(f);
+}
+
 typedef struct thread_data
 {
   uint8_t id;
 //	  unsigned int id;
 } thread_data_t;
 
+template <class IntTable>
 void*
 test(void* thread) 
 {
+  IntTable* mset = (IntTable*) the_table;
   thread_data_t* td = (thread_data_t*) thread;
   uint8_t ID = td->id;
   int phys_id = the_cores[ID];
@@ -149,7 +264,7 @@ test(void* thread)
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -186,11 +301,36 @@ test(void* thread)
     }
   MEM_BARRIER;
 
+  /* the operations of the measured phase, drawn before it starts */
+  op_stream_t* ops = NULL;
+  size_t ops_idx = 0;
+  if (op_stream_len)
+    {
+      ops = op_stream_new(op_stream_len, seeds, rand_max, rand_min);
+    }
+  if (!ID)
+    {
+      printf("#null backend: %.1f cycles/op (%s)\n",
+	     op_stream_null_cycles(ops, op_stream_len - 1, seeds, rand_max, rand_min,
+				   scale_put, scale_rem),
+	     ops != NULL ? "op stream" : "my_random");
+    }
+
+  /* count the retries of the measured phase only */
+  RETRY_STATS_THREAD_INIT(ID);
+
   barrier_cross(&barrier);
 
   if (!ID)
     {
-      printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(mset));
+      size_before = DS_SIZE(mset);
+      printf("#BEFORE size is: %zu\n", size_before);
+      mem_footprint_t f;
+      mem_process_t m;
+      footprint_of(mset->memory(), &f);
+      mem_process_sample(&m);
+      mem_process_print("filled", &m);
+      mem_footprint_print(&f, size_before);
     }
 
 
@@ -200,8 +340,7 @@ test(void* thread)
 
   while (stop == 0)
     {
-      c = (uint32_t)(my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])));
-      key = (c & rand_max) + rand_min;
+      OP_STREAM_OR_RAND_NXT(ops, ops_idx, op_stream_len - 1, c, key, seeds, rand_max, rand_min);
 
       if (unlikely(c <= scale_put))//{}
 	{
@@ -262,6 +401,7 @@ test(void* thread)
 
   barrier_cross(&barrier);
   RR_STOP_SIMPLE();
+  op_stream_free(ops, op_stream_len);
 
   if (!ID)
     {
@@ -300,6 +440,81 @@ test(void* thread)
   pthread_exit(NULL);
 }
 
+/* ################################################################### *
+ * CONFIGURATIONS: map variant x lock type
+ * ################################################################### */
+
+typedef struct ds_config
+{
+  const char* table;
+  const char* lock;
+  size_t lock_size;
+  void* (*create)(size_t capacity, size_t concurrency);
+  void* (*test)(void* thread);
+  MapMemory (*memory)(void* table);
+} ds_config_t;
+
+template <class Variant, class Lock>
+void*
+create_table(size_t capacity, size_t concurrency)
+{
+  return Variant::template create<Lock>(capacity, concurrency);
+}
+
+template <class Variant, class Lock>
+void*
+test_table(void* thread)
+{
+  return test<typename Variant::template table<Lock>::type>(thread);
+}
+
+template <class Variant, class Lock>
+MapMemory
+memory_table(void* table)
+{
+  return ((typename Variant::template table<Lock>::type*) table)->memory();
+}
+
+#define DS_CONFIG(variant, lock, lock_name)				\
+  { variant::name(), lock_name, sizeof(lock), create_table<variant, lock>, \
+      test_table<variant, lock>, memory_table<variant, lock> }
+#define DS_CONFIGS(variant)						\
+  DS_CONFIG(variant, TTASLock, "ttas"),					\
+    DS_CONFIG(variant, TASLock, "tas"),					\
+    DS_CONFIG(variant, TicketLock, "ticket"),				\
+    DS_CONFIG(variant, MCSLock, "mcs"),					\
+    DS_CONFIG(variant, DummyLock, "dummy")
+#define DS_CONFIG_NO_LOCK(variant)					\
+  DS_CONFIG(variant, DummyLock, "none")
+
+static const ds_config_t ds_configs[] =
+  {
+    DS_CONFIGS(hopscotch_variant),
+    DS_CONFIGS(bitmap_variant),
+    DS_CONFIGS(bitmap_soa_variant),
+    DS_CONFIGS(chained_variant),
+    DS_CONFIG_NO_LOCK(null_variant),
+    DS_CONFIG_NO_LOCK(private_std_variant),
+    DS_CONFIG_NO_LOCK(private_oa_variant),
+    DS_CONFIG_NO_LOCK(locked_std_variant),
+    DS_CONFIG_NO_LOCK(sharded_rw_variant),
+  };
+#define DS_NUM_CONFIGS (sizeof(ds_configs) / sizeof(ds_configs[0]))
+
+static const ds_config_t*
+find_config(const char* table, const char* lock)
+{
+  for (size_t c = 0; c < DS_NUM_CONFIGS; c++)
+    {
+      if (!strcmp(ds_configs[c].table, table)
+	  && (!strcmp(ds_configs[c].lock, lock) || !strcmp(ds_configs[c].lock, "none")))
+	{
+	  return ds_configs + c;
+	}
+    }
+  return NULL;
+}
+
 int
 main(int argc, char **argv) 
 {
@@ -320,6 +535,9 @@ main(int argc, char **argv)
     {"print-vals",                required_argument, NULL, 'v'},
     {"density",                   required_argument, NULL, 'f'},
     {"load-factor",               required_argument, NULL, 'l'},
+    {"table",                     required_argument, NULL, 't'},
+    {"lock",                      required_argument, NULL, 'k'},
+    {"op-stream",                 required_argument, NULL, 'O'},
     {NULL, 0, NULL, 0}
   };
 
@@ -327,7 +545,7 @@ main(int argc, char **argv)
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:f:", long_options, &i);
+      c = getopt_long(argc, argv, "hAf:d:i:n:r:s:u:m:a:l:p:b:v:f:t:k:O:", long_options, &i);
 		
       if(c == -1)
 	break;
@@ -370,6 +588,14 @@ main(int argc, char **argv)
 		 "        When using detailed profiling, how many values to print.\n"
 		 "  -f, --density <int>\n"
 		 "        Table density.\n"
+		 "  -t, --table <hopscotch|bitmap|bitmap-soa|chained>\n"
+		 "        Hash map variant (default hopscotch), or a baseline:\n"
+		 "        <null|private-std|private-oa|locked-std|sharded-rw>\n"
+		 "  -k, --lock <ttas|tas|ticket|mcs|dummy>\n"
+		 "        Lock type of the map (default ttas); dummy is for single-threaded runs\n"
+		 "  -O, --op-stream <int>\n"
+		 "        Draw the operations of each thread before the test, into a buffer of <int>\n"
+		 "        operations (rounded up to a power of two) that the test loops over\n"
 		 );
 	  exit(0);
 	case 'd':
@@ -403,6 +629,15 @@ main(int argc, char **argv)
 	case 'f':
 	  density = atoi(optarg);
 	  break;
+	case 't':
+	  table_name = optarg;
+	  break;
+	case 'k':
+	  lock_name = optarg;
+	  break;
+	case 'O':
+	  op_stream_len = pow2roundup(atol(optarg));
+	  break;
 	case '?':
 	default:
 	  printf("Use -h or --help for help\n");
@@ -411,6 +646,22 @@ main(int argc, char **argv)
     }
 
 
+  const ds_config_t* config = find_config(table_name, lock_name);
+  if (config == NULL)
+    {
+      printf("** unknown table / lock: %s / %s; available:\n", table_name, lock_name);
+      for (size_t c = 0; c < DS_NUM_CONFIGS; c++)
+	{
+	  printf("   %s / %s\n", ds_configs[c].table, ds_configs[c].lock);
+	}
+      exit(1);
+    }
+  if (!strcmp(config->lock, "dummy") && num_threads > 1)
+    {
+      printf("** the dummy lock is for single-threaded runs; use -n 1\n");
+      exit(1);
+    }
+
   if (!is_power_of_two(initial))
     {
       size_t initial_pow2 = pow2roundup(initial);
@@ -424,10 +675,7 @@ main(int argc, char **argv)
     }
 
   printf("## Initial: %zu / Range: %zu / Load factor: %zu\n", initial, range, load_factor);
-
-  double kb = initial * sizeof(DS_NODE) / 1024.0;
-  double mb = kb / 1024.0;
-  printf("Sizeof initial: %.2f KB = %.2f MB\n", kb, mb);
+  printf("## Table: %s / Lock: %s (%zu bytes)\n", config->table, config->lock, config->lock_size);
 
   if (!is_power_of_two(range))
     {
@@ -465,6 +713,10 @@ main(int argc, char **argv)
   stop = 0;
 
   maxhtlength = (unsigned int) initial / load_factor;
+  the_table = config->create(maxhtlength, 16);
+  mem_process_t mem;
+  mem_process_sample(&mem);
+  mem_process_print("created", &mem);
 
   /* Initializes the local data */
   putting_succ = (ticks *) calloc(num_threads , sizeof(ticks));
@@ -489,6 +741,11 @@ main(int argc, char **argv)
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -499,7 +756,7 @@ main(int argc, char **argv)
   for(t = 0; t < num_threads; t++)
     {
       tds[t].id = t;
-      rc = pthread_create(&threads[t], &attr, test, tds + t);
+      rc = pthread_create(&threads[t], &attr, config->test, tds + t);
       if (rc)
 	{
 	  printf("ERROR; return code from pthread_create() is %d\n", rc);
@@ -530,6 +787,9 @@ main(int argc, char **argv)
     }
 
   free(tds);
+  mem_footprint_t footprint;
+  footprint_of(config->memory(the_table), &footprint);
+  mem_process_sample(&mem);
     
   volatile ticks putting_suc_total = 0;
   volatile ticks putting_fal_total = 0;
@@ -561,23 +821,23 @@ main(int argc, char **argv)
     }
 //  cout<<"****end"<<endl;
 #if defined(COMPUTE_LATENCY)
-  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
 
   int UNUSED pr = (int) (putting_count_total_succ - removing_count_total_succ);
-  if (size_after != (initial + pr))
+  if (size_after != (size_before + pr))
     {
-      printf("// WRONG size. %zu + %d != %zu\n", initial, pr, size_after);
-      assert(size_after == (initial + pr));
+      printf("// WRONG size. %zu + %d != %zu\n", size_before, pr, size_after);
+      assert(size_after == (size_before + pr));
     }
 
   printf("    : %-10s | %-10s | %-11s | %-11s | %s\n", "total", "success", "succ %", "total %", "effective %");
@@ -598,6 +858,10 @@ main(int argc, char **argv)
   double throughput = (putting_count_total + getting_count_total + removing_count_total) * 1000.0 / duration;
   printf("#txs %zu\t(%-10.0f\n", num_threads, throughput);
   printf("ops/ms:%.3f\n", throughput / 1e3);
+  RETRY_STATS_PRINT(putting_count_total + getting_count_total + removing_count_total);
+  mem_process_print("measured", &mem);
+  mem_footprint_print(&footprint, size_after);
+  mem_efficiency_print(throughput / 1e3, &mem, &footprint);
 
 //  RR_PRINT_UNPROTECTED(RAPL_PRINT_POW);
   RR_PRINT_CORRECTED();    
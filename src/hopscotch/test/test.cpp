@@ -28,7 +28,7 @@
 #include "rapl_read.h"
 
 #include "../framework/cpp_framework.h"
-#include "../data_structures/hopscotch.hpp"
+#include "../src/hopscotch.hpp"
 
 
 #ifdef __sparc__
@@ -45,6 +45,7 @@ using namespace std;
 #define HASWELL				1
 
 Hopscotch *obj;
+Hopscotch::htm_stats htm_before; /* the transactions of the filling */
 int done = 0 ;
 
 unsigned int maxhtlength;
@@ -132,7 +133,7 @@ void* test(void* thread){
     
 #if defined(COMPUTE_LATENCY) && PFD_TYPE == 0
   volatile ticks start_acq, end_acq;
-  volatile ticks correction = getticks_correction_calc();
+  volatile ticks correction = getticks_overhead();
 #endif
     
   seeds = seed_rand();
@@ -174,6 +175,10 @@ void* test(void* thread){
       printf("#BEFORE size is: %zu\n", (size_t) DS_SIZE(mset));
     }
 */
+  if (!ID)
+    {
+      htm_before = obj->get_htm_stats();
+    }
 
   barrier_cross(&barrier_global);
 
@@ -244,6 +249,12 @@ void* test(void* thread){
   barrier_cross(&barrier);
   RR_STOP_SIMPLE();
 
+  /* the transactions of the measured phase */
+  if (!ID)
+    {
+      obj->print_htm_stats(htm_before);
+    }
+
 /*
   if (!ID)
     {
@@ -483,6 +494,11 @@ main(int argc, char **argv)
   barrier_init(&barrier_global, num_threads + 1);
   barrier_init(&barrier, num_threads);
     
+#if defined(COMPUTE_LATENCY)
+  /* the latencies are reported in ns */
+  tsc_calibrate();
+#endif
+
   /* Initialize and set thread detached attribute */
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -559,14 +575,14 @@ main(int argc, char **argv)
     }
 //  cout<<"****end"<<endl;
 #if defined(COMPUTE_LATENCY)
-  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in cycles) \n"); fflush(stdout);
-  long unsigned get_suc = (getting_count_total_succ) ? getting_suc_total / getting_count_total_succ : 0;
-  long unsigned get_fal = (getting_count_total - getting_count_total_succ) ? getting_fal_total / (getting_count_total - getting_count_total_succ) : 0;
-  long unsigned put_suc = putting_count_total_succ ? putting_suc_total / putting_count_total_succ : 0;
-  long unsigned put_fal = (putting_count_total - putting_count_total_succ) ? putting_fal_total / (putting_count_total - putting_count_total_succ) : 0;
-  long unsigned rem_suc = removing_count_total_succ ? removing_suc_total / removing_count_total_succ : 0;
-  long unsigned rem_fal = (removing_count_total - removing_count_total_succ) ? removing_fal_total / (removing_count_total - removing_count_total_succ) : 0;
-  printf("%-7zu %-8lu %-8lu %-8lu %-8lu %-8lu %-8lu\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
+  printf("#thread srch_suc srch_fal insr_suc insr_fal remv_suc remv_fal   ## latency (in ns) \n"); fflush(stdout);
+  double get_suc = (getting_count_total_succ) ? ticks_to_ns(getting_suc_total) / getting_count_total_succ : 0;
+  double get_fal = (getting_count_total - getting_count_total_succ) ? ticks_to_ns(getting_fal_total) / (getting_count_total - getting_count_total_succ) : 0;
+  double put_suc = putting_count_total_succ ? ticks_to_ns(putting_suc_total) / putting_count_total_succ : 0;
+  double put_fal = (putting_count_total - putting_count_total_succ) ? ticks_to_ns(putting_fal_total) / (putting_count_total - putting_count_total_succ) : 0;
+  double rem_suc = removing_count_total_succ ? ticks_to_ns(removing_suc_total) / removing_count_total_succ : 0;
+  double rem_fal = (removing_count_total - removing_count_total_succ) ? ticks_to_ns(removing_fal_total) / (removing_count_total - removing_count_total_succ) : 0;
+  printf("%-7zu %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f %-8.1f\n", num_threads, get_suc, get_fal, put_suc, put_fal, rem_suc, rem_fal);
 #endif
     
 #define LLU long long unsigned int
@@ -36,18 +36,10 @@ __thread long long total_samples[ENTRY_TIMES_SIZE] = {0, 0, 0, 0, 0, 0, 0, 0, 0,
 __thread const char *measurement_msgs[ENTRY_TIMES_SIZE];
 __thread ticks getticks_correction = 0;
 
+/* the overhead of a fenced measurement on the calling thread */
 ticks getticks_correction_calc() 
 {
-#    define GETTICKS_CALC_REPS 1000000
-  ticks t_dur = 0;
-  uint32_t i;
-  for (i = 0; i < GETTICKS_CALC_REPS; i++) {
-    ticks t_start = getticks();
-    ticks t_end = getticks();
-    t_dur += t_end - t_start;
-  }
-  getticks_correction = (ticks)(t_dur / (double) GETTICKS_CALC_REPS);
-  /* printf("(cor: %llu)", (unsigned long long int) getticks_correction); */
+  getticks_correction = getticks_overhead();
   return getticks_correction;
 }
 
@@ -86,12 +78,12 @@ prints_ticks_stats(int start, int end)
 	    }
 	  printf("[%02d]%s:\n", i, measurement_msgs[i]);
 	  double ticks_perc = 100 * ((double) total_sum_ticks[i] / tticks);
-	  double secs = total_sum_ticks[i] / (REF_SPEED_GHZ * 1.e9);
+	  double secs = ticks_to_ns(total_sum_ticks[i]) / 1.e9;
 	  int s = (int) trunc(secs);
 	  int ms = (int) trunc((secs - s) * 1000);
 	  int us = (int) trunc(((secs - s) * 1000000) - (ms * 1000));
 	  int ns = (int) trunc(((secs - s) * 1000000000) - (ms * 1000000) - (us * 1000));
-	  double secsa = (total_sum_ticks[i] / total_samples[i]) / (REF_SPEED_GHZ * 1.e9);
+	  double secsa = (ticks_to_ns(total_sum_ticks[i]) / total_samples[i]) / 1.e9;
 	  int sa = (int) trunc(secsa);
 	  int msa = (int) trunc((secsa - sa) * 1000);
 	  int usa = (int) trunc(((secsa - sa) * 1000000) - (msa * 1000));
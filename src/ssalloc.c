@@ -32,47 +32,289 @@
 #include <string.h>
 #include <assert.h>
 #include <malloc.h>
+#if defined(NUMA) && !defined(SSALLOC_USE_MALLOC)
+#  include <numa.h>
+#endif
 
 #include "ssalloc.h"
 #include "measurements.h"
 
-#define SSMEM_CACHE_LINE_SIZE 64
-
 #if !defined(SSALLOC_USE_MALLOC)
-static __thread uintptr_t ssalloc_app_mem[SSALLOC_NUM_ALLOCATORS];
-static __thread size_t alloc_next[SSALLOC_NUM_ALLOCATORS] = {0};
-static __thread void* ssalloc_free_list[SSALLOC_NUM_ALLOCATORS][256] = {{0}};
-static __thread uint8_t ssalloc_free_cur[SSALLOC_NUM_ALLOCATORS] = {0};
-static __thread uint8_t ssalloc_free_num[SSALLOC_NUM_ALLOCATORS] = {0};
-#endif 
 
-void
-ssalloc_set(void* mem)
-{
-#if !defined(SSALLOC_USE_MALLOC)
-  ssalloc_app_mem[0] = (uintptr_t) mem;
+#if !defined(likely)
+#  define likely(x)       __builtin_expect((x), 1)
+#  define unlikely(x)     __builtin_expect((x), 0)
 #endif
+
+#define SSALLOC_CLASS_LARGE SSALLOC_NUM_CLASSES
+#define SSALLOC_RUNS_PER_CHUNK (SSALLOC_CHUNK_SIZE / SSALLOC_RUN_SIZE)
+
+static const uint32_t ssalloc_class_size[SSALLOC_NUM_CLASSES] =
+  {
+    8, 16, 24, 32, 48, 64, 80, 96, 128, 160, 192, 256,
+    320, 384, 512, 640, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192
+  };
+
+/* a chunk of an arena */
+typedef struct ssalloc_chunk
+{
+  uintptr_t base;
+  struct ssalloc_arena* owner;
+  size_t runs;			/* runs carved out of the chunk so far */
+  size_t carved;		/* bytes of objects in these runs */
+  size_t free;			/* bytes of them on the free lists (while trimming) */
+  struct ssalloc_chunk* next;
+} ssalloc_chunk_t;
+
+/* the header of a run, or of a large object's mapping */
+typedef struct ssalloc_run
+{
+  uint32_t class_id;
+  uint32_t obj_size;
+  ssalloc_chunk_t* chunk;	/* the chunk of the run */
+  size_t mapped;		/* bytes of the mapping of a large object */
+} ssalloc_run_t;
+
+/* an object on a free list */
+typedef struct ssalloc_free
+{
+  struct ssalloc_free* next;
+} ssalloc_free_t;
+
+typedef struct ssalloc_arena
+{
+  uintptr_t bump[SSALLOC_NUM_CLASSES]; /* next object in the run a class carves from */
+  uintptr_t bump_end[SSALLOC_NUM_CLASSES];
+  ssalloc_free_t* free_list[SSALLOC_NUM_CLASSES];
+  size_t free_bytes;		/* bytes on the free lists */
+  size_t trim_at;		/* free_bytes that trigger the next trim (and SSALLOC_TRIM_SIZE) */
+  ssalloc_chunk_t* chunks;	/* the chunks in use, the newest (being carved) first */
+  ssalloc_chunk_t* empty;	/* trimmed chunks, reused before new ones are mapped */
+  size_t mapped;
+} ssalloc_arena_t;
+
+static __thread ssalloc_arena_t ssalloc_arenas[SSALLOC_NUM_ALLOCATORS];
+
+static inline uint32_t
+ssalloc_class_of(size_t size)
+{
+  uint32_t c = 0;
+  while (ssalloc_class_size[c] < size)
+    {
+      c++;
+    }
+  return c;
 }
 
-void
-ssalloc_init()
+static inline ssalloc_run_t*
+ssalloc_run_of(void* ptr)
 {
-#if !defined(SSALLOC_USE_MALLOC)
-  int i;
-  for (i = 0; i < SSALLOC_NUM_ALLOCATORS; i++)
+  return (ssalloc_run_t*) ((uintptr_t) ptr & ~(SSALLOC_RUN_SIZE - 1));
+}
+
+static void
+ssalloc_oom(size_t size)
+{
+  fprintf(stderr, "*** error: ssalloc: cannot map %zu bytes: %s\n", size, strerror(errno));
+  abort();
+}
+
+/* maps size bytes, aligned to align (a multiple of the page size) */
+static void*
+ssalloc_map(size_t size, size_t align)
+{
+  const size_t len = size + align;
+  uintptr_t mem = (uintptr_t) mmap(NULL, len, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if ((void*) mem == MAP_FAILED)
+    {
+      ssalloc_oom(size);
+    }
+  const uintptr_t aligned = (mem + align - 1) & ~(align - 1);
+  if (aligned > mem)
     {
-      ssalloc_app_mem[i] = (uintptr_t) memalign(SSMEM_CACHE_LINE_SIZE, SSALLOC_SIZE);
-      assert((void*) ssalloc_app_mem[i] != NULL);
+      munmap((void*) mem, aligned - mem);
+    }
+  if (mem + len > aligned + size)
+    {
+      munmap((void*) (aligned + size), mem + len - (aligned + size));
+    }
+#if defined(MADV_HUGEPAGE) && !defined(SSALLOC_NO_HUGEPAGES)
+  if (size >= SSALLOC_CHUNK_SIZE)
+    {
+      madvise((void*) aligned, size, MADV_HUGEPAGE);
     }
 #endif
+  return (void*) aligned;
 }
 
-void
-ssalloc_offset(size_t size)
+/* gives class c of arena a a new run to carve objects from */
+static void
+ssalloc_run_new(ssalloc_arena_t* a, uint32_t c)
 {
-#if !defined(SSALLOC_USE_MALLOC)
-  ssalloc_app_mem[0] += size;
+  ssalloc_chunk_t* chunk = a->chunks;
+  if (chunk == NULL || chunk->runs == SSALLOC_RUNS_PER_CHUNK)
+    {
+      chunk = a->empty;
+      if (chunk != NULL)
+	{
+	  a->empty = chunk->next;
+	}
+      else
+	{
+	  chunk = (ssalloc_chunk_t*) malloc(sizeof(ssalloc_chunk_t));
+	  assert(chunk != NULL);
+	  chunk->base = (uintptr_t) ssalloc_map(SSALLOC_CHUNK_SIZE, SSALLOC_CHUNK_SIZE);
+#if defined(NUMA)
+	  /* prefer the node of the thread, before anything touches the chunk;
+	     without NUMA, the thread touching it first places it there too */
+	  if (numa_available() >= 0)
+	    {
+	      numa_setlocal_memory((void*) chunk->base, SSALLOC_CHUNK_SIZE);
+	    }
 #endif
+	  chunk->owner = a;
+	  a->mapped += SSALLOC_CHUNK_SIZE;
+	}
+      chunk->runs = 0;
+      chunk->carved = 0;
+      chunk->next = a->chunks;
+      a->chunks = chunk;
+    }
+
+  ssalloc_run_t* run = (ssalloc_run_t*) (chunk->base + chunk->runs * SSALLOC_RUN_SIZE);
+  const uint32_t size = ssalloc_class_size[c];
+  run->class_id = c;
+  run->obj_size = size;
+  run->chunk = chunk;
+  chunk->runs++;
+  chunk->carved += ((SSALLOC_RUN_SIZE - SSALLOC_RUN_HEADER) / size) * size;
+
+  a->bump[c] = (uintptr_t) run + SSALLOC_RUN_HEADER;
+  a->bump_end[c] = (uintptr_t) run + SSALLOC_RUN_SIZE;
+}
+
+static void*
+ssalloc_large(size_t alignment, size_t size)
+{
+  const size_t offset = alignment > SSALLOC_RUN_HEADER ? alignment : SSALLOC_RUN_HEADER;
+  const size_t mapped = (offset + size + getpagesize() - 1) & ~((size_t) getpagesize() - 1);
+  ssalloc_run_t* run = (ssalloc_run_t*) ssalloc_map(mapped, SSALLOC_RUN_SIZE);
+  run->class_id = SSALLOC_CLASS_LARGE;
+  run->obj_size = 0;
+  run->chunk = NULL;
+  run->mapped = mapped;
+  return (void*) ((uintptr_t) run + offset);
+}
+
+static inline void*
+ssalloc_class_alloc(ssalloc_arena_t* a, uint32_t c)
+{
+  ssalloc_free_t* obj = a->free_list[c];
+  if (obj != NULL)
+    {
+      a->free_list[c] = obj->next;
+      a->free_bytes -= ssalloc_class_size[c];
+      return (void*) obj;
+    }
+
+  if (unlikely(a->bump[c] + ssalloc_class_size[c] > a->bump_end[c]))
+    {
+      ssalloc_run_new(a, c);
+    }
+  void* ret = (void*) a->bump[c];
+  a->bump[c] += ssalloc_class_size[c];
+  return ret;
+}
+
+/* the chunks whose objects are all on the free lists of the thread are
+   taken off the lists, their memory is given back, and they are kept for
+   reuse. Chunks with a run that a class still carves from are left alone,
+   as are chunks some of whose objects are on other threads' lists. */
+static size_t
+ssalloc_trim_arena(ssalloc_arena_t* a)
+{
+  ssalloc_chunk_t* chunk;
+  for (chunk = a->chunks; chunk != NULL; chunk = chunk->next)
+    {
+      chunk->free = 0;
+    }
+
+  uint32_t c;
+  for (c = 0; c < SSALLOC_NUM_CLASSES; c++)
+    {
+      ssalloc_free_t* obj;
+      for (obj = a->free_list[c]; obj != NULL; obj = obj->next)
+	{
+	  ssalloc_chunk_t* ch = ssalloc_run_of(obj)->chunk;
+	  if (ch->owner == a)
+	    {
+	      ch->free += ssalloc_class_size[c];
+	    }
+	}
+    }
+
+  for (c = 0; c < SSALLOC_NUM_CLASSES; c++)
+    {
+      if (a->bump[c] < a->bump_end[c])
+	{
+	  ssalloc_run_of((void*) a->bump[c])->chunk->free = 0;
+	}
+    }
+
+  /* a chunk is trimmed when free == carved */
+  size_t trimmed = 0;
+  for (c = 0; c < SSALLOC_NUM_CLASSES; c++)
+    {
+      ssalloc_free_t** prev = &a->free_list[c];
+      ssalloc_free_t* obj = *prev;
+      while (obj != NULL)
+	{
+	  ssalloc_chunk_t* ch = ssalloc_run_of(obj)->chunk;
+	  if (ch->owner == a && ch->carved > 0 && ch->free == ch->carved)
+	    {
+	      *prev = obj->next;
+	      a->free_bytes -= ssalloc_class_size[c];
+	    }
+	  else
+	    {
+	      prev = &obj->next;
+	    }
+	  obj = *prev;
+	}
+    }
+
+  ssalloc_chunk_t** prev = &a->chunks;
+  chunk = *prev;
+  while (chunk != NULL)
+    {
+      if (chunk->carved > 0 && chunk->free == chunk->carved)
+	{
+	  *prev = chunk->next;
+	  madvise((void*) chunk->base, SSALLOC_CHUNK_SIZE, MADV_DONTNEED);
+	  trimmed += SSALLOC_CHUNK_SIZE;
+	  chunk->next = a->empty;
+	  a->empty = chunk;
+	}
+      else
+	{
+	  prev = &chunk->next;
+	}
+      chunk = *prev;
+    }
+
+  /* don't walk the free lists again before they grow by as much */
+  a->trim_at = 2 * a->free_bytes;
+  return trimmed;
+}
+
+#endif	/* !SSALLOC_USE_MALLOC */
+
+void
+ssalloc_init()
+{
+  /* the arenas of a thread start empty, and map their chunks on the first
+     allocations, so there is nothing to set up */
 }
 
 void*
@@ -83,20 +325,13 @@ ssalloc_alloc(unsigned int allocator, size_t size)
 #if defined(SSALLOC_USE_MALLOC)
   ret = (void*) malloc(size);
 #else
-  if (ssalloc_free_num[allocator] > 2)
+  if (unlikely(size > SSALLOC_MAX_SMALL))
     {
-      uint8_t spot = ssalloc_free_cur[allocator] - ssalloc_free_num[allocator];
-      ret = ssalloc_free_list[allocator][spot];
-      ssalloc_free_num[allocator]--;
+      ret = ssalloc_large(SSALLOC_RUN_HEADER, size);
     }
   else
     {
-      ret = (void*) (ssalloc_app_mem[allocator] + alloc_next[allocator]);
-      alloc_next[allocator] += size;
-      if (alloc_next[allocator] > SSALLOC_SIZE)
-	{
-	  fprintf(stderr, "*** warning: allocator %2d : out of bounds alloc\n", allocator);
-	}
+      ret = ssalloc_class_alloc(&ssalloc_arenas[allocator], ssalloc_class_of(size));
     }
 #endif
   return ret;
@@ -116,23 +351,27 @@ ssalloc_aligned_alloc(unsigned int allocator, size_t alignement, size_t size)
 #if defined(SSALLOC_USE_MALLOC)
   ret = (void*) memalign(alignement, size);
 #else
-  ret = (void*) (ssalloc_app_mem[allocator] + alloc_next[allocator]);
-  uintptr_t retu = (uintptr_t) ret;
-  if ((retu & (alignement - 1)) != 0)
+  /* the objects of a run start at a cache line, so a class whose size is a
+     multiple of alignement gives aligned objects */
+  uint32_t c = size > SSALLOC_MAX_SMALL ? SSALLOC_CLASS_LARGE : ssalloc_class_of(size);
+  if (alignement > SSALLOC_RUN_HEADER)
     {
-      size_t offset = alignement - (retu & (alignement - 1));
-      retu += offset;
-      alloc_next[allocator] += offset;
-      ret = (void*) retu;
+      c = SSALLOC_CLASS_LARGE;
     }
-
-  alloc_next[allocator] += size;
-
-  assert((((uintptr_t) ret) & (alignement-1)) == 0);
-  if (alloc_next[allocator] > SSALLOC_SIZE)
+  while (c < SSALLOC_CLASS_LARGE && (ssalloc_class_size[c] & (alignement - 1)) != 0)
     {
-      fprintf(stderr, "*** warning: allocator %2d : out of bounds alloc\n", allocator);
+      c++;
     }
+  if (c == SSALLOC_CLASS_LARGE)
+    {
+      assert(alignement < SSALLOC_RUN_SIZE);
+      ret = ssalloc_large(alignement, size);
+    }
+  else
+    {
+      ret = ssalloc_class_alloc(&ssalloc_arenas[allocator], c);
+    }
+  assert((((uintptr_t) ret) & (alignement-1)) == 0);
 #endif
   return ret;
 }
@@ -149,15 +388,51 @@ ssfree_alloc(unsigned int allocator, void* ptr)
 #if defined(SSALLOC_USE_MALLOC)
   free(ptr);
 #else
-  ssalloc_free_num[allocator]++;
-  /* PRINT("free %3d (num_free after: %3d)", ssalloc_free_cur, ssalloc_free_num); */
-  ssalloc_free_list[allocator][ssalloc_free_cur[allocator]++] = ptr;
+  if (ptr == NULL)
+    {
+      return;
+    }
+  ssalloc_run_t* run = ssalloc_run_of(ptr);
+  if (unlikely(run->class_id == SSALLOC_CLASS_LARGE))
+    {
+      munmap((void*) run, run->mapped);
+      return;
+    }
+
+  ssalloc_arena_t* a = &ssalloc_arenas[allocator];
+  ssalloc_free_t* obj = (ssalloc_free_t*) ptr;
+  obj->next = a->free_list[run->class_id];
+  a->free_list[run->class_id] = obj;
+  a->free_bytes += run->obj_size;
+  if (unlikely(a->free_bytes >= SSALLOC_TRIM_SIZE && a->free_bytes >= a->trim_at))
+    {
+      ssalloc_trim_arena(a);
+    }
 #endif
 }
 
-
 void
 ssfree(void* ptr)
 {
   ssfree_alloc(0, ptr);
 }
+
+size_t
+ssalloc_trim(unsigned int allocator)
+{
+#if defined(SSALLOC_USE_MALLOC)
+  return 0;
+#else
+  return ssalloc_trim_arena(&ssalloc_arenas[allocator]);
+#endif
+}
+
+size_t
+ssalloc_mapped(unsigned int allocator)
+{
+#if defined(SSALLOC_USE_MALLOC)
+  return 0;
+#else
+  return ssalloc_arenas[allocator].mapped;
+#endif
+}